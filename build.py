@@ -198,6 +198,7 @@ class KithareBuilder:
         self.cflags = [
             "-O3",
             "-std=c++14",
+            "-pthread",
             "-lSDL2",
             "-lSDL2main",
             "-lSDL2_image",
@@ -9,6 +9,8 @@
 #include <memory>
 #include <vector>
 
+#include <kithare/json.hpp>
+#include <kithare/sink.hpp>
 #include <kithare/string.hpp>
 #include <kithare/token.hpp>
 
@@ -35,7 +37,7 @@ namespace kh {
     class AstRevUnaryOperation;
     class AstBinaryOperation;
     class AstTernaryOperation;
-    class AstComparisonOperation;
+    class AstComparisonExpression;
     class AstSubscriptExpression;
     class AstCallExpression;
     class AstScoping;
@@ -44,6 +46,8 @@ namespace kh {
     class AstList;
     class AstDict;
 
+    class LazyBody;
+
     std::u32string str(const kh::AstModule& module_ast, size_t indent = 0);
     std::u32string str(const kh::AstImport& import_ast, size_t indent = 0);
     std::u32string str(const kh::AstUserType& type_ast, size_t indent = 0);
@@ -127,7 +131,8 @@ namespace kh {
 
         virtual ~AstBody() {}
 
-        virtual std::u32string str(size_t indent = 0) const;
+        /* Dumps the AST with `kh::AstWriter` */
+        std::u32string str(size_t indent = 0) const;
     };
 
     class AstExpression : public kh::AstBody {
@@ -152,8 +157,6 @@ namespace kh {
         } expression_type = kh::AstExpression::NONE;
 
         virtual ~AstExpression() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
     };
 
     class AstIdentifiers : public kh::AstExpression {
@@ -168,8 +171,6 @@ namespace kh {
                        const std::vector<size_t>& _generics_refs,
                        const std::vector<std::vector<uint64_t>>& _generics_array);
         virtual ~AstIdentifiers() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
     };
 
     class AstDeclaration : public kh::AstExpression {
@@ -186,9 +187,7 @@ namespace kh {
         AstDeclaration(size_t _index, const kh::AstIdentifiers& _var_type,
                        const std::vector<uint64_t>& _var_array, const std::string& _var_name,
                        std::shared_ptr<kh::AstExpression>& _expression, size_t _refs);
-        virtual ~AstDeclaration() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstDeclaration();
     };
 
     class AstFunction : public kh::AstExpression {
@@ -205,6 +204,14 @@ namespace kh {
         std::vector<std::shared_ptr<kh::AstBody>> body;
         bool is_conditional;
 
+        /* Token range of the body, from its opening to past its closing curly bracket, when it was
+         * skipped to be parsed lazily. Both are 0 if the body was parsed */
+        size_t body_begin = 0;
+        size_t body_end = 0;
+
+        /* Set instead of `body` when the body is parsed on demand, shared between copies */
+        std::shared_ptr<kh::LazyBody> lazy_body;
+
         bool is_public = true;
         bool is_static = false;
 
@@ -214,9 +221,10 @@ namespace kh {
                     const kh::AstIdentifiers& _return_type, size_t _return_refs,
                     const std::vector<kh::AstDeclaration>& _arguments,
                     const std::vector<std::shared_ptr<kh::AstBody>>& _body, bool _is_conditional);
-        virtual ~AstFunction() {}
+        virtual ~AstFunction();
 
-        virtual std::u32string str(size_t indent = 0) const;
+        /* Gets the body, parsing it first if it's lazy */
+        const std::vector<std::shared_ptr<kh::AstBody>>& getBody() const;
     };
 
     class AstUnaryOperation : public kh::AstExpression {
@@ -226,9 +234,7 @@ namespace kh {
 
         AstUnaryOperation(size_t _index, kh::Operator _operation,
                           std::shared_ptr<kh::AstExpression>& _rvalue);
-        virtual ~AstUnaryOperation() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstUnaryOperation();
     };
 
     class AstRevUnaryOperation : public kh::AstExpression {
@@ -238,9 +244,7 @@ namespace kh {
 
         AstRevUnaryOperation(size_t _index, kh::Operator _operation,
                              std::shared_ptr<kh::AstExpression>& _rvalue);
-        virtual ~AstRevUnaryOperation() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstRevUnaryOperation();
     };
 
     class AstBinaryOperation : public kh::AstExpression {
@@ -252,9 +256,7 @@ namespace kh {
         AstBinaryOperation(size_t _index, kh::Operator _operation,
                            std::shared_ptr<kh::AstExpression>& _lvalue,
                            std::shared_ptr<kh::AstExpression>& _rvalue);
-        virtual ~AstBinaryOperation() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstBinaryOperation();
     };
 
     class AstTernaryOperation : public kh::AstExpression {
@@ -266,9 +268,7 @@ namespace kh {
         AstTernaryOperation(size_t _index, std::shared_ptr<kh::AstExpression>& _condition,
                             std::shared_ptr<kh::AstExpression>& _value,
                             std::shared_ptr<kh::AstExpression>& _otherwise);
-        virtual ~AstTernaryOperation() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstTernaryOperation();
     };
 
     class AstComparisonExpression : public kh::AstExpression {
@@ -278,9 +278,7 @@ namespace kh {
 
         AstComparisonExpression(size_t _index, const std::vector<kh::Operator>& _operations,
                                 const std::vector<std::shared_ptr<kh::AstExpression>>& _values);
-        virtual ~AstComparisonExpression() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstComparisonExpression();
     };
 
     class AstSubscriptExpression : public kh::AstExpression {
@@ -290,9 +288,7 @@ namespace kh {
 
         AstSubscriptExpression(size_t _index, std::shared_ptr<kh::AstExpression>& _expression,
                                const std::vector<std::shared_ptr<kh::AstExpression>>& _arguments);
-        virtual ~AstSubscriptExpression() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstSubscriptExpression();
     };
 
     class AstCallExpression : public kh::AstExpression {
@@ -302,9 +298,7 @@ namespace kh {
 
         AstCallExpression(size_t _index, std::shared_ptr<kh::AstExpression>& _expression,
                           const std::vector<std::shared_ptr<kh::AstExpression>>& _arguments);
-        virtual ~AstCallExpression() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstCallExpression();
     };
 
     class AstScoping : public kh::AstExpression {
@@ -314,9 +308,7 @@ namespace kh {
 
         AstScoping(size_t _index, std::shared_ptr<kh::AstExpression>& _expression,
                    const std::vector<std::string>& _identifiers);
-        virtual ~AstScoping() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstScoping();
     };
 
     class AstValue : public kh::AstExpression {
@@ -347,8 +339,6 @@ namespace kh {
         AstValue(size_t _index, const std::u32string& _string,
                  kh::AstValue::ValueType _value_type = kh::AstValue::ValueType::STRING);
         virtual ~AstValue() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
     };
 
     class AstTuple : public kh::AstExpression {
@@ -356,9 +346,7 @@ namespace kh {
         std::vector<std::shared_ptr<kh::AstExpression>> elements;
 
         AstTuple(size_t _index, const std::vector<std::shared_ptr<kh::AstExpression>>& _elements);
-        virtual ~AstTuple() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstTuple();
     };
 
     class AstList : public kh::AstExpression {
@@ -366,9 +354,7 @@ namespace kh {
         std::vector<std::shared_ptr<kh::AstExpression>> elements;
 
         AstList(size_t _index, const std::vector<std::shared_ptr<kh::AstExpression>>& _elements);
-        virtual ~AstList() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstList();
     };
 
     class AstDict : public kh::AstExpression {
@@ -378,9 +364,7 @@ namespace kh {
 
         AstDict(size_t _index, const std::vector<std::shared_ptr<kh::AstExpression>>& _keys,
                 const std::vector<std::shared_ptr<kh::AstExpression>>& _items);
-        virtual ~AstDict() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstDict();
     };
 
     class AstIf : public kh::AstBody {
@@ -393,9 +377,7 @@ namespace kh {
         AstIf(size_t _index, const std::vector<std::shared_ptr<kh::AstExpression>>& _conditions,
               const std::vector<std::vector<std::shared_ptr<kh::AstBody>>>& _bodies,
               const std::vector<std::shared_ptr<kh::AstBody>>& _else_body);
-        virtual ~AstIf() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstIf();
     };
 
     class AstWhile : public kh::AstBody {
@@ -405,9 +387,7 @@ namespace kh {
 
         AstWhile(size_t _index, std::shared_ptr<kh::AstExpression>& _condition,
                  const std::vector<std::shared_ptr<kh::AstBody>>& _body);
-        virtual ~AstWhile() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstWhile();
     };
 
     class AstDoWhile : public kh::AstBody {
@@ -417,9 +397,7 @@ namespace kh {
 
         AstDoWhile(size_t _index, std::shared_ptr<kh::AstExpression>& _condition,
                    const std::vector<std::shared_ptr<kh::AstBody>>& _body);
-        virtual ~AstDoWhile() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstDoWhile();
     };
 
     class AstFor : public kh::AstBody {
@@ -432,9 +410,7 @@ namespace kh {
         AstFor(size_t _index, std::shared_ptr<kh::AstExpression>& initialize,
                std::shared_ptr<kh::AstExpression>& condition, std::shared_ptr<kh::AstExpression>& step,
                const std::vector<std::shared_ptr<kh::AstBody>>& _body);
-        virtual ~AstFor() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstFor();
     };
 
     class AstForEach : public kh::AstBody {
@@ -446,9 +422,7 @@ namespace kh {
         AstForEach(size_t _index, std::shared_ptr<kh::AstExpression>& _target,
                    std::shared_ptr<kh::AstExpression>& _iterator,
                    const std::vector<std::shared_ptr<kh::AstBody>>& _body);
-        virtual ~AstForEach() {}
-
-        virtual std::u32string str(size_t indent = 0) const;
+        virtual ~AstForEach();
     };
 
     class AstStatement : public kh::AstBody {
@@ -461,8 +435,75 @@ namespace kh {
         AstStatement(size_t _index, kh::AstStatement::Type _statement_type,
                      std::shared_ptr<kh::AstExpression>& _expression);
         AstStatement(size_t _index, kh::AstStatement::Type _statement_type, size_t _loop_count);
-        virtual ~AstStatement() {}
+        virtual ~AstStatement();
+    };
 
-        virtual std::u32string str(size_t indent = 0) const;
+    /* Streams the textual dump of ASTs as UTF-8 into a sink, in the same format `kh::str` returns */
+    class AstWriter {
+    public:
+        AstWriter(kh::Sink& _sink);
+
+        void write(const kh::AstModule& module_ast, size_t indent = 0);
+        void write(const kh::AstImport& import_ast, size_t indent = 0);
+        void write(const kh::AstUserType& type_ast, size_t indent = 0);
+        void write(const kh::AstEnumType& enum_ast, size_t indent = 0);
+        void write(const kh::AstBody& body_ast, size_t indent = 0);
+
+    private:
+        kh::Sink& sink;
+
+        /* Cached indentation, which only grows to the deepest level written so far */
+        std::string tabs;
+
+        void line(size_t indent);
+        void writeNames(const std::vector<std::string>& names, const char* separator);
+        void writeType(const kh::AstIdentifiers& type, size_t refs, const std::vector<uint64_t>& array,
+                       size_t indent);
+        void writeChild(const char* label, const std::shared_ptr<kh::AstExpression>& child,
+                        size_t indent);
+        void writeBody(const char* label, const std::vector<std::shared_ptr<kh::AstBody>>& body,
+                       size_t indent);
+
+        void writeExpression(const kh::AstExpression& expr_ast, size_t indent);
+        void writeIdentifiers(const kh::AstIdentifiers& identifiers_ast, size_t indent);
+        void writeDeclaration(const kh::AstDeclaration& declaration_ast, size_t indent);
+        void writeFunction(const kh::AstFunction& function_ast, size_t indent);
+        void writeComparison(const kh::AstComparisonExpression& comparison_ast, size_t indent);
+        void writeScoping(const kh::AstScoping& scoping_ast, size_t indent);
+        void writeValue(const kh::AstValue& value_ast);
+        void writeElements(const char* header,
+                           const std::vector<std::shared_ptr<kh::AstExpression>>& elements,
+                           size_t indent);
+        void writeDict(const kh::AstDict& dict_ast, size_t indent);
+        void writeIf(const kh::AstIf& if_ast, size_t indent);
+        void writeStatement(const kh::AstStatement& statement_ast, size_t indent);
+    };
+
+    /* Streams ASTs as JSON, every node is an object with its `kind` and source `index` */
+    class AstJsonWriter {
+    public:
+        AstJsonWriter(kh::JsonWriter& _json);
+
+        void write(const kh::AstModule& module_ast);
+        void write(const kh::AstImport& import_ast);
+        void write(const kh::AstUserType& type_ast);
+        void write(const kh::AstEnumType& enum_ast);
+        void write(const kh::AstBody& body_ast);
+
+    private:
+        kh::JsonWriter& json;
+
+        void begin(const char* kind, size_t index);
+        void writeDimensions(const char* name, const std::vector<uint64_t>& dimensions);
+        void writeChild(const char* name, const std::shared_ptr<kh::AstExpression>& child);
+        void writeChildren(const char* name,
+                           const std::vector<std::shared_ptr<kh::AstExpression>>& children);
+        void writeBody(const char* name, const std::vector<std::shared_ptr<kh::AstBody>>& body);
+
+        void writeExpression(const kh::AstExpression& expr_ast);
+        void writeIdentifiers(const kh::AstIdentifiers& identifiers_ast);
+        void writeDeclaration(const kh::AstDeclaration& declaration_ast);
+        void writeFunction(const kh::AstFunction& function_ast);
+        void writeValue(const kh::AstValue& value_ast);
     };
 }
@@ -6,9 +6,165 @@
 
 #pragma once
 
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <kithare/ast.hpp>
+#include <kithare/exception.hpp>
 #include <kithare/ir.hpp>
+#include <kithare/symbols.hpp>
+#include <kithare/thread_pool.hpp>
+#include <kithare/token.hpp>
+
+/* How deeply generics can instantiate each other, which stops ones recursing with ever larger type
+ * arguments such as `f!T` calling `f!(list!T)` */
+#define KH_GENERIC_DEPTH_LIMIT 64
 
 
 namespace kh {
-    class Builder {};
+    class BuildException : public kh::Exception {
+    public:
+        std::string what;
+        size_t index;
+
+        /* Filled in by `kh::locate`, the AST only knows the source index */
+        size_t line = 0;
+        size_t column = 0;
+
+        BuildException(const std::string& _what, size_t _index) : what(_what), index(_index) {}
+        virtual ~BuildException() {}
+        virtual std::string format() const;
+    };
+
+    /* Fills in the lines and columns of the exceptions from the tokens of the source */
+    void locate(std::vector<kh::BuildException>& exceptions, const std::vector<kh::Token>& tokens);
+
+    /* What a name declared at the top level of a module refers to */
+    struct BuildSymbol {
+        enum Kind { FUNCTION, GENERIC_FUNCTION, TYPE, ENUM, GLOBAL } kind;
+
+        /* Index of the function or global in the module, of the generic function in the builder,
+         * or of the user type or enum in the AST */
+        uint32_t id;
+
+        /* The type of functions, types, enums and globals */
+        const kh::IrType* type;
+    };
+
+    /* The types generic arguments are bound to, keyed by the IDs of their names */
+    typedef kh::IdMap<const kh::IrType*> GenericBindings;
+
+    /* A function body waiting to be lowered, with the results of lowering it */
+    struct BuildTask {
+        kh::IrFunction* function;
+
+        /* None for the module initializer which assigns the globals */
+        const kh::AstFunction* function_ast;
+
+        kh::GenericBindings bindings;
+        size_t depth = 0;
+
+        /* Constants of the function, merged into the module afterwards */
+        kh::IrModule scratch;
+        std::vector<kh::BuildException> errors;
+    };
+
+    /* Semantic analysis of a module, lowering it into IR. The top level declarations are collected
+     * first into a symbol table which is only read afterwards, then every function body is type
+     * checked and lowered on its own task of a thread pool */
+    class Builder {
+    public:
+        std::vector<kh::BuildException> exceptions;
+
+        Builder(const kh::AstModule& _module_ast, kh::IrModule& _module_ir);
+
+        /* A worker count of 0 uses the amount of hardware threads available. The IR and the
+         * exceptions, which are sorted by where they are in the source, don't depend on it */
+        void build(size_t workers = 0);
+
+        const kh::AstModule& moduleAst() const;
+        const kh::IrModule& moduleIr() const;
+
+        /* Gets the declaration of a name at the top level of the module, or null. The declarations
+         * don't change after they're collected, so the tasks look them up without locking */
+        const kh::BuildSymbol* symbol(uint32_t id) const;
+        const kh::BuildSymbol* symbol(const std::string& name) const;
+
+        /* Resolves a type written in the source, reporting it and returning null if it's invalid.
+         * The names of generic arguments resolve to the types they're bound to */
+        const kh::IrType* resolveType(const kh::AstIdentifiers& type_ast, size_t refs,
+                                      const std::vector<uint64_t>& array,
+                                      std::vector<kh::BuildException>& errors,
+                                      const kh::GenericBindings* bindings = nullptr) const;
+
+        /* Gets the function of a generic function instantiated with the type arguments, declaring
+         * it and queueing its body the first time. Instances are only made once however many tasks
+         * ask for them at once. Returns null if the instance is invalid */
+        const kh::BuildSymbol* instantiate(uint32_t generic, const std::vector<const kh::IrType*>& args,
+                                           size_t depth, size_t index,
+                                           std::vector<kh::BuildException>& errors);
+
+        /* The AST and the names of the generic arguments of a generic function */
+        const kh::AstFunction& genericAst(uint32_t generic) const;
+        const std::vector<uint32_t>& genericArguments(uint32_t generic) const;
+
+    private:
+        struct GenericFunction {
+            const kh::AstFunction* function_ast;
+            std::string name;
+
+            /* Generic arguments of the user type first for methods */
+            std::vector<uint32_t> arguments;
+        };
+
+        struct InstanceHash {
+            size_t operator()(const std::pair<uint32_t, std::vector<const kh::IrType*>>& key) const;
+        };
+
+        const kh::AstModule& module_ast;
+        kh::IrModule& module_ir;
+
+        kh::IdMap<kh::BuildSymbol> symbols;
+        std::vector<GenericFunction> generics;
+
+        /* One for each function in the module, in the same order. They're only added to while the
+         * tasks run by instantiations, the deque keeps the tasks where they are */
+        std::deque<kh::BuildTask> tasks;
+
+        /* Nodes of unordered maps stay where they are, so the symbols are handed out as they are */
+        std::mutex instances_mutex;
+        std::unordered_map<std::pair<uint32_t, std::vector<const kh::IrType*>>, kh::BuildSymbol,
+                           InstanceHash>
+            instances;
+        kh::ThreadPool* pool = nullptr;
+
+        /* The interners of the thread building, which its tasks intern into as well */
+        std::shared_ptr<kh::TypeInterner> types;
+        std::shared_ptr<kh::IdentifierInterner> identifiers;
+
+        /* Collects the declarations, phase one */
+        void declare();
+        void declareFunction(const kh::AstFunction& function_ast, const std::string& name,
+                             const std::vector<std::string>& type_generic_args = {});
+
+        /* Declares a function and its task, returning its `func` type or null if the signature is
+         * invalid. The caller locks `instances_mutex` in phase two */
+        const kh::IrType* addFunction(const kh::AstFunction& function_ast, const std::string& name,
+                                      const kh::GenericBindings& bindings, size_t depth,
+                                      std::vector<kh::BuildException>& errors);
+
+        /* Lowers the body of the task, phase two */
+        void lower(kh::BuildTask& task);
+
+        /* Queues the lowering of the task on the pool */
+        void submit(kh::BuildTask& task);
+
+        /* Puts the instances in an order which doesn't depend on which task made them first,
+         * returning the tasks in the new order of the functions */
+        std::vector<kh::BuildTask*> sortInstances(size_t declared);
+    };
 }
@@ -21,4 +21,31 @@ namespace kh {
 
     std::u32string readFile(const std::u32string& path);
     std::string readFileBinary(const std::u32string& path);
+
+    /* Replaces the file by writing a temporary one next to it and renaming it over, so readers never
+     * see it half written */
+    void writeFileBinary(const std::u32string& path, const std::string& data);
+
+    /* Absolute path of an existing file with the symbolic links and `.`, `..` components resolved,
+     * so the same file is always named the same way. Throws `kh::FileError` if it doesn't exist */
+    std::u32string canonicalPath(const std::u32string& path);
+
+    /* A read-only view of a whole file, memory-mapped where it's supported and read into memory
+     * otherwise */
+    class MappedFile {
+    public:
+        MappedFile(const std::u32string& path);
+        ~MappedFile();
+
+        MappedFile(const kh::MappedFile&) = delete;
+        kh::MappedFile& operator=(const kh::MappedFile&) = delete;
+
+        const char* data() const;
+        size_t size() const;
+
+    private:
+        const char* mapped = nullptr;
+        size_t mapped_size = 0;
+        std::string buffer;
+    };
 }
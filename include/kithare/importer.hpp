@@ -0,0 +1,108 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <kithare/ast.hpp>
+#include <kithare/exception.hpp>
+#include <kithare/lexer.hpp>
+#include <kithare/parser.hpp>
+
+/* File extension of Kithare source files, which the import path gets appended with */
+#define KH_SOURCE_EXTENSION U".kh"
+
+/* Appended to the path of a source file for the path of its module interface, `a.kh` has `a.khi` */
+#define KH_INTERFACE_SUFFIX U"i"
+
+/* Module index of imports which couldn't be resolved */
+#define KH_UNRESOLVED_IMPORT ((size_t)-1)
+
+
+namespace kh {
+    class ImportException : public kh::Exception {
+    public:
+        std::string what;
+
+        /* The module with the import or include statement, or the module which couldn't be read */
+        std::u32string path;
+        size_t index;
+        size_t line;
+        size_t column;
+
+        ImportException(const std::string& _what, const std::u32string& _path, size_t _index,
+                        size_t _line, size_t _column)
+            : what(_what), path(_path), index(_index), line(_line), column(_column) {}
+        virtual ~ImportException() {}
+        virtual std::string format() const;
+    };
+
+    struct ImportedModule {
+        /* Canonical path of the file, see `kh::canonicalPath` */
+        std::u32string path;
+
+        std::shared_ptr<const std::vector<kh::Token>> tokens;
+        std::shared_ptr<kh::AstModule> ast;
+        std::vector<kh::LexException> lex_exceptions;
+        std::vector<kh::ParseException> parse_exceptions;
+
+        /* Whether the AST was loaded from the module interface, which leaves `tokens` unset and the
+         * AST with only the public declarations and no function bodies */
+        bool from_interface = false;
+
+        /* Hash of the source file when it was parsed with interfaces in use, zero otherwise */
+        uint64_t source_hash = 0;
+
+        /* Index in `kh::ModuleGraph::modules` which each of `ast->imports` resolved to, or
+         * `KH_UNRESOLVED_IMPORT` */
+        std::vector<size_t> imports;
+    };
+
+    struct ModuleGraph {
+        /* Every module loaded, once each and sorted by path */
+        std::vector<kh::ImportedModule> modules;
+        size_t root = KH_UNRESOLVED_IMPORT;
+
+        /* Groups of modules importing each other, each one sorted by index */
+        std::vector<std::vector<size_t>> cycles;
+
+        std::vector<kh::ImportException> exceptions;
+    };
+
+    /* Loads the module at the path and everything it imports or includes. Each module is read,
+     * lexed and parsed on a thread pool as soon as it's found, and a file imported from many places
+     * is only loaded once. Relative imports are looked up from the directory of the module with the
+     * import, others from the directory of the root module and then the search paths in order.
+     * Function bodies of the imported modules are skipped while the imports are being found and
+     * parsed after, their errors are reported with the rest, see `kh::LazyBody`.
+     *
+     * With `use_interfaces`, imported modules are loaded from their interfaces when they're up to
+     * date, and the interfaces of the ones which had to be parsed are written if they had no errors */
+    kh::ModuleGraph loadModules(const std::u32string& path,
+                                const std::vector<std::u32string>& search_paths = {},
+                                size_t workers = 0, bool use_interfaces = false);
+
+    /* Copies the public declarations of the module, what other modules can use of it, without the
+     * function bodies and initializers. All of the imports are kept as the module depends on them */
+    kh::AstModule moduleInterface(const kh::AstModule& module_ast);
+
+    /* Reads the interface of the source file, returning null if it doesn't exist, is invalid or
+     * doesn't match the hash of the source */
+    std::shared_ptr<kh::AstModule> loadInterface(const std::u32string& source_path,
+                                                 uint64_t source_hash);
+
+    /* Writes the interface of the source file unless it's already up to date, returning whether it
+     * was written. Throws `kh::FileError` if it couldn't be */
+    bool updateInterface(const std::u32string& source_path, const kh::AstModule& module_ast,
+                         uint64_t source_hash);
+
+    /* Finds the strongly connected components of the import graph in linear time, returning the ones
+     * which form cycles: those with more than one module and modules importing themselves */
+    std::vector<std::vector<size_t>> findImportCycles(const std::vector<kh::ImportedModule>& modules);
+}
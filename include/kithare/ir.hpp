@@ -6,63 +6,393 @@
 
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include <kithare/sink.hpp>
+
+/* Size of the blocks `kh::IrArena` allocates, larger allocations get a block of their own */
+#define KH_IR_ARENA_BLOCK_SIZE 65536
+
+/* Operand of an instruction which doesn't use it, and the value of a `return` without one */
+#define KH_IR_NONE ((uint32_t)-1)
+
+/* Amount of independently locked parts of the type interner, see `kh::internType` */
+#define KH_IR_TYPE_SHARDS 64
+
 
 namespace kh {
-    class IrModule;
-    class IrScope;
+    class IrArena;
+    class IrType;
+    class IrConst;
     class IrVariable;
-
+    struct IrInstruction;
     class IrFunction;
-    class IrIntrinsic;
-    class IrUserFunction;
+    class IrModule;
 
-    class IrClassGeneric;
-    class IrStructGeneric;
-    class IrFunctionGeneric;
+    /* Bump allocator owning the nodes of a module. Everything in it is freed at once, only the
+     * objects which aren't trivially destructible, such as functions, get their destructors ran */
+    class IrArena {
+    public:
+        IrArena() {}
+        ~IrArena();
 
-    class IrType;
-    class IrRefType;
-    class IrArrayType;
-    class IrListType;
-    class IrTupleType;
-    class IrDictType;
-    class IrFuncType;
-    class IrClassType;
-    class IrStructType;
-    class IrEnumType;
-
-    class IrBody;
-    class IrExpressionBody;
-    class IrIf;
-    class IrWhile;
-    class IrDoWhile;
-    class IrFor;
-    class IrContinueLoop;
-    class IrBreakLoop;
-    class IrReturn;
-
-    class IrExpression;
-    class IrVariableExpression;
-    class IrReturnRefExpression;
-    class IrFunctionExpression;
-    class IrTernaryExpression;
-    class IrAssignExpression;
-    class IrDerefExpression;
-    class IrScopeExpression;
-    class IrCallExpression;
+        IrArena(const kh::IrArena&) = delete;
+        kh::IrArena& operator=(const kh::IrArena&) = delete;
 
-    class IrConst;
-    class IrIntegerConst;
-    class IrUnsignedIntegerConst;
-    class IrFloatConst;
-    class IrDoubleConst;
-    class IrComplexConst;
-    class IrComplexFConst;
-    class IrStringConst;
-    class IrBufferConst;
-    class IrEnumerationConst;
-
-    class IrModule {};
+        void* allocate(size_t size, size_t alignment);
+
+        template <typename T, typename... Args>
+        T* make(Args&&... args) {
+            T* object = new (this->allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            if (!std::is_trivially_destructible<T>::value) {
+                this->destructors.emplace_back(object, [](void* ptr) { ((T*)ptr)->~T(); });
+            }
+            return object;
+        }
+
+        /* Bytes handed out so far */
+        size_t allocated() const;
+
+    private:
+        std::vector<std::unique_ptr<char[]>> blocks;
+        char* current = nullptr;
+        size_t remaining = 0;
+        size_t total = 0;
+
+        std::vector<std::pair<void*, void (*)(void*)>> destructors;
+    };
+
+    /* Types are hash-consed, there's only one instance of each structural type, so types are equal
+     * only if their pointers are and can be used as keys as they are. Get them from
+     * `kh::internType` or `kh::IrModule::type` rather than constructing them */
+    class IrType {
+    public:
+        enum Kind {
+            VOID,
+            BOOL,
+            CHAR,
+            INT8,
+            INT16,
+            INT32,
+            INT64,
+            UINT8,
+            UINT16,
+            UINT32,
+            UINT64,
+            FLOAT,
+            DOUBLE,
+            COMPLEXF,
+            COMPLEX,
+            STRING,
+            BUFFER,
+
+            /* Compound types, see `children` */
+            REF,
+            ARRAY,
+            LIST,
+            TUPLE,
+            DICT,
+            FUNC,
+
+            /* User types, named by `name` */
+            CLASS,
+            STRUCT,
+            ENUM
+        } kind;
+
+        /* The referenced or element type of references, arrays and lists, the key and the item
+         * type of dicts, the elements of tuples, and the return type followed by the argument types
+         * of functions. User types have their generic arguments */
+        std::vector<const kh::IrType*> children;
+
+        /* Length of arrays */
+        uint64_t length = 0;
+
+        std::string name;
+
+        /* Structural hash, from the pointers of the children as they're interned already */
+        size_t hash;
+
+        IrType(kh::IrType::Kind _kind, const std::vector<const kh::IrType*>& _children = {},
+               uint64_t _length = 0, const std::string& _name = "");
+
+        /* Structural equality, which is only needed for interning */
+        bool operator==(const kh::IrType& other) const;
+
+        bool isInteger() const;
+        bool isSigned() const;
+        bool isFloating() const;
+        bool isComplex() const;
+
+        /* Size in bits of booleans, characters and numbers, complex numbers having the size of
+         * their parts */
+        size_t bits() const;
+    };
+
+    /* Gets the canonical instance of the type from the calling thread's interner, making it on its
+     * first use. It's safe to call from many threads at once */
+    const kh::IrType* internType(kh::IrType::Kind kind,
+                                 const std::vector<const kh::IrType*>& children = {},
+                                 uint64_t length = 0, const std::string& name = "");
+
+    /* Amount of types in the calling thread's interner */
+    size_t internedTypes();
+
+    /* A generation of interned types, which is freed along with them once the last
+     * `kh::TypeScope` using it is gone. Types of different generations are never equal */
+    class TypeInterner;
+
+    std::shared_ptr<kh::TypeInterner> newTypeInterner();
+
+    /* Makes the calling thread intern its types into `interner` while this lives, rather than into
+     * the process wide interner which is kept until exiting. A long running process, such as the
+     * compile server, gives each build a new generation so the types of the builds it ran don't
+     * pile up. The threads working on a build enter its generation too, see `currentTypeInterner` */
+    class TypeScope {
+    public:
+        TypeScope(const std::shared_ptr<kh::TypeInterner>& interner);
+        ~TypeScope();
+
+        TypeScope(const kh::TypeScope&) = delete;
+        kh::TypeScope& operator=(const kh::TypeScope&) = delete;
+
+    private:
+        std::shared_ptr<kh::TypeInterner> previous;
+    };
+
+    /* The generation of the calling thread's innermost `kh::TypeScope`, null outside of them */
+    std::shared_ptr<kh::TypeInterner> currentTypeInterner();
+
+    /* A constant of a module's pool, referred to by its index from `CONST` instructions. The
+     * value is kept as raw bits so equal constants are found by comparing them */
+    class IrConst {
+    public:
+        enum Kind {
+            BOOL,
+            CHARACTER,
+            INTEGER,
+            UNSIGNED_INTEGER,
+            FLOAT,
+            DOUBLE,
+            COMPLEXF,
+            COMPLEX,
+            STRING,
+            BUFFER,
+            ENUMERATION
+        } kind;
+
+        const kh::IrType* type;
+
+        /* The value, or the real and imaginary parts of complex numbers, or the index of the
+         * string or buffer in the module */
+        uint64_t bits[2] = {0, 0};
+
+        IrConst(kh::IrConst::Kind _kind, const kh::IrType* _type, uint64_t _bits = 0,
+                uint64_t _imaginary_bits = 0)
+            : kind(_kind), type(_type), bits{_bits, _imaginary_bits} {}
+
+        static kh::IrConst boolean(const kh::IrType* type, bool value);
+        static kh::IrConst character(const kh::IrType* type, char32_t value);
+        static kh::IrConst integer(const kh::IrType* type, int64_t value);
+        static kh::IrConst uinteger(const kh::IrType* type, uint64_t value);
+        static kh::IrConst floating(const kh::IrType* type, double value);
+        static kh::IrConst complex(const kh::IrType* type, double real, double imaginary);
+
+        int64_t integer() const;
+        uint64_t uinteger() const;
+        double floating() const;
+        double real() const;
+        double imaginary() const;
+
+        bool operator==(const kh::IrConst& other) const;
+    };
+
+    class IrVariable {
+    public:
+        std::string name;
+        const kh::IrType* type;
+        size_t index;
+
+        /* Globals which other modules can use, locals never are */
+        bool is_public = false;
+
+        IrVariable(const std::string& _name, const kh::IrType* _type, size_t _index)
+            : name(_name), type(_type), index(_index) {}
+    };
+
+    /* Instructions are values too, referred to by their index in the function */
+    enum class IrOp : uint8_t {
+        /* a: constant */
+        CONST,
+
+        /* a: local variable, b: value for stores */
+        LOAD,
+        STORE,
+
+        /* a: global variable, b: value for stores */
+        GLOBAL_LOAD,
+        GLOBAL_STORE,
+
+        /* a: value, converted to the type of the instruction */
+        CONVERT,
+
+        /* a: value */
+        NEG,
+        NOT,
+        BIT_NOT,
+
+        /* a and b: values */
+        ADD,
+        SUB,
+        MUL,
+        DIV,
+        MOD,
+        POW,
+        BIT_AND,
+        BIT_OR,
+        BIT_LSHIFT,
+        BIT_RSHIFT,
+
+        /* a and b: values, with a boolean result */
+        EQUAL,
+        NOT_EQUAL,
+        LESS,
+        MORE,
+        LESS_EQUAL,
+        MORE_EQUAL,
+
+        /* a: function, b: first argument in `kh::IrFunction::operands`, c: amount of arguments */
+        CALL,
+
+        /* a: target instruction */
+        JUMP,
+
+        /* a: condition, b: target if it's true, c: target if it's false */
+        BRANCH,
+
+        /* a: value or `KH_IR_NONE` */
+        RETURN,
+
+        /* Left behind by passes removing instructions */
+        NOP
+    };
+
+    const char* cstr(kh::IrOp op);
+
+    struct IrInstruction {
+        kh::IrOp op;
+
+        /* Type of the value, void for instructions without one */
+        const kh::IrType* type;
+
+        uint32_t a = KH_IR_NONE;
+        uint32_t b = KH_IR_NONE;
+        uint32_t c = KH_IR_NONE;
+
+        /* Index of the source it was lowered from */
+        uint32_t index = 0;
+    };
+
+    class IrFunction {
+    public:
+        std::string name;
+        const kh::IrType* return_type;
+
+        /* The arguments are the first locals */
+        size_t arguments = 0;
+        std::vector<kh::IrVariable> locals;
+
+        std::vector<kh::IrInstruction> code;
+
+        /* Arguments of calls, which take more values than fit in an instruction */
+        std::vector<uint32_t> operands;
+
+        size_t index;
+        bool is_public = true;
+
+        /* Instances of generics are made for the module using them, so passes may drop them */
+        bool is_instance = false;
+
+        IrFunction(const std::string& _name, const kh::IrType* _return_type, size_t _index)
+            : name(_name), return_type(_return_type), index(_index) {}
+
+        /* Appends an instruction, returning its index */
+        uint32_t emit(kh::IrOp op, const kh::IrType* type, uint32_t a = KH_IR_NONE,
+                      uint32_t b = KH_IR_NONE, uint32_t c = KH_IR_NONE, size_t source_index = 0);
+
+        uint32_t call(const kh::IrType* type, uint32_t function, const std::vector<uint32_t>& args,
+                      size_t source_index = 0);
+
+        /* Adds a local variable, returning its index */
+        uint32_t local(const std::string& local_name, const kh::IrType* type,
+                       size_t source_index = 0);
+    };
+
+    class IrModule {
+    public:
+        kh::IrArena arena;
+
+        std::vector<kh::IrFunction*> functions;
+        std::vector<kh::IrVariable> globals;
+
+        /* Deduplicated pools, see `kh::IrModule::constant` */
+        std::vector<kh::IrConst> constants;
+        std::vector<std::u32string> strings;
+        std::vector<std::string> buffers;
+
+        IrModule() {}
+
+        IrModule(const kh::IrModule&) = delete;
+        kh::IrModule& operator=(const kh::IrModule&) = delete;
+
+        /* Shortcut of `kh::internType` */
+        const kh::IrType* type(kh::IrType::Kind kind,
+                               const std::vector<const kh::IrType*>& children = {},
+                               uint64_t length = 0, const std::string& name = "");
+
+        kh::IrFunction* function(const std::string& name, const kh::IrType* return_type,
+                                 size_t index = 0);
+
+        /* These get the index of the constant in the pool, adding it if there's no equal one */
+        uint32_t constant(const kh::IrConst& value);
+        uint32_t string(const std::u32string& value);
+        uint32_t buffer(const std::string& value);
+
+        /* Drops the constants, strings and buffers the functions don't use anymore, renumbering
+         * the rest. Returns the amount of constants dropped */
+        size_t removeUnusedConstants();
+
+    private:
+        struct ConstHash {
+            size_t operator()(const kh::IrConst& value) const;
+        };
+
+        std::unordered_map<kh::IrConst, uint32_t, ConstHash> constant_ids;
+        std::unordered_map<std::u32string, uint32_t> string_ids;
+        std::unordered_map<std::string, uint32_t> buffer_ids;
+    };
+
+    /* Streams the textual dump of the IR into a sink */
+    class IrWriter {
+    public:
+        IrWriter(kh::Sink& _sink);
+
+        void write(const kh::IrModule& module_ir);
+        void write(const kh::IrModule& module_ir, const kh::IrFunction& function_ir);
+        void write(const kh::IrType* type);
+
+    private:
+        kh::Sink& sink;
+
+        void writeConst(const kh::IrModule& module_ir, const kh::IrConst& value);
+    };
+
+    std::u32string str(const kh::IrModule& module_ir);
+    std::u32string str(const kh::IrType* type);
 }
@@ -0,0 +1,66 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <kithare/sink.hpp>
+
+
+namespace kh {
+    /* Writes compact JSON into a sink as it goes, keeping track of where the commas go so the
+     * document never has to be built in memory */
+    class JsonWriter {
+    public:
+        JsonWriter(kh::Sink& _sink);
+
+        void beginObject();
+        void endObject();
+        void beginArray();
+        void endArray();
+
+        /* Starts a member of the current object, the next value written is its value */
+        void key(const char* name);
+
+        void value(bool boolean);
+        void value(int64_t n);
+        void value(uint64_t n);
+        void value(double n);
+        void value(const char* str);
+        void value(const std::string& str);
+        void value(const std::u32string& str);
+        void null();
+
+        /* Writes the bytes of the buffer as the code points U+0000 to U+00FF */
+        void buffer(const std::string& buffer);
+
+        /* Writes an array of the names, which is what identifiers are usually split into */
+        void names(const std::vector<std::string>& names);
+
+        /* Shortcuts of `key` followed by the value */
+        template <typename T>
+        void member(const char* name, const T& member_value) {
+            this->key(name);
+            this->value(member_value);
+        }
+
+        void member(const char* name, size_t member_value) {
+            this->key(name);
+            this->value((uint64_t)member_value);
+        }
+
+    private:
+        kh::Sink& sink;
+
+        /* Whether the next value is the first one in its array or object */
+        bool first = true;
+
+        void separate();
+        void string(const char* str, size_t size);
+    };
+}
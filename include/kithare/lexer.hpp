@@ -59,6 +59,19 @@ namespace kh {
                (U'A' <= chr && chr <= U'F');
     }
 
+    /* Gets the value of a digit which is already known to be a hex digit */
+    inline uint32_t hexDigit(char32_t chr) {
+        return chr <= U'9' ? chr - U'0' : (chr | 0x20) - U'a' + 10;
+    }
+
+    /* Converts the digits of an integer literal of the base (up to 16) without any prefix or
+     * suffix, returns false if the value doesn't fit in 64 bits */
+    bool parseInteger(const char32_t* begin, const char32_t* end, unsigned base, uint64_t& value);
+
+    /* Converts the digits of a floating literal such as `12.5`, `.5` or `3.` to the nearest double,
+     * returns infinity if it's too large */
+    double parseFloating(const char32_t* begin, const char32_t* end);
+
     std::vector<kh::Token> lex(const std::u32string& source);
 
     std::vector<kh::Token> lex(KH_LEX_CTX);
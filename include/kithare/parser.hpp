@@ -6,30 +6,46 @@
 
 #pragma once
 
+#include <mutex>
+
 #include <kithare/ast.hpp>
 #include <kithare/exception.hpp>
 #include <kithare/string.hpp>
 #include <kithare/token.hpp>
 
-#define KH_PARSE_GUARD()                                                                    \
-    do {                                                                                    \
-        if (context.ti >= context.tokens.size()) {                                          \
-            context.exceptions.emplace_back("expected a token but reached the end of file", \
-                                            context.tokens.back());                         \
-            goto end;                                                                       \
-        }                                                                                   \
+#define KH_PARSE_GUARD()                                                                         \
+    do {                                                                                         \
+        if (context.ti >= context.tokens.size()) {                                               \
+            context.error("expected a token but reached the end of file", context.tokens.back()); \
+            goto end;                                                                            \
+        }                                                                                        \
     } while (false)
 
 #define KH_PARSE_CTX kh::ParserContext& context
 
+/* Amount of errors reported before the parser skips the rest of the file */
+#define KH_PARSE_ERROR_LIMIT 100
+
+/* Default of how deep brackets, bodies and generic types may nest, each level takes the parser a few
+ * kilobytes of stack */
+#define KH_PARSE_NESTING_LIMIT 256
+
+/* Stack a level of nesting takes the parser at most, it's about 3.4 kilobytes for brackets */
+#define KH_PARSE_LEVEL_STACK 4096
+
 
 namespace kh {
     class ParseException : public kh::Exception {
     public:
         std::string what;
-        kh::Token token;
+        size_t index;
+        size_t length;
+        size_t line;
+        size_t column;
 
-        ParseException(const std::string _what, const kh::Token& _token) : what(_what), token(_token) {}
+        ParseException(const std::string& _what, const kh::Token& _token)
+            : what(_what), index(_token.index), length(_token.length), line(_token.line),
+              column(_token.column) {}
         virtual ~ParseException() {}
         virtual std::string format() const;
     };
@@ -41,12 +57,54 @@ namespace kh {
         /* Token iterator */
         size_t ti = 0;
 
+        /* Set by an error until the parser recovers at the next statement or declaration, errors in
+         * between are most likely cascaded from the first one and get dropped */
+        bool panicking = false;
+
+        /* How deep expressions, bodies and generic types may nest, anything deeper gets reported and
+         * skipped */
+        size_t nesting_limit = KH_PARSE_NESTING_LIMIT;
+        size_t depth = 0;
+
+        /* When set to the tokens being parsed, the bodies of named functions and methods are
+         * skipped by matching their curly brackets, to be parsed on the first `getBody` call. Errors
+         * in them are only found then, see `kh::LazyBody::exceptions` */
+        std::shared_ptr<const std::vector<kh::Token>> lazy_tokens{};
+
+        /* Reports an error unless the parser is panicking or reached `KH_PARSE_ERROR_LIMIT` */
+        void error(const std::string& what, const kh::Token& token);
+
         /* Gets token of the current iterator index */
         inline kh::Token& tok() const {
             return *(kh::Token*)(size_t) & this->tokens[this->ti];
         }
     };
 
+    /* A function body which is parsed the first time it's needed */
+    class LazyBody {
+    public:
+        LazyBody(const std::shared_ptr<const std::vector<kh::Token>>& _tokens, size_t _begin,
+                 size_t _nesting_limit);
+
+        LazyBody(const kh::LazyBody&) = delete;
+        kh::LazyBody& operator=(const kh::LazyBody&) = delete;
+
+        /* Parses the body on the first call, threads calling it meanwhile wait for that parse */
+        const std::vector<std::shared_ptr<kh::AstBody>>& body();
+
+        /* The errors in the body, parsing it first if it hasn't been */
+        const std::vector<kh::ParseException>& exceptions();
+
+    private:
+        std::shared_ptr<const std::vector<kh::Token>> tokens;
+        size_t begin;
+        size_t nesting_limit;
+
+        std::once_flag parsed;
+        std::vector<std::shared_ptr<kh::AstBody>> parsed_body;
+        std::vector<kh::ParseException> parse_exceptions;
+    };
+
     inline bool isReservedKeyword(const std::string& identifier) {
         return identifier == "public" || identifier == "private" || identifier == "static" ||
                identifier == "try" || identifier == "def" || identifier == "class" ||
@@ -57,6 +115,25 @@ namespace kh {
                identifier == "return" || identifier == "ref";
     }
 
+    /* The kind of scope the parser recovers in, which decides the keywords it synchronizes at */
+    enum class ParseScope { TOP, USER_TYPE, BODY };
+
+    /* Skips the rest of the construct which failed to parse if the parser is panicking, up to after
+     * a semicolon or a closed block, or up to a curly bracket closing the current block or a keyword
+     * starting the next construct */
+    void recover(KH_PARSE_CTX, kh::ParseScope scope);
+
+    /* Reports an expression, body or type nested deeper than the limit. The nested part is skipped
+     * by counting brackets instead of parsing, stopping after the body if `is_body`, otherwise at a
+     * semicolon or the closing bracket of the enclosing level */
+    void skipNesting(KH_PARSE_CTX, bool is_body);
+
+    /* The highest nesting limit the parser can recurse through without running out of stack on the
+     * main thread or a `kh::ThreadPool` worker, leaving half of the smaller stack to the rest of
+     * the program. It's never below `KH_PARSE_NESTING_LIMIT`, which is all that's allowed where the
+     * stack sizes aren't known */
+    size_t maxNestingLimit();
+
     kh::AstModule parse(const std::vector<kh::Token>& tokens);
     kh::AstExpression* parseExpression(const std::vector<kh::Token>& tokens);
 
@@ -70,6 +147,7 @@ namespace kh {
     kh::AstUserType parseUserType(KH_PARSE_CTX, bool is_class);
     kh::AstEnumType parseEnum(KH_PARSE_CTX);
     std::vector<std::shared_ptr<kh::AstBody>> parseBody(KH_PARSE_CTX, size_t loop_count = 0);
+
     void parseTopScopeIdentifiersAndGenericArgs(KH_PARSE_CTX, std::vector<std::string>& identifiers,
                                                 std::vector<std::string>& generic_args);
 
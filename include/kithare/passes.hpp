@@ -0,0 +1,125 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#pragma once
+
+#include <map>
+
+#include <kithare/ir.hpp>
+
+/* Budgets of running a call at compile time, see `kh::evaluateCalls` */
+#define KH_EVAL_STEP_LIMIT 1000000
+#define KH_EVAL_MEMORY_LIMIT (16 * 1024 * 1024)
+#define KH_EVAL_DEPTH_LIMIT 512
+
+/* Instructions all of the calls evaluated in a module get to run together */
+#define KH_EVAL_MODULE_STEP_LIMIT (16 * KH_EVAL_STEP_LIMIT)
+
+/* Cost model of `kh::inlineCalls`. Functions of up to the threshold's amount of instructions are
+ * inlined, each constant argument allowing a larger one as folding may shrink it, and the code of
+ * the module grows by at most the percentage given */
+#define KH_INLINE_THRESHOLD 24
+#define KH_INLINE_CONSTANT_BONUS 8
+#define KH_INLINE_GROWTH 50
+
+
+namespace kh {
+    /* Calls the function on a reference to each operand of the instruction which is the value of
+     * another instruction, including the arguments of calls */
+    template <typename F>
+    void forEachValue(kh::IrInstruction& instruction, std::vector<uint32_t>& operands, F f) {
+        switch (instruction.op) {
+            case kh::IrOp::CONST:
+            case kh::IrOp::LOAD:
+            case kh::IrOp::GLOBAL_LOAD:
+            case kh::IrOp::JUMP:
+            case kh::IrOp::NOP:
+                break;
+            case kh::IrOp::STORE:
+            case kh::IrOp::GLOBAL_STORE:
+                f(instruction.b);
+                break;
+            case kh::IrOp::CALL:
+                for (uint32_t j = 0; j < instruction.c; j++) {
+                    f(operands[instruction.b + j]);
+                }
+                break;
+            case kh::IrOp::CONVERT:
+            case kh::IrOp::NEG:
+            case kh::IrOp::NOT:
+            case kh::IrOp::BIT_NOT:
+            case kh::IrOp::BRANCH:
+            case kh::IrOp::RETURN:
+                if (instruction.a != KH_IR_NONE) {
+                    f(instruction.a);
+                }
+                break;
+            default:
+                f(instruction.a);
+                f(instruction.b);
+        }
+    }
+
+    /* Merges instances of generics whose IR is the same as an earlier function's into it, calling
+     * the one left instead. Instances only differing by which merged functions they call are
+     * merged too. Returns the amount of functions removed */
+    size_t mergeIdenticalFunctions(kh::IrModule& module_ir);
+
+    /* Inlines the calls of small functions into their callers, going through the call graph
+     * from the callees up so the callees are inlined into first. Recursive functions, including
+     * mutually recursive ones, aren't inlined anywhere. The code grows by at most `growth`
+     * percent of what it was, see `KH_INLINE_GROWTH`. Returns the amount of calls inlined, which
+     * are best folded afterwards */
+    size_t inlineCalls(kh::IrModule& module_ir, size_t growth = KH_INLINE_GROWTH);
+
+    /* Computes an instruction on constants exactly like the generated code does, with integers
+     * wrapping around. False if the result is only known at runtime, such as for integer divisions
+     * by zero. The second operand is ignored by conversions and unary operations */
+    bool evaluate(kh::IrOp op, const kh::IrType* type, const kh::IrConst& a, const kh::IrConst& b,
+                  kh::IrConst& result);
+
+    /* Replaces the instructions computed from constants with their results, propagating the locals
+     * which are always assigned the same constant and folding the branches on constants. Returns
+     * the amount of instructions folded */
+    size_t foldConstants(kh::IrModule& module_ir);
+
+    /* What `kh::evaluateCalls` keeps between its runs on the same module, the results of the calls
+     * already run, failed ones included, and the instructions left for the rest to run */
+    struct EvaluatedCalls {
+        struct CallLess {
+            bool operator()(const std::pair<uint32_t, std::vector<kh::IrConst>>& a,
+                            const std::pair<uint32_t, std::vector<kh::IrConst>>& b) const;
+        };
+
+        /* Whether the call could be evaluated and its result, by the function and arguments */
+        std::map<std::pair<uint32_t, std::vector<kh::IrConst>>, std::pair<bool, kh::IrConst>,
+                 CallLess>
+            results;
+        size_t steps = KH_EVAL_MODULE_STEP_LIMIT;
+    };
+
+    /* Runs the calls of pure functions with constant arguments, replacing them with their results.
+     * Calls which run out of their budget of instructions, memory or depth are left as they are,
+     * and so are all of them once the module's budget in `evaluated` runs out. A call is only run
+     * once with the same arguments over every run sharing `evaluated`. Returns the amount of calls
+     * replaced, folding the constants again may make more of them constant */
+    size_t evaluateCalls(kh::IrModule& module_ir, kh::EvaluatedCalls& evaluated);
+
+    /* Amounts of what `kh::eliminateDeadCode` removed */
+    struct EliminatedCode {
+        size_t functions = 0;
+        size_t globals = 0;
+        size_t constants = 0;
+    };
+
+    /* Removes the functions which can't be called from `main` and the initializer of the globals,
+     * or from the public functions of modules without a `main`, including the instances of
+     * generics. Globals which are never read, apart from the public ones of modules without a
+     * `main`, the unused values and locals within the functions and the constants nothing uses
+     * anymore are removed as well. Types are interned for the whole
+     * program rather than kept by modules, so there are none to remove */
+    kh::EliminatedCode eliminateDeadCode(kh::IrModule& module_ir);
+}
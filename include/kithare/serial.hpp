@@ -0,0 +1,142 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <kithare/ast.hpp>
+#include <kithare/exception.hpp>
+#include <kithare/token.hpp>
+
+#define KH_SERIAL_VERSION 1
+#define KH_SERIAL_HEADER_SIZE 24
+
+/* How deeply records may nest when they're read back, each level takes the reader a few kilobytes
+ * of stack. Module interfaces nesting deeper are rejected, so their sources get parsed instead */
+#define KH_SERIAL_DEPTH_LIMIT 1024
+
+
+/* Layout of `.ktok`, `.kast` and `.khi` buffers, every fixed size integer is little-endian:
+ *
+ *   magic        4 bytes, "KTOK", "KAST" or "KINT"
+ *   version      u32, `KH_SERIAL_VERSION`
+ *   strings      u32, amount of strings in the string table
+ *   body offset  u32, from the start of the buffer
+ *   body size    u32
+ *   root         u32, offset of the module record in the body (0 for tokens)
+ *   string index (strings + 1) x u32, offsets of the strings from the end of the index
+ *   string data  the bytes of every string back to back
+ *   body         the records
+ *
+ * A token record is its type byte, the varint index delta from the previous token, length, line and
+ * column, followed by its value. An AST record is a `kh::AstTag` byte and the varint source index,
+ * followed by its fields. Records only refer to records written before them, child references are
+ * varints of the body offset plus one, zero being a null child. Strings are varint indices into the
+ * string table, except for the code points of string literals which are stored inline as varints
+ * since they don't need to be valid Unicode. The body of a module interface starts with the u64 hash
+ * of the source it was made from */
+namespace kh {
+    class SerialException : public kh::Exception {
+    public:
+        std::string what;
+        size_t index;
+
+        SerialException(const std::string& _what, size_t _index) : what(_what), index(_index) {}
+        virtual ~SerialException() {}
+        virtual std::string format() const;
+    };
+
+    enum class AstTag {
+        MODULE,
+        IMPORT,
+        USER_TYPE,
+        ENUM_TYPE,
+
+        IF,
+        WHILE,
+        DO_WHILE,
+        FOR,
+        FOREACH,
+        STATEMENT,
+
+        IDENTIFIERS,
+        DECLARATION,
+        FUNCTION,
+        UNARY,
+        REV_UNARY,
+        BINARY,
+        TERNARY,
+        COMPARISON,
+        SUBSCRIPT,
+        CALL,
+        SCOPING,
+        VALUE,
+        TUPLE,
+        LIST,
+        DICT
+    };
+
+    std::string serialize(const std::vector<kh::Token>& tokens);
+    std::string serialize(const kh::AstModule& module_ast);
+
+    std::vector<kh::Token> deserializeTokens(const char* data, size_t size);
+    kh::AstModule deserializeAst(const char* data, size_t size);
+
+    /* A module interface is serialized like an AST, tagged with the `kh::hash` of the source bytes so
+     * it can be checked to be up to date before reading the rest. See `kh::moduleInterface` */
+    std::string serializeInterface(const kh::AstModule& interface_ast, uint64_t source_hash);
+    uint64_t interfaceHash(const char* data, size_t size);
+    kh::AstModule deserializeInterface(const char* data, size_t size);
+
+    /* Reads a `.ktok` or `.kast` buffer in place, such as a memory-mapped file, the header is
+     * validated on construction and every read is bounds checked */
+    class SerialReader {
+    public:
+        SerialReader(const char* _data, size_t _size, const char* magic);
+
+        /* Offset of the module record for `.kast` buffers */
+        size_t root() const;
+        size_t bodySize() const;
+
+        size_t strings() const;
+        std::string string(size_t id) const;
+
+        /* These read at a body offset, moving it past the value */
+        uint8_t byte(size_t& offset) const;
+        uint64_t varint(size_t& offset) const;
+        int64_t signedVarint(size_t& offset) const;
+        double floating(size_t& offset) const;
+
+        /* Reads a child reference, returning false for a null child. The child is checked to be
+         * written before `record` and to not be referenced by any other record, so the records
+         * form a tree which is read in time linear to the size of the body */
+        bool child(size_t& offset, size_t record, size_t& child_offset) const;
+
+        /* Track how deeply the records being read nest, throwing once they're deeper than
+         * `KH_SERIAL_DEPTH_LIMIT` */
+        void enter(size_t record) const;
+        void leave() const;
+
+    private:
+        const unsigned char* data;
+        size_t size;
+
+        size_t string_count;
+        const unsigned char* string_index;
+        const unsigned char* string_data;
+        size_t string_data_size;
+
+        const unsigned char* body;
+        size_t body_size;
+        size_t root_offset;
+
+        /* The records referenced so far, and how deep the one being read is */
+        mutable std::vector<bool> referenced;
+        mutable size_t depth = 0;
+    };
+}
@@ -0,0 +1,51 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <kithare/exception.hpp>
+
+
+namespace kh {
+    class ServerException : public kh::Exception {
+    public:
+        std::string what;
+
+        ServerException(const std::string& _what) : what(_what) {}
+        virtual ~ServerException() {}
+        virtual std::string format() const;
+    };
+
+    /* A compile request sent by `kcr --client`, the working directory is passed along so relative
+     * paths in the arguments could be resolved by the server */
+    struct ServerRequest {
+        std::string cwd;
+        std::vector<std::u32string> args;
+    };
+
+    struct ServerResponse {
+        int code = 0;
+        std::string out;
+        std::string err;
+    };
+
+    typedef std::function<kh::ServerResponse(const kh::ServerRequest&)> ServerHandler;
+
+    /* Gets the default Unix socket path the compile server listens on */
+    std::string defaultSocketPath();
+
+    /* Listens on `socket_path` and serves compile requests with `handler` on a pool of `workers`
+     * threads, this only returns by throwing a `kh::ServerException` */
+    void runServer(const std::string& socket_path, const kh::ServerHandler& handler,
+                   size_t workers = 0);
+
+    /* Sends a single compile request to the server listening at `socket_path` */
+    kh::ServerResponse runClient(const std::string& socket_path, const kh::ServerRequest& request);
+}
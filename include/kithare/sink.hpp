@@ -0,0 +1,53 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/* Size of the buffer of a sink which writes to a file descriptor */
+#define KH_SINK_BUFFER_SIZE 65536
+
+
+namespace kh {
+    /* Buffered UTF-8 output, either written to a file descriptor with a few large writes or
+     * appended to a string */
+    class Sink {
+    public:
+        Sink(int _fd);
+        Sink(std::string& _str);
+        ~Sink();
+
+        Sink(const kh::Sink&) = delete;
+        kh::Sink& operator=(const kh::Sink&) = delete;
+
+        void write(char chr);
+        void write(const char* str);
+        void write(const char* data, size_t size);
+        void write(const std::string& str);
+
+        /* Encodes the string as UTF-8 */
+        void write(const std::u32string& str);
+        void writeUtf8(char32_t chr);
+
+        void writeInt(int64_t n);
+        void writeUint(uint64_t n);
+        void writeFloat(double n);
+
+        /* Writes out everything buffered to the file descriptor */
+        void flush();
+
+    private:
+        int fd = -1;
+        std::string* str = nullptr;
+
+        char* buffer = nullptr;
+        size_t size = 0;
+
+        void writeOut(const char* data, size_t size);
+    };
+}
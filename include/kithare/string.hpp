@@ -9,6 +9,9 @@
 #include <complex>
 #include <string>
 
+/* Size of a buffer which fits any number written by `kh::formatFloat` */
+#define KH_FLOAT_STR_SIZE 32
+
 
 namespace kh {
     void getLineColumn(const std::u32string& str, size_t index, size_t& column, size_t& line);
@@ -28,6 +31,14 @@ namespace kh {
     std::u32string str(float n);
     std::u32string str(double n);
 
+    /* Writes the shortest digits which read back to exactly `n` into the buffer, such as `0.1`,
+     * `25.0` or `1e+100`, returns the end of what was written */
+    char* formatFloat(char* buffer, double n);
+    char* formatFloat(char* buffer, float n);
+
     std::u32string str(const std::complex<float>& n);
     std::u32string str(const std::complex<double>& n);
+
+    /* FNV-1a hash of the bytes, which unlike `std::hash` is stable across runs and platforms */
+    uint64_t hash(const std::string& str);
 }
@@ -0,0 +1,148 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* ID which no identifier has, and the value of names which aren't bound */
+#define KH_NO_IDENTIFIER ((uint32_t)-1)
+
+/* Amount of independently locked parts of the identifier interner */
+#define KH_IDENTIFIER_SHARDS 64
+
+
+namespace kh {
+    /* Gets the ID of an identifier from the calling thread's interner, which is the same for every
+     * occurrence of it in every module. It's safe to call from many threads at once */
+    uint32_t internIdentifier(const std::string& name);
+
+    const std::string& identifierName(uint32_t id);
+
+    /* A generation of identifier IDs, the same as a `kh::TypeInterner` is of types */
+    class IdentifierInterner;
+
+    std::shared_ptr<kh::IdentifierInterner> newIdentifierInterner();
+
+    /* Makes the calling thread intern its identifiers into `interner` while this lives, see
+     * `kh::TypeScope` */
+    class IdentifierScope {
+    public:
+        IdentifierScope(const std::shared_ptr<kh::IdentifierInterner>& interner);
+        ~IdentifierScope();
+
+        IdentifierScope(const kh::IdentifierScope&) = delete;
+        kh::IdentifierScope& operator=(const kh::IdentifierScope&) = delete;
+
+    private:
+        std::shared_ptr<kh::IdentifierInterner> previous;
+    };
+
+    /* The generation of the calling thread's innermost `kh::IdentifierScope`, null outside of
+     * them */
+    std::shared_ptr<kh::IdentifierInterner> currentIdentifierInterner();
+
+    /* Open addressing hash map keyed by identifier IDs, probed linearly through flat arrays. Keys
+     * are never removed, the owners rebind them to a value meaning unbound instead */
+    template <typename T>
+    class IdMap {
+    public:
+        IdMap() : keys(16, KH_NO_IDENTIFIER), values(16) {}
+
+        T* find(uint32_t id) {
+            size_t slot = this->slotOf(id);
+            return this->keys[slot] == id ? &this->values[slot] : nullptr;
+        }
+
+        const T* find(uint32_t id) const {
+            size_t slot = this->slotOf(id);
+            return this->keys[slot] == id ? &this->values[slot] : nullptr;
+        }
+
+        /* Gets the value of the key, inserting a default one if it's not in the map */
+        T& operator[](uint32_t id) {
+            size_t slot = this->slotOf(id);
+            if (this->keys[slot] == id) {
+                return this->values[slot];
+            }
+
+            /* Kept at most half full, so probes stay short */
+            if ((this->count + 1) * 2 > this->keys.size()) {
+                this->grow();
+                slot = this->slotOf(id);
+            }
+
+            this->keys[slot] = id;
+            this->count++;
+            return this->values[slot];
+        }
+
+        size_t size() const {
+            return this->count;
+        }
+
+    private:
+        std::vector<uint32_t> keys;
+        std::vector<T> values;
+        size_t count = 0;
+
+        /* Finds the slot of the key, or the empty slot where it would be inserted */
+        size_t slotOf(uint32_t id) const {
+            size_t mask = this->keys.size() - 1;
+            size_t slot = ((size_t)id * 0x9E3779B97F4A7C15ull >> 32) & mask;
+            while (this->keys[slot] != id && this->keys[slot] != KH_NO_IDENTIFIER) {
+                slot = (slot + 1) & mask;
+            }
+            return slot;
+        }
+
+        void grow() {
+            std::vector<uint32_t> old_keys = std::move(this->keys);
+            std::vector<T> old_values = std::move(this->values);
+            this->keys.assign(old_keys.size() * 2, KH_NO_IDENTIFIER);
+            this->values = std::vector<T>(old_values.size() * 2);
+
+            for (size_t i = 0; i < old_keys.size(); i++) {
+                if (old_keys[i] != KH_NO_IDENTIFIER) {
+                    size_t slot = this->slotOf(old_keys[i]);
+                    this->keys[slot] = old_keys[i];
+                    this->values[slot] = std::move(old_values[i]);
+                }
+            }
+        }
+    };
+
+    /* Nested scopes of names in a single table. Declarations overwrite the outer bindings and
+     * remember them in an undo log, which popping a scope unwinds, so looking a name up costs the
+     * same however deep the scopes are */
+    class ScopedSymbols {
+    public:
+        void push();
+        void pop();
+
+        /* Binds the name in the innermost scope, false if it's bound in that scope already */
+        bool declare(uint32_t id, uint32_t value);
+
+        /* Gets the value bound to the name, or `KH_NO_IDENTIFIER` */
+        uint32_t find(uint32_t id) const;
+
+        size_t depth() const;
+
+    private:
+        struct Binding {
+            uint32_t value = KH_NO_IDENTIFIER;
+            uint32_t depth = 0;
+        };
+
+        kh::IdMap<Binding> bindings;
+        std::vector<std::pair<uint32_t, Binding>> undo;
+        std::vector<size_t> marks;
+    };
+}
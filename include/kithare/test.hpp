@@ -18,6 +18,9 @@
 
 namespace kh_test {
     void utf8Test(std::vector<std::string>& errors);
+    void stringTest(std::vector<std::string>& errors);
     void lexerTest(std::vector<std::string>& errors);
     void parserTest(std::vector<std::string>& errors);
+    void importerTest(std::vector<std::string>& errors);
+    void builderTest(std::vector<std::string>& errors);
 }
@@ -0,0 +1,51 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace kh {
+    class ThreadPool {
+    public:
+        /* A worker count of 0 uses the amount of hardware threads available */
+        ThreadPool(size_t workers = 0);
+        ~ThreadPool();
+
+        ThreadPool(const kh::ThreadPool&) = delete;
+        kh::ThreadPool& operator=(const kh::ThreadPool&) = delete;
+
+        /* Queues a task to be ran by one of the workers */
+        void submit(const std::function<void()>& task);
+
+        /* Blocks until every submitted task has finished running, then rethrows the first exception
+         * a task threw since the last wait if there was one */
+        void wait();
+
+        size_t size() const;
+
+    private:
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> tasks;
+
+        std::mutex mutex;
+        std::condition_variable task_available;
+        std::condition_variable task_done;
+
+        std::exception_ptr exception;
+        size_t running = 0;
+        bool stopping = false;
+
+        void work();
+    };
+}
@@ -6,10 +6,13 @@
 
 #pragma once
 
+#include <kithare/sink.hpp>
 #include <kithare/string.hpp>
 
 
 namespace kh {
+    class JsonWriter;
+
     struct Token;
     struct TokenValue;
     enum class Operator;
@@ -21,6 +24,17 @@ namespace kh {
     std::u32string str(kh::Operator op);
     std::u32string str(kh::Symbol sym);
 
+    /* ASCII spellings of the token types, operators and symbols */
+    const char* cstr(kh::TokenType type);
+    const char* cstr(kh::Operator op);
+    const char* cstr(kh::Symbol sym);
+
+    /* Writes the token in the same format as `kh::str` without building a string */
+    void writeToken(kh::Sink& sink, const kh::Token& token, bool show_token_type = false);
+
+    /* Writes the token as a JSON object with its `type`, source `index`, `length` and `value` */
+    void writeJson(kh::JsonWriter& json, const kh::Token& token);
+
     enum class Operator {
         ADD,
         SUB,
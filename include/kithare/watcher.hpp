@@ -0,0 +1,51 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <kithare/exception.hpp>
+
+
+namespace kh {
+    class WatchException : public kh::Exception {
+    public:
+        std::string what;
+
+        WatchException(const std::string& _what) : what(_what) {}
+        virtual ~WatchException() {}
+        virtual std::string format() const;
+    };
+
+    /* Recursively finds every `.kh` source file inside of a directory */
+    std::vector<std::string> findSources(const std::string& directory);
+
+    /* Watches a directory tree for modified `.kh` files, this is only supported on Linux where it's
+     * implemented with inotify */
+    class Watcher {
+    public:
+        Watcher(const std::string& _directory);
+        ~Watcher();
+
+        Watcher(const kh::Watcher&) = delete;
+        kh::Watcher& operator=(const kh::Watcher&) = delete;
+
+        /* Blocks until at least one source file got written, created or removed, then returns the
+         * paths of every source changed during that burst of events (editors tend to save in
+         * several steps) */
+        std::vector<std::string> wait();
+
+    private:
+        std::string directory;
+        int fd = -1;
+        std::unordered_map<int, std::string> watched_dirs;
+
+        void watchTree(const std::string& path, std::vector<std::string>* new_sources);
+    };
+}
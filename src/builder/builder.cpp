@@ -3,3 +3,486 @@
  * The source code for Kithare programming language is distributed under the MIT license.
  * Copyright (C) 2021 Kithare Organization
  */
+
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+
+#include <kithare/builder.hpp>
+#include <kithare/utf8.hpp>
+
+
+std::string kh::BuildException::format() const {
+    return this->what + " at line " + std::to_string(this->line) + " column " +
+           std::to_string(this->column);
+}
+
+void kh::locate(std::vector<kh::BuildException>& exceptions, const std::vector<kh::Token>& tokens) {
+    for (kh::BuildException& exc : exceptions) {
+        /* The tokens are sorted by their index */
+        auto token = std::lower_bound(
+            tokens.begin(), tokens.end(), exc.index,
+            [](const kh::Token& token, size_t index) { return token.index < index; });
+        if (token != tokens.end()) {
+            exc.line = token->line;
+            exc.column = token->column;
+        }
+    }
+}
+
+static std::string joinNames(const std::vector<std::string>& names) {
+    std::string joined;
+    for (size_t i = 0; i < names.size(); i++) {
+        if (i) {
+            joined += '.';
+        }
+        joined += names[i];
+    }
+    return joined;
+}
+
+kh::Builder::Builder(const kh::AstModule& _module_ast, kh::IrModule& _module_ir)
+    : module_ast(_module_ast), module_ir(_module_ir) {}
+
+const kh::AstModule& kh::Builder::moduleAst() const {
+    return this->module_ast;
+}
+
+const kh::IrModule& kh::Builder::moduleIr() const {
+    return this->module_ir;
+}
+
+const kh::BuildSymbol* kh::Builder::symbol(uint32_t id) const {
+    return this->symbols.find(id);
+}
+
+const kh::BuildSymbol* kh::Builder::symbol(const std::string& name) const {
+    return this->symbols.find(kh::internIdentifier(name));
+}
+
+void kh::Builder::build(size_t workers) {
+    this->declare();
+
+    /* Every body is lowered on its own, with the constants it uses going into a scratch module of
+     * its task, so the tasks only share the symbols and the types which are read-only or locked.
+     * Instances of generics queue their own tasks as they're made */
+    std::vector<kh::BuildTask*> declared_tasks;
+    for (kh::BuildTask& task : this->tasks) {
+        declared_tasks.push_back(&task);
+    }
+
+    {
+        kh::ThreadPool pool(workers);
+        this->pool = &pool;
+        this->types = kh::currentTypeInterner();
+        this->identifiers = kh::currentIdentifierInterner();
+        for (kh::BuildTask* task : declared_tasks) {
+            this->submit(*task);
+        }
+        pool.wait();
+        this->pool = nullptr;
+    }
+
+    /* Merged in the order of the functions, so the pools and the diagnostics are the same whichever
+     * order the tasks had finished in */
+    for (kh::BuildTask* task : this->sortInstances(declared_tasks.size())) {
+        const kh::IrModule& scratch = task->scratch;
+
+        std::vector<uint32_t> constants(scratch.constants.size());
+        for (size_t j = 0; j < scratch.constants.size(); j++) {
+            kh::IrConst value = scratch.constants[j];
+            if (value.kind == kh::IrConst::STRING) {
+                value.bits[0] = this->module_ir.string(scratch.strings[value.bits[0]]);
+            }
+            else if (value.kind == kh::IrConst::BUFFER) {
+                value.bits[0] = this->module_ir.buffer(scratch.buffers[value.bits[0]]);
+            }
+            constants[j] = this->module_ir.constant(value);
+        }
+
+        for (kh::IrInstruction& instruction : task->function->code) {
+            if (instruction.op == kh::IrOp::CONST) {
+                instruction.a = constants[instruction.a];
+            }
+        }
+
+        this->exceptions.insert(this->exceptions.end(), task->errors.begin(), task->errors.end());
+    }
+
+    /* Every instance of a generic reports the errors of its body, once is enough */
+    std::stable_sort(this->exceptions.begin(), this->exceptions.end(),
+                     [](const kh::BuildException& a, const kh::BuildException& b) {
+                         return a.index < b.index;
+                     });
+    this->exceptions.erase(std::unique(this->exceptions.begin(), this->exceptions.end(),
+                                       [](const kh::BuildException& a, const kh::BuildException& b) {
+                                           return a.index == b.index && a.what == b.what;
+                                       }),
+                           this->exceptions.end());
+}
+
+void kh::Builder::submit(kh::BuildTask& task) {
+    this->pool->submit([this, &task]() {
+        kh::TypeScope types(this->types);
+        kh::IdentifierScope identifiers(this->identifiers);
+        this->lower(task);
+    });
+}
+
+std::vector<kh::BuildTask*> kh::Builder::sortInstances(size_t declared) {
+    std::vector<kh::IrFunction*>& functions = this->module_ir.functions;
+    std::vector<kh::BuildTask*> ordered;
+    for (kh::BuildTask& task : this->tasks) {
+        ordered.push_back(&task);
+    }
+
+    /* The names of the instances are unique, as they have the type arguments in them */
+    std::sort(ordered.begin() + declared, ordered.end(),
+              [](const kh::BuildTask* a, const kh::BuildTask* b) {
+                  return a->function->name < b->function->name;
+              });
+
+    std::unordered_map<const kh::IrFunction*, uint32_t> old_indices;
+    for (size_t i = 0; i < functions.size(); i++) {
+        old_indices[functions[i]] = (uint32_t)i;
+    }
+
+    std::vector<uint32_t> remap(functions.size());
+    for (size_t i = 0; i < functions.size(); i++) {
+        remap[old_indices[ordered[i]->function]] = (uint32_t)i;
+    }
+
+    for (size_t i = declared; i < functions.size(); i++) {
+        functions[i] = ordered[i]->function;
+    }
+    for (kh::IrFunction* function_ir : functions) {
+        for (kh::IrInstruction& instruction : function_ir->code) {
+            if (instruction.op == kh::IrOp::CALL) {
+                instruction.a = remap[instruction.a];
+            }
+        }
+    }
+
+    return ordered;
+}
+
+void kh::Builder::declare() {
+    auto add = [this](const std::string& name, const kh::BuildSymbol& symbol, size_t index) {
+        uint32_t id = kh::internIdentifier(name);
+        if (this->symbols.find(id)) {
+            this->exceptions.emplace_back("`" + name + "` is already declared", index);
+            return false;
+        }
+        this->symbols[id] = symbol;
+        return true;
+    };
+
+    /* Types first, as the rest refer to them. Generic ones are only types with their arguments */
+    for (size_t i = 0; i < this->module_ast.user_types.size(); i++) {
+        const kh::AstUserType& type_ast = this->module_ast.user_types[i];
+        std::string name = joinNames(type_ast.identifiers);
+        const kh::IrType* type =
+            type_ast.generic_args.empty()
+                ? this->module_ir.type(type_ast.is_class ? kh::IrType::CLASS : kh::IrType::STRUCT,
+                                       {}, 0, name)
+                : nullptr;
+        add(name, {kh::BuildSymbol::TYPE, (uint32_t)i, type}, type_ast.index);
+    }
+
+    for (size_t i = 0; i < this->module_ast.enums.size(); i++) {
+        const kh::AstEnumType& enum_ast = this->module_ast.enums[i];
+        std::string name = joinNames(enum_ast.identifiers);
+        add(name,
+            {kh::BuildSymbol::ENUM, (uint32_t)i, this->module_ir.type(kh::IrType::ENUM, {}, 0, name)},
+            enum_ast.index);
+    }
+
+    bool initialized = false;
+    for (const kh::AstDeclaration& variable : this->module_ast.variables) {
+        const kh::IrType* type =
+            this->resolveType(variable.var_type, variable.refs, variable.var_array, this->exceptions);
+        if (!type) {
+            continue;
+        }
+
+        if (add(variable.var_name,
+                {kh::BuildSymbol::GLOBAL, (uint32_t)this->module_ir.globals.size(), type},
+                variable.index)) {
+            this->module_ir.globals.emplace_back(variable.var_name, type, variable.index);
+            this->module_ir.globals.back().is_public = variable.is_public;
+            initialized = initialized || variable.expression;
+        }
+    }
+
+    for (const kh::AstFunction& function_ast : this->module_ast.functions) {
+        this->declareFunction(function_ast, joinNames(function_ast.identifiers));
+    }
+
+    for (const kh::AstUserType& type_ast : this->module_ast.user_types) {
+        for (const kh::AstFunction& method_ast : type_ast.methods) {
+            this->declareFunction(method_ast,
+                                  joinNames(type_ast.identifiers) + "." +
+                                      joinNames(method_ast.identifiers),
+                                  type_ast.generic_args);
+        }
+    }
+
+    /* The initializers of the globals go into a function of their own, its name can't clash */
+    if (initialized) {
+        kh::IrFunction* init =
+            this->module_ir.function("#init", this->module_ir.type(kh::IrType::VOID));
+        init->is_public = false;
+        this->tasks.emplace_back();
+        this->tasks.back().function = init;
+        this->tasks.back().function_ast = nullptr;
+    }
+}
+
+void kh::Builder::declareFunction(const kh::AstFunction& function_ast, const std::string& name,
+                                  const std::vector<std::string>& type_generic_args) {
+    uint32_t id = kh::internIdentifier(name);
+    if (this->symbols.find(id)) {
+        this->exceptions.emplace_back("`" + name + "` is already declared", function_ast.index);
+        return;
+    }
+
+    /* Generics are only declared here, their instances are made as they're used */
+    if (!function_ast.generic_args.empty() || !type_generic_args.empty()) {
+        GenericFunction generic{&function_ast, name, {}};
+        for (const std::string& arg : type_generic_args) {
+            generic.arguments.push_back(kh::internIdentifier(arg));
+        }
+        for (const std::string& arg : function_ast.generic_args) {
+            generic.arguments.push_back(kh::internIdentifier(arg));
+        }
+
+        this->symbols[id] = {kh::BuildSymbol::GENERIC_FUNCTION, (uint32_t)this->generics.size(),
+                             nullptr};
+        this->generics.push_back(generic);
+        return;
+    }
+
+    const kh::IrType* signature =
+        this->addFunction(function_ast, name, kh::GenericBindings(), 0, this->exceptions);
+    if (signature) {
+        this->symbols[id] = {kh::BuildSymbol::FUNCTION,
+                             (uint32_t)(this->module_ir.functions.size() - 1), signature};
+    }
+}
+
+const kh::IrType* kh::Builder::addFunction(const kh::AstFunction& function_ast,
+                                           const std::string& name,
+                                           const kh::GenericBindings& bindings, size_t depth,
+                                           std::vector<kh::BuildException>& errors) {
+    std::vector<const kh::IrType*> signature{this->resolveType(
+        function_ast.return_type, function_ast.return_refs, function_ast.return_array, errors,
+        &bindings)};
+    for (const kh::AstDeclaration& argument : function_ast.arguments) {
+        signature.push_back(this->resolveType(argument.var_type, argument.refs, argument.var_array,
+                                              errors, &bindings));
+    }
+
+    if (std::find(signature.begin(), signature.end(), nullptr) != signature.end()) {
+        return nullptr;
+    }
+
+    kh::IrFunction* function_ir = this->module_ir.function(name, signature[0], function_ast.index);
+    function_ir->is_public = function_ast.is_public;
+    for (size_t i = 0; i < function_ast.arguments.size(); i++) {
+        function_ir->local(function_ast.arguments[i].var_name, signature[i + 1],
+                           function_ast.arguments[i].index);
+    }
+    function_ir->arguments = function_ast.arguments.size();
+
+    this->tasks.emplace_back();
+    kh::BuildTask& task = this->tasks.back();
+    task.function = function_ir;
+    task.function_ast = &function_ast;
+    task.bindings = bindings;
+    task.depth = depth;
+
+    return this->module_ir.type(kh::IrType::FUNC, signature);
+}
+
+size_t kh::Builder::InstanceHash::operator()(
+    const std::pair<uint32_t, std::vector<const kh::IrType*>>& key) const {
+    size_t hash = key.first;
+    for (const kh::IrType* type : key.second) {
+        hash = hash * 31 + type->hash;
+    }
+    return hash;
+}
+
+const kh::BuildSymbol* kh::Builder::instantiate(uint32_t generic,
+                                                const std::vector<const kh::IrType*>& args,
+                                                size_t depth, size_t index,
+                                                std::vector<kh::BuildException>& errors) {
+    const GenericFunction& generic_function = this->generics[generic];
+    if (args.size() != generic_function.arguments.size()) {
+        errors.emplace_back("`" + generic_function.name + "` takes " +
+                                std::to_string(generic_function.arguments.size()) +
+                                " generic argument(s) but " + std::to_string(args.size()) +
+                                " were given",
+                            index);
+        return nullptr;
+    }
+
+    kh::BuildTask* task = nullptr;
+    const kh::BuildSymbol* symbol;
+    {
+        std::lock_guard<std::mutex> lock(this->instances_mutex);
+        auto found = this->instances.find({generic, args});
+        if (found != this->instances.end()) {
+            return found->second.type ? &found->second : nullptr;
+        }
+
+        if (depth > KH_GENERIC_DEPTH_LIMIT) {
+            errors.emplace_back("`" + generic_function.name + "` is instantiated too deeply", index);
+            return nullptr;
+        }
+
+        std::string name = generic_function.name + "!(";
+        kh::GenericBindings bindings;
+        for (size_t i = 0; i < args.size(); i++) {
+            bindings[generic_function.arguments[i]] = args[i];
+            name += (i ? ", " : "") + kh::encodeUtf8(kh::str(args[i]));
+        }
+        name += ')';
+
+        /* Invalid instances are remembered too, so their errors are only reported once */
+        size_t tasks = this->tasks.size();
+        const kh::IrType* signature =
+            this->addFunction(*generic_function.function_ast, name, bindings, depth, errors);
+        symbol = &this->instances
+                      .emplace(std::make_pair(generic, args),
+                               kh::BuildSymbol{kh::BuildSymbol::FUNCTION,
+                                               (uint32_t)(this->module_ir.functions.size() - 1),
+                                               signature})
+                      .first->second;
+        if (this->tasks.size() > tasks) {
+            task = &this->tasks.back();
+            task->function->is_instance = true;
+        }
+    }
+
+    if (!symbol->type) {
+        return nullptr;
+    }
+    this->submit(*task);
+    return symbol;
+}
+
+const kh::AstFunction& kh::Builder::genericAst(uint32_t generic) const {
+    return *this->generics[generic].function_ast;
+}
+
+const std::vector<uint32_t>& kh::Builder::genericArguments(uint32_t generic) const {
+    return this->generics[generic].arguments;
+}
+
+static const std::unordered_map<std::string, kh::IrType::Kind> primitive_types = {
+    {"void", kh::IrType::VOID},         {"bool", kh::IrType::BOOL},
+    {"char", kh::IrType::CHAR},         {"int8", kh::IrType::INT8},
+    {"int16", kh::IrType::INT16},       {"int32", kh::IrType::INT32},
+    {"int64", kh::IrType::INT64},       {"int", kh::IrType::INT64},
+    {"uint8", kh::IrType::UINT8},       {"byte", kh::IrType::UINT8},
+    {"uint16", kh::IrType::UINT16},     {"uint32", kh::IrType::UINT32},
+    {"uint64", kh::IrType::UINT64},     {"uint", kh::IrType::UINT64},
+    {"float", kh::IrType::FLOAT},       {"double", kh::IrType::DOUBLE},
+    {"complexf", kh::IrType::COMPLEXF}, {"complex", kh::IrType::COMPLEX},
+    {"str", kh::IrType::STRING},        {"buffer", kh::IrType::BUFFER}};
+
+const kh::IrType* kh::Builder::resolveType(const kh::AstIdentifiers& type_ast, size_t refs,
+                                           const std::vector<uint64_t>& array,
+                                           std::vector<kh::BuildException>& errors,
+                                           const kh::GenericBindings* bindings) const {
+    std::string name = joinNames(type_ast.identifiers);
+    uint32_t id = kh::internIdentifier(name);
+    const kh::BuildSymbol* symbol = this->symbol(id);
+    const kh::IrType* const* bound = bindings ? bindings->find(id) : nullptr;
+    const kh::IrType* type = nullptr;
+
+    if (!type_ast.generics.empty()) {
+        std::vector<const kh::IrType*> children;
+        for (size_t i = 0; i < type_ast.generics.size(); i++) {
+            children.push_back(this->resolveType(
+                type_ast.generics[i], i < type_ast.generics_refs.size() ? type_ast.generics_refs[i] : 0,
+                i < type_ast.generics_array.size() ? type_ast.generics_array[i]
+                                                   : std::vector<uint64_t>(),
+                errors, bindings));
+            if (!children.back()) {
+                return nullptr;
+            }
+        }
+
+        /* Instances of generic user types are told apart by their arguments, which interning
+         * makes each of them once */
+        const kh::AstUserType* type_ast_ptr =
+            symbol && symbol->kind == kh::BuildSymbol::TYPE && !bound
+                ? &this->module_ast.user_types[symbol->id]
+                : nullptr;
+
+        if (name == "list" && children.size() == 1) {
+            type = kh::internType(kh::IrType::LIST, children);
+        }
+        else if (name == "dict" && children.size() == 2) {
+            type = kh::internType(kh::IrType::DICT, children);
+        }
+        else if (name == "tuple") {
+            type = kh::internType(kh::IrType::TUPLE, children);
+        }
+        else if (type_ast_ptr && type_ast_ptr->generic_args.size() == children.size()) {
+            type = kh::internType(type_ast_ptr->is_class ? kh::IrType::CLASS : kh::IrType::STRUCT,
+                                  children, 0, name);
+        }
+        else if (type_ast_ptr) {
+            errors.emplace_back("`" + name + "` takes " +
+                                    std::to_string(type_ast_ptr->generic_args.size()) +
+                                    " generic argument(s) but " + std::to_string(children.size()) +
+                                    " were given",
+                                type_ast.index);
+            return nullptr;
+        }
+        else {
+            errors.emplace_back("`" + name + "` isn't a generic type", type_ast.index);
+            return nullptr;
+        }
+    }
+    else {
+        auto primitive = primitive_types.find(name);
+
+        if (bound && *bound) {
+            type = *bound;
+        }
+        else if (primitive != primitive_types.end()) {
+            type = kh::internType(primitive->second);
+        }
+        else if (symbol && symbol->kind == kh::BuildSymbol::TYPE && !symbol->type) {
+            errors.emplace_back("`" + name + "` needs generic arguments", type_ast.index);
+            return nullptr;
+        }
+        else if (symbol &&
+                 (symbol->kind == kh::BuildSymbol::TYPE || symbol->kind == kh::BuildSymbol::ENUM)) {
+            type = symbol->type;
+        }
+        else {
+            errors.emplace_back("unknown type `" + name + "`", type_ast.index);
+            return nullptr;
+        }
+    }
+
+    if (type->kind == kh::IrType::VOID && (refs || !array.empty())) {
+        errors.emplace_back("`void` can't be referenced or be the element of an array", type_ast.index);
+        return nullptr;
+    }
+
+    /* `int[2][3]` is an array of 2 arrays of 3 integers */
+    for (size_t i = array.size(); i > 0; i--) {
+        type = kh::internType(kh::IrType::ARRAY, {type}, array[i - 1]);
+    }
+    for (size_t i = 0; i < refs; i++) {
+        type = kh::internType(kh::IrType::REF, {type});
+    }
+
+    return type;
+}
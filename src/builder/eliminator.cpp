@@ -0,0 +1,209 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <kithare/passes.hpp>
+
+
+/* Instructions which can be dropped if nothing uses their value. Integer divisions are kept, as
+ * they may be divisions by zero */
+static bool isPure(kh::IrOp op) {
+    switch (op) {
+        case kh::IrOp::STORE:
+        case kh::IrOp::GLOBAL_STORE:
+        case kh::IrOp::DIV:
+        case kh::IrOp::MOD:
+        case kh::IrOp::CALL:
+        case kh::IrOp::JUMP:
+        case kh::IrOp::BRANCH:
+        case kh::IrOp::RETURN:
+        case kh::IrOp::NOP:
+            return false;
+        default:
+            return true;
+    }
+}
+
+/* Drops the assignments of locals which are never read and the values nothing uses, then removes
+ * the instructions and the locals left unused */
+static void eliminateInFunction(kh::IrFunction& function_ir, const std::vector<bool>& live_globals) {
+    std::vector<kh::IrInstruction>& code = function_ir.code;
+    const kh::IrType* void_type = kh::internType(kh::IrType::VOID);
+    auto remove = [void_type](kh::IrInstruction& instruction) {
+        instruction.op = kh::IrOp::NOP;
+        instruction.type = void_type;
+        instruction.a = KH_IR_NONE;
+        instruction.b = KH_IR_NONE;
+        instruction.c = KH_IR_NONE;
+    };
+
+    std::vector<bool> read(function_ir.locals.size());
+    for (size_t i = 0; i < function_ir.arguments; i++) {
+        read[i] = true;
+    }
+    for (const kh::IrInstruction& instruction : code) {
+        if (instruction.op == kh::IrOp::LOAD) {
+            read[instruction.a] = true;
+        }
+    }
+    for (kh::IrInstruction& instruction : code) {
+        if ((instruction.op == kh::IrOp::STORE && !read[instruction.a]) ||
+            (instruction.op == kh::IrOp::GLOBAL_STORE && !live_globals[instruction.a])) {
+            remove(instruction);
+        }
+    }
+
+    /* Values come before the instructions using them, so one pass backwards drops the ones only
+     * used by dropped instructions */
+    std::vector<size_t> uses(code.size());
+    for (kh::IrInstruction& instruction : code) {
+        kh::forEachValue(instruction, function_ir.operands, [&](uint32_t& value) { uses[value]++; });
+    }
+    for (size_t i = code.size(); i > 0; i--) {
+        kh::IrInstruction& instruction = code[i - 1];
+        if (!uses[i - 1] && isPure(instruction.op)) {
+            kh::forEachValue(instruction, function_ir.operands,
+                             [&](uint32_t& value) { uses[value]--; });
+            remove(instruction);
+        }
+    }
+
+    /* Jumps over nothing but removed instructions are removed too, going backwards so jumps to
+     * such jumps are found as well */
+    std::vector<uint32_t> next(code.size() + 1);
+    next[code.size()] = (uint32_t)code.size();
+    for (size_t i = code.size(); i > 0; i--) {
+        kh::IrInstruction& instruction = code[i - 1];
+        if (instruction.op == kh::IrOp::JUMP && instruction.a >= i && next[instruction.a] == next[i]) {
+            remove(instruction);
+        }
+        next[i - 1] = instruction.op == kh::IrOp::NOP ? next[i] : (uint32_t)(i - 1);
+    }
+
+    /* Jumps to a removed instruction go to the next one kept */
+    std::vector<uint32_t> indices(code.size() + 1);
+    size_t size = 0;
+    for (size_t i = 0; i < code.size(); i++) {
+        indices[i] = (uint32_t)size;
+        if (code[i].op != kh::IrOp::NOP) {
+            code[size++] = code[i];
+        }
+    }
+    indices[code.size()] = (uint32_t)size;
+    code.resize(size);
+
+    std::vector<uint32_t> locals(function_ir.locals.size(), KH_IR_NONE);
+    std::vector<kh::IrVariable> kept_locals;
+    for (size_t i = 0; i < function_ir.locals.size(); i++) {
+        if (read[i]) {
+            locals[i] = (uint32_t)kept_locals.size();
+            kept_locals.push_back(function_ir.locals[i]);
+        }
+    }
+    function_ir.locals = kept_locals;
+
+    for (kh::IrInstruction& instruction : code) {
+        kh::forEachValue(instruction, function_ir.operands,
+                         [&](uint32_t& value) { value = indices[value]; });
+
+        switch (instruction.op) {
+            case kh::IrOp::LOAD:
+            case kh::IrOp::STORE:
+                instruction.a = locals[instruction.a];
+                break;
+            case kh::IrOp::JUMP:
+                instruction.a = indices[instruction.a];
+                break;
+            case kh::IrOp::BRANCH:
+                instruction.b = indices[instruction.b];
+                instruction.c = indices[instruction.c];
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+kh::EliminatedCode kh::eliminateDeadCode(kh::IrModule& module_ir) {
+    std::vector<kh::IrFunction*>& functions = module_ir.functions;
+    kh::EliminatedCode eliminated;
+
+    /* Programs start from `main` and the initializer of the globals, the public functions and
+     * globals of modules without a `main` are used by the ones importing them */
+    bool is_program = false;
+    for (const kh::IrFunction* function_ir : functions) {
+        is_program = is_program || function_ir->name == "main";
+    }
+
+    std::vector<bool> live(functions.size());
+    std::vector<uint32_t> pending;
+    for (size_t i = 0; i < functions.size(); i++) {
+        const kh::IrFunction& function_ir = *functions[i];
+        if (function_ir.name == "#init" || function_ir.name == "main" ||
+            (!is_program && function_ir.is_public && !function_ir.is_instance)) {
+            live[i] = true;
+            pending.push_back((uint32_t)i);
+        }
+    }
+
+    std::vector<bool> live_globals(module_ir.globals.size());
+    for (size_t i = 0; i < module_ir.globals.size(); i++) {
+        live_globals[i] = !is_program && module_ir.globals[i].is_public;
+    }
+
+    while (!pending.empty()) {
+        const kh::IrFunction& function_ir = *functions[pending.back()];
+        pending.pop_back();
+
+        for (const kh::IrInstruction& instruction : function_ir.code) {
+            if (instruction.op == kh::IrOp::CALL && !live[instruction.a]) {
+                live[instruction.a] = true;
+                pending.push_back(instruction.a);
+            }
+            else if (instruction.op == kh::IrOp::GLOBAL_LOAD) {
+                live_globals[instruction.a] = true;
+            }
+        }
+    }
+
+    std::vector<uint32_t> indices(functions.size(), KH_IR_NONE);
+    size_t size = 0;
+    for (size_t i = 0; i < functions.size(); i++) {
+        if (live[i]) {
+            indices[i] = (uint32_t)size;
+            functions[size++] = functions[i];
+        }
+    }
+    eliminated.functions = functions.size() - size;
+    functions.resize(size);
+
+    std::vector<uint32_t> globals(module_ir.globals.size(), KH_IR_NONE);
+    std::vector<kh::IrVariable> kept_globals;
+    for (size_t i = 0; i < module_ir.globals.size(); i++) {
+        if (live_globals[i]) {
+            globals[i] = (uint32_t)kept_globals.size();
+            kept_globals.push_back(module_ir.globals[i]);
+        }
+    }
+    eliminated.globals = module_ir.globals.size() - kept_globals.size();
+    module_ir.globals = kept_globals;
+
+    for (kh::IrFunction* function_ir : functions) {
+        eliminateInFunction(*function_ir, live_globals);
+
+        for (kh::IrInstruction& instruction : function_ir->code) {
+            if (instruction.op == kh::IrOp::CALL) {
+                instruction.a = indices[instruction.a];
+            }
+            else if (instruction.op == kh::IrOp::GLOBAL_LOAD ||
+                     instruction.op == kh::IrOp::GLOBAL_STORE) {
+                instruction.a = globals[instruction.a];
+            }
+        }
+    }
+
+    eliminated.constants = module_ir.removeUnusedConstants();
+    return eliminated;
+}
@@ -0,0 +1,600 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <cmath>
+#include <complex>
+
+#include <kithare/passes.hpp>
+
+
+/* Integers are kept in 64 bits, sign-extended for the signed types and zero-extended for the rest,
+ * so wrapping them around is cutting them to their size */
+static uint64_t wrapInteger(const kh::IrType* type, uint64_t value) {
+    size_t bits = type->bits();
+    if (bits >= 64) {
+        return value;
+    }
+
+    uint64_t mask = ((uint64_t)1 << bits) - 1;
+    value &= mask;
+    if (type->isSigned() && (value >> (bits - 1)) & 1) {
+        value |= ~mask;
+    }
+    return value;
+}
+
+static bool isIntegral(const kh::IrType* type) {
+    return type->isInteger() || type->kind == kh::IrType::BOOL || type->kind == kh::IrType::CHAR;
+}
+
+static kh::IrConst integerConst(const kh::IrType* type, uint64_t value) {
+    value = wrapInteger(type, value);
+    if (type->kind == kh::IrType::BOOL) {
+        return kh::IrConst::boolean(type, value != 0);
+    }
+    else if (type->kind == kh::IrType::CHAR) {
+        return kh::IrConst::character(type, (char32_t)value);
+    }
+    else if (type->isSigned()) {
+        return kh::IrConst::integer(type, (int64_t)value);
+    }
+    return kh::IrConst::uinteger(type, value);
+}
+
+/* Integers of any size as the C code computes them, but wrapping around on overflows instead of
+ * being undefined. Divisions by zero and shifts by more than the size are left to the runtime */
+static bool integerArithmetic(kh::IrOp op, const kh::IrType* type, uint64_t x, uint64_t y,
+                              uint64_t& result) {
+    bool is_signed = type->isSigned();
+
+    switch (op) {
+        case kh::IrOp::ADD:
+            result = x + y;
+            break;
+        case kh::IrOp::SUB:
+            result = x - y;
+            break;
+        case kh::IrOp::MUL:
+            result = x * y;
+            break;
+
+        case kh::IrOp::DIV:
+        case kh::IrOp::MOD:
+            if (y == 0) {
+                return false;
+            }
+            /* The smallest number divided by -1 is the only signed division which overflows */
+            if (is_signed && (int64_t)y == -1) {
+                result = op == kh::IrOp::DIV ? 0 - x : 0;
+            }
+            else if (is_signed) {
+                result = (uint64_t)(op == kh::IrOp::DIV ? (int64_t)x / (int64_t)y
+                                                        : (int64_t)x % (int64_t)y);
+            }
+            else {
+                result = op == kh::IrOp::DIV ? x / y : x % y;
+            }
+            break;
+
+        case kh::IrOp::POW:
+            /* Negative powers are divisions, which truncate to 0 unless the base is 1 or -1 */
+            if (is_signed && (int64_t)y < 0) {
+                if (x == 0) {
+                    return false;
+                }
+                result = x == 1 ? 1 : (int64_t)x == -1 ? (y & 1 ? x : 1) : 0;
+                break;
+            }
+            result = 1;
+            for (; y; y >>= 1) {
+                if (y & 1) {
+                    result *= x;
+                }
+                x *= x;
+            }
+            break;
+
+        case kh::IrOp::BIT_AND:
+            result = x & y;
+            break;
+        case kh::IrOp::BIT_OR:
+            result = x | y;
+            break;
+
+        case kh::IrOp::BIT_LSHIFT:
+        case kh::IrOp::BIT_RSHIFT:
+            if (y >= type->bits()) {
+                return false;
+            }
+            if (op == kh::IrOp::BIT_LSHIFT) {
+                result = x << y;
+            }
+            else {
+                result = is_signed ? (uint64_t)((int64_t)x >> y) : x >> y;
+            }
+            break;
+
+        default:
+            return false;
+    }
+
+    result = wrapInteger(type, result);
+    return true;
+}
+
+/* Floats are computed as floats, rather than as doubles rounded afterwards */
+template <typename T>
+static bool floatingArithmetic(kh::IrOp op, T x, T y, T& result) {
+    switch (op) {
+        case kh::IrOp::ADD:
+            result = x + y;
+            return true;
+        case kh::IrOp::SUB:
+            result = x - y;
+            return true;
+        case kh::IrOp::MUL:
+            result = x * y;
+            return true;
+        case kh::IrOp::DIV:
+            result = x / y;
+            return true;
+        case kh::IrOp::MOD:
+            result = std::fmod(x, y);
+            return true;
+        case kh::IrOp::POW:
+            result = std::pow(x, y);
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Complex powers are left to the runtime, as the C libraries compute them differently */
+template <typename T>
+static bool complexArithmetic(kh::IrOp op, std::complex<T> x, std::complex<T> y,
+                              std::complex<T>& result) {
+    switch (op) {
+        case kh::IrOp::ADD:
+            result = x + y;
+            return true;
+        case kh::IrOp::SUB:
+            result = x - y;
+            return true;
+        case kh::IrOp::MUL:
+            result = x * y;
+            return true;
+        case kh::IrOp::DIV:
+            result = x / y;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool arithmetic(kh::IrOp op, const kh::IrType* type, const kh::IrConst& a,
+                       const kh::IrConst& b, kh::IrConst& result) {
+    if (type->isInteger()) {
+        uint64_t value;
+        if (!integerArithmetic(op, type, a.uinteger(), b.uinteger(), value)) {
+            return false;
+        }
+        result = integerConst(type, value);
+        return true;
+    }
+    else if (type->kind == kh::IrType::FLOAT) {
+        float value;
+        if (!floatingArithmetic(op, (float)a.floating(), (float)b.floating(), value)) {
+            return false;
+        }
+        result = kh::IrConst::floating(type, value);
+        return true;
+    }
+    else if (type->kind == kh::IrType::DOUBLE) {
+        double value;
+        if (!floatingArithmetic(op, a.floating(), b.floating(), value)) {
+            return false;
+        }
+        result = kh::IrConst::floating(type, value);
+        return true;
+    }
+    else if (type->kind == kh::IrType::COMPLEXF) {
+        std::complex<float> value;
+        if (!complexArithmetic(op, std::complex<float>((float)a.real(), (float)a.imaginary()),
+                               std::complex<float>((float)b.real(), (float)b.imaginary()),
+                               value)) {
+            return false;
+        }
+        result = kh::IrConst::complex(type, value.real(), value.imag());
+        return true;
+    }
+    else if (type->kind == kh::IrType::COMPLEX) {
+        std::complex<double> value;
+        if (!complexArithmetic(op, std::complex<double>(a.real(), a.imaginary()),
+                               std::complex<double>(b.real(), b.imaginary()), value)) {
+            return false;
+        }
+        result = kh::IrConst::complex(type, value.real(), value.imag());
+        return true;
+    }
+    return false;
+}
+
+static bool compare(kh::IrOp op, const kh::IrConst& a, const kh::IrConst& b, bool& result) {
+    const kh::IrType* type = a.type;
+
+    /* Strings and buffers are pooled, equal ones are at the same index */
+    if (op == kh::IrOp::EQUAL || op == kh::IrOp::NOT_EQUAL) {
+        bool equal;
+        if (type->isFloating() || type->isComplex()) {
+            equal = a.real() == b.real() && (!type->isComplex() || a.imaginary() == b.imaginary());
+        }
+        else {
+            equal = a.bits[0] == b.bits[0];
+        }
+        result = op == kh::IrOp::EQUAL ? equal : !equal;
+        return true;
+    }
+
+    /* Ordered, signed integers compare as they're sign-extended */
+    int order;
+    if (type->isFloating()) {
+        double x = a.floating(), y = b.floating();
+        if (std::isnan(x) || std::isnan(y)) {
+            result = false;
+            return true;
+        }
+        order = x < y ? -1 : x > y ? 1 : 0;
+    }
+    else if (type->isSigned()) {
+        order = a.integer() < b.integer() ? -1 : a.integer() > b.integer() ? 1 : 0;
+    }
+    else if (isIntegral(type)) {
+        order = a.uinteger() < b.uinteger() ? -1 : a.uinteger() > b.uinteger() ? 1 : 0;
+    }
+    else {
+        return false;
+    }
+
+    switch (op) {
+        case kh::IrOp::LESS:
+            result = order < 0;
+            return true;
+        case kh::IrOp::MORE:
+            result = order > 0;
+            return true;
+        case kh::IrOp::LESS_EQUAL:
+            result = order <= 0;
+            return true;
+        case kh::IrOp::MORE_EQUAL:
+            result = order >= 0;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Conversions of floats to integers which don't fit are undefined in C, so they're not folded */
+static bool convert(const kh::IrType* type, const kh::IrConst& a, kh::IrConst& result) {
+    const kh::IrType* from = a.type;
+
+    if (isIntegral(from)) {
+        uint64_t value = a.uinteger();
+        bool is_signed = from->isSigned();
+
+        if (isIntegral(type)) {
+            result = type->kind == kh::IrType::BOOL ? kh::IrConst::boolean(type, value != 0)
+                                                    : integerConst(type, value);
+        }
+        else if (type->kind == kh::IrType::FLOAT || type->kind == kh::IrType::COMPLEXF) {
+            float real = is_signed ? (float)(int64_t)value : (float)value;
+            result = type->isComplex() ? kh::IrConst::complex(type, real, 0.0)
+                                       : kh::IrConst::floating(type, real);
+        }
+        else if (type->kind == kh::IrType::DOUBLE || type->kind == kh::IrType::COMPLEX) {
+            double real = is_signed ? (double)(int64_t)value : (double)value;
+            result = type->isComplex() ? kh::IrConst::complex(type, real, 0.0)
+                                       : kh::IrConst::floating(type, real);
+        }
+        else {
+            return false;
+        }
+        return true;
+    }
+
+    if (from->isFloating()) {
+        double value = a.floating();
+
+        if (type->isFloating()) {
+            result = kh::IrConst::floating(type, value);
+        }
+        else if (type->isComplex()) {
+            result = kh::IrConst::complex(type, value, 0.0);
+        }
+        else if (type->kind == kh::IrType::BOOL) {
+            result = kh::IrConst::boolean(type, value != 0.0);
+        }
+        else if (isIntegral(type)) {
+            if (std::isnan(value)) {
+                return false;
+            }
+
+            double truncated = std::trunc(value);
+            size_t bits = type->bits();
+            if (type->isSigned() ? truncated < -std::ldexp(1.0, (int)bits - 1) ||
+                                       truncated >= std::ldexp(1.0, (int)bits - 1)
+                                 : truncated < 0.0 || truncated >= std::ldexp(1.0, (int)bits)) {
+                return false;
+            }
+            result = integerConst(type, type->isSigned() ? (uint64_t)(int64_t)truncated
+                                                         : (uint64_t)truncated);
+        }
+        else {
+            return false;
+        }
+        return true;
+    }
+
+    if (from->isComplex() && type->isComplex()) {
+        result = kh::IrConst::complex(type, a.real(), a.imaginary());
+        return true;
+    }
+    return false;
+}
+
+bool kh::evaluate(kh::IrOp op, const kh::IrType* type, const kh::IrConst& a,
+                  const kh::IrConst& b, kh::IrConst& result) {
+    switch (op) {
+        case kh::IrOp::CONVERT:
+            return convert(type, a, result);
+
+        case kh::IrOp::NEG:
+            if (type->isInteger()) {
+                result = integerConst(type, 0 - a.uinteger());
+            }
+            else if (type->isFloating()) {
+                result = kh::IrConst::floating(type, -a.floating());
+            }
+            else if (type->isComplex()) {
+                result = kh::IrConst::complex(type, -a.real(), -a.imaginary());
+            }
+            else {
+                return false;
+            }
+            return true;
+
+        case kh::IrOp::NOT:
+            if (type->kind != kh::IrType::BOOL) {
+                return false;
+            }
+            result = kh::IrConst::boolean(type, !a.bits[0]);
+            return true;
+
+        case kh::IrOp::BIT_NOT:
+            if (!type->isInteger()) {
+                return false;
+            }
+            result = integerConst(type, ~a.uinteger());
+            return true;
+
+        case kh::IrOp::EQUAL:
+        case kh::IrOp::NOT_EQUAL:
+        case kh::IrOp::LESS:
+        case kh::IrOp::MORE:
+        case kh::IrOp::LESS_EQUAL:
+        case kh::IrOp::MORE_EQUAL: {
+            bool value;
+            if (!compare(op, a, b, value)) {
+                return false;
+            }
+            result = kh::IrConst::boolean(type, value);
+            return true;
+        }
+
+        default:
+            return arithmetic(op, type, a, b, result);
+    }
+}
+
+static bool isUnary(kh::IrOp op) {
+    return op == kh::IrOp::CONVERT || op == kh::IrOp::NEG || op == kh::IrOp::NOT ||
+           op == kh::IrOp::BIT_NOT;
+}
+
+static bool isFoldable(kh::IrOp op) {
+    return isUnary(op) || (kh::IrOp::ADD <= op && op <= kh::IrOp::MORE_EQUAL);
+}
+
+/* What's known of a value, lowered from unknown yet to a constant to varying as more code is found
+ * to be reachable */
+struct Lattice {
+    enum State { UNKNOWN, CONSTANT, VARYING } state = UNKNOWN;
+    kh::IrConst value = kh::IrConst(kh::IrConst::BOOL, nullptr);
+
+    /* Merges another value in, returning whether it changed */
+    bool meet(const Lattice& other) {
+        if (other.state == UNKNOWN || this->state == VARYING ||
+            (this->state == CONSTANT && other.state == CONSTANT && this->value == other.value)) {
+            return false;
+        }
+        if (this->state == UNKNOWN) {
+            *this = other;
+        }
+        else {
+            this->state = VARYING;
+        }
+        return true;
+    }
+};
+
+/* Sparse conditional constant propagation. Code is only reachable once a branch which can go to
+ * it is, so branches on locals which are only assigned elsewhere in the branch still fold. Locals
+ * are only used after they're declared, which assigns them, so a local has any of the values it's
+ * assigned in reachable code */
+static size_t foldFunction(kh::IrModule& module_ir, kh::IrFunction& function_ir) {
+    std::vector<kh::IrInstruction>& code = function_ir.code;
+    std::vector<Lattice> values(code.size());
+    std::vector<Lattice> locals(function_ir.locals.size());
+    std::vector<bool> reachable(code.size() + 1);
+
+    Lattice varying;
+    varying.state = Lattice::VARYING;
+    for (size_t i = 0; i < function_ir.arguments; i++) {
+        locals[i] = varying;
+    }
+
+    bool changed = true;
+    reachable[0] = true;
+    while (changed) {
+        changed = false;
+        auto reach = [&](uint32_t target) {
+            if (!reachable[target]) {
+                reachable[target] = true;
+                changed = true;
+            }
+        };
+
+        for (size_t i = 0; i < code.size(); i++) {
+            const kh::IrInstruction& instruction = code[i];
+            if (!reachable[i]) {
+                continue;
+            }
+
+            Lattice value;
+            switch (instruction.op) {
+                case kh::IrOp::CONST:
+                    value.state = Lattice::CONSTANT;
+                    value.value = module_ir.constants[instruction.a];
+                    break;
+                case kh::IrOp::LOAD:
+                    value = locals[instruction.a];
+                    break;
+                case kh::IrOp::STORE:
+                    changed = locals[instruction.a].meet(values[instruction.b]) || changed;
+                    break;
+                case kh::IrOp::GLOBAL_LOAD:
+                case kh::IrOp::CALL:
+                    value = varying;
+                    break;
+
+                default:
+                    if (!isFoldable(instruction.op)) {
+                        break;
+                    }
+
+                    const Lattice& a = values[instruction.a];
+                    const Lattice& b = values[isUnary(instruction.op) ? instruction.a : instruction.b];
+                    if (a.state == Lattice::VARYING || b.state == Lattice::VARYING) {
+                        value = varying;
+                    }
+                    else if (a.state == Lattice::CONSTANT && b.state == Lattice::CONSTANT) {
+                        value.state = kh::evaluate(instruction.op, instruction.type, a.value,
+                                                   b.value, value.value)
+                                          ? Lattice::CONSTANT
+                                          : Lattice::VARYING;
+                    }
+            }
+            changed = values[i].meet(value) || changed;
+
+            switch (instruction.op) {
+                case kh::IrOp::JUMP:
+                    reach(instruction.a);
+                    break;
+                case kh::IrOp::BRANCH:
+                    if (values[instruction.a].state == Lattice::VARYING) {
+                        reach(instruction.b);
+                        reach(instruction.c);
+                    }
+                    else if (values[instruction.a].state == Lattice::CONSTANT) {
+                        reach(values[instruction.a].value.bits[0] ? instruction.b : instruction.c);
+                    }
+                    break;
+                case kh::IrOp::RETURN:
+                    break;
+                default:
+                    reach((uint32_t)i + 1);
+            }
+        }
+    }
+
+    const kh::IrType* void_type = kh::internType(kh::IrType::VOID);
+    auto replace = [&](kh::IrInstruction& instruction, kh::IrOp op, uint32_t a) {
+        instruction.op = op;
+        instruction.a = a;
+        instruction.b = KH_IR_NONE;
+        instruction.c = KH_IR_NONE;
+        if (op == kh::IrOp::NOP) {
+            instruction.type = void_type;
+        }
+    };
+
+    size_t count = 0;
+    for (size_t i = 0; i < code.size(); i++) {
+        kh::IrInstruction& instruction = code[i];
+        if (!reachable[i]) {
+            replace(instruction, kh::IrOp::NOP, KH_IR_NONE);
+        }
+        else if (instruction.op == kh::IrOp::BRANCH &&
+                 values[instruction.a].state == Lattice::CONSTANT) {
+            replace(instruction, kh::IrOp::JUMP,
+                    values[instruction.a].value.bits[0] ? instruction.b : instruction.c);
+            count++;
+        }
+        else if ((instruction.op == kh::IrOp::LOAD || isFoldable(instruction.op)) &&
+                 values[i].state == Lattice::CONSTANT) {
+            replace(instruction, kh::IrOp::CONST, module_ir.constant(values[i].value));
+            count++;
+        }
+    }
+
+    /* Constants and loads nothing uses anymore are dropped, the rest are left for the C compiler */
+    std::vector<size_t> uses(code.size());
+    for (const kh::IrInstruction& instruction : code) {
+        switch (instruction.op) {
+            case kh::IrOp::CONST:
+            case kh::IrOp::LOAD:
+            case kh::IrOp::GLOBAL_LOAD:
+            case kh::IrOp::JUMP:
+            case kh::IrOp::NOP:
+                break;
+            case kh::IrOp::STORE:
+            case kh::IrOp::GLOBAL_STORE:
+                uses[instruction.b]++;
+                break;
+            case kh::IrOp::CALL:
+                for (uint32_t j = 0; j < instruction.c; j++) {
+                    uses[function_ir.operands[instruction.b + j]]++;
+                }
+                break;
+            case kh::IrOp::BRANCH:
+            case kh::IrOp::RETURN:
+                if (instruction.a != KH_IR_NONE) {
+                    uses[instruction.a]++;
+                }
+                break;
+            default:
+                uses[instruction.a]++;
+                if (!isUnary(instruction.op)) {
+                    uses[instruction.b]++;
+                }
+        }
+    }
+
+    for (size_t i = 0; i < code.size(); i++) {
+        if (!uses[i] && (code[i].op == kh::IrOp::CONST || code[i].op == kh::IrOp::LOAD)) {
+            replace(code[i], kh::IrOp::NOP, KH_IR_NONE);
+        }
+    }
+
+    return count;
+}
+
+size_t kh::foldConstants(kh::IrModule& module_ir) {
+    size_t count = 0;
+    for (kh::IrFunction* function_ir : module_ir.functions) {
+        count += foldFunction(module_ir, *function_ir);
+    }
+    return count;
+}
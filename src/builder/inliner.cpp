@@ -0,0 +1,298 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <algorithm>
+
+#include <kithare/passes.hpp>
+
+
+/* Instructions of the function which end up in the generated code */
+static size_t cost(const kh::IrFunction& function_ir) {
+    return (size_t)std::count_if(
+        function_ir.code.begin(), function_ir.code.end(),
+        [](const kh::IrInstruction& instruction) { return instruction.op != kh::IrOp::NOP; });
+}
+
+static kh::IrInstruction makeInstruction(kh::IrOp op, const kh::IrType* type, uint32_t a,
+                                         uint32_t b, uint32_t index) {
+    kh::IrInstruction instruction;
+    instruction.op = op;
+    instruction.type = type;
+    instruction.a = a;
+    instruction.b = b;
+    instruction.index = index;
+    return instruction;
+}
+
+/* Strongly connected components of the call graph by Tarjan's algorithm, which finds the
+ * recursive functions. Functions calling each other, directly or not, are in the same component.
+ * The depth first search keeps its own stack of the function and its next instruction, so long call
+ * chains can't overflow the call stack */
+class CallGraph {
+public:
+    /* The functions in the order their components are completed, which has the callees before
+     * their callers */
+    std::vector<uint32_t> order;
+
+    /* Functions calling themselves, directly or not */
+    std::vector<bool> recursive;
+
+    CallGraph(const kh::IrModule& module_ir) : recursive(module_ir.functions.size()) {
+        size_t count = module_ir.functions.size();
+        std::vector<uint32_t> indices(count, KH_IR_NONE);
+        std::vector<uint32_t> lowlinks(count);
+        std::vector<bool> on_stack(count);
+        std::vector<uint32_t> stack;
+        std::vector<std::pair<uint32_t, size_t>> search;
+        uint32_t visited = 0;
+
+        for (uint32_t start = 0; start < count; start++) {
+            if (indices[start] != KH_IR_NONE) {
+                continue;
+            }
+
+            indices[start] = lowlinks[start] = visited++;
+            stack.push_back(start);
+            on_stack[start] = true;
+            search.emplace_back(start, 0);
+
+            while (!search.empty()) {
+                uint32_t function = search.back().first;
+                const std::vector<kh::IrInstruction>& code = module_ir.functions[function]->code;
+
+                if (search.back().second < code.size()) {
+                    const kh::IrInstruction& instruction = code[search.back().second++];
+                    if (instruction.op != kh::IrOp::CALL) {
+                        continue;
+                    }
+
+                    uint32_t callee = instruction.a;
+                    if (callee == function) {
+                        this->recursive[function] = true;
+                    }
+                    if (indices[callee] == KH_IR_NONE) {
+                        indices[callee] = lowlinks[callee] = visited++;
+                        stack.push_back(callee);
+                        on_stack[callee] = true;
+                        search.emplace_back(callee, 0);
+                    }
+                    else if (on_stack[callee]) {
+                        lowlinks[function] = std::min(lowlinks[function], indices[callee]);
+                    }
+                    continue;
+                }
+
+                search.pop_back();
+                if (!search.empty()) {
+                    uint32_t caller = search.back().first;
+                    lowlinks[caller] = std::min(lowlinks[caller], lowlinks[function]);
+                }
+
+                if (lowlinks[function] != indices[function]) {
+                    continue;
+                }
+
+                /* Components of more than one function are mutually recursive */
+                size_t first = this->order.size();
+                uint32_t member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    on_stack[member] = false;
+                    this->order.push_back(member);
+                } while (member != function);
+
+                for (size_t i = first; i < this->order.size(); i++) {
+                    this->recursive[this->order[i]] =
+                        this->recursive[this->order[i]] || this->order.size() - first > 1;
+                }
+            }
+        }
+    }
+};
+
+/* Replaces the call at `site` with the code of the callee. The arguments are stored into its
+ * locals, added to the caller's, and its returns store the result and jump past the code, to where
+ * the result is loaded. Returns the index of the instruction after the inlined code */
+static size_t inlineCall(kh::IrFunction& caller, size_t site, const kh::IrFunction& callee) {
+    std::vector<kh::IrInstruction>& code = caller.code;
+    const kh::IrInstruction call = code[site];
+    const kh::IrType* void_type = kh::internType(kh::IrType::VOID);
+
+    uint32_t base = (uint32_t)caller.locals.size();
+    for (const kh::IrVariable& local : callee.locals) {
+        caller.local(callee.name + "." + local.name, local.type, local.index);
+    }
+    uint32_t result = KH_IR_NONE;
+    if (callee.return_type != void_type) {
+        result = caller.local("#" + callee.name, callee.return_type, call.index);
+    }
+
+    /* Where the instructions of the callee go, returns taking two instructions when they store
+     * the result. Jumps to the end of the callee go to the end of the inlined code */
+    std::vector<uint32_t> starts(callee.code.size() + 1);
+    std::vector<uint32_t> values(callee.code.size(), KH_IR_NONE);
+    uint32_t next = (uint32_t)site + call.c;
+    for (size_t i = 0; i < callee.code.size(); i++) {
+        const kh::IrInstruction& instruction = callee.code[i];
+        starts[i] = next;
+        if (instruction.op != kh::IrOp::RETURN) {
+            values[i] = next++;
+        }
+        else {
+            next += instruction.a != KH_IR_NONE && result != KH_IR_NONE ? 2 : 1;
+        }
+    }
+    uint32_t end = next;
+    starts[callee.code.size()] = end;
+
+    std::vector<kh::IrInstruction> inlined;
+    inlined.reserve(end + 1 - site);
+    for (uint32_t j = 0; j < call.c; j++) {
+        inlined.push_back(makeInstruction(kh::IrOp::STORE, void_type, base + j,
+                                          caller.operands[call.b + j], call.index));
+    }
+
+    for (const kh::IrInstruction& instruction : callee.code) {
+        kh::IrInstruction copy = instruction;
+
+        switch (copy.op) {
+            case kh::IrOp::LOAD:
+            case kh::IrOp::STORE:
+                copy.a += base;
+                break;
+            case kh::IrOp::JUMP:
+                copy.a = starts[copy.a];
+                break;
+            case kh::IrOp::BRANCH:
+                copy.b = starts[copy.b];
+                copy.c = starts[copy.c];
+                break;
+            case kh::IrOp::CALL: {
+                uint32_t operands = (uint32_t)caller.operands.size();
+                for (uint32_t j = 0; j < copy.c; j++) {
+                    caller.operands.push_back(values[callee.operands[copy.b + j]]);
+                }
+                copy.b = operands;
+                inlined.push_back(copy);
+                continue;
+            }
+            case kh::IrOp::RETURN:
+                if (copy.a != KH_IR_NONE && result != KH_IR_NONE) {
+                    inlined.push_back(makeInstruction(kh::IrOp::STORE, void_type, result,
+                                                      values[copy.a], copy.index));
+                }
+                inlined.push_back(
+                    makeInstruction(kh::IrOp::JUMP, void_type, end, KH_IR_NONE, copy.index));
+                continue;
+            default:
+                break;
+        }
+
+        kh::forEachValue(copy, caller.operands, [&](uint32_t& value) { value = values[value]; });
+        inlined.push_back(copy);
+    }
+
+    if (result != KH_IR_NONE) {
+        inlined.push_back(
+            makeInstruction(kh::IrOp::LOAD, callee.return_type, result, KH_IR_NONE, call.index));
+    }
+    else {
+        inlined.push_back(
+            makeInstruction(kh::IrOp::NOP, void_type, KH_IR_NONE, KH_IR_NONE, call.index));
+    }
+
+    /* The value of the call is what's loaded at the end, the instructions after it move along */
+    uint32_t shift = end - (uint32_t)site;
+    auto move = [&](uint32_t& index) {
+        if (index == site) {
+            index = end;
+        }
+        else if (index > site) {
+            index += shift;
+        }
+    };
+    auto moveTarget = [&](uint32_t& index) {
+        if (index > site) {
+            index += shift;
+        }
+    };
+
+    for (size_t i = 0; i < code.size(); i++) {
+        if (i == site) {
+            continue;
+        }
+        kh::IrInstruction& instruction = code[i];
+        kh::forEachValue(instruction, caller.operands, move);
+        if (instruction.op == kh::IrOp::JUMP) {
+            moveTarget(instruction.a);
+        }
+        else if (instruction.op == kh::IrOp::BRANCH) {
+            moveTarget(instruction.b);
+            moveTarget(instruction.c);
+        }
+    }
+
+    code.erase(code.begin() + site);
+    code.insert(code.begin() + site, inlined.begin(), inlined.end());
+    return end + 1;
+}
+
+size_t kh::inlineCalls(kh::IrModule& module_ir, size_t growth) {
+    if (growth == 0) {
+        return 0;
+    }
+
+    CallGraph graph(module_ir);
+
+    std::vector<size_t> sizes(module_ir.functions.size());
+    size_t total = 0;
+    for (size_t i = 0; i < module_ir.functions.size(); i++) {
+        sizes[i] = cost(*module_ir.functions[i]);
+        total += sizes[i];
+    }
+    /* Large enough growths don't limit anything, rather than overflowing */
+    size_t budget = total && growth > (size_t)-1 / total ? (size_t)-1 : total * growth / 100;
+    size_t count = 0;
+
+    /* The callees are inlined into before their callers, which then inline the code they ended up
+     * with */
+    for (uint32_t function : graph.order) {
+        kh::IrFunction& caller = *module_ir.functions[function];
+
+        for (size_t i = 0; i < caller.code.size();) {
+            const kh::IrInstruction& instruction = caller.code[i];
+            if (instruction.op != kh::IrOp::CALL || graph.recursive[instruction.a]) {
+                i++;
+                continue;
+            }
+
+            /* Constant arguments are likely to fold much of the callee away */
+            size_t constants = 0;
+            for (uint32_t j = 0; j < instruction.c; j++) {
+                if (caller.code[caller.operands[instruction.b + j]].op == kh::IrOp::CONST) {
+                    constants++;
+                }
+            }
+
+            size_t size = sizes[instruction.a];
+            size_t added = size + instruction.c;
+            if (size > KH_INLINE_THRESHOLD + KH_INLINE_CONSTANT_BONUS * constants ||
+                added > budget) {
+                i++;
+                continue;
+            }
+
+            budget -= added;
+            i = inlineCall(caller, i, *module_ir.functions[instruction.a]);
+            count++;
+        }
+
+        sizes[function] = cost(caller);
+    }
+
+    return count;
+}
@@ -0,0 +1,306 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <algorithm>
+#include <functional>
+#include <map>
+
+#include <kithare/passes.hpp>
+
+
+/* Types whose values are constants of the pool */
+static bool isConstType(const kh::IrType* type) {
+    return type->kind <= kh::IrType::BUFFER || type->kind == kh::IrType::ENUM;
+}
+
+/* Functions only computing their result from their arguments, through other such functions. They
+ * can be recursive, the interpreter bounds how deep */
+static std::vector<bool> pureFunctions(const kh::IrModule& module_ir) {
+    const std::vector<kh::IrFunction*>& functions = module_ir.functions;
+    std::vector<bool> pure(functions.size());
+
+    for (size_t i = 0; i < functions.size(); i++) {
+        const kh::IrFunction& function_ir = *functions[i];
+        pure[i] = isConstType(function_ir.return_type);
+        for (const kh::IrVariable& local : function_ir.locals) {
+            pure[i] = pure[i] && isConstType(local.type);
+        }
+        for (const kh::IrInstruction& instruction : function_ir.code) {
+            pure[i] = pure[i] && instruction.op != kh::IrOp::GLOBAL_LOAD &&
+                      instruction.op != kh::IrOp::GLOBAL_STORE;
+        }
+    }
+
+    /* Calling an impure function makes the caller impure too */
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < functions.size(); i++) {
+            if (!pure[i]) {
+                continue;
+            }
+            for (const kh::IrInstruction& instruction : functions[i]->code) {
+                if (instruction.op == kh::IrOp::CALL && !pure[instruction.a]) {
+                    pure[i] = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    return pure;
+}
+
+/* The functions ordered with their callees first, apart from recursion, so the calls replaced in a
+ * callee don't have to be run again by each call of its callers. The depth first search keeps its
+ * own stack of the function and its next instruction as call chains can be long */
+static std::vector<uint32_t> calleesFirst(const kh::IrModule& module_ir) {
+    size_t count = module_ir.functions.size();
+    std::vector<uint32_t> order;
+    std::vector<bool> visited(count);
+    std::vector<std::pair<uint32_t, size_t>> stack;
+
+    for (uint32_t start = 0; start < count; start++) {
+        if (visited[start]) {
+            continue;
+        }
+        visited[start] = true;
+        stack.emplace_back(start, 0);
+
+        while (!stack.empty()) {
+            const std::vector<kh::IrInstruction>& code =
+                module_ir.functions[stack.back().first]->code;
+            size_t next = stack.back().second;
+            while (next < code.size() &&
+                   (code[next].op != kh::IrOp::CALL || visited[code[next].a])) {
+                next++;
+            }
+
+            if (next == code.size()) {
+                order.push_back(stack.back().first);
+                stack.pop_back();
+                continue;
+            }
+
+            stack.back().second = next + 1;
+            visited[code[next].a] = true;
+            stack.emplace_back(code[next].a, 0);
+        }
+    }
+
+    return order;
+}
+
+/* Runs functions on constants, giving up once it has run for too many instructions, has too many
+ * values alive or calls too deeply. It also gives up on what's only known at runtime, such as
+ * integer divisions by zero. The instructions of every call are taken out of the budget */
+class Interpreter {
+public:
+    Interpreter(const kh::IrModule& _module_ir, size_t& _budget)
+        : module_ir(_module_ir), budget(_budget) {}
+
+    bool call(uint32_t function, const std::vector<kh::IrConst>& args, kh::IrConst& result) {
+        this->steps = 0;
+        this->limit = std::min<size_t>(KH_EVAL_STEP_LIMIT, this->budget);
+        this->memory = 0;
+
+        bool returned = this->run(function, args, result, 0);
+        this->budget -= std::min(this->steps, this->budget);
+        return returned;
+    }
+
+private:
+    const kh::IrModule& module_ir;
+    size_t& budget;
+    size_t steps = 0;
+    size_t limit = 0;
+    size_t memory = 0;
+
+    bool run(uint32_t function, const std::vector<kh::IrConst>& args, kh::IrConst& result,
+             size_t depth) {
+        const kh::IrFunction& function_ir = *this->module_ir.functions[function];
+        const std::vector<kh::IrInstruction>& code = function_ir.code;
+
+        size_t frame = (code.size() + function_ir.locals.size()) * sizeof(kh::IrConst);
+        if (depth > KH_EVAL_DEPTH_LIMIT || this->memory + frame > KH_EVAL_MEMORY_LIMIT) {
+            return false;
+        }
+        this->memory += frame;
+
+        /* Values without a type are unassigned */
+        kh::IrConst unassigned(kh::IrConst::BOOL, nullptr);
+        std::vector<kh::IrConst> values(code.size(), unassigned);
+        std::vector<kh::IrConst> locals(function_ir.locals.size(), unassigned);
+        for (size_t i = 0; i < args.size(); i++) {
+            locals[i] = args[i];
+        }
+
+        bool returned = false;
+        size_t pc = 0;
+        while (pc < code.size()) {
+            const kh::IrInstruction& instruction = code[pc];
+            if (++this->steps > this->limit) {
+                break;
+            }
+
+            switch (instruction.op) {
+                case kh::IrOp::CONST:
+                    values[pc] = this->module_ir.constants[instruction.a];
+                    break;
+
+                case kh::IrOp::LOAD:
+                    values[pc] = locals[instruction.a];
+                    if (!values[pc].type) {
+                        pc = code.size() + 1;
+                        continue;
+                    }
+                    break;
+
+                case kh::IrOp::STORE:
+                    locals[instruction.a] = values[instruction.b];
+                    break;
+
+                case kh::IrOp::CALL: {
+                    std::vector<kh::IrConst> call_args;
+                    for (uint32_t j = 0; j < instruction.c; j++) {
+                        call_args.push_back(values[function_ir.operands[instruction.b + j]]);
+                    }
+                    if (!this->run(instruction.a, call_args, values[pc], depth + 1)) {
+                        pc = code.size() + 1;
+                        continue;
+                    }
+                    break;
+                }
+
+                case kh::IrOp::JUMP:
+                    pc = instruction.a;
+                    continue;
+
+                case kh::IrOp::BRANCH:
+                    pc = values[instruction.a].bits[0] ? instruction.b : instruction.c;
+                    continue;
+
+                case kh::IrOp::RETURN:
+                    if (instruction.a != KH_IR_NONE) {
+                        result = values[instruction.a];
+                    }
+                    returned = true;
+                    pc = code.size();
+                    continue;
+
+                case kh::IrOp::NOP:
+                    break;
+
+                case kh::IrOp::GLOBAL_LOAD:
+                case kh::IrOp::GLOBAL_STORE:
+                    pc = code.size() + 1;
+                    continue;
+
+                default: {
+                    const kh::IrConst& b =
+                        values[instruction.b != KH_IR_NONE ? instruction.b : instruction.a];
+                    if (!kh::evaluate(instruction.op, instruction.type, values[instruction.a], b,
+                                      values[pc])) {
+                        pc = code.size() + 1;
+                        continue;
+                    }
+                }
+            }
+            pc++;
+        }
+
+        this->memory -= frame;
+
+        /* Void functions may end without returning */
+        if (!returned && pc == code.size() && function_ir.return_type->kind == kh::IrType::VOID) {
+            returned = true;
+        }
+        return returned && this->steps <= this->limit;
+    }
+};
+
+struct ConstLess {
+    bool operator()(const kh::IrConst& a, const kh::IrConst& b) const {
+        if (a.kind != b.kind) {
+            return a.kind < b.kind;
+        }
+        if (a.type != b.type) {
+            return std::less<const kh::IrType*>()(a.type, b.type);
+        }
+        return a.bits[0] != b.bits[0] ? a.bits[0] < b.bits[0] : a.bits[1] < b.bits[1];
+    }
+};
+
+bool kh::EvaluatedCalls::CallLess::operator()(
+    const std::pair<uint32_t, std::vector<kh::IrConst>>& a,
+    const std::pair<uint32_t, std::vector<kh::IrConst>>& b) const {
+    if (a.first != b.first) {
+        return a.first < b.first;
+    }
+    return std::lexicographical_compare(a.second.begin(), a.second.end(), b.second.begin(),
+                                        b.second.end(), ConstLess());
+}
+
+size_t kh::evaluateCalls(kh::IrModule& module_ir, kh::EvaluatedCalls& evaluated) {
+    std::vector<bool> pure = pureFunctions(module_ir);
+    Interpreter interpreter(module_ir, evaluated.steps);
+    const kh::IrType* void_type = kh::internType(kh::IrType::VOID);
+
+    /* The same calls are only run once, whether they could be or not, so the ones which failed
+     * don't use up the budget again on every run */
+    auto& results = evaluated.results;
+    size_t count = 0;
+
+    for (uint32_t function : calleesFirst(module_ir)) {
+        kh::IrFunction* function_ir = module_ir.functions[function];
+        std::vector<kh::IrInstruction>& code = function_ir->code;
+
+        for (kh::IrInstruction& instruction : code) {
+            if (instruction.op != kh::IrOp::CALL || !pure[instruction.a]) {
+                continue;
+            }
+
+            std::vector<kh::IrConst> args;
+            for (uint32_t j = 0; j < instruction.c; j++) {
+                const kh::IrInstruction& arg = code[function_ir->operands[instruction.b + j]];
+                if (arg.op != kh::IrOp::CONST) {
+                    break;
+                }
+                args.push_back(module_ir.constants[arg.a]);
+            }
+            if (args.size() != instruction.c) {
+                continue;
+            }
+
+            auto key = std::make_pair(instruction.a, args);
+            auto found = results.find(key);
+            if (found == results.end()) {
+                kh::IrConst result(kh::IrConst::BOOL, nullptr);
+                bool evaluated = interpreter.call(instruction.a, args, result);
+                found = results.emplace(key, std::make_pair(evaluated, result)).first;
+            }
+            if (!found->second.first) {
+                continue;
+            }
+
+            /* The arguments are left for the constant folding to drop */
+            if (instruction.type == void_type) {
+                instruction.op = kh::IrOp::NOP;
+                instruction.a = KH_IR_NONE;
+            }
+            else {
+                instruction.op = kh::IrOp::CONST;
+                instruction.a = module_ir.constant(found->second.second);
+            }
+            instruction.b = KH_IR_NONE;
+            instruction.c = KH_IR_NONE;
+            count++;
+        }
+    }
+
+    return count;
+}
@@ -3,3 +3,417 @@
  * The source code for Kithare programming language is distributed under the MIT license.
  * Copyright (C) 2021 Kithare Organization
  */
+
+#include <cstring>
+#include <mutex>
+#include <unordered_set>
+
+#include <kithare/ir.hpp>
+
+
+kh::IrArena::~IrArena() {
+    /* Destroyed in reverse, as objects made later may refer to the earlier ones */
+    for (size_t i = this->destructors.size(); i > 0; i--) {
+        this->destructors[i - 1].second(this->destructors[i - 1].first);
+    }
+}
+
+void* kh::IrArena::allocate(size_t size, size_t alignment) {
+    size_t padding = (alignment - (size_t)this->current % alignment) % alignment;
+
+    if (!this->current || padding + size > this->remaining) {
+        size_t block_size = size + alignment > KH_IR_ARENA_BLOCK_SIZE ? size + alignment
+                                                                      : KH_IR_ARENA_BLOCK_SIZE;
+        this->blocks.emplace_back(new char[block_size]);
+        this->current = this->blocks.back().get();
+        this->remaining = block_size;
+        padding = (alignment - (size_t)this->current % alignment) % alignment;
+    }
+
+    void* memory = this->current + padding;
+    this->current += padding + size;
+    this->remaining -= padding + size;
+    this->total += size;
+    return memory;
+}
+
+size_t kh::IrArena::allocated() const {
+    return this->total;
+}
+
+static size_t combineHash(size_t hash, size_t value) {
+    return hash ^ (value + 0x9E3779B97F4A7C15 + (hash << 6) + (hash >> 2));
+}
+
+kh::IrType::IrType(kh::IrType::Kind _kind, const std::vector<const kh::IrType*>& _children,
+                   uint64_t _length, const std::string& _name)
+    : kind(_kind), children(_children), length(_length), name(_name) {
+    this->hash = combineHash(std::hash<std::string>()(this->name), (size_t)this->kind);
+    this->hash = combineHash(this->hash, (size_t)this->length);
+    for (const kh::IrType* child : this->children) {
+        this->hash = combineHash(this->hash, std::hash<const kh::IrType*>()(child));
+    }
+}
+
+bool kh::IrType::operator==(const kh::IrType& other) const {
+    return this->kind == other.kind && this->length == other.length &&
+           this->children == other.children && this->name == other.name;
+}
+
+bool kh::IrType::isInteger() const {
+    return kh::IrType::INT8 <= this->kind && this->kind <= kh::IrType::UINT64;
+}
+
+bool kh::IrType::isSigned() const {
+    return kh::IrType::INT8 <= this->kind && this->kind <= kh::IrType::INT64;
+}
+
+bool kh::IrType::isFloating() const {
+    return this->kind == kh::IrType::FLOAT || this->kind == kh::IrType::DOUBLE;
+}
+
+bool kh::IrType::isComplex() const {
+    return this->kind == kh::IrType::COMPLEXF || this->kind == kh::IrType::COMPLEX;
+}
+
+size_t kh::IrType::bits() const {
+    switch (this->kind) {
+        case kh::IrType::BOOL:
+            return 1;
+        case kh::IrType::INT8:
+        case kh::IrType::UINT8:
+            return 8;
+        case kh::IrType::INT16:
+        case kh::IrType::UINT16:
+            return 16;
+        case kh::IrType::CHAR:
+        case kh::IrType::INT32:
+        case kh::IrType::UINT32:
+        case kh::IrType::FLOAT:
+        case kh::IrType::COMPLEXF:
+            return 32;
+        case kh::IrType::INT64:
+        case kh::IrType::UINT64:
+        case kh::IrType::DOUBLE:
+        case kh::IrType::COMPLEX:
+            return 64;
+        default:
+            return 0;
+    }
+}
+
+struct TypeHash {
+    size_t operator()(const kh::IrType* type) const {
+        return type->hash;
+    }
+};
+
+struct TypeEqual {
+    bool operator()(const kh::IrType* a, const kh::IrType* b) const {
+        return *a == *b;
+    }
+};
+
+/* Each shard has its own lock, so threads interning different types rarely wait for each other */
+struct TypeShard {
+    std::mutex mutex;
+    std::unordered_set<const kh::IrType*, TypeHash, TypeEqual> types;
+    kh::IrArena arena;
+};
+
+class kh::TypeInterner {
+public:
+    TypeShard shards[KH_IR_TYPE_SHARDS];
+};
+
+static thread_local std::shared_ptr<kh::TypeInterner> thread_types;
+
+static TypeShard* typeShards() {
+    static kh::TypeInterner process_types;
+    return thread_types ? thread_types->shards : process_types.shards;
+}
+
+const kh::IrType* kh::internType(kh::IrType::Kind kind,
+                                 const std::vector<const kh::IrType*>& children, uint64_t length,
+                                 const std::string& name) {
+    kh::IrType key(kind, children, length, name);
+    TypeShard& shard = typeShards()[key.hash % KH_IR_TYPE_SHARDS];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.types.find(&key);
+    if (found != shard.types.end()) {
+        return *found;
+    }
+
+    const kh::IrType* type = shard.arena.make<kh::IrType>(std::move(key));
+    shard.types.insert(type);
+    return type;
+}
+
+size_t kh::internedTypes() {
+    size_t count = 0;
+    for (size_t i = 0; i < KH_IR_TYPE_SHARDS; i++) {
+        std::lock_guard<std::mutex> lock(typeShards()[i].mutex);
+        count += typeShards()[i].types.size();
+    }
+    return count;
+}
+
+std::shared_ptr<kh::TypeInterner> kh::newTypeInterner() {
+    return std::make_shared<kh::TypeInterner>();
+}
+
+kh::TypeScope::TypeScope(const std::shared_ptr<kh::TypeInterner>& interner)
+    : previous(thread_types) {
+    thread_types = interner;
+}
+
+kh::TypeScope::~TypeScope() {
+    thread_types = this->previous;
+}
+
+std::shared_ptr<kh::TypeInterner> kh::currentTypeInterner() {
+    return thread_types;
+}
+
+static uint64_t doubleBits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double bitsDouble(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+kh::IrConst kh::IrConst::boolean(const kh::IrType* type, bool value) {
+    return kh::IrConst(kh::IrConst::BOOL, type, value);
+}
+
+kh::IrConst kh::IrConst::character(const kh::IrType* type, char32_t value) {
+    return kh::IrConst(kh::IrConst::CHARACTER, type, value);
+}
+
+kh::IrConst kh::IrConst::integer(const kh::IrType* type, int64_t value) {
+    return kh::IrConst(kh::IrConst::INTEGER, type, (uint64_t)value);
+}
+
+kh::IrConst kh::IrConst::uinteger(const kh::IrType* type, uint64_t value) {
+    return kh::IrConst(kh::IrConst::UNSIGNED_INTEGER, type, value);
+}
+
+/* Floats are kept as doubles, rounded to the precision of their type */
+kh::IrConst kh::IrConst::floating(const kh::IrType* type, double value) {
+    if (type->kind == kh::IrType::FLOAT) {
+        return kh::IrConst(kh::IrConst::FLOAT, type, doubleBits((float)value));
+    }
+    return kh::IrConst(kh::IrConst::DOUBLE, type, doubleBits(value));
+}
+
+kh::IrConst kh::IrConst::complex(const kh::IrType* type, double real, double imaginary) {
+    if (type->kind == kh::IrType::COMPLEXF) {
+        return kh::IrConst(kh::IrConst::COMPLEXF, type, doubleBits((float)real),
+                           doubleBits((float)imaginary));
+    }
+    return kh::IrConst(kh::IrConst::COMPLEX, type, doubleBits(real), doubleBits(imaginary));
+}
+
+int64_t kh::IrConst::integer() const {
+    return (int64_t)this->bits[0];
+}
+
+uint64_t kh::IrConst::uinteger() const {
+    return this->bits[0];
+}
+
+double kh::IrConst::floating() const {
+    return bitsDouble(this->bits[0]);
+}
+
+double kh::IrConst::real() const {
+    return bitsDouble(this->bits[0]);
+}
+
+double kh::IrConst::imaginary() const {
+    return bitsDouble(this->bits[1]);
+}
+
+bool kh::IrConst::operator==(const kh::IrConst& other) const {
+    return this->kind == other.kind && this->type == other.type && this->bits[0] == other.bits[0] &&
+           this->bits[1] == other.bits[1];
+}
+
+size_t kh::IrModule::ConstHash::operator()(const kh::IrConst& value) const {
+    size_t hash = combineHash(value.type->hash, (size_t)value.kind);
+    hash = combineHash(hash, std::hash<uint64_t>()(value.bits[0]));
+    return combineHash(hash, std::hash<uint64_t>()(value.bits[1]));
+}
+
+const char* kh::cstr(kh::IrOp op) {
+    switch (op) {
+        case kh::IrOp::CONST:
+            return "const";
+        case kh::IrOp::LOAD:
+            return "load";
+        case kh::IrOp::STORE:
+            return "store";
+        case kh::IrOp::GLOBAL_LOAD:
+            return "global_load";
+        case kh::IrOp::GLOBAL_STORE:
+            return "global_store";
+        case kh::IrOp::CONVERT:
+            return "convert";
+        case kh::IrOp::NEG:
+            return "neg";
+        case kh::IrOp::NOT:
+            return "not";
+        case kh::IrOp::BIT_NOT:
+            return "bit_not";
+        case kh::IrOp::ADD:
+            return "add";
+        case kh::IrOp::SUB:
+            return "sub";
+        case kh::IrOp::MUL:
+            return "mul";
+        case kh::IrOp::DIV:
+            return "div";
+        case kh::IrOp::MOD:
+            return "mod";
+        case kh::IrOp::POW:
+            return "pow";
+        case kh::IrOp::BIT_AND:
+            return "bit_and";
+        case kh::IrOp::BIT_OR:
+            return "bit_or";
+        case kh::IrOp::BIT_LSHIFT:
+            return "bit_lshift";
+        case kh::IrOp::BIT_RSHIFT:
+            return "bit_rshift";
+        case kh::IrOp::EQUAL:
+            return "equal";
+        case kh::IrOp::NOT_EQUAL:
+            return "not_equal";
+        case kh::IrOp::LESS:
+            return "less";
+        case kh::IrOp::MORE:
+            return "more";
+        case kh::IrOp::LESS_EQUAL:
+            return "less_equal";
+        case kh::IrOp::MORE_EQUAL:
+            return "more_equal";
+        case kh::IrOp::CALL:
+            return "call";
+        case kh::IrOp::JUMP:
+            return "jump";
+        case kh::IrOp::BRANCH:
+            return "branch";
+        case kh::IrOp::RETURN:
+            return "return";
+        case kh::IrOp::NOP:
+            return "nop";
+    }
+
+    return "unknown";
+}
+
+uint32_t kh::IrFunction::emit(kh::IrOp op, const kh::IrType* type, uint32_t a, uint32_t b,
+                              uint32_t c, size_t source_index) {
+    kh::IrInstruction instruction;
+    instruction.op = op;
+    instruction.type = type;
+    instruction.a = a;
+    instruction.b = b;
+    instruction.c = c;
+    instruction.index = (uint32_t)source_index;
+
+    this->code.push_back(instruction);
+    return (uint32_t)(this->code.size() - 1);
+}
+
+uint32_t kh::IrFunction::call(const kh::IrType* type, uint32_t function,
+                              const std::vector<uint32_t>& args, size_t source_index) {
+    uint32_t first = (uint32_t)this->operands.size();
+    this->operands.insert(this->operands.end(), args.begin(), args.end());
+    return this->emit(kh::IrOp::CALL, type, function, first, (uint32_t)args.size(), source_index);
+}
+
+uint32_t kh::IrFunction::local(const std::string& local_name, const kh::IrType* type,
+                               size_t source_index) {
+    this->locals.emplace_back(local_name, type, source_index);
+    return (uint32_t)(this->locals.size() - 1);
+}
+
+const kh::IrType* kh::IrModule::type(kh::IrType::Kind kind,
+                                     const std::vector<const kh::IrType*>& children,
+                                     uint64_t length, const std::string& name) {
+    return kh::internType(kind, children, length, name);
+}
+
+kh::IrFunction* kh::IrModule::function(const std::string& name, const kh::IrType* return_type,
+                                       size_t index) {
+    this->functions.push_back(this->arena.make<kh::IrFunction>(name, return_type, index));
+    return this->functions.back();
+}
+
+uint32_t kh::IrModule::constant(const kh::IrConst& value) {
+    auto id = this->constant_ids.emplace(value, (uint32_t)this->constants.size());
+    if (id.second) {
+        this->constants.push_back(value);
+    }
+    return id.first->second;
+}
+
+uint32_t kh::IrModule::string(const std::u32string& value) {
+    auto id = this->string_ids.emplace(value, (uint32_t)this->strings.size());
+    if (id.second) {
+        this->strings.push_back(value);
+    }
+    return id.first->second;
+}
+
+uint32_t kh::IrModule::buffer(const std::string& value) {
+    auto id = this->buffer_ids.emplace(value, (uint32_t)this->buffers.size());
+    if (id.second) {
+        this->buffers.push_back(value);
+    }
+    return id.first->second;
+}
+
+size_t kh::IrModule::removeUnusedConstants() {
+    std::vector<kh::IrConst> old_constants = std::move(this->constants);
+    std::vector<std::u32string> old_strings = std::move(this->strings);
+    std::vector<std::string> old_buffers = std::move(this->buffers);
+    this->constants.clear();
+    this->strings.clear();
+    this->buffers.clear();
+    this->constant_ids.clear();
+    this->string_ids.clear();
+    this->buffer_ids.clear();
+
+    /* Added back in the order the functions use them in */
+    std::vector<uint32_t> indices(old_constants.size(), KH_IR_NONE);
+    for (kh::IrFunction* function_ir : this->functions) {
+        for (kh::IrInstruction& instruction : function_ir->code) {
+            if (instruction.op != kh::IrOp::CONST) {
+                continue;
+            }
+
+            uint32_t& index = indices[instruction.a];
+            if (index == KH_IR_NONE) {
+                kh::IrConst value = old_constants[instruction.a];
+                if (value.kind == kh::IrConst::STRING) {
+                    value.bits[0] = this->string(old_strings[value.bits[0]]);
+                }
+                else if (value.kind == kh::IrConst::BUFFER) {
+                    value.bits[0] = this->buffer(old_buffers[value.bits[0]]);
+                }
+                index = this->constant(value);
+            }
+            instruction.a = index;
+        }
+    }
+
+    return old_constants.size() - this->constants.size();
+}
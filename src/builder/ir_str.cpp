@@ -3,3 +3,265 @@
  * The source code for Kithare programming language is distributed under the MIT license.
  * Copyright (C) 2021 Kithare Organization
  */
+
+#include <kithare/ir.hpp>
+#include <kithare/string.hpp>
+#include <kithare/utf8.hpp>
+
+
+static const char* primitive_names[] = {"void",   "bool",   "char",   "int8",     "int16",
+                                        "int32",  "int64",  "uint8",  "uint16",   "uint32",
+                                        "uint64", "float",  "double", "complexf", "complex",
+                                        "str",    "buffer"};
+
+std::u32string kh::str(const kh::IrModule& module_ir) {
+    std::string str;
+    {
+        kh::Sink sink(str);
+        kh::IrWriter(sink).write(module_ir);
+    }
+    return kh::decodeUtf8(str);
+}
+
+std::u32string kh::str(const kh::IrType* type) {
+    std::string str;
+    {
+        kh::Sink sink(str);
+        kh::IrWriter(sink).write(type);
+    }
+    return kh::decodeUtf8(str);
+}
+
+kh::IrWriter::IrWriter(kh::Sink& _sink) : sink(_sink) {}
+
+void kh::IrWriter::write(const kh::IrModule& module_ir) {
+    for (size_t i = 0; i < module_ir.globals.size(); i++) {
+        this->sink.write("global ");
+        this->write(module_ir.globals[i].type);
+        this->sink.write(' ');
+        this->sink.write(module_ir.globals[i].name);
+        this->sink.write('\n');
+    }
+
+    for (const kh::IrFunction* function_ir : module_ir.functions) {
+        this->write(module_ir, *function_ir);
+    }
+}
+
+void kh::IrWriter::write(const kh::IrModule& module_ir, const kh::IrFunction& function_ir) {
+    this->sink.write("function ");
+    this->sink.write(function_ir.name);
+    this->sink.write('(');
+    for (size_t i = 0; i < function_ir.arguments; i++) {
+        if (i) {
+            this->sink.write(", ");
+        }
+        this->write(function_ir.locals[i].type);
+        this->sink.write(' ');
+        this->sink.write(function_ir.locals[i].name);
+    }
+    this->sink.write(") -> ");
+    this->write(function_ir.return_type);
+    this->sink.write('\n');
+
+    for (size_t i = function_ir.arguments; i < function_ir.locals.size(); i++) {
+        this->sink.write("    local $");
+        this->sink.writeUint(i);
+        this->sink.write(' ');
+        this->write(function_ir.locals[i].type);
+        this->sink.write(' ');
+        this->sink.write(function_ir.locals[i].name);
+        this->sink.write('\n');
+    }
+
+    for (size_t i = 0; i < function_ir.code.size(); i++) {
+        const kh::IrInstruction& instruction = function_ir.code[i];
+
+        this->sink.write("    ");
+        this->sink.writeUint(i);
+        this->sink.write(": ");
+
+        if (instruction.type->kind != kh::IrType::VOID) {
+            this->sink.write('%');
+            this->sink.writeUint(i);
+            this->sink.write(" = ");
+        }
+
+        this->sink.write(kh::cstr(instruction.op));
+        if (instruction.type->kind != kh::IrType::VOID) {
+            this->sink.write(' ');
+            this->write(instruction.type);
+        }
+
+        switch (instruction.op) {
+            case kh::IrOp::CONST:
+                this->sink.write(' ');
+                this->writeConst(module_ir, module_ir.constants[instruction.a]);
+                break;
+
+            case kh::IrOp::LOAD:
+                this->sink.write(" $");
+                this->sink.writeUint(instruction.a);
+                break;
+
+            case kh::IrOp::STORE:
+                this->sink.write(" $");
+                this->sink.writeUint(instruction.a);
+                this->sink.write(", %");
+                this->sink.writeUint(instruction.b);
+                break;
+
+            case kh::IrOp::GLOBAL_LOAD:
+                this->sink.write(' ');
+                this->sink.write(module_ir.globals[instruction.a].name);
+                break;
+
+            case kh::IrOp::GLOBAL_STORE:
+                this->sink.write(' ');
+                this->sink.write(module_ir.globals[instruction.a].name);
+                this->sink.write(", %");
+                this->sink.writeUint(instruction.b);
+                break;
+
+            case kh::IrOp::CALL:
+                this->sink.write(' ');
+                this->sink.write(module_ir.functions[instruction.a]->name);
+                this->sink.write('(');
+                for (uint32_t j = 0; j < instruction.c; j++) {
+                    this->sink.write(j ? ", %" : "%");
+                    this->sink.writeUint(function_ir.operands[instruction.b + j]);
+                }
+                this->sink.write(')');
+                break;
+
+            case kh::IrOp::JUMP:
+                this->sink.write(" #");
+                this->sink.writeUint(instruction.a);
+                break;
+
+            case kh::IrOp::BRANCH:
+                this->sink.write(" %");
+                this->sink.writeUint(instruction.a);
+                this->sink.write(", #");
+                this->sink.writeUint(instruction.b);
+                this->sink.write(", #");
+                this->sink.writeUint(instruction.c);
+                break;
+
+            case kh::IrOp::NOP:
+                break;
+
+            /* The rest have up to two values */
+            default:
+                if (instruction.a != KH_IR_NONE) {
+                    this->sink.write(" %");
+                    this->sink.writeUint(instruction.a);
+                }
+                if (instruction.b != KH_IR_NONE) {
+                    this->sink.write(", %");
+                    this->sink.writeUint(instruction.b);
+                }
+        }
+
+        this->sink.write('\n');
+    }
+}
+
+void kh::IrWriter::write(const kh::IrType* type) {
+    if (type->kind <= kh::IrType::BUFFER) {
+        this->sink.write(primitive_names[type->kind]);
+        return;
+    }
+
+    switch (type->kind) {
+        case kh::IrType::REF:
+            this->sink.write("ref ");
+            this->write(type->children[0]);
+            return;
+
+        case kh::IrType::ARRAY:
+            this->write(type->children[0]);
+            this->sink.write('[');
+            this->sink.writeUint(type->length);
+            this->sink.write(']');
+            return;
+
+        case kh::IrType::FUNC:
+            this->sink.write("func!(");
+            this->write(type->children[0]);
+            this->sink.write('(');
+            for (size_t i = 1; i < type->children.size(); i++) {
+                if (i > 1) {
+                    this->sink.write(", ");
+                }
+                this->write(type->children[i]);
+            }
+            this->sink.write("))");
+            return;
+
+        default:
+            break;
+    }
+
+    switch (type->kind) {
+        case kh::IrType::LIST:
+            this->sink.write("list");
+            break;
+        case kh::IrType::TUPLE:
+            this->sink.write("tuple");
+            break;
+        case kh::IrType::DICT:
+            this->sink.write("dict");
+            break;
+        default:
+            this->sink.write(type->name);
+    }
+
+    if (!type->children.empty()) {
+        this->sink.write("!(");
+        for (size_t i = 0; i < type->children.size(); i++) {
+            if (i) {
+                this->sink.write(", ");
+            }
+            this->write(type->children[i]);
+        }
+        this->sink.write(')');
+    }
+}
+
+void kh::IrWriter::writeConst(const kh::IrModule& module_ir, const kh::IrConst& value) {
+    switch (value.kind) {
+        case kh::IrConst::BOOL:
+            this->sink.write(value.uinteger() ? "true" : "false");
+            break;
+        case kh::IrConst::CHARACTER:
+            this->sink.write(kh::quote(std::u32string(1, (char32_t)value.uinteger())));
+            break;
+        case kh::IrConst::INTEGER:
+            this->sink.writeInt(value.integer());
+            break;
+        case kh::IrConst::UNSIGNED_INTEGER:
+        case kh::IrConst::ENUMERATION:
+            this->sink.writeUint(value.uinteger());
+            break;
+        case kh::IrConst::FLOAT:
+        case kh::IrConst::DOUBLE:
+            this->sink.writeFloat(value.floating());
+            break;
+        case kh::IrConst::COMPLEXF:
+        case kh::IrConst::COMPLEX:
+            this->sink.write('(');
+            this->sink.writeFloat(value.real());
+            this->sink.write(", ");
+            this->sink.writeFloat(value.imaginary());
+            this->sink.write("i)");
+            break;
+        case kh::IrConst::STRING:
+            this->sink.write(kh::quote(module_ir.strings[value.uinteger()]));
+            break;
+        case kh::IrConst::BUFFER:
+            this->sink.write('b');
+            this->sink.write(kh::quote(module_ir.buffers[value.uinteger()]));
+            break;
+    }
+}
@@ -0,0 +1,128 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <unordered_map>
+
+#include <kithare/passes.hpp>
+
+
+static size_t combineHash(size_t hash, size_t value) {
+    return hash ^ (value + 0x9E3779B97F4A7C15 + (hash << 6) + (hash >> 2));
+}
+
+/* Hash of everything the generated code depends on, the names and the source indices aside. Calls
+ * are hashed by the function they end up calling */
+static size_t hashFunction(const kh::IrFunction& function_ir, const std::vector<uint32_t>& merged) {
+    size_t hash = combineHash(function_ir.return_type->hash, function_ir.arguments);
+    for (const kh::IrVariable& local : function_ir.locals) {
+        hash = combineHash(hash, local.type->hash);
+    }
+
+    for (const kh::IrInstruction& instruction : function_ir.code) {
+        hash = combineHash(hash, (size_t)instruction.op);
+        hash = combineHash(hash, instruction.type->hash);
+        hash = combineHash(hash, instruction.op == kh::IrOp::CALL ? merged[instruction.a]
+                                                                 : instruction.a);
+        hash = combineHash(hash, instruction.b);
+        hash = combineHash(hash, instruction.c);
+    }
+
+    for (uint32_t operand : function_ir.operands) {
+        hash = combineHash(hash, operand);
+    }
+    return hash;
+}
+
+static bool sameFunction(const kh::IrFunction& a, const kh::IrFunction& b,
+                         const std::vector<uint32_t>& merged) {
+    if (a.return_type != b.return_type || a.arguments != b.arguments ||
+        a.locals.size() != b.locals.size() || a.code.size() != b.code.size() ||
+        a.operands != b.operands) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.locals.size(); i++) {
+        if (a.locals[i].type != b.locals[i].type) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < a.code.size(); i++) {
+        const kh::IrInstruction& x = a.code[i];
+        const kh::IrInstruction& y = b.code[i];
+        bool same_a = x.op == kh::IrOp::CALL ? merged[x.a] == merged[y.a] : x.a == y.a;
+        if (x.op != y.op || x.type != y.type || !same_a || x.b != y.b || x.c != y.c) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t kh::mergeIdenticalFunctions(kh::IrModule& module_ir) {
+    std::vector<kh::IrFunction*>& functions = module_ir.functions;
+
+    /* The function each one is merged into, itself if it's kept */
+    std::vector<uint32_t> merged(functions.size());
+    for (size_t i = 0; i < functions.size(); i++) {
+        merged[i] = (uint32_t)i;
+    }
+
+    /* Merging functions makes their callers the same, so it's repeated until nothing changes */
+    size_t count = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        std::unordered_multimap<size_t, uint32_t> kept;
+
+        for (size_t i = 0; i < functions.size(); i++) {
+            if (merged[i] != i) {
+                continue;
+            }
+
+            size_t hash = hashFunction(*functions[i], merged);
+            auto candidates = kept.equal_range(hash);
+            auto candidate = candidates.first;
+            while (candidate != candidates.second &&
+                   !sameFunction(*functions[candidate->second], *functions[i], merged)) {
+                candidate++;
+            }
+
+            if (candidate != candidates.second && functions[i]->is_instance) {
+                merged[i] = candidate->second;
+                count++;
+                changed = true;
+            }
+            else {
+                kept.emplace(hash, (uint32_t)i);
+            }
+        }
+
+        /* The functions merged into the ones merged this time, which are kept themselves */
+        for (uint32_t& target : merged) {
+            target = merged[target];
+        }
+    }
+
+    std::vector<uint32_t> indices(functions.size());
+    size_t size = 0;
+    for (size_t i = 0; i < functions.size(); i++) {
+        if (merged[i] == i) {
+            indices[i] = (uint32_t)size;
+            functions[size++] = functions[i];
+        }
+    }
+    functions.resize(size);
+
+    for (kh::IrFunction* function_ir : functions) {
+        for (kh::IrInstruction& instruction : function_ir->code) {
+            if (instruction.op == kh::IrOp::CALL) {
+                instruction.a = indices[merged[instruction.a]];
+            }
+        }
+    }
+
+    return count;
+}
@@ -3,3 +3,1193 @@
  * The source code for Kithare programming language is distributed under the MIT license.
  * Copyright (C) 2021 Kithare Organization
  */
+
+#include <algorithm>
+
+#include <kithare/builder.hpp>
+#include <kithare/utf8.hpp>
+
+
+/* A lowered expression, the instruction holding its value. The type is null if the expression had
+ * errors, which were reported already */
+struct Value {
+    uint32_t id;
+    const kh::IrType* type;
+};
+
+/* A variable that can be assigned to */
+struct Target {
+    bool global;
+    uint32_t id;
+    const kh::IrType* type;
+};
+
+/* Jumps out of a loop waiting for where the loop ends or continues to be known */
+struct Loop {
+    std::vector<uint32_t> breaks;
+    std::vector<uint32_t> continues;
+};
+
+static bool isNumeric(const kh::IrType* type) {
+    return type->isInteger() || type->isFloating() || type->isComplex();
+}
+
+/* Increments and decrements, which assign to their operand */
+static bool isStep(kh::Operator op) {
+    return op == kh::Operator::INCREMENT || op == kh::Operator::DECREMENT;
+}
+
+/* Assignments, which take a variable rather than a value on their left */
+static bool isAssignment(kh::Operator op) {
+    switch (op) {
+        case kh::Operator::ASSIGN:
+        case kh::Operator::IADD:
+        case kh::Operator::ISUB:
+        case kh::Operator::IMUL:
+        case kh::Operator::IDIV:
+        case kh::Operator::IMOD:
+        case kh::Operator::IPOW:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static std::string typeName(const kh::IrType* type) {
+    return "`" + kh::encodeUtf8(kh::str(type)) + "`";
+}
+
+static std::string operatorName(kh::Operator op) {
+    return std::string("`") + kh::cstr(op) + "`";
+}
+
+static kh::IrOp arithmeticOp(kh::Operator op) {
+    switch (op) {
+        case kh::Operator::ADD:
+        case kh::Operator::IADD:
+            return kh::IrOp::ADD;
+        case kh::Operator::SUB:
+        case kh::Operator::ISUB:
+            return kh::IrOp::SUB;
+        case kh::Operator::MUL:
+        case kh::Operator::IMUL:
+            return kh::IrOp::MUL;
+        case kh::Operator::DIV:
+        case kh::Operator::IDIV:
+            return kh::IrOp::DIV;
+        case kh::Operator::MOD:
+        case kh::Operator::IMOD:
+            return kh::IrOp::MOD;
+        case kh::Operator::POW:
+        case kh::Operator::IPOW:
+            return kh::IrOp::POW;
+        case kh::Operator::BIT_AND:
+            return kh::IrOp::BIT_AND;
+        case kh::Operator::BIT_OR:
+            return kh::IrOp::BIT_OR;
+        case kh::Operator::BIT_LSHIFT:
+            return kh::IrOp::BIT_LSHIFT;
+        case kh::Operator::BIT_RSHIFT:
+            return kh::IrOp::BIT_RSHIFT;
+        case kh::Operator::EQUAL:
+            return kh::IrOp::EQUAL;
+        case kh::Operator::NOT_EQUAL:
+            return kh::IrOp::NOT_EQUAL;
+        case kh::Operator::LESS:
+            return kh::IrOp::LESS;
+        case kh::Operator::MORE:
+            return kh::IrOp::MORE;
+        case kh::Operator::LESS_EQUAL:
+            return kh::IrOp::LESS_EQUAL;
+        case kh::Operator::MORE_EQUAL:
+            return kh::IrOp::MORE_EQUAL;
+        default:
+            return kh::IrOp::NOP;
+    }
+}
+
+/* Type checks and lowers the body of a single function. It only reads the builder apart from
+ * instantiating generics, so any amount of them can run at once on different functions */
+class FunctionBuilder {
+public:
+    FunctionBuilder(kh::Builder& _builder, kh::BuildTask& task)
+        : builder(_builder), function(*task.function), scratch(task.scratch), errors(task.errors),
+          bindings(task.bindings), depth(task.depth) {
+        for (size_t kind = kh::IrType::VOID; kind <= kh::IrType::BUFFER; kind++) {
+            this->primitives[kind] = kh::internType((kh::IrType::Kind)kind);
+        }
+    }
+
+    void lowerFunction(const kh::AstFunction& function_ast) {
+        this->locals.push();
+        for (size_t i = 0; i < this->function.arguments; i++) {
+            uint32_t id = kh::internIdentifier(this->function.locals[i].name);
+            if (!this->locals.declare(id, (uint32_t)i)) {
+                this->error("`" + this->function.locals[i].name + "` is already declared",
+                            this->function.locals[i].index);
+            }
+        }
+
+        this->lowerBody(function_ast.getBody());
+        this->locals.pop();
+
+        if (this->endReachable()) {
+            if (this->function.return_type == this->primitive(kh::IrType::VOID)) {
+                this->emit(kh::IrOp::RETURN, this->primitive(kh::IrType::VOID), KH_IR_NONE,
+                           function_ast.index);
+            }
+            else {
+                this->error("`" + this->function.name + "` doesn't return a value on every path",
+                            function_ast.index);
+            }
+        }
+    }
+
+    /* Assigns the globals with initializers, in the order they're declared */
+    void lowerInitializer(const std::vector<kh::AstDeclaration>& variables) {
+        for (const kh::AstDeclaration& variable : variables) {
+            const kh::BuildSymbol* symbol = this->builder.symbol(variable.var_name);
+            if (!variable.expression || !symbol || symbol->kind != kh::BuildSymbol::GLOBAL ||
+                this->builder.moduleIr().globals[symbol->id].index != variable.index) {
+                continue;
+            }
+
+            Value value =
+                this->convert(this->lower(*variable.expression), symbol->type, variable.index);
+            if (value.type) {
+                this->emit(kh::IrOp::GLOBAL_STORE, this->primitive(kh::IrType::VOID), symbol->id,
+                           variable.index, value.id);
+            }
+        }
+
+        this->emit(kh::IrOp::RETURN, this->primitive(kh::IrType::VOID), KH_IR_NONE, 0);
+    }
+
+private:
+    kh::Builder& builder;
+    kh::IrFunction& function;
+    kh::IrModule& scratch;
+    std::vector<kh::BuildException>& errors;
+
+    /* The types of the generic arguments in instances of generics */
+    const kh::GenericBindings& bindings;
+    size_t depth;
+
+    const kh::IrType* primitives[kh::IrType::BUFFER + 1];
+    kh::ScopedSymbols locals;
+    std::vector<Loop> loops;
+
+    const kh::IrType* primitive(kh::IrType::Kind kind) const {
+        return this->primitives[kind];
+    }
+
+    Value error(const std::string& what, size_t index) {
+        this->errors.emplace_back(what, index);
+        return {KH_IR_NONE, nullptr};
+    }
+
+    Value unsupported(const std::string& what, size_t index) {
+        return this->error("the builder doesn't support " + what + " yet", index);
+    }
+
+    uint32_t emit(kh::IrOp op, const kh::IrType* type, uint32_t a, size_t index,
+                  uint32_t b = KH_IR_NONE, uint32_t c = KH_IR_NONE) {
+        return this->function.emit(op, type, a, b, c, index);
+    }
+
+    Value constant(const kh::IrConst& value, size_t index) {
+        return {this->emit(kh::IrOp::CONST, value.type, this->scratch.constant(value), index),
+                value.type};
+    }
+
+    /* A small number as a constant of a boolean, character or numeric type */
+    Value number(const kh::IrType* type, int64_t value, size_t index) {
+        if (type->kind == kh::IrType::BOOL) {
+            return this->constant(kh::IrConst::boolean(type, value != 0), index);
+        }
+        else if (type->kind == kh::IrType::CHAR) {
+            return this->constant(kh::IrConst::character(type, (char32_t)value), index);
+        }
+        else if (type->isSigned()) {
+            return this->constant(kh::IrConst::integer(type, value), index);
+        }
+        else if (type->isInteger()) {
+            return this->constant(kh::IrConst::uinteger(type, (uint64_t)value), index);
+        }
+        else if (type->isFloating()) {
+            return this->constant(kh::IrConst::floating(type, (double)value), index);
+        }
+        else {
+            return this->constant(kh::IrConst::complex(type, (double)value, 0.0), index);
+        }
+    }
+
+    /* The type both operands of an arithmetic or comparison are converted to, the same way C does
+     * it with complex numbers on top of the floating point ones. Null if there's none */
+    const kh::IrType* commonType(const kh::IrType* a, const kh::IrType* b) const {
+        if (a == b) {
+            return a;
+        }
+        if (!isNumeric(a) || !isNumeric(b)) {
+            return nullptr;
+        }
+
+        bool is_double = a->kind == kh::IrType::DOUBLE || b->kind == kh::IrType::DOUBLE ||
+                         a->kind == kh::IrType::COMPLEX || b->kind == kh::IrType::COMPLEX;
+        if (a->isComplex() || b->isComplex()) {
+            return this->primitive(is_double ? kh::IrType::COMPLEX : kh::IrType::COMPLEXF);
+        }
+        if (a->isFloating() || b->isFloating()) {
+            return this->primitive(is_double ? kh::IrType::DOUBLE : kh::IrType::FLOAT);
+        }
+        if (a->bits() != b->bits()) {
+            return a->bits() > b->bits() ? a : b;
+        }
+        return a->isSigned() ? b : a;
+    }
+
+    /* Numbers convert to each other implicitly, except for complex numbers to real ones. Explicit
+     * conversions also convert between integers and booleans or characters */
+    Value convert(Value value, const kh::IrType* type, size_t index, bool is_explicit = false) {
+        if (!value.type || !type || value.type == type) {
+            return {value.id, value.type ? type : nullptr};
+        }
+
+        bool valid = isNumeric(value.type) && isNumeric(type) &&
+                     (type->isComplex() || !value.type->isComplex());
+        if (is_explicit && !valid) {
+            auto integral = [](const kh::IrType* t) {
+                return t->isInteger() || t->kind == kh::IrType::BOOL || t->kind == kh::IrType::CHAR;
+            };
+            valid = (integral(value.type) && integral(type)) ||
+                    (type->isFloating() && integral(value.type)) ||
+                    (value.type->isFloating() && integral(type));
+        }
+
+        if (!valid) {
+            return this->error("can't convert " + typeName(value.type) + " to " + typeName(type),
+                               index);
+        }
+        return {this->emit(kh::IrOp::CONVERT, type, value.id, index), type};
+    }
+
+    Value condition(const kh::AstExpression& expr_ast) {
+        return this->condition(this->lower(expr_ast), expr_ast.index);
+    }
+
+    Value condition(Value value, size_t index) {
+        if (value.type && value.type != this->primitive(kh::IrType::BOOL)) {
+            return this->error("expected a `bool` condition but got " + typeName(value.type), index);
+        }
+        return value;
+    }
+
+    Target target(const kh::AstExpression& expr_ast) {
+        if (expr_ast.expression_type != kh::AstExpression::IDENTIFIER) {
+            this->unsupported("assigning to anything but a variable", expr_ast.index);
+            return {false, KH_IR_NONE, nullptr};
+        }
+
+        const kh::AstIdentifiers& identifiers_ast = (const kh::AstIdentifiers&)expr_ast;
+        if (identifiers_ast.identifiers.size() != 1 || !identifiers_ast.generics.empty()) {
+            this->unsupported("assigning to anything but a variable", expr_ast.index);
+            return {false, KH_IR_NONE, nullptr};
+        }
+
+        const std::string& name = identifiers_ast.identifiers[0];
+        uint32_t id = kh::internIdentifier(name);
+        uint32_t local = this->locals.find(id);
+        if (local != KH_NO_IDENTIFIER) {
+            return {false, local, this->function.locals[local].type};
+        }
+
+        const kh::BuildSymbol* symbol = this->builder.symbol(id);
+        if (symbol && symbol->kind == kh::BuildSymbol::GLOBAL) {
+            return {true, symbol->id, symbol->type};
+        }
+
+        this->error(symbol ? "`" + name + "` can't be assigned to" : "`" + name + "` is not declared",
+                    expr_ast.index);
+        return {false, KH_IR_NONE, nullptr};
+    }
+
+    Value load(const Target& target, size_t index) {
+        return {this->emit(target.global ? kh::IrOp::GLOBAL_LOAD : kh::IrOp::LOAD, target.type,
+                           target.id, index),
+                target.type};
+    }
+
+    void store(const Target& target, const Value& value, size_t index) {
+        this->emit(target.global ? kh::IrOp::GLOBAL_STORE : kh::IrOp::STORE,
+                   this->primitive(kh::IrType::VOID), target.id, index, value.id);
+    }
+
+    bool endReachable() const {
+        const std::vector<kh::IrInstruction>& code = this->function.code;
+        std::vector<bool> seen(code.size() + 1);
+        std::vector<uint32_t> pending{0};
+
+        while (!pending.empty()) {
+            uint32_t i = pending.back();
+            pending.pop_back();
+            if (seen[i]) {
+                continue;
+            }
+            seen[i] = true;
+            if (i == code.size()) {
+                return true;
+            }
+
+            switch (code[i].op) {
+                case kh::IrOp::JUMP:
+                    pending.push_back(code[i].a);
+                    break;
+                case kh::IrOp::BRANCH:
+                    pending.push_back(code[i].b);
+                    pending.push_back(code[i].c);
+                    break;
+                case kh::IrOp::RETURN:
+                    break;
+                default:
+                    pending.push_back(i + 1);
+            }
+        }
+
+        return false;
+    }
+
+    void lowerBody(const std::vector<std::shared_ptr<kh::AstBody>>& body) {
+        this->locals.push();
+        for (const std::shared_ptr<kh::AstBody>& part : body) {
+            if (part) {
+                this->lowerPart(*part);
+            }
+        }
+        this->locals.pop();
+    }
+
+    void lowerPart(const kh::AstBody& part) {
+        switch (part.type) {
+            case kh::AstBody::EXPRESSION:
+                this->lower((const kh::AstExpression&)part);
+                break;
+
+            case kh::AstBody::IF: {
+                const kh::AstIf& if_ast = (const kh::AstIf&)part;
+                std::vector<uint32_t> ends;
+
+                for (size_t i = 0; i < if_ast.conditions.size(); i++) {
+                    Value condition = this->condition(*if_ast.conditions[i]);
+                    uint32_t branch = this->emit(kh::IrOp::BRANCH, this->primitive(kh::IrType::VOID),
+                                                 condition.id, if_ast.conditions[i]->index);
+                    this->function.code[branch].b = branch + 1;
+
+                    /* The last body without an `else` falls through to the end instead */
+                    this->lowerBody(if_ast.bodies[i]);
+                    if (i + 1 < if_ast.conditions.size() || !if_ast.else_body.empty()) {
+                        ends.push_back(this->emit(kh::IrOp::JUMP, this->primitive(kh::IrType::VOID),
+                                                  KH_IR_NONE, part.index));
+                    }
+                    this->function.code[branch].c = (uint32_t)this->function.code.size();
+                }
+
+                this->lowerBody(if_ast.else_body);
+                for (uint32_t end : ends) {
+                    this->function.code[end].a = (uint32_t)this->function.code.size();
+                }
+                break;
+            }
+
+            case kh::AstBody::WHILE: {
+                const kh::AstWhile& while_ast = (const kh::AstWhile&)part;
+                uint32_t start = (uint32_t)this->function.code.size();
+
+                Value condition = this->condition(*while_ast.condition);
+                uint32_t branch = this->emit(kh::IrOp::BRANCH, this->primitive(kh::IrType::VOID),
+                                             condition.id, part.index);
+                this->function.code[branch].b = branch + 1;
+
+                this->loops.emplace_back();
+                this->lowerBody(while_ast.body);
+                this->emit(kh::IrOp::JUMP, this->primitive(kh::IrType::VOID), start, part.index);
+                this->function.code[branch].c = (uint32_t)this->function.code.size();
+                this->endLoop(start, (uint32_t)this->function.code.size());
+                break;
+            }
+
+            case kh::AstBody::DO_WHILE: {
+                const kh::AstDoWhile& do_while_ast = (const kh::AstDoWhile&)part;
+                uint32_t start = (uint32_t)this->function.code.size();
+
+                this->loops.emplace_back();
+                this->lowerBody(do_while_ast.body);
+                uint32_t next = (uint32_t)this->function.code.size();
+
+                Value condition = this->condition(*do_while_ast.condition);
+                uint32_t branch = this->emit(kh::IrOp::BRANCH, this->primitive(kh::IrType::VOID),
+                                             condition.id, part.index, start);
+                this->function.code[branch].c = branch + 1;
+                this->endLoop(next, branch + 1);
+                break;
+            }
+
+            case kh::AstBody::FOR: {
+                const kh::AstFor& for_ast = (const kh::AstFor&)part;
+                this->locals.push();
+                if (for_ast.initialize) {
+                    this->lower(*for_ast.initialize);
+                }
+
+                uint32_t start = (uint32_t)this->function.code.size();
+                uint32_t branch = KH_IR_NONE;
+                if (for_ast.condition) {
+                    Value condition = this->condition(*for_ast.condition);
+                    branch = this->emit(kh::IrOp::BRANCH, this->primitive(kh::IrType::VOID),
+                                        condition.id, part.index);
+                    this->function.code[branch].b = branch + 1;
+                }
+
+                this->loops.emplace_back();
+                this->lowerBody(for_ast.body);
+                uint32_t next = (uint32_t)this->function.code.size();
+                if (for_ast.step) {
+                    this->lower(*for_ast.step);
+                }
+                this->emit(kh::IrOp::JUMP, this->primitive(kh::IrType::VOID), start, part.index);
+
+                if (branch != KH_IR_NONE) {
+                    this->function.code[branch].c = (uint32_t)this->function.code.size();
+                }
+                this->endLoop(next, (uint32_t)this->function.code.size());
+                this->locals.pop();
+                break;
+            }
+
+            case kh::AstBody::FOREACH:
+                this->unsupported("`for` loops over iterables", part.index);
+                break;
+
+            case kh::AstBody::STATEMENT:
+                this->lowerStatement((const kh::AstStatement&)part);
+                break;
+
+            case kh::AstBody::NONE:
+                break;
+        }
+    }
+
+    /* Patches the jumps of the innermost loop */
+    void endLoop(uint32_t next, uint32_t end) {
+        for (uint32_t jump : this->loops.back().continues) {
+            this->function.code[jump].a = next;
+        }
+        for (uint32_t jump : this->loops.back().breaks) {
+            this->function.code[jump].a = end;
+        }
+        this->loops.pop_back();
+    }
+
+    void lowerStatement(const kh::AstStatement& statement_ast) {
+        const kh::IrType* void_type = this->primitive(kh::IrType::VOID);
+
+        if (statement_ast.statement_type == kh::AstStatement::Type::RETURN) {
+            if (!statement_ast.expression) {
+                if (this->function.return_type != void_type) {
+                    this->error("expected a return value of type " +
+                                    typeName(this->function.return_type),
+                                statement_ast.index);
+                }
+                this->emit(kh::IrOp::RETURN, void_type, KH_IR_NONE, statement_ast.index);
+            }
+            else if (this->function.return_type == void_type) {
+                this->error("`" + this->function.name + "` doesn't return a value",
+                            statement_ast.index);
+            }
+            else {
+                Value value = this->convert(this->lower(*statement_ast.expression),
+                                            this->function.return_type, statement_ast.index);
+                this->emit(kh::IrOp::RETURN, void_type, value.id, statement_ast.index);
+            }
+            return;
+        }
+
+        bool is_break = statement_ast.statement_type == kh::AstStatement::Type::BREAK;
+
+        /* `break 1;` breaks out of 2 loops, the parser counted the `if`s as well */
+        if (statement_ast.loop_count >= this->loops.size()) {
+            this->error(std::string(is_break ? "`break`" : "`continue`") + " is used outside of a loop",
+                        statement_ast.index);
+            return;
+        }
+
+        Loop& loop = this->loops[this->loops.size() - 1 - statement_ast.loop_count];
+        uint32_t jump = this->emit(kh::IrOp::JUMP, void_type, KH_IR_NONE, statement_ast.index);
+        (is_break ? loop.breaks : loop.continues).push_back(jump);
+    }
+
+    Value lower(const kh::AstExpression& expr_ast) {
+        switch (expr_ast.expression_type) {
+            case kh::AstExpression::IDENTIFIER:
+                return this->lowerIdentifiers((const kh::AstIdentifiers&)expr_ast);
+
+            case kh::AstExpression::DECLARE:
+                return this->lowerDeclaration((const kh::AstDeclaration&)expr_ast);
+
+            case kh::AstExpression::UNARY:
+                return this->lowerUnary((const kh::AstUnaryOperation&)expr_ast);
+
+            case kh::AstExpression::REV_UNARY: {
+                const kh::AstRevUnaryOperation& unary_ast = (const kh::AstRevUnaryOperation&)expr_ast;
+                if (unary_ast.operation != kh::Operator::INCREMENT &&
+                    unary_ast.operation != kh::Operator::DECREMENT) {
+                    return this->unsupported("the postfix " + operatorName(unary_ast.operation) +
+                                                 " operator",
+                                             expr_ast.index);
+                }
+                return this->lowerStep(unary_ast.operation, *unary_ast.rvalue, expr_ast.index, false);
+            }
+
+            case kh::AstExpression::BINARY:
+                return this->lowerBinary((const kh::AstBinaryOperation&)expr_ast);
+
+            case kh::AstExpression::TERNARY:
+                return this->lowerTernary((const kh::AstTernaryOperation&)expr_ast);
+
+            case kh::AstExpression::COMPARISON:
+                return this->lowerComparison((const kh::AstComparisonExpression&)expr_ast);
+
+            case kh::AstExpression::CALL:
+                return this->lowerCall((const kh::AstCallExpression&)expr_ast);
+
+            case kh::AstExpression::CONSTANT:
+                return this->lowerValue((const kh::AstValue&)expr_ast);
+
+            case kh::AstExpression::FUNCTION:
+                return this->unsupported("lambdas", expr_ast.index);
+            case kh::AstExpression::SUBSCRIPT:
+                return this->unsupported("subscripting", expr_ast.index);
+            case kh::AstExpression::SCOPE:
+                return this->unsupported("member access", expr_ast.index);
+            case kh::AstExpression::TUPLE:
+                return this->unsupported("tuples", expr_ast.index);
+            case kh::AstExpression::LIST:
+                return this->unsupported("lists", expr_ast.index);
+            case kh::AstExpression::DICT:
+                return this->unsupported("dicts", expr_ast.index);
+
+            default:
+                return this->error("unknown expression", expr_ast.index);
+        }
+    }
+
+    Value lowerIdentifiers(const kh::AstIdentifiers& identifiers_ast) {
+        const std::vector<std::string>& names = identifiers_ast.identifiers;
+        if (!identifiers_ast.generics.empty()) {
+            return this->unsupported("generics", identifiers_ast.index);
+        }
+
+        if (names.size() == 1) {
+            if (names[0] == "true" || names[0] == "false") {
+                return this->constant(
+                    kh::IrConst::boolean(this->primitive(kh::IrType::BOOL), names[0] == "true"),
+                    identifiers_ast.index);
+            }
+
+            uint32_t id = kh::internIdentifier(names[0]);
+            const kh::BuildSymbol* symbol = this->builder.symbol(id);
+            if (this->locals.find(id) != KH_NO_IDENTIFIER ||
+                (symbol && symbol->kind == kh::BuildSymbol::GLOBAL)) {
+                return this->load(this->target(identifiers_ast), identifiers_ast.index);
+            }
+
+            return this->error(symbol ? "`" + names[0] + "` isn't a value"
+                                      : "`" + names[0] + "` is not declared",
+                               identifiers_ast.index);
+        }
+
+        /* Enum members, such as `Color.red` */
+        uint32_t id = kh::internIdentifier(names[0]);
+        const kh::BuildSymbol* symbol = this->builder.symbol(id);
+        if (names.size() == 2 && symbol && symbol->kind == kh::BuildSymbol::ENUM &&
+            this->locals.find(id) == KH_NO_IDENTIFIER) {
+            const kh::AstEnumType& enum_ast = this->builder.moduleAst().enums[symbol->id];
+            for (size_t i = 0; i < enum_ast.members.size(); i++) {
+                if (enum_ast.members[i] == names[1]) {
+                    return this->constant(
+                        kh::IrConst(kh::IrConst::ENUMERATION, symbol->type, enum_ast.values[i]),
+                        identifiers_ast.index);
+                }
+            }
+            return this->error("`" + names[0] + "` has no member `" + names[1] + "`",
+                               identifiers_ast.index);
+        }
+
+        return this->unsupported("member access", identifiers_ast.index);
+    }
+
+    Value lowerDeclaration(const kh::AstDeclaration& declaration_ast) {
+        const kh::IrType* void_type = this->primitive(kh::IrType::VOID);
+        const kh::IrType* type =
+            this->builder.resolveType(declaration_ast.var_type, declaration_ast.refs,
+                                      declaration_ast.var_array, this->errors, &this->bindings);
+        if (!type) {
+            return {KH_IR_NONE, nullptr};
+        }
+        if (type == void_type) {
+            return this->error("variables can't be `void`", declaration_ast.index);
+        }
+        /* The initializer is lowered before the variable is in scope */
+        Value value{KH_IR_NONE, nullptr};
+        if (declaration_ast.expression) {
+            value = this->convert(this->lower(*declaration_ast.expression), type,
+                                  declaration_ast.index);
+        }
+        else if (type->kind == kh::IrType::BOOL || type->kind == kh::IrType::CHAR || isNumeric(type)) {
+            value = this->number(type, 0, declaration_ast.index);
+        }
+
+        uint32_t local = (uint32_t)this->function.locals.size();
+        if (!this->locals.declare(kh::internIdentifier(declaration_ast.var_name), local)) {
+            return this->error("`" + declaration_ast.var_name + "` is already declared",
+                               declaration_ast.index);
+        }
+
+        this->function.local(declaration_ast.var_name, type, declaration_ast.index);
+        if (value.type) {
+            this->store({false, local, type}, value, declaration_ast.index);
+        }
+
+        return {KH_IR_NONE, void_type};
+    }
+
+    /* Chains of prefix operators aren't limited by the parser, so they're lowered in a loop from
+     * the innermost operator rather than by recursing once per operator */
+    Value lowerUnary(const kh::AstUnaryOperation& unary_ast) {
+        std::vector<const kh::AstUnaryOperation*> chain = {&unary_ast};
+        while (!isStep(chain.back()->operation) &&
+               chain.back()->rvalue->expression_type == kh::AstExpression::UNARY) {
+            chain.push_back((const kh::AstUnaryOperation*)chain.back()->rvalue.get());
+        }
+
+        Value value{KH_IR_NONE, nullptr};
+        const kh::AstUnaryOperation& innermost = *chain.back();
+        if (isStep(innermost.operation)) {
+            value = this->lowerStep(innermost.operation, *innermost.rvalue, innermost.index, true);
+            chain.pop_back();
+        }
+        else {
+            value = this->lower(*innermost.rvalue);
+        }
+
+        for (size_t i = chain.size(); i > 0; i--) {
+            value = this->unary(chain[i - 1]->operation, value, chain[i - 1]->index);
+        }
+        return value;
+    }
+
+    Value lowerStep(kh::Operator op, const kh::AstExpression& rvalue, size_t index, bool prefix) {
+        Target target = this->target(rvalue);
+        if (!target.type) {
+            return {KH_IR_NONE, nullptr};
+        }
+        if (!target.type->isInteger() && !target.type->isFloating()) {
+            return this->error("the " + operatorName(op) + " operator can't be used on " +
+                                   typeName(target.type),
+                               index);
+        }
+
+        Value old = this->load(target, index);
+        Value one = this->number(target.type, 1, index);
+        Value result = {this->emit(op == kh::Operator::INCREMENT ? kh::IrOp::ADD : kh::IrOp::SUB,
+                                   target.type, old.id, index, one.id),
+                        target.type};
+        this->store(target, result, index);
+        return prefix ? result : old;
+    }
+
+    Value unary(kh::Operator op, Value value, size_t index) {
+        if (!value.type) {
+            return value;
+        }
+
+        switch (op) {
+            case kh::Operator::ADD:
+            case kh::Operator::SUB:
+                if (!isNumeric(value.type)) {
+                    break;
+                }
+                return op == kh::Operator::ADD
+                           ? value
+                           : Value{this->emit(kh::IrOp::NEG, value.type, value.id, index), value.type};
+
+            case kh::Operator::NOT:
+                if (value.type->kind != kh::IrType::BOOL) {
+                    break;
+                }
+                return {this->emit(kh::IrOp::NOT, value.type, value.id, index), value.type};
+
+            case kh::Operator::BIT_NOT:
+                if (!value.type->isInteger()) {
+                    break;
+                }
+                return {this->emit(kh::IrOp::BIT_NOT, value.type, value.id, index), value.type};
+
+            default:
+                return this->unsupported("the " + operatorName(op) + " operator", index);
+        }
+
+        return this->error("the " + operatorName(op) + " operator can't be used on " +
+                               typeName(value.type),
+                           index);
+    }
+
+    Value arithmetic(kh::Operator op, Value a, Value b, size_t index) {
+        if (!a.type || !b.type) {
+            return {KH_IR_NONE, nullptr};
+        }
+
+        kh::IrOp ir_op = arithmeticOp(op);
+        const kh::IrType* type = this->commonType(a.type, b.type);
+        bool is_bitwise = ir_op == kh::IrOp::BIT_AND || ir_op == kh::IrOp::BIT_OR ||
+                          ir_op == kh::IrOp::BIT_LSHIFT || ir_op == kh::IrOp::BIT_RSHIFT;
+
+        if (!type || !isNumeric(type) || (is_bitwise && !type->isInteger()) ||
+            (ir_op == kh::IrOp::MOD && type->isComplex())) {
+            return this->error("the " + operatorName(op) + " operator can't be used on " +
+                                   typeName(a.type) + " and " + typeName(b.type),
+                               index);
+        }
+
+        a = this->convert(a, type, index);
+        b = this->convert(b, type, index);
+        return {this->emit(ir_op, type, a.id, index, b.id), type};
+    }
+
+    Value compare(kh::Operator op, Value a, Value b, size_t index) {
+        if (!a.type || !b.type) {
+            return {KH_IR_NONE, nullptr};
+        }
+
+        kh::IrOp ir_op = arithmeticOp(op);
+        const kh::IrType* type = this->commonType(a.type, b.type);
+        bool is_equality = ir_op == kh::IrOp::EQUAL || ir_op == kh::IrOp::NOT_EQUAL;
+        bool valid = type && (is_equality ? type->kind != kh::IrType::VOID
+                                          : type->isInteger() || type->isFloating() ||
+                                                type->kind == kh::IrType::CHAR);
+
+        if (!valid) {
+            return this->error("the " + operatorName(op) + " operator can't be used on " +
+                                   typeName(a.type) + " and " + typeName(b.type),
+                               index);
+        }
+
+        a = this->convert(a, type, index);
+        b = this->convert(b, type, index);
+        return {this->emit(ir_op, this->primitive(kh::IrType::BOOL), a.id, index, b.id),
+                this->primitive(kh::IrType::BOOL)};
+    }
+
+    /* Binary operators associate to the left, so chains of them nest through the left operand and
+     * aren't limited by the parser either. They're lowered in a loop from the innermost operation,
+     * each one getting the value of its left operand */
+    Value lowerBinary(const kh::AstBinaryOperation& binary_ast) {
+        std::vector<const kh::AstBinaryOperation*> chain = {&binary_ast};
+        while (!isAssignment(chain.back()->operation) &&
+               chain.back()->lvalue->expression_type == kh::AstExpression::BINARY) {
+            chain.push_back((const kh::AstBinaryOperation*)chain.back()->lvalue.get());
+        }
+
+        /* The locals of the short-circuited operators, from the outermost one */
+        const kh::IrType* bool_type = this->primitive(kh::IrType::BOOL);
+        std::vector<uint32_t> results(chain.size(), KH_IR_NONE);
+        for (size_t i = 0; i < chain.size(); i++) {
+            if (chain[i]->operation == kh::Operator::AND || chain[i]->operation == kh::Operator::OR) {
+                results[i] = this->function.local(
+                    chain[i]->operation == kh::Operator::AND ? "#and" : "#or", bool_type,
+                    chain[i]->index);
+            }
+        }
+
+        Value value{KH_IR_NONE, nullptr};
+        const kh::AstBinaryOperation& innermost = *chain.back();
+        if (isAssignment(innermost.operation)) {
+            value = this->lowerAssignment(innermost);
+            chain.pop_back();
+        }
+        else {
+            value = this->lower(*innermost.lvalue);
+        }
+
+        for (size_t i = chain.size(); i > 0; i--) {
+            value = this->binary(*chain[i - 1], value, results[i - 1]);
+        }
+        return value;
+    }
+
+    Value lowerAssignment(const kh::AstBinaryOperation& binary_ast) {
+        size_t index = binary_ast.index;
+        Target target = this->target(*binary_ast.lvalue);
+
+        if (binary_ast.operation == kh::Operator::ASSIGN) {
+            Value value = this->convert(this->lower(*binary_ast.rvalue), target.type, index);
+            if (!value.type) {
+                return value;
+            }
+            this->store(target, value, index);
+            return value;
+        }
+
+        if (!target.type) {
+            return {KH_IR_NONE, nullptr};
+        }
+        Value old = this->load(target, index);
+        Value value =
+            this->arithmetic(binary_ast.operation, old, this->lower(*binary_ast.rvalue), index);
+        value = this->convert(value, target.type, index);
+        if (value.type) {
+            this->store(target, value, index);
+        }
+        return value;
+    }
+
+    /* Lowers the right operand and the operation, given the value of the left operand */
+    Value binary(const kh::AstBinaryOperation& binary_ast, Value a, uint32_t result_local) {
+        size_t index = binary_ast.index;
+
+        switch (binary_ast.operation) {
+            case kh::Operator::AND:
+            case kh::Operator::OR: {
+                /* Short-circuited, the result goes through a local as the IR has no phi nodes */
+                bool is_and = binary_ast.operation == kh::Operator::AND;
+                const kh::IrType* bool_type = this->primitive(kh::IrType::BOOL);
+                Target result{false, result_local, bool_type};
+
+                a = this->condition(a, binary_ast.lvalue->index);
+                this->store(result, a, index);
+                uint32_t branch =
+                    this->emit(kh::IrOp::BRANCH, this->primitive(kh::IrType::VOID), a.id, index);
+
+                Value b = this->condition(*binary_ast.rvalue);
+                this->store(result, b, index);
+                uint32_t end = (uint32_t)this->function.code.size();
+                this->function.code[branch].b = is_and ? branch + 1 : end;
+                this->function.code[branch].c = is_and ? end : branch + 1;
+
+                if (!a.type || !b.type) {
+                    return {KH_IR_NONE, nullptr};
+                }
+                return this->load(result, index);
+            }
+
+            case kh::Operator::EQUAL:
+            case kh::Operator::NOT_EQUAL:
+            case kh::Operator::LESS:
+            case kh::Operator::MORE:
+            case kh::Operator::LESS_EQUAL:
+            case kh::Operator::MORE_EQUAL:
+                return this->compare(binary_ast.operation, a, this->lower(*binary_ast.rvalue), index);
+
+            default:
+                if (arithmeticOp(binary_ast.operation) == kh::IrOp::NOP) {
+                    return this->unsupported("the " + operatorName(binary_ast.operation) + " operator",
+                                             index);
+                }
+                return this->arithmetic(binary_ast.operation, a, this->lower(*binary_ast.rvalue),
+                                        index);
+        }
+    }
+
+    /* Chained ternaries nest through the value of the outer one, which is lowered after its
+     * condition. So the conditions are lowered from the outermost ternary and the rest from the
+     * innermost one, in loops as the parser doesn't limit these chains either */
+    Value lowerTernary(const kh::AstTernaryOperation& ternary_ast) {
+        std::vector<const kh::AstTernaryOperation*> chain = {&ternary_ast};
+        while (chain.back()->value->expression_type == kh::AstExpression::TERNARY) {
+            chain.push_back((const kh::AstTernaryOperation*)chain.back()->value.get());
+        }
+
+        std::vector<Value> conditions;
+        std::vector<uint32_t> branches;
+        for (const kh::AstTernaryOperation* link : chain) {
+            conditions.push_back(this->condition(*link->condition));
+            branches.push_back(this->emit(kh::IrOp::BRANCH, this->primitive(kh::IrType::VOID),
+                                          conditions.back().id, link->index));
+            this->function.code[branches.back()].b = branches.back() + 1;
+        }
+
+        Value value = this->lower(*chain.back()->value);
+        for (size_t i = chain.size(); i > 0; i--) {
+            value = this->ternary(*chain[i - 1], conditions[i - 1], branches[i - 1], value);
+        }
+        return value;
+    }
+
+    /* The value of the otherwise branch is converted to the type of the first one */
+    Value ternary(const kh::AstTernaryOperation& ternary_ast, Value condition, uint32_t branch,
+                  Value value) {
+        size_t index = ternary_ast.index;
+        const kh::IrType* void_type = this->primitive(kh::IrType::VOID);
+
+        if (!value.type || value.type == void_type) {
+            this->lower(*ternary_ast.otherwise);
+            return value.type ? this->error("the values of a ternary can't be `void`", index) : value;
+        }
+
+        Target result{false, this->function.local("#ternary", value.type, index), value.type};
+        this->store(result, value, index);
+        uint32_t jump = this->emit(kh::IrOp::JUMP, void_type, KH_IR_NONE, index);
+        this->function.code[branch].c = jump + 1;
+
+        Value otherwise = this->convert(this->lower(*ternary_ast.otherwise), value.type, index);
+        if (otherwise.type) {
+            this->store(result, otherwise, index);
+        }
+        this->function.code[jump].a = (uint32_t)this->function.code.size();
+
+        if (!condition.type || !otherwise.type) {
+            return {KH_IR_NONE, nullptr};
+        }
+        return this->load(result, index);
+    }
+
+    /* Chains like `a < b <= c` are `a < b and b <= c`, with `b` evaluated once */
+    Value lowerComparison(const kh::AstComparisonExpression& comparison_ast) {
+        size_t index = comparison_ast.index;
+        Value left = this->lower(*comparison_ast.values[0]);
+
+        if (comparison_ast.operations.size() == 1) {
+            return this->compare(comparison_ast.operations[0], left,
+                                 this->lower(*comparison_ast.values[1]), index);
+        }
+
+        const kh::IrType* bool_type = this->primitive(kh::IrType::BOOL);
+        Target result{false, this->function.local("#comparison", bool_type, index), bool_type};
+        std::vector<uint32_t> exits;
+        bool valid = true;
+
+        for (size_t i = 0; i < comparison_ast.operations.size(); i++) {
+            Value right = this->lower(*comparison_ast.values[i + 1]);
+            Value compared = this->compare(comparison_ast.operations[i], left, right, index);
+            valid = valid && compared.type;
+            left = right;
+
+            this->store(result, compared, index);
+            if (i + 1 < comparison_ast.operations.size()) {
+                uint32_t branch =
+                    this->emit(kh::IrOp::BRANCH, this->primitive(kh::IrType::VOID), compared.id, index);
+                this->function.code[branch].b = branch + 1;
+                exits.push_back(branch);
+            }
+        }
+
+        for (uint32_t exit : exits) {
+            this->function.code[exit].c = (uint32_t)this->function.code.size();
+        }
+
+        if (!valid) {
+            return {KH_IR_NONE, nullptr};
+        }
+        return this->load(result, index);
+    }
+
+    Value lowerCall(const kh::AstCallExpression& call_ast) {
+        size_t index = call_ast.index;
+        if (call_ast.expression->expression_type != kh::AstExpression::IDENTIFIER) {
+            return this->unsupported("calling anything but a function", index);
+        }
+
+        const kh::AstIdentifiers& callee = (const kh::AstIdentifiers&)*call_ast.expression;
+        std::string name;
+        for (size_t i = 0; i < callee.identifiers.size(); i++) {
+            name += (i ? "." : "") + callee.identifiers[i];
+        }
+
+        std::vector<Value> args;
+        for (const std::shared_ptr<kh::AstExpression>& argument : call_ast.arguments) {
+            args.push_back(this->lower(*argument));
+        }
+
+        /* Conversions, such as `int(3.5)` */
+        uint32_t id = kh::internIdentifier(name);
+        const kh::BuildSymbol* symbol = this->builder.symbol(id);
+        bool is_local = this->locals.find(id) != KH_NO_IDENTIFIER;
+        if (!is_local && !symbol && callee.generics.empty()) {
+            kh::AstIdentifiers type_ast(callee.index, callee.identifiers, {}, {}, {});
+            std::vector<kh::BuildException> type_errors;
+            const kh::IrType* type =
+                this->builder.resolveType(type_ast, 0, {}, type_errors, &this->bindings);
+
+            if (!type) {
+                return this->error("`" + name + "` is not declared", index);
+            }
+            if (args.size() != 1) {
+                return this->error("converting to " + typeName(type) + " takes 1 argument", index);
+            }
+            return this->convert(args[0], type, index, true);
+        }
+
+        if (!is_local && symbol && symbol->kind == kh::BuildSymbol::GENERIC_FUNCTION) {
+            symbol = this->instantiate(callee, symbol->id, name, args, index);
+            if (!symbol) {
+                return {KH_IR_NONE, nullptr};
+            }
+        }
+        else if (!is_local && !symbol) {
+            return this->error("`" + name + "` is not declared", index);
+        }
+        else if (is_local || symbol->kind != kh::BuildSymbol::FUNCTION) {
+            return !is_local && symbol->kind == kh::BuildSymbol::TYPE
+                       ? this->unsupported("constructing user types", index)
+                       : this->error("`" + name + "` isn't a function", index);
+        }
+        else if (!callee.generics.empty()) {
+            return this->error("`" + name + "` isn't generic", index);
+        }
+
+        /* The signature is in the symbol, the other functions may be being lowered right now */
+        const std::vector<const kh::IrType*>& signature = symbol->type->children;
+        if (args.size() != signature.size() - 1) {
+            return this->error("`" + name + "` takes " + std::to_string(signature.size() - 1) +
+                                   " argument(s) but " + std::to_string(args.size()) +
+                                   " were given",
+                               index);
+        }
+
+        std::vector<uint32_t> operands;
+        bool valid = true;
+        for (size_t i = 0; i < args.size(); i++) {
+            Value arg = this->convert(args[i], signature[i + 1], call_ast.arguments[i]->index);
+            valid = valid && arg.type;
+            operands.push_back(arg.id);
+        }
+
+        if (!valid) {
+            return {KH_IR_NONE, nullptr};
+        }
+        return {this->function.call(signature[0], symbol->id, operands, index), signature[0]};
+    }
+
+    /* Binds the generic arguments in the type of a parameter to the parts of the argument's type
+     * in the same place, false if they conflict */
+    bool infer(const kh::AstIdentifiers& type_ast, const kh::IrType* type,
+               const std::vector<uint32_t>& arguments, std::vector<const kh::IrType*>& args) {
+        if (type_ast.identifiers.size() == 1 && type_ast.generics.empty()) {
+            uint32_t id = kh::internIdentifier(type_ast.identifiers[0]);
+            for (size_t i = 0; i < arguments.size(); i++) {
+                if (arguments[i] == id) {
+                    if (args[i] && args[i] != type) {
+                        return false;
+                    }
+                    args[i] = type;
+                }
+            }
+            return true;
+        }
+
+        if (type_ast.generics.size() != type->children.size()) {
+            return true;
+        }
+        for (size_t i = 0; i < type_ast.generics.size(); i++) {
+            bool plain = (i >= type_ast.generics_refs.size() || !type_ast.generics_refs[i]) &&
+                         (i >= type_ast.generics_array.size() || type_ast.generics_array[i].empty());
+            if (plain && !this->infer(type_ast.generics[i], type->children[i], arguments, args)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* Gets the instance of a generic function a call refers to, from the generic arguments given
+     * or inferred from the types of the arguments */
+    const kh::BuildSymbol* instantiate(const kh::AstIdentifiers& callee, uint32_t generic,
+                                       const std::string& name, const std::vector<Value>& values,
+                                       size_t index) {
+        const std::vector<uint32_t>& arguments = this->builder.genericArguments(generic);
+        std::vector<const kh::IrType*> args;
+
+        if (!callee.generics.empty()) {
+            for (size_t i = 0; i < callee.generics.size(); i++) {
+                args.push_back(this->builder.resolveType(
+                    callee.generics[i], i < callee.generics_refs.size() ? callee.generics_refs[i] : 0,
+                    i < callee.generics_array.size() ? callee.generics_array[i]
+                                                     : std::vector<uint64_t>(),
+                    this->errors, &this->bindings));
+                if (!args.back()) {
+                    return nullptr;
+                }
+            }
+        }
+        else {
+            const kh::AstFunction& function_ast = this->builder.genericAst(generic);
+            args.resize(arguments.size(), nullptr);
+            bool valid = values.size() == function_ast.arguments.size();
+
+            for (size_t i = 0; valid && i < values.size(); i++) {
+                const kh::AstDeclaration& argument = function_ast.arguments[i];
+                if (!values[i].type) {
+                    return nullptr;
+                }
+                if (!argument.refs && argument.var_array.empty()) {
+                    valid = this->infer(argument.var_type, values[i].type, arguments, args);
+                }
+            }
+
+            if (!valid || std::find(args.begin(), args.end(), nullptr) != args.end()) {
+                this->error("can't infer the generic arguments of `" + name + "`", index);
+                return nullptr;
+            }
+        }
+
+        return this->builder.instantiate(generic, args, this->depth + 1, index, this->errors);
+    }
+
+    Value lowerValue(const kh::AstValue& value_ast) {
+        size_t index = value_ast.index;
+
+        switch (value_ast.value_type) {
+            case kh::AstValue::CHARACTER: {
+                const kh::IrType* type = this->primitive(kh::IrType::CHAR);
+                return this->constant(kh::IrConst::character(type, value_ast.character), index);
+            }
+            case kh::AstValue::UINTEGER: {
+                const kh::IrType* type = this->primitive(kh::IrType::UINT64);
+                return this->constant(kh::IrConst::uinteger(type, value_ast.uinteger), index);
+            }
+            case kh::AstValue::INTEGER: {
+                const kh::IrType* type = this->primitive(kh::IrType::INT64);
+                return this->constant(kh::IrConst::integer(type, value_ast.integer), index);
+            }
+            case kh::AstValue::FLOATING: {
+                const kh::IrType* type = this->primitive(kh::IrType::DOUBLE);
+                return this->constant(kh::IrConst::floating(type, value_ast.floating), index);
+            }
+            case kh::AstValue::IMAGINARY: {
+                const kh::IrType* type = this->primitive(kh::IrType::COMPLEX);
+                return this->constant(kh::IrConst::complex(type, 0.0, value_ast.imaginary), index);
+            }
+            case kh::AstValue::BUFFER: {
+                const kh::IrType* type = this->primitive(kh::IrType::BUFFER);
+                uint32_t buffer = this->scratch.buffer(value_ast.buffer);
+                return this->constant(kh::IrConst(kh::IrConst::BUFFER, type, buffer), index);
+            }
+            case kh::AstValue::STRING: {
+                const kh::IrType* type = this->primitive(kh::IrType::STRING);
+                uint32_t string = this->scratch.string(value_ast.string);
+                return this->constant(kh::IrConst(kh::IrConst::STRING, type, string), index);
+            }
+        }
+
+        return this->error("unknown value", index);
+    }
+};
+
+void kh::Builder::lower(kh::BuildTask& task) {
+    FunctionBuilder function_builder(*this, task);
+
+    if (task.function_ast) {
+        function_builder.lowerFunction(*task.function_ast);
+    }
+    else {
+        function_builder.lowerInitializer(this->module_ast.variables);
+    }
+}
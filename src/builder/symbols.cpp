@@ -0,0 +1,102 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#include <kithare/symbols.hpp>
+
+
+/* The IDs of a shard are `index * KH_IDENTIFIER_SHARDS + shard`, the names are in a deque so the
+ * references handed out stay valid as it grows */
+struct IdentifierShard {
+    std::mutex mutex;
+    std::unordered_map<std::string, uint32_t> ids;
+    std::deque<std::string> names;
+};
+
+class kh::IdentifierInterner {
+public:
+    IdentifierShard shards[KH_IDENTIFIER_SHARDS];
+};
+
+static thread_local std::shared_ptr<kh::IdentifierInterner> thread_identifiers;
+
+static IdentifierShard* identifierShards() {
+    static kh::IdentifierInterner process_identifiers;
+    return thread_identifiers ? thread_identifiers->shards : process_identifiers.shards;
+}
+
+uint32_t kh::internIdentifier(const std::string& name) {
+    size_t shard_index = std::hash<std::string>()(name) % KH_IDENTIFIER_SHARDS;
+    IdentifierShard& shard = identifierShards()[shard_index];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto id = shard.ids.emplace(name, (uint32_t)(shard.names.size() * KH_IDENTIFIER_SHARDS +
+                                                 shard_index));
+    if (id.second) {
+        shard.names.push_back(name);
+    }
+    return id.first->second;
+}
+
+const std::string& kh::identifierName(uint32_t id) {
+    IdentifierShard& shard = identifierShards()[id % KH_IDENTIFIER_SHARDS];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.names[id / KH_IDENTIFIER_SHARDS];
+}
+
+std::shared_ptr<kh::IdentifierInterner> kh::newIdentifierInterner() {
+    return std::make_shared<kh::IdentifierInterner>();
+}
+
+kh::IdentifierScope::IdentifierScope(const std::shared_ptr<kh::IdentifierInterner>& interner)
+    : previous(thread_identifiers) {
+    thread_identifiers = interner;
+}
+
+kh::IdentifierScope::~IdentifierScope() {
+    thread_identifiers = this->previous;
+}
+
+std::shared_ptr<kh::IdentifierInterner> kh::currentIdentifierInterner() {
+    return thread_identifiers;
+}
+
+void kh::ScopedSymbols::push() {
+    this->marks.push_back(this->undo.size());
+}
+
+void kh::ScopedSymbols::pop() {
+    for (size_t i = this->undo.size(); i > this->marks.back(); i--) {
+        *this->bindings.find(this->undo[i - 1].first) = this->undo[i - 1].second;
+    }
+    this->undo.resize(this->marks.back());
+    this->marks.pop_back();
+}
+
+bool kh::ScopedSymbols::declare(uint32_t id, uint32_t value) {
+    Binding& binding = this->bindings[id];
+    if (binding.value != KH_NO_IDENTIFIER && binding.depth == this->marks.size()) {
+        return false;
+    }
+
+    this->undo.emplace_back(id, binding);
+    binding.value = value;
+    binding.depth = (uint32_t)this->marks.size();
+    return true;
+}
+
+uint32_t kh::ScopedSymbols::find(uint32_t id) const {
+    const Binding* binding = this->bindings.find(id);
+    return binding ? binding->value : KH_NO_IDENTIFIER;
+}
+
+size_t kh::ScopedSymbols::depth() const {
+    return this->marks.size();
+}
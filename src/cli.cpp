@@ -8,38 +8,122 @@
 #define _SILENCE_ALL_CXX17_DEPRECATION_WARNINGS
 #define _SILENCE_CXX17_CODECVT_HEADER_DEPRECATION_WARNING
 #include <codecvt>
+#else
+#include <unistd.h>
 #endif
 
 #include <chrono>
 #include <clocale>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <unordered_map>
 #include <vector>
 
 #include <kithare/ansi.hpp>
+#include <kithare/builder.hpp>
 #include <kithare/file.hpp>
+#include <kithare/importer.hpp>
 #include <kithare/info.hpp>
+#include <kithare/json.hpp>
 #include <kithare/lexer.hpp>
 #include <kithare/parser.hpp>
+#include <kithare/passes.hpp>
+#include <kithare/server.hpp>
 #include <kithare/string.hpp>
+#include <kithare/symbols.hpp>
 #include <kithare/test.hpp>
 #include <kithare/utf8.hpp>
+#include <kithare/watcher.hpp>
+
+#define CLI_ERROR_BEGIN(stream) \
+    if (!options.nocolor)       \
+        stream << KH_ANSI_FG_RED;
+
+#define CLI_ERROR_END(stream) \
+    if (!options.nocolor)     \
+        stream << KH_ANSI_RESET;
+
+/* Same as the above for a `kh::Sink` */
+#define CLI_SINK_ERROR_BEGIN(sink) \
+    if (!options.nocolor)          \
+        sink.write(KH_ANSI_FG_RED);
+
+#define CLI_SINK_ERROR_END(sink) \
+    if (!options.nocolor)        \
+        sink.write(KH_ANSI_RESET);
+
+/* Amount of sources the compile server and the watch mode keep lexed and parsed, the least recently
+ * used ones are dropped past it */
+#define CLI_CACHE_LIMIT 256
 
-#define CLI_ERROR_BEGIN() \
-    if (!nocolor)         \
-        std::cerr << KH_ANSI_FG_RED;
 
-#define CLI_ERROR_END() \
-    if (!nocolor)       \
-        std::cerr << KH_ANSI_RESET;
+struct CliOptions {
+    bool nocolor = false, help = false, show_tokens = false, show_ast = false, show_timer = false,
+         tokens_json = false, ast_json = false, silent = false, test_mode = false, version = false,
+         server = false, client = false, watch = false, interface = false, show_ir = false;
+    size_t nesting_limit = KH_PARSE_NESTING_LIMIT;
+    size_t inline_growth = KH_INLINE_GROWTH;
+    std::string socket_path;
+    std::vector<std::u32string> excess_args;
 
+    /* Arguments forwarded by `kcr --client` to the compile server */
+    std::vector<std::u32string> server_args;
+};
+
+/* Lexed and parsed results of a source file kept warm by the compile server between requests */
+struct CachedSource {
+    uint64_t hash;
+    size_t nesting_limit;
+    std::vector<kh::Token> tokens;
+    std::vector<kh::LexException> lex_exceptions;
+    std::shared_ptr<kh::AstModule> ast;
+    std::vector<kh::ParseException> parse_exceptions;
+};
 
 static std::vector<std::u32string> args;
-static bool nocolor = false, help = false, show_tokens = false, show_ast = false, show_timer = false,
-            silent = false, test_mode = false, version = false;
-static std::vector<std::u32string> excess_args;
+static bool use_cache = false;
+static std::mutex cache_mutex;
+/* Entries of the cache, with when they were last used */
+struct CacheEntry {
+    std::shared_ptr<const CachedSource> source;
+    uint64_t used;
+};
+
+static std::unordered_map<std::u32string, CacheEntry> cache;
+static uint64_t cache_clock = 0;
+
+/* Every build of the compile server interns its types and identifiers into a generation of its
+ * own, which goes away with it rather than piling up over the life of the server */
+struct ServerBuild {
+    kh::TypeScope types{kh::newTypeInterner()};
+    kh::IdentifierScope identifiers{kh::newIdentifierInterner()};
+};
 
-static void handleArgs() {
-    for (std::u32string& _arg : args) {
+/* Parses the decimal value of a flag, false if it isn't one or doesn't fit */
+static bool parseCount(const std::u32string& digits, size_t& count) {
+    if (digits.empty()) {
+        return false;
+    }
+
+    size_t n = 0;
+    for (char32_t chr : digits) {
+        if (chr < '0' || chr > '9' || n > ((size_t)-1 - (chr - '0')) / 10) {
+            return false;
+        }
+        n = n * 10 + (chr - '0');
+    }
+
+    count = n;
+    return true;
+}
+
+static bool handleArgs(const std::vector<std::u32string>& arguments, CliOptions& options,
+                       std::ostream& err) {
+    for (const std::u32string& _arg : arguments) {
         std::u32string arg;
 
         /* Indicates that it is a flag argument (which starts with `-`. `--`, or `/`) */
@@ -51,151 +135,641 @@ static void handleArgs() {
         }
         /* Excess arguments */
         else {
-            excess_args.push_back(_arg);
+            options.excess_args.push_back(_arg);
+            options.server_args.push_back(_arg);
             continue;
         }
 
+        if (arg != U"client" && arg.compare(0, 7, U"socket=") != 0) {
+            options.server_args.push_back(_arg);
+        }
+
         /* Sets the booleans of the specified flags */
         if (arg == U"nocolor" || arg == U"nocolour" || arg == U"colorless" || arg == U"colourless") {
-            nocolor = true;
+            options.nocolor = true;
         }
         else if (arg == U"h" || arg == U"help") {
-            help = true;
+            options.help = true;
         }
         else if (arg == U"tokens") {
-            show_tokens = true;
+            options.show_tokens = true;
+        }
+        else if (arg == U"tokens=json") {
+            options.show_tokens = true;
+            options.tokens_json = true;
         }
         else if (arg == U"ast") {
-            show_ast = true;
+            options.show_ast = true;
+        }
+        else if (arg == U"ast=json") {
+            options.show_ast = true;
+            options.ast_json = true;
         }
         else if (arg == U"t" || arg == U"timer") {
-            show_timer = true;
+            options.show_timer = true;
         }
         else if (arg == U"s" || arg == U"silent") {
-            silent = true;
+            options.silent = true;
         }
         else if (arg == U"test") {
-            test_mode = true;
+            options.test_mode = true;
         }
         else if (arg == U"v" || arg == U"version") {
-            version = true;
+            options.version = true;
+        }
+        else if (arg == U"server") {
+            options.server = true;
+        }
+        else if (arg == U"client") {
+            options.client = true;
+        }
+        else if (arg == U"watch") {
+            options.watch = true;
+        }
+        else if (arg == U"interface") {
+            options.interface = true;
+        }
+        else if (arg == U"ir") {
+            options.show_ir = true;
+        }
+        else if (arg.compare(0, 7, U"socket=") == 0) {
+            options.socket_path = kh::encodeUtf8(arg.substr(7));
+        }
+        else if (arg.compare(0, 14, U"nesting-limit=") == 0) {
+            if (!parseCount(arg.substr(14), options.nesting_limit)) {
+                if (!options.silent) {
+                    CLI_ERROR_BEGIN(err);
+                    err << "Invalid nesting limit: " << kh::encodeUtf8(arg.substr(14)) << '\n';
+                    CLI_ERROR_END(err);
+                }
+                return false;
+            }
+
+            /* Deeper nesting would run the parser out of stack */
+            if (options.nesting_limit > kh::maxNestingLimit()) {
+                if (!options.silent) {
+                    CLI_ERROR_BEGIN(err);
+                    err << "Nesting limit above the maximum of " << kh::maxNestingLimit() << ": "
+                        << kh::encodeUtf8(arg.substr(14)) << '\n';
+                    CLI_ERROR_END(err);
+                }
+                return false;
+            }
+        }
+        else if (arg.compare(0, 14, U"inline-growth=") == 0) {
+            if (!parseCount(arg.substr(14), options.inline_growth)) {
+                if (!options.silent) {
+                    CLI_ERROR_BEGIN(err);
+                    err << "Invalid inline growth: " << kh::encodeUtf8(arg.substr(14)) << '\n';
+                    CLI_ERROR_END(err);
+                }
+                return false;
+            }
+        }
+        else {
+            if (!options.silent) {
+                CLI_ERROR_BEGIN(err);
+                err << "Unrecognized flag argument: " << kh::encodeUtf8(arg) << '\n';
+                CLI_ERROR_END(err);
+            }
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Lexes and parses a source, or reuses the cached results if the source hasn't changed */
+static std::shared_ptr<const CachedSource> lexAndParse(const CliOptions& options,
+                                                       const std::u32string& path,
+                                                       const std::string& source_bytes,
+                                                       std::ostream& out) {
+    uint64_t hash = kh::hash(source_bytes);
+
+    if (use_cache) {
+        std::unique_lock<std::mutex> lock(cache_mutex);
+        auto cached = cache.find(path);
+        if (cached != cache.end() && cached->second.source->hash == hash &&
+            cached->second.source->nesting_limit == options.nesting_limit) {
+            if (options.show_timer && !options.silent) {
+                out << "Reused cached tokens and AST\n";
+            }
+            cached->second.used = cache_clock++;
+            return cached->second.source;
+        }
+    }
+
+    std::shared_ptr<CachedSource> result = std::make_shared<CachedSource>();
+    result->hash = hash;
+    result->nesting_limit = options.nesting_limit;
+    std::u32string source = kh::decodeUtf8(source_bytes);
+
+    auto lex_start = std::chrono::high_resolution_clock::now();
+    kh::LexerContext lexer_context{source, result->lex_exceptions};
+    result->tokens = kh::lex(lexer_context);
+    auto lex_end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> lex_elapsed = lex_end - lex_start;
+
+    if (options.show_timer && !options.silent) {
+        out << "Finished lexing in " << lex_elapsed.count() << "s\n";
+    }
+
+    auto parse_start = std::chrono::high_resolution_clock::now();
+    kh::ParserContext parser_context{result->tokens, result->parse_exceptions};
+    parser_context.nesting_limit = options.nesting_limit;
+    result->ast = std::make_shared<kh::AstModule>(kh::parseWhole(parser_context));
+    auto parse_end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> parse_elapsed = parse_end - parse_start;
+
+    if (options.show_timer && !options.silent) {
+        out << "Finished parsing in " << parse_elapsed.count() << "s\n";
+    }
+
+    if (use_cache) {
+        std::unique_lock<std::mutex> lock(cache_mutex);
+        cache[path] = {result, cache_clock++};
+
+        if (cache.size() > CLI_CACHE_LIMIT) {
+            auto oldest = cache.begin();
+            for (auto entry = cache.begin(); entry != cache.end(); entry++) {
+                if (entry->second.used < oldest->second.used) {
+                    oldest = entry;
+                }
+            }
+            cache.erase(oldest);
+        }
+    }
+
+    return result;
+}
+
+/* Streams what `write` writes into a sink straight to the standard output or error rather than
+ * building it in memory, other streams such as the compile server's responses get it as a whole */
+template <typename F>
+static void writeOutput(std::ostream& out, const F& write) {
+    if (&out == &std::cout || &out == &std::cerr) {
+        out.flush();
+        kh::Sink sink(&out == &std::cout ? 1 : 2);
+        write(sink);
+    }
+    else {
+        std::string output;
+        {
+            kh::Sink sink(output);
+            write(sink);
+        }
+        out << output;
+    }
+}
+
+/* Prints the diagnostics and the requested dumps of a lexed and parsed source, returns the amount of
+ * errors */
+static int report(const CliOptions& options, const CachedSource& result, std::ostream& out,
+                  std::ostream& err) {
+    int code = 0;
+
+    if (!result.lex_exceptions.empty()) {
+        if (!options.silent) {
+            writeOutput(err, [&](kh::Sink& sink) {
+                CLI_SINK_ERROR_BEGIN(sink);
+                for (const kh::LexException& exc : result.lex_exceptions) {
+                    sink.write("LexException: ");
+                    sink.write(exc.format());
+                    sink.write('\n');
+                }
+                CLI_SINK_ERROR_END(sink);
+            });
+        }
+
+        code += result.lex_exceptions.size();
+    }
+    if (options.show_tokens && !options.silent) {
+        if (options.tokens_json) {
+            writeOutput(out, [&](kh::Sink& sink) {
+                kh::JsonWriter json(sink);
+                json.beginArray();
+                for (const kh::Token& token : result.tokens) {
+                    kh::writeJson(json, token);
+                }
+                json.endArray();
+                sink.write('\n');
+            });
         }
         else {
-            if (!silent) {
-                CLI_ERROR_BEGIN();
-                std::cout << "Unrecognized flag argument: " << kh::encodeUtf8(arg) << '\n';
-                CLI_ERROR_END();
+            writeOutput(out, [&](kh::Sink& sink) {
+                sink.write("tokens:\n");
+                for (const kh::Token& token : result.tokens) {
+                    sink.write('\t');
+                    kh::writeToken(sink, token, true);
+                    sink.write('\n');
+                }
+            });
+        }
+    }
+
+    if (!result.parse_exceptions.empty()) {
+        if (!options.silent) {
+            writeOutput(err, [&](kh::Sink& sink) {
+                CLI_SINK_ERROR_BEGIN(sink);
+                for (const kh::ParseException& exc : result.parse_exceptions) {
+                    sink.write("ParseException: ");
+                    sink.write(exc.format());
+                    sink.write('\n');
+                }
+                CLI_SINK_ERROR_END(sink);
+            });
+        }
+
+        code += result.parse_exceptions.size();
+    }
+    if (options.show_ast && !code && !options.silent) {
+        writeOutput(out, [&](kh::Sink& sink) {
+            if (options.ast_json) {
+                kh::JsonWriter json(sink);
+                kh::AstJsonWriter(json).write(*result.ast);
+            }
+            else {
+                kh::AstWriter(sink).write(*result.ast);
             }
-            std::exit(1);
+            sink.write('\n');
+        });
+    }
+
+    return code;
+}
+
+/* Runs the semantic analysis of a parsed source and prints its IR, returns the amount of errors */
+static int build(const CliOptions& options, const CachedSource& result, std::ostream& out,
+                 std::ostream& err) {
+    kh::IrModule module_ir;
+    kh::Builder builder(*result.ast, module_ir);
+
+    auto build_start = std::chrono::high_resolution_clock::now();
+    builder.build();
+    auto build_end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> build_elapsed = build_end - build_start;
+
+    if (options.show_timer && !options.silent) {
+        out << "Finished building in " << build_elapsed.count() << "s\n";
+    }
+
+    if (!builder.exceptions.empty()) {
+        if (!options.silent) {
+            kh::locate(builder.exceptions, result.tokens);
+            writeOutput(err, [&](kh::Sink& sink) {
+                CLI_SINK_ERROR_BEGIN(sink);
+                for (const kh::BuildException& exc : builder.exceptions) {
+                    sink.write("BuildException: ");
+                    sink.write(exc.format());
+                    sink.write('\n');
+                }
+                CLI_SINK_ERROR_END(sink);
+            });
         }
+
+        return builder.exceptions.size();
+    }
+
+    auto merge_start = std::chrono::high_resolution_clock::now();
+    size_t merged = kh::mergeIdenticalFunctions(module_ir);
+    auto merge_end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> merge_elapsed = merge_end - merge_start;
+
+    if (options.show_timer && !options.silent) {
+        out << "Merged " << merged << " identical function(s) in " << merge_elapsed.count()
+            << "s\n";
+    }
+
+    /* Inlining first gives the folding the callees' code with the callers' constants */
+    auto inline_start = std::chrono::high_resolution_clock::now();
+    size_t inlined = kh::inlineCalls(module_ir, options.inline_growth);
+    auto inline_end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> inline_elapsed = inline_end - inline_start;
+
+    if (options.show_timer && !options.silent) {
+        out << "Inlined " << inlined << " call(s) in " << inline_elapsed.count() << "s\n";
+    }
+
+    /* Calls evaluated at compile time give constants to fold further, which may give more calls
+     * constant arguments. The rounds share the budget and the calls already run */
+    size_t folded = 0, evaluated = 0;
+    kh::EvaluatedCalls evaluated_calls;
+    std::chrono::duration<double> fold_elapsed(0), eval_elapsed(0);
+    for (size_t calls = 1; calls;) {
+        auto fold_start = std::chrono::high_resolution_clock::now();
+        folded += kh::foldConstants(module_ir);
+        auto fold_end = std::chrono::high_resolution_clock::now();
+        calls = kh::evaluateCalls(module_ir, evaluated_calls);
+        auto eval_end = std::chrono::high_resolution_clock::now();
+
+        fold_elapsed += fold_end - fold_start;
+        eval_elapsed += eval_end - fold_end;
+        evaluated += calls;
     }
+
+    if (options.show_timer && !options.silent) {
+        out << "Folded " << folded << " constant instruction(s) in " << fold_elapsed.count()
+            << "s\n";
+        out << "Evaluated " << evaluated << " call(s) at compile time in " << eval_elapsed.count()
+            << "s\n";
+    }
+
+    auto eliminate_start = std::chrono::high_resolution_clock::now();
+    kh::EliminatedCode eliminated = kh::eliminateDeadCode(module_ir);
+    auto eliminate_end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> eliminate_elapsed = eliminate_end - eliminate_start;
+
+    if (options.show_timer && !options.silent) {
+        out << "Eliminated " << eliminated.functions << " function(s), " << eliminated.globals
+            << " global(s) and " << eliminated.constants << " constant(s) in "
+            << eliminate_elapsed.count() << "s\n";
+    }
+
+    if (!options.silent) {
+        writeOutput(out, [&](kh::Sink& sink) { kh::IrWriter(sink).write(module_ir); });
+    }
+
+    return 0;
 }
 
-static int execute() {
+static int execute(const CliOptions& options, std::ostream& out, std::ostream& err) {
     int code = 0;
 
-    if (version && !silent) {
-        std::cout << "Kithare " KH_VERSION_STR << "\nOS: " KH_OS << "\nCompiler: " KH_COMPILER
-                  << "\nCompiled on " __DATE__ " at " __TIME__ << '\n';
+    if (options.version && !options.silent) {
+        out << "Kithare " KH_VERSION_STR << "\nOS: " KH_OS << "\nCompiler: " KH_COMPILER
+            << "\nCompiled on " __DATE__ " at " __TIME__ << '\n';
     }
 
-    if (help && !silent) {
-        std::cout << "TODO\n";
+    if (options.help && !options.silent) {
+        out << "TODO\n";
     }
 
     /* Unittest */
-    if (test_mode) {
+    if (options.test_mode) {
         std::vector<std::string> errors;
         kh_test::utf8Test(errors);
+        kh_test::stringTest(errors);
         kh_test::lexerTest(errors);
         kh_test::parserTest(errors);
+        kh_test::importerTest(errors);
+        kh_test::builderTest(errors);
 
-        if (!silent) {
-            std::cout << "Unittest: " << errors.size() << " error(s)\n";
+        if (!options.silent) {
+            out << "Unittest: " << errors.size() << " error(s)\n";
 
-            CLI_ERROR_BEGIN();
+            CLI_ERROR_BEGIN(err);
             for (const std::string& error : errors) {
-                std::cerr << error << '\n';
+                err << error << '\n';
             }
-            CLI_ERROR_END();
+            CLI_ERROR_END(err);
         }
 
-        std::exit(errors.size());
+        return errors.size();
     }
 
     /* Compilation */
-    if (!excess_args.empty()) {
-        std::u32string source;
+    if (!options.excess_args.empty()) {
+        std::shared_ptr<const CachedSource> result;
 
         try {
-            source = kh::readFile(excess_args[0]);
+            std::string source_bytes = kh::readFileBinary(options.excess_args[0]);
+            result = lexAndParse(options, options.excess_args[0], source_bytes, out);
         }
         catch (kh::Exception& exc) {
-            if (!silent) {
-                CLI_ERROR_BEGIN();
-                std::cerr << exc.format() << '\n';
-                CLI_ERROR_END();
+            if (!options.silent) {
+                CLI_ERROR_BEGIN(err);
+                err << exc.format() << '\n';
+                CLI_ERROR_END(err);
             }
-            std::exit(1);
+            return 1;
         }
 
-        auto lex_start = std::chrono::high_resolution_clock::now();
-        std::vector<kh::LexException> lex_exceptions;
-        kh::LexerContext lexer_context{source, lex_exceptions};
-        std::vector<kh::Token> tokens = kh::lex(lexer_context);
-        auto lex_end = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double> lex_elapsed = lex_end - lex_start;
+        code += report(options, *result, out, err);
 
-        if (show_timer && !silent) {
-            std::cout << "Finished lexing in " << lex_elapsed.count() << "s\n";
+        if (options.show_ir && !code) {
+            code += build(options, *result, out, err);
         }
-        if (!lex_exceptions.empty()) {
-            if (!silent) {
-                CLI_ERROR_BEGIN();
-                for (kh::LexException& exc : lex_exceptions) {
-                    std::cerr << "LexException: " << exc.format() << '\n';
+
+        /* Writes the module interface for importers to load instead of the source */
+        if (options.interface && !code) {
+            try {
+                kh::updateInterface(options.excess_args[0], *result->ast, result->hash);
+            }
+            catch (kh::Exception&) {
+                if (!options.silent) {
+                    CLI_ERROR_BEGIN(err);
+                    err << "unable to write the module interface\n";
+                    CLI_ERROR_END(err);
                 }
-                CLI_ERROR_END();
+                return 1;
             }
+        }
+    }
+
+    return code;
+}
+
+/* Runs a request of `kcr --client` inside of the compile server */
+static kh::ServerResponse handleRequest(const kh::ServerRequest& request) {
+    kh::ServerResponse response;
+    std::ostringstream out, err;
 
-            code += lex_exceptions.size();
+    CliOptions options;
+    if (!handleArgs(request.args, options, err)) {
+        response.code = 1;
+    }
+    else if (options.server || options.client || options.test_mode || options.watch) {
+        CLI_ERROR_BEGIN(err);
+        err << "This flag is not available through the compile server\n";
+        CLI_ERROR_END(err);
+        response.code = 1;
+    }
+    else {
+        /* Resolves relative paths from the client's working directory */
+        if (!options.excess_args.empty() && !options.excess_args[0].empty() &&
+            options.excess_args[0][0] != '/') {
+            options.excess_args[0] = kh::decodeUtf8(request.cwd) + U'/' + options.excess_args[0];
         }
-        if (show_tokens && !silent) {
-            std::cout << "tokens:\n";
-            for (kh::Token& token : tokens) {
-                std::cout << '\t' << kh::encodeUtf8(kh::str(token, true)) << '\n';
+
+        ServerBuild build;
+        response.code = execute(options, out, err);
+    }
+
+    response.out = out.str();
+    response.err = err.str();
+    return response;
+}
+
+static int runServerOrClient(const CliOptions& options) {
+    std::string socket_path =
+        options.socket_path.empty() ? kh::defaultSocketPath() : options.socket_path;
+
+    try {
+        if (options.server) {
+            use_cache = true;
+            if (!options.silent) {
+                std::cout << "Listening for compile requests on " << socket_path << '\n';
             }
+            kh::runServer(socket_path, handleRequest);
         }
 
-        auto parse_start = std::chrono::high_resolution_clock::now();
-        std::vector<kh::ParseException> parse_exceptions;
-        kh::ParserContext parser_context{tokens, parse_exceptions};
-        kh::AstModule ast = parseWhole(parser_context);
-        auto parse_end = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double> parse_elapsed = parse_end - parse_start;
+        kh::ServerRequest request;
+#ifndef _WIN32
+        char cwd[4096];
+        if (getcwd(cwd, sizeof(cwd))) {
+            request.cwd = cwd;
+        }
+#endif
 
-        if (show_timer && !silent) {
-            std::cout << "Finished parsing in " << parse_elapsed.count() << "s\n";
+        request.args = options.server_args;
+        kh::ServerResponse response = kh::runClient(socket_path, request);
+        std::cout << response.out;
+        std::cerr << response.err;
+        return response.code;
+    }
+    catch (kh::Exception& exc) {
+        if (!options.silent) {
+            CLI_ERROR_BEGIN(std::cerr);
+            std::cerr << exc.format() << '\n';
+            CLI_ERROR_END(std::cerr);
         }
-        if (!parse_exceptions.empty()) {
-            if (!silent) {
-                CLI_ERROR_BEGIN();
-                for (kh::ParseException& exc : parse_exceptions) {
-                    std::cerr << "ParseException: " << exc.format() << '\n';
-                }
-                CLI_ERROR_END();
+        return 1;
+    }
+}
+
+/* Resolves an import or include statement to the path of a source file inside of the watched
+ * directory, `import a.b` resolves to `a/b.kh` from the root and `import .a.b` from the directory of
+ * the importing source */
+static std::string resolveImport(const std::string& root, const std::string& importer,
+                                 const kh::AstImport& import_ast) {
+    std::string path = root;
+    if (import_ast.is_relative) {
+        size_t slash = importer.rfind('/');
+        path = slash == std::string::npos ? "." : importer.substr(0, slash);
+    }
+
+    for (const std::string& identifier : import_ast.path) {
+        path += '/' + identifier;
+    }
+
+    return path + ".kh";
+}
+
+/* Recompiles the changed sources along with every source which transitively imports them, the
+ * tokens and ASTs of the sources which didn't change are reused from the cache */
+static int rebuild(const CliOptions& options, const std::string& root,
+                   const std::vector<std::string>& changed,
+                   std::map<std::string, std::vector<std::string>>& imports) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::unordered_map<std::string, std::vector<std::string>> importers;
+    for (const auto& source : imports) {
+        for (const std::string& imported : source.second) {
+            importers[imported].push_back(source.first);
+        }
+    }
+
+    std::set<std::string> dirty(changed.begin(), changed.end());
+    std::vector<std::string> stack(changed.begin(), changed.end());
+    while (!stack.empty()) {
+        std::string path = stack.back();
+        stack.pop_back();
+
+        for (const std::string& importer : importers[path]) {
+            if (dirty.insert(importer).second) {
+                stack.push_back(importer);
             }
+        }
+    }
+
+    int code = 0;
+    size_t rebuilt = 0;
+
+    for (const std::string& path : dirty) {
+        std::u32string u32path = kh::decodeUtf8(path);
+        std::shared_ptr<const CachedSource> result;
+
+        try {
+            std::string source_bytes = kh::readFileBinary(u32path);
+            if (!options.silent) {
+                std::cout << "Compiling " << path << '\n';
+            }
+            result = lexAndParse(options, u32path, source_bytes, std::cout);
+        }
+        catch (kh::FileError&) {
+            /* The source got removed, its importers are still recompiled */
+            imports.erase(path);
+            std::unique_lock<std::mutex> lock(cache_mutex);
+            cache.erase(u32path);
+            continue;
+        }
+        catch (kh::Exception& exc) {
+            if (!options.silent) {
+                CLI_ERROR_BEGIN(std::cerr);
+                std::cerr << path << ": " << exc.format() << '\n';
+                CLI_ERROR_END(std::cerr);
+            }
+            code++;
+            continue;
+        }
 
-            code += parse_exceptions.size();
+        std::vector<std::string>& source_imports = imports[path];
+        source_imports.clear();
+        for (const kh::AstImport& import_ast : result->ast->imports) {
+            source_imports.push_back(resolveImport(root, path, import_ast));
         }
-        if (show_ast && !code && !silent) {
-            std::cout << kh::encodeUtf8(kh::str(ast)) << '\n';
+
+        code += report(options, *result, std::cout, std::cerr);
+        rebuilt++;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+
+    if (!options.silent) {
+        std::cout << "Rebuilt " << rebuilt << " file(s) with " << code << " error(s)";
+        if (options.show_timer) {
+            std::cout << " in " << elapsed.count() << 's';
         }
+        std::cout << std::endl;
     }
 
     return code;
 }
 
+/* Compiles every source inside of a directory, then keeps recompiling the sources which got changed
+ * until the process gets interrupted */
+static int runWatch(const CliOptions& options) {
+    std::string root = options.excess_args.empty() ? "." : kh::encodeUtf8(options.excess_args[0]);
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+
+    use_cache = true;
+    std::map<std::string, std::vector<std::string>> imports;
+
+    try {
+        kh::Watcher watcher(root);
+        rebuild(options, root, kh::findSources(root), imports);
+
+        if (!options.silent) {
+            std::cout << "Watching " << root << " for changes" << std::endl;
+        }
+
+        while (true) {
+            rebuild(options, root, watcher.wait(), imports);
+        }
+    }
+    catch (kh::Exception& exc) {
+        if (!options.silent) {
+            CLI_ERROR_BEGIN(std::cerr);
+            std::cerr << exc.format() << '\n';
+            CLI_ERROR_END(std::cerr);
+        }
+        return 1;
+    }
+}
+
 /* Entry point of the Kithare CLI program */
 #ifdef _WIN32
 int wmain(const int argc, wchar_t* argv[])
@@ -205,6 +779,10 @@ int main(const int argc, char* argv[])
 {
     /* Sets the locale to using UTF-8 */
     std::setlocale(LC_ALL, "en_US.utf8");
+
+    /* Output is either written in large chunks through `kh::Sink` or through the iostreams, which
+     * get flushed before that, so they don't need to be synchronized with stdio */
+    std::ios::sync_with_stdio(false);
 #ifdef _WIN32
     /* Sets up std::wcout and std::wcin on Windows */
     std::locale utf8_locale(std::locale(), new std::codecvt_utf8_utf16<wchar_t>);
@@ -225,6 +803,18 @@ int main(const int argc, char* argv[])
         args.push_back(kh::decodeUtf8(std::string(argv[arg])));
 #endif
 
-    handleArgs();
-    return execute();
+    CliOptions options;
+    if (!handleArgs(args, options, std::cerr)) {
+        return 1;
+    }
+
+    if (options.server || options.client) {
+        return runServerOrClient(options);
+    }
+
+    if (options.watch) {
+        return runWatch(options);
+    }
+
+    return execute(options, std::cout, std::cerr);
 }
@@ -4,6 +4,18 @@
  * Copyright (C) 2021 Kithare Organization
  */
 
+#include <cstdlib>
+
+#if _WIN32
+#include <io.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <kithare/file.hpp>
 #include <kithare/string.hpp>
 #include <kithare/utf8.hpp>
@@ -13,6 +25,17 @@ std::string kh::FileError::format() const {
     return "unable to read file";
 }
 
+#if _WIN32
+static std::wstring widePath(const std::u32string& path) {
+    std::wstring u16path;
+    u16path.reserve(path.size());
+    for (char32_t ch : path) {
+        u16path += (wchar_t)ch;
+    }
+    return u16path;
+}
+#endif
+
 std::u32string kh::readFile(const std::u32string& path) {
     return kh::decodeUtf8(kh::readFileBinary(path));
 }
@@ -23,13 +46,7 @@ std::string kh::readFileBinary(const std::u32string& path) {
     std::string ret;
     FILE* file;
 #if _WIN32
-    std::wstring u16path;
-    u16path.reserve(path.size());
-    for (char32_t ch : path) {
-        u16path += (wchar_t)ch;
-    }
-
-    file = _wfopen(u16path.c_str(), L"rb");
+    file = _wfopen(widePath(path).c_str(), L"rb");
 #else
     file = fopen(kh::encodeUtf8(path).c_str(), "rb");
 #endif
@@ -50,3 +67,109 @@ std::string kh::readFileBinary(const std::u32string& path) {
     fclose(file);
     return ret;
 }
+
+std::u32string kh::canonicalPath(const std::u32string& path) {
+#if _WIN32
+    wchar_t* full_path = _wfullpath(nullptr, widePath(path).c_str(), 0);
+    if (!full_path || _waccess(full_path, 0) != 0) {
+        free(full_path);
+        throw kh::FileError();
+    }
+
+    std::u32string ret;
+    for (wchar_t* ch = full_path; *ch; ch++) {
+        ret += (char32_t)*ch;
+    }
+#else
+    char* full_path = realpath(kh::encodeUtf8(path).c_str(), nullptr);
+    if (!full_path) {
+        throw kh::FileError();
+    }
+
+    std::u32string ret = kh::decodeUtf8(full_path);
+#endif
+
+    free(full_path);
+    return ret;
+}
+
+void kh::writeFileBinary(const std::u32string& path, const std::string& data) {
+    /* The process ID keeps compilers running at the same time from writing the same temporary */
+#if _WIN32
+    std::u32string temporary_path = path + U".tmp" + kh::decodeUtf8(std::to_string(_getpid()));
+    FILE* file = _wfopen(widePath(temporary_path).c_str(), L"wb");
+#else
+    std::u32string temporary_path = path + U".tmp" + kh::decodeUtf8(std::to_string(getpid()));
+    FILE* file = fopen(kh::encodeUtf8(temporary_path).c_str(), "wb");
+#endif
+
+    if (!file) {
+        throw kh::FileError();
+    }
+
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    written = fclose(file) == 0 && written;
+
+#if _WIN32
+    _wremove(widePath(path).c_str());
+    written = written && _wrename(widePath(temporary_path).c_str(), widePath(path).c_str()) == 0;
+    if (!written) {
+        _wremove(widePath(temporary_path).c_str());
+        throw kh::FileError();
+    }
+#else
+    written = written && rename(kh::encodeUtf8(temporary_path).c_str(),
+                                kh::encodeUtf8(path).c_str()) == 0;
+    if (!written) {
+        remove(kh::encodeUtf8(temporary_path).c_str());
+        throw kh::FileError();
+    }
+#endif
+}
+
+kh::MappedFile::MappedFile(const std::u32string& path) {
+#if _WIN32
+    this->buffer = kh::readFileBinary(path);
+#else
+    int fd = open(kh::encodeUtf8(path).c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw kh::FileError();
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        close(fd);
+        throw kh::FileError();
+    }
+
+    /* Empty files can't be mapped */
+    if (info.st_size > 0) {
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            throw kh::FileError();
+        }
+
+        this->mapped = (const char*)mapping;
+        this->mapped_size = info.st_size;
+    }
+
+    close(fd);
+#endif
+}
+
+kh::MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (this->mapped) {
+        munmap((void*)this->mapped, this->mapped_size);
+    }
+#endif
+}
+
+const char* kh::MappedFile::data() const {
+    return this->mapped ? this->mapped : this->buffer.data();
+}
+
+size_t kh::MappedFile::size() const {
+    return this->mapped ? this->mapped_size : this->buffer.size();
+}
@@ -0,0 +1,367 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <kithare/string.hpp>
+
+/* Implementation of the Grisu2 algorithm by Florian Loitsch, "Printing Floating-Point Numbers Quickly
+ * and Accurately with Integers". It always produces digits which read back to the exact same value,
+ * and in almost every case the shortest of those */
+
+
+/* Internal to this file, so they don't clash with other definitions of the same names */
+namespace {
+    /* A floating point number `f * 2^e` with a 64 bit significand */
+    struct DiyFp {
+        uint64_t f;
+        int e;
+    };
+
+    /* A normalized approximation of `10^k` */
+    struct CachedPower {
+        uint64_t f;
+        int e;
+        int k;
+    };
+
+    /* The value with the boundaries of the interval of numbers which round to it */
+    struct FloatBoundaries {
+        DiyFp w;
+        DiyFp minus;
+        DiyFp plus;
+    };
+}
+
+/* Normalized approximations of 10^k for k = -300, -292, ..., 324 */
+static const CachedPower cached_powers[79] = {
+        {0xAB70FE17C79AC6CAULL, -1060, -300},
+        {0xFF77B1FCBEBCDC4FULL, -1034, -292},
+        {0xBE5691EF416BD60CULL, -1007, -284},
+        {0x8DD01FAD907FFC3CULL, -980, -276},
+        {0xD3515C2831559A83ULL, -954, -268},
+        {0x9D71AC8FADA6C9B5ULL, -927, -260},
+        {0xEA9C227723EE8BCBULL, -901, -252},
+        {0xAECC49914078536DULL, -874, -244},
+        {0x823C12795DB6CE57ULL, -847, -236},
+        {0xC21094364DFB5637ULL, -821, -228},
+        {0x9096EA6F3848984FULL, -794, -220},
+        {0xD77485CB25823AC7ULL, -768, -212},
+        {0xA086CFCD97BF97F4ULL, -741, -204},
+        {0xEF340A98172AACE5ULL, -715, -196},
+        {0xB23867FB2A35B28EULL, -688, -188},
+        {0x84C8D4DFD2C63F3BULL, -661, -180},
+        {0xC5DD44271AD3CDBAULL, -635, -172},
+        {0x936B9FCEBB25C996ULL, -608, -164},
+        {0xDBAC6C247D62A584ULL, -582, -156},
+        {0xA3AB66580D5FDAF6ULL, -555, -148},
+        {0xF3E2F893DEC3F126ULL, -529, -140},
+        {0xB5B5ADA8AAFF80B8ULL, -502, -132},
+        {0x87625F056C7C4A8BULL, -475, -124},
+        {0xC9BCFF6034C13053ULL, -449, -116},
+        {0x964E858C91BA2655ULL, -422, -108},
+        {0xDFF9772470297EBDULL, -396, -100},
+        {0xA6DFBD9FB8E5B88FULL, -369, -92},
+        {0xF8A95FCF88747D94ULL, -343, -84},
+        {0xB94470938FA89BCFULL, -316, -76},
+        {0x8A08F0F8BF0F156BULL, -289, -68},
+        {0xCDB02555653131B6ULL, -263, -60},
+        {0x993FE2C6D07B7FACULL, -236, -52},
+        {0xE45C10C42A2B3B06ULL, -210, -44},
+        {0xAA242499697392D3ULL, -183, -36},
+        {0xFD87B5F28300CA0EULL, -157, -28},
+        {0xBCE5086492111AEBULL, -130, -20},
+        {0x8CBCCC096F5088CCULL, -103, -12},
+        {0xD1B71758E219652CULL, -77, -4},
+        {0x9C40000000000000ULL, -50, 4},
+        {0xE8D4A51000000000ULL, -24, 12},
+        {0xAD78EBC5AC620000ULL, 3, 20},
+        {0x813F3978F8940984ULL, 30, 28},
+        {0xC097CE7BC90715B3ULL, 56, 36},
+        {0x8F7E32CE7BEA5C70ULL, 83, 44},
+        {0xD5D238A4ABE98068ULL, 109, 52},
+        {0x9F4F2726179A2245ULL, 136, 60},
+        {0xED63A231D4C4FB27ULL, 162, 68},
+        {0xB0DE65388CC8ADA8ULL, 189, 76},
+        {0x83C7088E1AAB65DBULL, 216, 84},
+        {0xC45D1DF942711D9AULL, 242, 92},
+        {0x924D692CA61BE758ULL, 269, 100},
+        {0xDA01EE641A708DEAULL, 295, 108},
+        {0xA26DA3999AEF774AULL, 322, 116},
+        {0xF209787BB47D6B85ULL, 348, 124},
+        {0xB454E4A179DD1877ULL, 375, 132},
+        {0x865B86925B9BC5C2ULL, 402, 140},
+        {0xC83553C5C8965D3DULL, 428, 148},
+        {0x952AB45CFA97A0B3ULL, 455, 156},
+        {0xDE469FBD99A05FE3ULL, 481, 164},
+        {0xA59BC234DB398C25ULL, 508, 172},
+        {0xF6C69A72A3989F5CULL, 534, 180},
+        {0xB7DCBF5354E9BECEULL, 561, 188},
+        {0x88FCF317F22241E2ULL, 588, 196},
+        {0xCC20CE9BD35C78A5ULL, 614, 204},
+        {0x98165AF37B2153DFULL, 641, 212},
+        {0xE2A0B5DC971F303AULL, 667, 220},
+        {0xA8D9D1535CE3B396ULL, 694, 228},
+        {0xFB9B7CD9A4A7443CULL, 720, 236},
+        {0xBB764C4CA7A44410ULL, 747, 244},
+        {0x8BAB8EEFB6409C1AULL, 774, 252},
+        {0xD01FEF10A657842CULL, 800, 260},
+        {0x9B10A4E5E9913129ULL, 827, 268},
+        {0xE7109BFBA19C0C9DULL, 853, 276},
+        {0xAC2820D9623BF429ULL, 880, 284},
+        {0x80444B5E7AA7CF85ULL, 907, 292},
+        {0xBF21E44003ACDD2DULL, 933, 300},
+        {0x8E679C2F5E44FF8FULL, 960, 308},
+        {0xD433179D9C8CB841ULL, 986, 316},
+        {0x9E19DB92B4E31BA9ULL, 1013, 324},
+};
+
+static inline DiyFp subtract(const DiyFp& x, const DiyFp& y) {
+    return {x.f - y.f, x.e};
+}
+
+/* Multiplies the significands and keeps the upper 64 bits rounded */
+static inline DiyFp multiply(const DiyFp& x, const DiyFp& y) {
+    uint64_t x_low = x.f & 0xFFFFFFFF, x_high = x.f >> 32;
+    uint64_t y_low = y.f & 0xFFFFFFFF, y_high = y.f >> 32;
+
+    uint64_t low_low = x_low * y_low;
+    uint64_t low_high = x_low * y_high;
+    uint64_t high_low = x_high * y_low;
+    uint64_t high_high = x_high * y_high;
+
+    uint64_t middle = (low_low >> 32) + (low_high & 0xFFFFFFFF) + (high_low & 0xFFFFFFFF);
+    middle += (uint64_t)1 << 31;
+
+    return {high_high + (high_low >> 32) + (low_high >> 32) + (middle >> 32), x.e + y.e + 64};
+}
+
+static inline DiyFp normalize(DiyFp x) {
+    while (!(x.f >> 63)) {
+        x.f <<= 1;
+        x.e--;
+    }
+
+    return x;
+}
+
+template <typename T, typename Bits>
+static FloatBoundaries computeBoundaries(T value) {
+    const int precision = std::numeric_limits<T>::digits;
+    const int bias = std::numeric_limits<T>::max_exponent - 1 + (precision - 1);
+    const uint64_t hidden_bit = (uint64_t)1 << (precision - 1);
+
+    Bits raw;
+    std::memcpy(&raw, &value, sizeof(raw));
+    uint64_t bits = raw;
+
+    uint64_t exponent = bits >> (precision - 1);
+    uint64_t fraction = bits & (hidden_bit - 1);
+
+    DiyFp v = exponent == 0 ? DiyFp{fraction, 1 - bias}
+                                : DiyFp{fraction + hidden_bit, (int)exponent - bias};
+
+    /* The lower boundary is closer if the value is a power of 2 with the smallest significand */
+    bool lower_is_closer = fraction == 0 && exponent > 1;
+
+    DiyFp plus = normalize({2 * v.f + 1, v.e - 1});
+    DiyFp minus = lower_is_closer ? DiyFp{4 * v.f - 1, v.e - 2} : DiyFp{2 * v.f - 1, v.e - 1};
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    return {normalize(v), minus, plus};
+}
+
+/* Gets a cached power `c = 10^k` such that `-60 <= e + c.e + 64 <= -32` */
+static const CachedPower& cachedPower(int e) {
+    int f = -60 - e - 1;
+    int k = (f * 78913) / (1 << 18) + (f > 0);
+    return cached_powers[(300 + k + 7) / 8];
+}
+
+/* Gets the largest power of 10 which is less than or equal to `n`, returns its digit count */
+static int largestPow10(uint32_t n, uint32_t& pow10) {
+    int digits = 10;
+    pow10 = 1000000000;
+
+    while (pow10 > n && digits > 1) {
+        pow10 /= 10;
+        digits--;
+    }
+
+    return digits;
+}
+
+/* Moves the last digit closer to the value while it's still inside of the rounding interval */
+static void roundDigits(char* buffer, int length, uint64_t distance, uint64_t delta, uint64_t rest,
+                        uint64_t ten_k) {
+    while (rest < distance && delta - rest >= ten_k &&
+           (rest + ten_k < distance || distance - rest > rest + ten_k - distance)) {
+        buffer[length - 1]--;
+        rest += ten_k;
+    }
+}
+
+/* Generates the shortest digits inside of the interval `(minus, plus)` which are the closest to `w` */
+static void generateDigits(char* buffer, int& length, int& decimal_exponent, DiyFp minus,
+                           DiyFp w, DiyFp plus) {
+    uint64_t delta = subtract(plus, minus).f;
+    uint64_t distance = subtract(plus, w).f;
+
+    DiyFp one = {(uint64_t)1 << -plus.e, plus.e};
+
+    uint32_t integral = (uint32_t)(plus.f >> -one.e);
+    uint64_t fractional = plus.f & (one.f - 1);
+
+    uint32_t pow10;
+    int n = largestPow10(integral, pow10);
+
+    while (n > 0) {
+        buffer[length++] = (char)('0' + integral / pow10);
+        integral %= pow10;
+        n--;
+
+        uint64_t rest = ((uint64_t)integral << -one.e) + fractional;
+        if (rest <= delta) {
+            decimal_exponent += n;
+            roundDigits(buffer, length, distance, delta, rest, (uint64_t)pow10 << -one.e);
+            return;
+        }
+
+        pow10 /= 10;
+    }
+
+    int m = 0;
+    while (true) {
+        fractional *= 10;
+        buffer[length++] = (char)('0' + (fractional >> -one.e));
+        fractional &= one.f - 1;
+        m++;
+
+        delta *= 10;
+        distance *= 10;
+        if (fractional <= delta) {
+            break;
+        }
+    }
+
+    decimal_exponent -= m;
+    roundDigits(buffer, length, distance, delta, fractional, one.f);
+}
+
+/* Writes the exponent with a sign and at least 2 digits */
+static char* writeExponent(char* buffer, int e) {
+    if (e < 0) {
+        e = -e;
+        *buffer++ = '-';
+    }
+    else {
+        *buffer++ = '+';
+    }
+
+    if (e >= 100) {
+        *buffer++ = (char)('0' + e / 100);
+        e %= 100;
+    }
+
+    *buffer++ = (char)('0' + e / 10);
+    *buffer++ = (char)('0' + e % 10);
+    return buffer;
+}
+
+/* Lays out the digits `buffer * 10^decimal_exponent` positionally if the decimal point is close
+ * enough to them, or with an exponent like `1.5e+300` otherwise */
+static char* layoutDigits(char* buffer, int length, int decimal_exponent, int max_exp) {
+    int n = length + decimal_exponent;
+
+    /* digits000.0 */
+    if (length <= n && n <= max_exp) {
+        std::memset(buffer + length, '0', n - length);
+        buffer[n] = '.';
+        buffer[n + 1] = '0';
+        return buffer + n + 2;
+    }
+
+    /* dig.its */
+    if (0 < n && n <= max_exp) {
+        std::memmove(buffer + n + 1, buffer + n, length - n);
+        buffer[n] = '.';
+        return buffer + length + 1;
+    }
+
+    /* 0.000digits */
+    if (-4 < n && n <= 0) {
+        std::memmove(buffer + 2 - n, buffer, length);
+        buffer[0] = '0';
+        buffer[1] = '.';
+        std::memset(buffer + 2, '0', -n);
+        return buffer + 2 - n + length;
+    }
+
+    /* d.igitse+123 */
+    if (length > 1) {
+        std::memmove(buffer + 2, buffer + 1, length - 1);
+        buffer[1] = '.';
+        buffer += length + 1;
+    }
+    else {
+        buffer += 1;
+    }
+
+    *buffer++ = 'e';
+    return writeExponent(buffer, n - 1);
+}
+
+template <typename T, typename Bits>
+static char* formatFloating(char* buffer, T value) {
+    if (std::isnan(value)) {
+        std::memcpy(buffer, "nan", 3);
+        return buffer + 3;
+    }
+
+    if (std::signbit(value)) {
+        value = -value;
+        *buffer++ = '-';
+    }
+
+    if (std::isinf(value)) {
+        std::memcpy(buffer, "inf", 3);
+        return buffer + 3;
+    }
+
+    if (value == 0) {
+        std::memcpy(buffer, "0.0", 3);
+        return buffer + 3;
+    }
+
+    FloatBoundaries boundaries = computeBoundaries<T, Bits>(value);
+    const CachedPower& cached = cachedPower(boundaries.plus.e);
+    DiyFp c_minus_k = {cached.f, cached.e};
+
+    DiyFp w = multiply(boundaries.w, c_minus_k);
+    DiyFp minus = multiply(boundaries.minus, c_minus_k);
+    DiyFp plus = multiply(boundaries.plus, c_minus_k);
+
+    /* Shrinks the interval by 1 ulp on both ends to account for the rounding errors above */
+    minus.f++;
+    plus.f--;
+
+    int length = 0;
+    int decimal_exponent = -cached.k;
+    generateDigits(buffer, length, decimal_exponent, minus, w, plus);
+
+    return layoutDigits(buffer, length, decimal_exponent, std::numeric_limits<T>::digits10 + 1);
+}
+
+char* kh::formatFloat(char* buffer, double n) {
+    return formatFloating<double, uint64_t>(buffer, n);
+}
+
+char* kh::formatFloat(char* buffer, float n) {
+    return formatFloating<float, uint32_t>(buffer, n);
+}
@@ -0,0 +1,183 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <cmath>
+#include <cstring>
+
+#include <kithare/json.hpp>
+
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static inline bool needsEscape(unsigned char chr) {
+    return chr < 0x20 || chr == '"' || chr == '\\';
+}
+
+static void writeEscape(kh::Sink& sink, char32_t chr) {
+    switch (chr) {
+        case '"':
+            sink.write("\\\"", 2);
+            break;
+        case '\\':
+            sink.write("\\\\", 2);
+            break;
+        case '\n':
+            sink.write("\\n", 2);
+            break;
+        case '\r':
+            sink.write("\\r", 2);
+            break;
+        case '\t':
+            sink.write("\\t", 2);
+            break;
+        default: {
+            char escape[6] = {'\\', 'u', '0', '0', hex_digits[(chr >> 4) & 0xF],
+                              hex_digits[chr & 0xF]};
+            sink.write(escape, sizeof(escape));
+        }
+    }
+}
+
+kh::JsonWriter::JsonWriter(kh::Sink& _sink) : sink(_sink) {}
+
+void kh::JsonWriter::separate() {
+    if (!this->first) {
+        this->sink.write(',');
+    }
+    this->first = false;
+}
+
+void kh::JsonWriter::beginObject() {
+    this->separate();
+    this->sink.write('{');
+    this->first = true;
+}
+
+void kh::JsonWriter::endObject() {
+    this->sink.write('}');
+    this->first = false;
+}
+
+void kh::JsonWriter::beginArray() {
+    this->separate();
+    this->sink.write('[');
+    this->first = true;
+}
+
+void kh::JsonWriter::endArray() {
+    this->sink.write(']');
+    this->first = false;
+}
+
+void kh::JsonWriter::key(const char* name) {
+    this->separate();
+    this->string(name, std::strlen(name));
+    this->sink.write(':');
+    this->first = true;
+}
+
+void kh::JsonWriter::value(bool boolean) {
+    this->separate();
+    this->sink.write(boolean ? "true" : "false");
+}
+
+void kh::JsonWriter::value(int64_t n) {
+    this->separate();
+    this->sink.writeInt(n);
+}
+
+void kh::JsonWriter::value(uint64_t n) {
+    this->separate();
+    this->sink.writeUint(n);
+}
+
+void kh::JsonWriter::value(double n) {
+    /* JSON has no representation of infinity and NaN */
+    if (!std::isfinite(n)) {
+        this->null();
+        return;
+    }
+
+    this->separate();
+    this->sink.writeFloat(n);
+}
+
+void kh::JsonWriter::value(const char* str) {
+    this->separate();
+    this->string(str, std::strlen(str));
+}
+
+void kh::JsonWriter::value(const std::string& str) {
+    this->separate();
+    this->string(str.data(), str.size());
+}
+
+void kh::JsonWriter::value(const std::u32string& str) {
+    this->separate();
+    this->sink.write('"');
+
+    for (char32_t chr : str) {
+        if (chr < 0x80 && needsEscape((unsigned char)chr)) {
+            writeEscape(this->sink, chr);
+        }
+        /* Surrogates and anything past the Unicode range can't be encoded */
+        else if ((0xD800 <= chr && chr <= 0xDFFF) || chr > 0x10FFFF) {
+            this->sink.write("\\ufffd", 6);
+        }
+        else {
+            this->sink.writeUtf8(chr);
+        }
+    }
+
+    this->sink.write('"');
+}
+
+void kh::JsonWriter::null() {
+    this->separate();
+    this->sink.write("null", 4);
+}
+
+void kh::JsonWriter::buffer(const std::string& buffer) {
+    this->separate();
+    this->sink.write('"');
+
+    for (char byte : buffer) {
+        unsigned char chr = (unsigned char)byte;
+        if (needsEscape(chr)) {
+            writeEscape(this->sink, chr);
+        }
+        else {
+            this->sink.writeUtf8(chr);
+        }
+    }
+
+    this->sink.write('"');
+}
+
+void kh::JsonWriter::names(const std::vector<std::string>& names) {
+    this->beginArray();
+    for (const std::string& name : names) {
+        this->value(name);
+    }
+    this->endArray();
+}
+
+void kh::JsonWriter::string(const char* str, size_t size) {
+    this->sink.write('"');
+
+    /* Writes the runs of characters which don't need escaping at once */
+    size_t run = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (needsEscape((unsigned char)str[i])) {
+            this->sink.write(str + run, i - run);
+            writeEscape(this->sink, (unsigned char)str[i]);
+            run = i + 1;
+        }
+    }
+
+    this->sink.write(str + run, size - run);
+    this->sink.write('"');
+}
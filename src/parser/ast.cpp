@@ -7,6 +7,51 @@
 #include <kithare/ast.hpp>
 
 
+/* Children of the nodes being destroyed on this thread which are waiting to be destroyed */
+static thread_local std::vector<std::shared_ptr<kh::AstBody>>* released = nullptr;
+
+/* Destroying a node used to destroy its children recursively, which overflowed the stack for deeply
+ * nested ASTs. Destructors instead move the children they solely own onto the `released` stack, and
+ * the outermost destructor on the thread destroys them one at a time */
+class AstTeardown {
+public:
+    AstTeardown() {
+        if (released == nullptr) {
+            released = &this->stack;
+            this->is_outermost = true;
+        }
+    }
+
+    ~AstTeardown() {
+        if (this->is_outermost) {
+            while (!this->stack.empty()) {
+                std::shared_ptr<kh::AstBody> node = std::move(this->stack.back());
+                this->stack.pop_back();
+            }
+
+            released = nullptr;
+        }
+    }
+
+    template <typename T>
+    void release(std::shared_ptr<T>& child) {
+        if (child.use_count() == 1) {
+            released->push_back(std::move(child));
+        }
+    }
+
+    template <typename T>
+    void release(std::vector<T>& children) {
+        for (T& child : children) {
+            this->release(child);
+        }
+    }
+
+private:
+    std::vector<std::shared_ptr<kh::AstBody>> stack;
+    bool is_outermost = false;
+};
+
 kh::AstModule::AstModule(const std::vector<kh::AstImport>& _imports,
                          const std::vector<kh::AstFunction>& _functions,
                          const std::vector<kh::AstUserType>& _user_types,
@@ -55,6 +100,11 @@ kh::AstDeclaration::AstDeclaration(size_t _index, const kh::AstIdentifiers& _var
     this->expression_type = kh::AstExpression::DECLARE;
 }
 
+kh::AstDeclaration::~AstDeclaration() {
+    AstTeardown teardown;
+    teardown.release(this->expression);
+}
+
 kh::AstFunction::AstFunction(size_t _index, const std::vector<std::string>& _identifiers,
                              const std::vector<std::string>& _generic_args,
                              const std::vector<uint64_t>& _id_array,
@@ -71,6 +121,11 @@ kh::AstFunction::AstFunction(size_t _index, const std::vector<std::string>& _ide
     this->expression_type = kh::AstExpression::FUNCTION;
 }
 
+kh::AstFunction::~AstFunction() {
+    AstTeardown teardown;
+    teardown.release(this->body);
+}
+
 kh::AstUnaryOperation::AstUnaryOperation(size_t _index, kh::Operator _operation,
                                          std::shared_ptr<kh::AstExpression>& _rvalue)
     : operation(_operation), rvalue(_rvalue) {
@@ -79,6 +134,11 @@ kh::AstUnaryOperation::AstUnaryOperation(size_t _index, kh::Operator _operation,
     this->expression_type = kh::AstExpression::UNARY;
 }
 
+kh::AstUnaryOperation::~AstUnaryOperation() {
+    AstTeardown teardown;
+    teardown.release(this->rvalue);
+}
+
 kh::AstRevUnaryOperation::AstRevUnaryOperation(size_t _index, kh::Operator _operation,
                                                std::shared_ptr<kh::AstExpression>& _rvalue)
     : operation(_operation), rvalue(_rvalue) {
@@ -87,6 +147,11 @@ kh::AstRevUnaryOperation::AstRevUnaryOperation(size_t _index, kh::Operator _oper
     this->expression_type = kh::AstExpression::REV_UNARY;
 }
 
+kh::AstRevUnaryOperation::~AstRevUnaryOperation() {
+    AstTeardown teardown;
+    teardown.release(this->rvalue);
+}
+
 kh::AstBinaryOperation::AstBinaryOperation(size_t _index, kh::Operator _operation,
                                            std::shared_ptr<kh::AstExpression>& _lvalue,
                                            std::shared_ptr<kh::AstExpression>& _rvalue)
@@ -96,6 +161,12 @@ kh::AstBinaryOperation::AstBinaryOperation(size_t _index, kh::Operator _operatio
     this->expression_type = kh::AstExpression::BINARY;
 }
 
+kh::AstBinaryOperation::~AstBinaryOperation() {
+    AstTeardown teardown;
+    teardown.release(this->lvalue);
+    teardown.release(this->rvalue);
+}
+
 kh::AstTernaryOperation::AstTernaryOperation(size_t _index,
                                              std::shared_ptr<kh::AstExpression>& _condition,
                                              std::shared_ptr<kh::AstExpression>& _value,
@@ -106,6 +177,13 @@ kh::AstTernaryOperation::AstTernaryOperation(size_t _index,
     this->expression_type = kh::AstExpression::TERNARY;
 }
 
+kh::AstTernaryOperation::~AstTernaryOperation() {
+    AstTeardown teardown;
+    teardown.release(this->condition);
+    teardown.release(this->value);
+    teardown.release(this->otherwise);
+}
+
 kh::AstComparisonExpression::AstComparisonExpression(
     size_t _index, const std::vector<kh::Operator>& _operations,
     const std::vector<std::shared_ptr<kh::AstExpression>>& _values)
@@ -115,6 +193,11 @@ kh::AstComparisonExpression::AstComparisonExpression(
     this->expression_type = kh::AstExpression::COMPARISON;
 }
 
+kh::AstComparisonExpression::~AstComparisonExpression() {
+    AstTeardown teardown;
+    teardown.release(this->values);
+}
+
 kh::AstSubscriptExpression::AstSubscriptExpression(
     size_t _index, std::shared_ptr<kh::AstExpression>& _expression,
     const std::vector<std::shared_ptr<kh::AstExpression>>& _arguments)
@@ -124,6 +207,12 @@ kh::AstSubscriptExpression::AstSubscriptExpression(
     this->expression_type = kh::AstExpression::SUBSCRIPT;
 }
 
+kh::AstSubscriptExpression::~AstSubscriptExpression() {
+    AstTeardown teardown;
+    teardown.release(this->expression);
+    teardown.release(this->arguments);
+}
+
 kh::AstCallExpression::AstCallExpression(
     size_t _index, std::shared_ptr<kh::AstExpression>& _expression,
     const std::vector<std::shared_ptr<kh::AstExpression>>& _arguments)
@@ -133,6 +222,12 @@ kh::AstCallExpression::AstCallExpression(
     this->expression_type = kh::AstExpression::CALL;
 }
 
+kh::AstCallExpression::~AstCallExpression() {
+    AstTeardown teardown;
+    teardown.release(this->expression);
+    teardown.release(this->arguments);
+}
+
 kh::AstScoping::AstScoping(size_t _index, std::shared_ptr<kh::AstExpression>& _expression,
                            const std::vector<std::string>& _identifiers)
     : expression(_expression), identifiers(_identifiers) {
@@ -141,6 +236,11 @@ kh::AstScoping::AstScoping(size_t _index, std::shared_ptr<kh::AstExpression>& _e
     this->expression_type = kh::AstExpression::SCOPE;
 }
 
+kh::AstScoping::~AstScoping() {
+    AstTeardown teardown;
+    teardown.release(this->expression);
+}
+
 kh::AstValue::AstValue(size_t _index, char32_t _character, kh::AstValue::ValueType _value_type)
     : value_type((ValueType)((size_t)_value_type)) {
     this->index = _index;
@@ -197,6 +297,11 @@ kh::AstTuple::AstTuple(size_t _index, const std::vector<std::shared_ptr<kh::AstE
     this->expression_type = kh::AstExpression::TUPLE;
 }
 
+kh::AstTuple::~AstTuple() {
+    AstTeardown teardown;
+    teardown.release(this->elements);
+}
+
 kh::AstList::AstList(size_t _index, const std::vector<std::shared_ptr<kh::AstExpression>>& _elements)
     : elements(_elements) {
     this->index = _index;
@@ -204,6 +309,11 @@ kh::AstList::AstList(size_t _index, const std::vector<std::shared_ptr<kh::AstExp
     this->expression_type = kh::AstExpression::LIST;
 }
 
+kh::AstList::~AstList() {
+    AstTeardown teardown;
+    teardown.release(this->elements);
+}
+
 kh::AstDict::AstDict(size_t _index, const std::vector<std::shared_ptr<kh::AstExpression>>& _keys,
                      const std::vector<std::shared_ptr<kh::AstExpression>>& _items)
     : keys(_keys), items(_items) {
@@ -212,6 +322,12 @@ kh::AstDict::AstDict(size_t _index, const std::vector<std::shared_ptr<kh::AstExp
     this->expression_type = kh::AstExpression::DICT;
 }
 
+kh::AstDict::~AstDict() {
+    AstTeardown teardown;
+    teardown.release(this->keys);
+    teardown.release(this->items);
+}
+
 kh::AstIf::AstIf(size_t _index, const std::vector<std::shared_ptr<kh::AstExpression>>& _conditions,
                  const std::vector<std::vector<std::shared_ptr<kh::AstBody>>>& _bodies,
                  const std::vector<std::shared_ptr<kh::AstBody>>& _else_body)
@@ -220,6 +336,13 @@ kh::AstIf::AstIf(size_t _index, const std::vector<std::shared_ptr<kh::AstExpress
     this->type = kh::AstBody::IF;
 }
 
+kh::AstIf::~AstIf() {
+    AstTeardown teardown;
+    teardown.release(this->conditions);
+    teardown.release(this->bodies);
+    teardown.release(this->else_body);
+}
+
 kh::AstWhile::AstWhile(size_t _index, std::shared_ptr<kh::AstExpression>& _condition,
                        const std::vector<std::shared_ptr<kh::AstBody>>& _body)
     : condition(_condition), body(_body) {
@@ -227,6 +350,12 @@ kh::AstWhile::AstWhile(size_t _index, std::shared_ptr<kh::AstExpression>& _condi
     this->type = kh::AstBody::WHILE;
 }
 
+kh::AstWhile::~AstWhile() {
+    AstTeardown teardown;
+    teardown.release(this->condition);
+    teardown.release(this->body);
+}
+
 kh::AstDoWhile::AstDoWhile(size_t _index, std::shared_ptr<kh::AstExpression>& _condition,
                            const std::vector<std::shared_ptr<kh::AstBody>>& _body)
     : condition(_condition), body(_body) {
@@ -234,6 +363,12 @@ kh::AstDoWhile::AstDoWhile(size_t _index, std::shared_ptr<kh::AstExpression>& _c
     this->type = kh::AstBody::DO_WHILE;
 }
 
+kh::AstDoWhile::~AstDoWhile() {
+    AstTeardown teardown;
+    teardown.release(this->condition);
+    teardown.release(this->body);
+}
+
 kh::AstFor::AstFor(size_t _index, std::shared_ptr<kh::AstExpression>& _initialize,
                    std::shared_ptr<kh::AstExpression>& _condition,
                    std::shared_ptr<kh::AstExpression>& _step,
@@ -243,6 +378,14 @@ kh::AstFor::AstFor(size_t _index, std::shared_ptr<kh::AstExpression>& _initializ
     this->type = kh::AstBody::FOR;
 }
 
+kh::AstFor::~AstFor() {
+    AstTeardown teardown;
+    teardown.release(this->initialize);
+    teardown.release(this->condition);
+    teardown.release(this->step);
+    teardown.release(this->body);
+}
+
 kh::AstForEach::AstForEach(size_t _index, std::shared_ptr<kh::AstExpression>& _target,
                            std::shared_ptr<kh::AstExpression>& _iterator,
                            const std::vector<std::shared_ptr<kh::AstBody>>& _body)
@@ -251,6 +394,13 @@ kh::AstForEach::AstForEach(size_t _index, std::shared_ptr<kh::AstExpression>& _t
     this->type = kh::AstBody::FOREACH;
 }
 
+kh::AstForEach::~AstForEach() {
+    AstTeardown teardown;
+    teardown.release(this->target);
+    teardown.release(this->iterator);
+    teardown.release(this->body);
+}
+
 kh::AstStatement::AstStatement(size_t _index, kh::AstStatement::Type _statement_type,
                                std::shared_ptr<kh::AstExpression>& _expression)
     : statement_type((Type)((size_t)_statement_type)), expression(_expression) {
@@ -264,3 +414,8 @@ kh::AstStatement::AstStatement(size_t _index, kh::AstStatement::Type _statement_
     this->index = _index;
     this->type = kh::AstBody::STATEMENT;
 }
+
+kh::AstStatement::~AstStatement() {
+    AstTeardown teardown;
+    teardown.release(this->expression);
+}
@@ -0,0 +1,476 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <kithare/ast.hpp>
+
+
+kh::AstJsonWriter::AstJsonWriter(kh::JsonWriter& _json) : json(_json) {}
+
+void kh::AstJsonWriter::begin(const char* kind, size_t index) {
+    this->json.beginObject();
+    this->json.member("kind", kind);
+    this->json.member("index", index);
+}
+
+void kh::AstJsonWriter::writeDimensions(const char* name, const std::vector<uint64_t>& dimensions) {
+    this->json.key(name);
+    this->json.beginArray();
+    for (uint64_t dimension : dimensions) {
+        this->json.value(dimension);
+    }
+    this->json.endArray();
+}
+
+void kh::AstJsonWriter::writeChild(const char* name,
+                                   const std::shared_ptr<kh::AstExpression>& child) {
+    this->json.key(name);
+    if (child) {
+        this->write(*child);
+    }
+    else {
+        this->json.null();
+    }
+}
+
+void kh::AstJsonWriter::writeChildren(
+    const char* name, const std::vector<std::shared_ptr<kh::AstExpression>>& children) {
+    this->json.key(name);
+    this->json.beginArray();
+    for (auto& child : children) {
+        if (child) {
+            this->write(*child);
+        }
+        else {
+            this->json.null();
+        }
+    }
+    this->json.endArray();
+}
+
+void kh::AstJsonWriter::writeBody(const char* name,
+                                  const std::vector<std::shared_ptr<kh::AstBody>>& body) {
+    if (name) {
+        this->json.key(name);
+    }
+
+    this->json.beginArray();
+    for (auto& part : body) {
+        if (part) {
+            this->write(*part);
+        }
+        else {
+            this->json.null();
+        }
+    }
+    this->json.endArray();
+}
+
+void kh::AstJsonWriter::write(const kh::AstModule& module_ast) {
+    this->json.beginObject();
+    this->json.member("kind", "module");
+
+    this->json.key("imports");
+    this->json.beginArray();
+    for (auto& import_ast : module_ast.imports) {
+        this->write(import_ast);
+    }
+    this->json.endArray();
+
+    this->json.key("functions");
+    this->json.beginArray();
+    for (auto& function : module_ast.functions) {
+        this->writeFunction(function);
+    }
+    this->json.endArray();
+
+    this->json.key("user_types");
+    this->json.beginArray();
+    for (auto& type_ast : module_ast.user_types) {
+        this->write(type_ast);
+    }
+    this->json.endArray();
+
+    this->json.key("enums");
+    this->json.beginArray();
+    for (auto& enum_ast : module_ast.enums) {
+        this->write(enum_ast);
+    }
+    this->json.endArray();
+
+    this->json.key("variables");
+    this->json.beginArray();
+    for (auto& variable : module_ast.variables) {
+        this->writeDeclaration(variable);
+    }
+    this->json.endArray();
+
+    this->json.endObject();
+}
+
+void kh::AstJsonWriter::write(const kh::AstImport& import_ast) {
+    this->begin(import_ast.is_include ? "include" : "import", import_ast.index);
+    this->json.member("is_relative", import_ast.is_relative);
+    this->json.member("is_public", import_ast.is_public);
+    this->json.key("path");
+    this->json.names(import_ast.path);
+
+    if (!import_ast.is_include) {
+        this->json.member("identifier", import_ast.identifier);
+    }
+
+    this->json.endObject();
+}
+
+void kh::AstJsonWriter::write(const kh::AstUserType& type_ast) {
+    this->begin(type_ast.is_class ? "class" : "struct", type_ast.index);
+    this->json.key("name");
+    this->json.names(type_ast.identifiers);
+    this->json.member("is_public", type_ast.is_public);
+
+    this->json.key("base");
+    if (type_ast.base) {
+        this->writeIdentifiers(*type_ast.base);
+    }
+    else {
+        this->json.null();
+    }
+
+    this->json.key("generic_args");
+    this->json.names(type_ast.generic_args);
+
+    this->json.key("members");
+    this->json.beginArray();
+    for (auto& member : type_ast.members) {
+        this->writeDeclaration(member);
+    }
+    this->json.endArray();
+
+    this->json.key("methods");
+    this->json.beginArray();
+    for (auto& method : type_ast.methods) {
+        this->writeFunction(method);
+    }
+    this->json.endArray();
+
+    this->json.endObject();
+}
+
+void kh::AstJsonWriter::write(const kh::AstEnumType& enum_ast) {
+    this->begin("enum", enum_ast.index);
+    this->json.key("name");
+    this->json.names(enum_ast.identifiers);
+    this->json.member("is_public", enum_ast.is_public);
+
+    this->json.key("members");
+    this->json.beginArray();
+    for (size_t member = 0; member < enum_ast.members.size(); member++) {
+        this->json.beginObject();
+        this->json.member("name", enum_ast.members[member]);
+        this->json.member("value", enum_ast.values[member]);
+        this->json.endObject();
+    }
+    this->json.endArray();
+
+    this->json.endObject();
+}
+
+void kh::AstJsonWriter::write(const kh::AstBody& body_ast) {
+    switch (body_ast.type) {
+        case kh::AstBody::EXPRESSION:
+            this->writeExpression((const kh::AstExpression&)body_ast);
+            return;
+
+        case kh::AstBody::IF: {
+            auto& if_ast = (const kh::AstIf&)body_ast;
+            this->begin("if", if_ast.index);
+            this->writeChildren("conditions", if_ast.conditions);
+
+            this->json.key("bodies");
+            this->json.beginArray();
+            for (auto& body : if_ast.bodies) {
+                this->writeBody(nullptr, body);
+            }
+            this->json.endArray();
+
+            this->writeBody("else_body", if_ast.else_body);
+        } break;
+
+        case kh::AstBody::WHILE: {
+            auto& while_ast = (const kh::AstWhile&)body_ast;
+            this->begin("while", while_ast.index);
+            this->writeChild("condition", while_ast.condition);
+            this->writeBody("body", while_ast.body);
+        } break;
+
+        case kh::AstBody::DO_WHILE: {
+            auto& do_while_ast = (const kh::AstDoWhile&)body_ast;
+            this->begin("do_while", do_while_ast.index);
+            this->writeChild("condition", do_while_ast.condition);
+            this->writeBody("body", do_while_ast.body);
+        } break;
+
+        case kh::AstBody::FOR: {
+            auto& for_ast = (const kh::AstFor&)body_ast;
+            this->begin("for", for_ast.index);
+            this->writeChild("initializer", for_ast.initialize);
+            this->writeChild("condition", for_ast.condition);
+            this->writeChild("step", for_ast.step);
+            this->writeBody("body", for_ast.body);
+        } break;
+
+        case kh::AstBody::FOREACH: {
+            auto& foreach_ast = (const kh::AstForEach&)body_ast;
+            this->begin("foreach", foreach_ast.index);
+            this->writeChild("target", foreach_ast.target);
+            this->writeChild("iterator", foreach_ast.iterator);
+            this->writeBody("body", foreach_ast.body);
+        } break;
+
+        case kh::AstBody::STATEMENT: {
+            auto& statement_ast = (const kh::AstStatement&)body_ast;
+            this->begin("statement", statement_ast.index);
+
+            switch (statement_ast.statement_type) {
+                case kh::AstStatement::Type::CONTINUE:
+                    this->json.member("statement", "continue");
+                    this->json.member("loop_count", statement_ast.loop_count);
+                    break;
+                case kh::AstStatement::Type::BREAK:
+                    this->json.member("statement", "break");
+                    this->json.member("loop_count", statement_ast.loop_count);
+                    break;
+                case kh::AstStatement::Type::RETURN:
+                    this->json.member("statement", "return");
+                    this->writeChild("expression", statement_ast.expression);
+                    break;
+            }
+        } break;
+
+        default:
+            this->begin("unknown", body_ast.index);
+    }
+
+    this->json.endObject();
+}
+
+void kh::AstJsonWriter::writeExpression(const kh::AstExpression& expr_ast) {
+    switch (expr_ast.expression_type) {
+        case kh::AstExpression::IDENTIFIER:
+            this->writeIdentifiers((const kh::AstIdentifiers&)expr_ast);
+            return;
+
+        case kh::AstExpression::DECLARE:
+            this->writeDeclaration((const kh::AstDeclaration&)expr_ast);
+            return;
+
+        case kh::AstExpression::FUNCTION:
+            this->writeFunction((const kh::AstFunction&)expr_ast);
+            return;
+
+        case kh::AstExpression::CONSTANT:
+            this->writeValue((const kh::AstValue&)expr_ast);
+            return;
+
+        case kh::AstExpression::UNARY: {
+            auto& unary_ast = (const kh::AstUnaryOperation&)expr_ast;
+            this->begin("unary", unary_ast.index);
+            this->json.member("operator", kh::cstr(unary_ast.operation));
+            this->writeChild("rvalue", unary_ast.rvalue);
+        } break;
+
+        case kh::AstExpression::REV_UNARY: {
+            auto& unary_ast = (const kh::AstRevUnaryOperation&)expr_ast;
+            this->begin("reverse_unary", unary_ast.index);
+            this->json.member("operator", kh::cstr(unary_ast.operation));
+            this->writeChild("rvalue", unary_ast.rvalue);
+        } break;
+
+        case kh::AstExpression::BINARY: {
+            auto& binary_ast = (const kh::AstBinaryOperation&)expr_ast;
+            this->begin("binary", binary_ast.index);
+            this->json.member("operator", kh::cstr(binary_ast.operation));
+            this->writeChild("lvalue", binary_ast.lvalue);
+            this->writeChild("rvalue", binary_ast.rvalue);
+        } break;
+
+        case kh::AstExpression::TERNARY: {
+            auto& ternary_ast = (const kh::AstTernaryOperation&)expr_ast;
+            this->begin("ternary", ternary_ast.index);
+            this->writeChild("condition", ternary_ast.condition);
+            this->writeChild("value", ternary_ast.value);
+            this->writeChild("otherwise", ternary_ast.otherwise);
+        } break;
+
+        case kh::AstExpression::COMPARISON: {
+            auto& comparison_ast = (const kh::AstComparisonExpression&)expr_ast;
+            this->begin("comparison", comparison_ast.index);
+
+            this->json.key("operators");
+            this->json.beginArray();
+            for (kh::Operator operation : comparison_ast.operations) {
+                this->json.value(kh::cstr(operation));
+            }
+            this->json.endArray();
+
+            this->writeChildren("values", comparison_ast.values);
+        } break;
+
+        case kh::AstExpression::SUBSCRIPT: {
+            auto& subscript_ast = (const kh::AstSubscriptExpression&)expr_ast;
+            this->begin("subscript", subscript_ast.index);
+            this->writeChild("expression", subscript_ast.expression);
+            this->writeChildren("arguments", subscript_ast.arguments);
+        } break;
+
+        case kh::AstExpression::CALL: {
+            auto& call_ast = (const kh::AstCallExpression&)expr_ast;
+            this->begin("call", call_ast.index);
+            this->writeChild("expression", call_ast.expression);
+            this->writeChildren("arguments", call_ast.arguments);
+        } break;
+
+        case kh::AstExpression::SCOPE: {
+            auto& scoping_ast = (const kh::AstScoping&)expr_ast;
+            this->begin("scoping", scoping_ast.index);
+            this->writeChild("expression", scoping_ast.expression);
+            this->json.key("identifiers");
+            this->json.names(scoping_ast.identifiers);
+        } break;
+
+        case kh::AstExpression::TUPLE: {
+            auto& tuple_ast = (const kh::AstTuple&)expr_ast;
+            this->begin("tuple", tuple_ast.index);
+            this->writeChildren("elements", tuple_ast.elements);
+        } break;
+
+        case kh::AstExpression::LIST: {
+            auto& list_ast = (const kh::AstList&)expr_ast;
+            this->begin("list", list_ast.index);
+            this->writeChildren("elements", list_ast.elements);
+        } break;
+
+        case kh::AstExpression::DICT: {
+            auto& dict_ast = (const kh::AstDict&)expr_ast;
+            this->begin("dict", dict_ast.index);
+            this->writeChildren("keys", dict_ast.keys);
+            this->writeChildren("items", dict_ast.items);
+        } break;
+
+        default:
+            this->begin("unknown", expr_ast.index);
+    }
+
+    this->json.endObject();
+}
+
+void kh::AstJsonWriter::writeIdentifiers(const kh::AstIdentifiers& identifiers_ast) {
+    this->begin("identifiers", identifiers_ast.index);
+    this->json.key("identifiers");
+    this->json.names(identifiers_ast.identifiers);
+
+    this->json.key("generics");
+    this->json.beginArray();
+    for (size_t i = 0; i < identifiers_ast.generics.size(); i++) {
+        this->json.beginObject();
+        this->json.key("type");
+        this->writeIdentifiers(identifiers_ast.generics[i]);
+        this->json.member("refs", identifiers_ast.generics_refs[i]);
+        this->writeDimensions("array", identifiers_ast.generics_array[i]);
+        this->json.endObject();
+    }
+    this->json.endArray();
+
+    this->json.endObject();
+}
+
+void kh::AstJsonWriter::writeDeclaration(const kh::AstDeclaration& declaration_ast) {
+    this->begin("declare", declaration_ast.index);
+    this->json.member("is_public", declaration_ast.is_public);
+    this->json.member("is_static", declaration_ast.is_static);
+    this->json.key("type");
+    this->writeIdentifiers(declaration_ast.var_type);
+    this->json.member("refs", declaration_ast.refs);
+    this->writeDimensions("array", declaration_ast.var_array);
+    this->json.member("name", declaration_ast.var_name);
+    this->writeChild("expression", declaration_ast.expression);
+    this->json.endObject();
+}
+
+void kh::AstJsonWriter::writeFunction(const kh::AstFunction& function_ast) {
+    this->begin("function", function_ast.index);
+    this->json.member("is_public", function_ast.is_public);
+    this->json.member("is_static", function_ast.is_static);
+    this->json.member("is_conditional", function_ast.is_conditional);
+
+    /* Lambdas have no name */
+    this->json.key("name");
+    this->json.names(function_ast.identifiers);
+    this->json.key("generic_args");
+    this->json.names(function_ast.generic_args);
+    this->writeDimensions("array", function_ast.id_array);
+
+    this->json.key("return_type");
+    this->writeIdentifiers(function_ast.return_type);
+    this->json.member("return_refs", function_ast.return_refs);
+    this->writeDimensions("return_array", function_ast.return_array);
+
+    this->json.key("arguments");
+    this->json.beginArray();
+    for (auto& argument : function_ast.arguments) {
+        this->writeDeclaration(argument);
+    }
+    this->json.endArray();
+
+    this->writeBody("body", function_ast.getBody());
+    this->json.endObject();
+}
+
+void kh::AstJsonWriter::writeValue(const kh::AstValue& value_ast) {
+    this->begin("value", value_ast.index);
+
+    switch (value_ast.value_type) {
+        case kh::AstValue::ValueType::CHARACTER:
+            this->json.member("type", "character");
+            this->json.member("value", std::u32string(1, value_ast.character));
+            break;
+
+        case kh::AstValue::ValueType::UINTEGER:
+            this->json.member("type", "uinteger");
+            this->json.member("value", value_ast.uinteger);
+            break;
+
+        case kh::AstValue::ValueType::INTEGER:
+            this->json.member("type", "integer");
+            this->json.member("value", value_ast.integer);
+            break;
+
+        case kh::AstValue::ValueType::FLOATING:
+            this->json.member("type", "floating");
+            this->json.member("value", value_ast.floating);
+            break;
+
+        case kh::AstValue::ValueType::IMAGINARY:
+            this->json.member("type", "imaginary");
+            this->json.member("value", value_ast.imaginary);
+            break;
+
+        case kh::AstValue::ValueType::BUFFER:
+            this->json.member("type", "buffer");
+            this->json.key("value");
+            this->json.buffer(value_ast.buffer);
+            break;
+
+        case kh::AstValue::ValueType::STRING:
+            this->json.member("type", "string");
+            this->json.member("value", value_ast.string);
+            break;
+
+        default:
+            this->json.member("type", "unknown");
+    }
+
+    this->json.endObject();
+}
@@ -8,642 +8,619 @@
 #include <kithare/utf8.hpp>
 
 
-#define REPR_ALL_IN(var)   \
-    for (auto& _var : var) \
-    str += U"\n\t" + ind + kh::str(_var, indent + 1)
-
-#define BODY_HEADER()                   \
-    std::u32string ind;                 \
-    ind.reserve(indent);                \
-    for (size_t i = 0; i < indent; i++) \
-        ind += '\t';                    \
-                                        \
-    std::u32string str;
+/* Dumps an AST into a string with `kh::AstWriter` */
+#define KH_AST_STR(ast, indent)                \
+    std::string str;                           \
+    {                                          \
+        kh::Sink sink(str);                    \
+        kh::AstWriter(sink).write(ast, indent); \
+    }                                          \
+    return kh::decodeUtf8(str);
 
 
 std::u32string kh::str(const kh::AstModule& module_ast, size_t indent) {
-    std::u32string ind;
-    ind.reserve(indent);
-    for (size_t i = 0; i < indent; i++) {
-        ind += '\t';
-    }
+    KH_AST_STR(module_ast, indent);
+}
 
-    std::u32string str = U"ast:";
+std::u32string kh::str(const kh::AstImport& import_ast, size_t indent) {
+    KH_AST_STR(import_ast, indent);
+}
 
-    REPR_ALL_IN(module_ast.imports);
-    REPR_ALL_IN(module_ast.functions);
-    REPR_ALL_IN(module_ast.user_types);
-    REPR_ALL_IN(module_ast.enums);
-    REPR_ALL_IN(module_ast.variables);
-    return str;
+std::u32string kh::str(const kh::AstUserType& type_ast, size_t indent) {
+    KH_AST_STR(type_ast, indent);
 }
 
-std::u32string kh::str(const kh::AstImport& import_ast, size_t indent) {
-    std::u32string ind;
-    ind.reserve(indent);
-    for (size_t i = 0; i < indent; i++) {
-        ind += '\t';
-    }
+std::u32string kh::str(const kh::AstEnumType& enum_ast, size_t indent) {
+    KH_AST_STR(enum_ast, indent);
+}
 
-    std::u32string str = import_ast.is_include ? U"include:" : U"import:";
-    str += U"\n\t" + ind + U"type: " + (import_ast.is_relative ? U"relative" : U"absolute");
-    str += U"\n\t" + ind + U"access: " + (import_ast.is_public ? U"public" : U"private");
+std::u32string kh::str(const kh::AstBody& body_ast, size_t indent) {
+    KH_AST_STR(body_ast, indent);
+}
 
-    str += U"\n\t" + ind + U"path: ";
-    for (const std::string& dir : import_ast.path) {
-        str += kh::decodeUtf8(dir) + (&dir == &import_ast.path.back() ? U"" : U".");
-    }
+std::u32string kh::AstBody::str(size_t indent) const {
+    KH_AST_STR(*this, indent);
+}
 
-    if (!import_ast.is_include) {
-        str += U"\n\t" + ind + U"identifier: " + kh::decodeUtf8(import_ast.identifier);
+kh::AstWriter::AstWriter(kh::Sink& _sink) : sink(_sink) {}
+
+void kh::AstWriter::line(size_t indent) {
+    while (this->tabs.size() < indent + 1) {
+        this->tabs += this->tabs.empty() ? '\n' : '\t';
     }
 
-    return str;
+    this->sink.write(this->tabs.data(), indent + 1);
 }
 
-std::u32string kh::str(const kh::AstUserType& type_ast, size_t indent) {
-    std::u32string ind;
-    ind.reserve(indent);
-    for (size_t i = 0; i < indent; i++) {
-        ind += '\t';
+void kh::AstWriter::writeNames(const std::vector<std::string>& names, const char* separator) {
+    for (const std::string& name : names) {
+        this->sink.write(name);
+        if (&name != &names.back()) {
+            this->sink.write(separator);
+        }
     }
+}
 
-    std::u32string str = (type_ast.is_class ? U"class:\n\t" : U"struct:\n\t") + ind + U"name: ";
-    for (const std::string& identifier : type_ast.identifiers) {
-        str += kh::decodeUtf8(identifier) + (&identifier == &type_ast.identifiers.back() ? U"" : U".");
+void kh::AstWriter::writeType(const kh::AstIdentifiers& type, size_t refs,
+                              const std::vector<uint64_t>& array, size_t indent) {
+    for (size_t i = 0; i < refs; i++) {
+        this->sink.write("ref ");
     }
 
-    str += U"\n\t" + ind + U"access: " + (type_ast.is_public ? U"public" : U"private");
+    this->writeIdentifiers(type, indent);
 
-    if (type_ast.base) {
-        str += U"\n\t" + ind + U"base " + (type_ast.is_class ? U"class:" : U"struct:");
-        str += U"\n\t\t" + ind + kh::str(*type_ast.base, indent + 3);
+    for (uint64_t dimension : array) {
+        this->sink.write('[');
+        this->sink.writeUint(dimension);
+        this->sink.write(']');
     }
+}
 
-    if (!type_ast.generic_args.empty()) {
-        str += U"\n\t" + ind + U"generic argument(s): ";
-        for (const std::string& generic_ : type_ast.generic_args) {
-            str +=
-                kh::decodeUtf8(generic_) + (&generic_ == &type_ast.generic_args.back() ? U"" : U", ");
-        }
+void kh::AstWriter::writeChild(const char* label, const std::shared_ptr<kh::AstExpression>& child,
+                               size_t indent) {
+    if (child) {
+        this->line(indent + 1);
+        this->sink.write(label);
+        this->line(indent + 2);
+        this->write(*child, indent + 2);
     }
+}
 
-    if (!type_ast.members.empty()) {
-        str += U"\n\t" + ind + U"member(s):";
-        for (auto& member : type_ast.members) {
-            str += U"\n\t\t" + ind + kh::str(member, indent + 2);
-        }
-    }
+void kh::AstWriter::writeBody(const char* label, const std::vector<std::shared_ptr<kh::AstBody>>& body,
+                              size_t indent) {
+    if (!body.empty()) {
+        this->line(indent + 1);
+        this->sink.write(label);
 
-    if (!type_ast.methods.empty()) {
-        str += U"\n\t" + ind + U"method(s):";
-        for (auto& method : type_ast.methods) {
-            str += U"\n\t\t" + ind + kh::str(method, indent + 2);
+        for (auto& part : body) {
+            if (part) {
+                this->line(indent + 2);
+                this->write(*part, indent + 2);
+            }
         }
     }
-
-    return str;
 }
 
-std::u32string kh::str(const kh::AstEnumType& enum_ast, size_t indent) {
-    std::u32string ind;
-    ind.reserve(indent);
-    for (size_t i = 0; i < indent; i++) {
-        ind += '\t';
+void kh::AstWriter::write(const kh::AstModule& module_ast, size_t indent) {
+    this->sink.write("ast:");
+
+    for (auto& import_ast : module_ast.imports) {
+        this->line(indent + 1);
+        this->write(import_ast, indent + 1);
     }
 
-    std::u32string str = U"enum:\n\t" + ind + U"name: ";
-    for (const std::string& identifier : enum_ast.identifiers) {
-        str += kh::decodeUtf8(identifier) + (&identifier == &enum_ast.identifiers.back() ? U"" : U".");
+    for (auto& function : module_ast.functions) {
+        this->line(indent + 1);
+        this->write(function, indent + 1);
     }
 
-    str += U"\n\t" + ind + U"access: " + (enum_ast.is_public ? U"public" : U"private");
+    for (auto& type_ast : module_ast.user_types) {
+        this->line(indent + 1);
+        this->write(type_ast, indent + 1);
+    }
 
-    str += U"\n\t" + ind + U"member(s):";
-    for (size_t member = 0; member < enum_ast.members.size(); member++) {
-        str += U"\n\t\t" + ind + kh::decodeUtf8(enum_ast.members[member]) + U": " +
-               kh::str(enum_ast.values[member]);
+    for (auto& enum_ast : module_ast.enums) {
+        this->line(indent + 1);
+        this->write(enum_ast, indent + 1);
     }
 
-    return str;
+    for (auto& variable : module_ast.variables) {
+        this->line(indent + 1);
+        this->write(variable, indent + 1);
+    }
 }
 
-std::u32string kh::str(const kh::AstBody& body_ast, size_t indent) {
-    return body_ast.str(indent);
-}
+void kh::AstWriter::write(const kh::AstImport& import_ast, size_t indent) {
+    this->sink.write(import_ast.is_include ? "include:" : "import:");
 
-std::u32string kh::AstBody::str(size_t indent) const {
-    return U"[unknown body]";
-}
+    this->line(indent + 1);
+    this->sink.write(import_ast.is_relative ? "type: relative" : "type: absolute");
 
-std::u32string kh::AstExpression::str(size_t indent) const {
-    return U"[unknown expression]";
-}
+    this->line(indent + 1);
+    this->sink.write(import_ast.is_public ? "access: public" : "access: private");
 
-std::u32string kh::AstIdentifiers::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"identifier(s): ";
+    this->line(indent + 1);
+    this->sink.write("path: ");
+    this->writeNames(import_ast.path, ".");
 
-    for (const std::string& identifier : this->identifiers) {
-        str += kh::decodeUtf8(identifier) + (&identifier == &this->identifiers.back() ? U"" : U".");
+    if (!import_ast.is_include) {
+        this->line(indent + 1);
+        this->sink.write("identifier: ");
+        this->sink.write(import_ast.identifier);
     }
+}
 
-    bool is_function = this->identifiers.size() == 1 && this->identifiers[0] == "func";
-
-    if (!this->generics.empty()) {
-        str += U"!(";
-        for (size_t i = 0; i < this->generics.size(); i++) {
-            for (size_t refs = 0; refs < this->generics_refs[i]; refs++) {
-                str += U"ref ";
-            }
+void kh::AstWriter::write(const kh::AstUserType& type_ast, size_t indent) {
+    this->sink.write(type_ast.is_class ? "class:" : "struct:");
 
-            str += kh::str(this->generics[i], indent);
+    this->line(indent + 1);
+    this->sink.write("name: ");
+    this->writeNames(type_ast.identifiers, ".");
 
-            for (size_t d = 0; d < this->generics_array[i].size(); d++) {
-                str += U"[" + kh::str(this->generics_array[i][d]) + U"]";
-            }
+    this->line(indent + 1);
+    this->sink.write(type_ast.is_public ? "access: public" : "access: private");
 
-            if (is_function && i == 0) {
-                str += U"(";
-            }
-            else if (i != this->generics.size() - 1) {
-                str += U", ";
-            }
-        }
-        str += is_function ? U"))" : U")";
+    if (type_ast.base) {
+        this->line(indent + 1);
+        this->sink.write(type_ast.is_class ? "base class:" : "base struct:");
+        this->line(indent + 2);
+        this->writeIdentifiers(*type_ast.base, indent + 3);
     }
 
-    return str;
-}
-
-std::u32string kh::AstUnaryOperation::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"unary expression:";
-
-    str += U"\n\t" + ind + U"operator: " + kh::str(this->operation);
+    if (!type_ast.generic_args.empty()) {
+        this->line(indent + 1);
+        this->sink.write("generic argument(s): ");
+        this->writeNames(type_ast.generic_args, ", ");
+    }
 
-    if (this->rvalue) {
-        str += U"\n\t" + ind + U"rvalue:\n\t\t" + ind + kh::str(*this->rvalue, indent + 2);
+    if (!type_ast.members.empty()) {
+        this->line(indent + 1);
+        this->sink.write("member(s):");
+        for (auto& member : type_ast.members) {
+            this->line(indent + 2);
+            this->writeDeclaration(member, indent + 2);
+        }
     }
 
-    return str;
+    if (!type_ast.methods.empty()) {
+        this->line(indent + 1);
+        this->sink.write("method(s):");
+        for (auto& method : type_ast.methods) {
+            this->line(indent + 2);
+            this->writeFunction(method, indent + 2);
+        }
+    }
 }
 
-std::u32string kh::AstRevUnaryOperation::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"reverse unary expression:";
+void kh::AstWriter::write(const kh::AstEnumType& enum_ast, size_t indent) {
+    this->sink.write("enum:");
 
-    str += U"\n\t" + ind + U"operator: " + kh::str(this->operation);
+    this->line(indent + 1);
+    this->sink.write("name: ");
+    this->writeNames(enum_ast.identifiers, ".");
 
-    if (this->rvalue) {
-        str += U"\n\t" + ind + U"rvalue:\n\t\t" + ind + kh::str(*this->rvalue, indent + 2);
-    }
+    this->line(indent + 1);
+    this->sink.write(enum_ast.is_public ? "access: public" : "access: private");
 
-    return str;
+    this->line(indent + 1);
+    this->sink.write("member(s):");
+    for (size_t member = 0; member < enum_ast.members.size(); member++) {
+        this->line(indent + 2);
+        this->sink.write(enum_ast.members[member]);
+        this->sink.write(": ");
+        this->sink.writeUint(enum_ast.values[member]);
+    }
 }
 
-std::u32string kh::AstBinaryOperation::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"binary expression:";
+void kh::AstWriter::write(const kh::AstBody& body_ast, size_t indent) {
+    switch (body_ast.type) {
+        case kh::AstBody::EXPRESSION:
+            this->writeExpression((const kh::AstExpression&)body_ast, indent);
+            break;
 
-    str += U"\n\t" + ind + U"operator: " + kh::str(this->operation);
+        case kh::AstBody::IF:
+            this->writeIf((const kh::AstIf&)body_ast, indent);
+            break;
 
-    if (this->lvalue) {
-        str += U"\n\t" + ind + U"lvalue:\n\t\t" + ind + kh::str(*this->lvalue, indent + 2);
-    }
+        case kh::AstBody::WHILE: {
+            auto& while_ast = (const kh::AstWhile&)body_ast;
+            this->sink.write("while:");
+            this->writeChild("condition:", while_ast.condition, indent);
+            this->writeBody("body:", while_ast.body, indent);
+        } break;
+
+        case kh::AstBody::DO_WHILE: {
+            auto& do_while_ast = (const kh::AstDoWhile&)body_ast;
+            this->sink.write("do while:");
+            this->writeChild("condition:", do_while_ast.condition, indent);
+            this->writeBody("body:", do_while_ast.body, indent);
+        } break;
+
+        case kh::AstBody::FOR: {
+            auto& for_ast = (const kh::AstFor&)body_ast;
+            this->sink.write("for:");
+            this->writeChild("initializer:", for_ast.initialize, indent);
+            this->writeChild("condition:", for_ast.condition, indent);
+            this->writeChild("step:", for_ast.step, indent);
+            this->writeBody("body:", for_ast.body, indent);
+        } break;
+
+        case kh::AstBody::FOREACH: {
+            auto& foreach_ast = (const kh::AstForEach&)body_ast;
+            this->sink.write("foreach:");
+            this->writeChild("target:", foreach_ast.target, indent);
+            this->writeChild("iterator:", foreach_ast.iterator, indent);
+            this->writeBody("body:", foreach_ast.body, indent);
+        } break;
+
+        case kh::AstBody::STATEMENT:
+            this->writeStatement((const kh::AstStatement&)body_ast, indent);
+            break;
 
-    if (this->rvalue) {
-        str += U"\n\t" + ind + U"rvalue:\n\t\t" + ind + kh::str(*this->rvalue, indent + 2);
+        default:
+            this->sink.write("[unknown body]");
     }
-
-    return str;
 }
 
-std::u32string kh::AstTernaryOperation::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"ternary expression:";
-
-    if (this->condition) {
-        str += U"\n\t" + ind + U"condition:\n\t\t" + ind + kh::str(*this->condition, indent + 2);
-    }
-
-    if (this->value) {
-        str += U"\n\t" + ind + U"value:\n\t\t" + ind + kh::str(*this->value, indent + 2);
-    }
+void kh::AstWriter::writeExpression(const kh::AstExpression& expr_ast, size_t indent) {
+    switch (expr_ast.expression_type) {
+        case kh::AstExpression::IDENTIFIER:
+            this->writeIdentifiers((const kh::AstIdentifiers&)expr_ast, indent);
+            break;
 
-    if (this->otherwise) {
-        str += U"\n\t" + ind + U"otherwise:\n\t\t" + ind + kh::str(*this->otherwise, indent + 2);
-    }
+        case kh::AstExpression::DECLARE:
+            this->writeDeclaration((const kh::AstDeclaration&)expr_ast, indent);
+            break;
 
-    return str;
-}
+        case kh::AstExpression::FUNCTION:
+            this->writeFunction((const kh::AstFunction&)expr_ast, indent);
+            break;
 
-std::u32string kh::AstComparisonExpression::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"comparison expression:\n\t" + ind + U"operation(s): ";
+        case kh::AstExpression::UNARY: {
+            auto& unary_ast = (const kh::AstUnaryOperation&)expr_ast;
+            this->sink.write("unary expression:");
+            this->line(indent + 1);
+            this->sink.write("operator: ");
+            this->sink.write(kh::cstr(unary_ast.operation));
+            this->writeChild("rvalue:", unary_ast.rvalue, indent);
+        } break;
+
+        case kh::AstExpression::REV_UNARY: {
+            auto& unary_ast = (const kh::AstRevUnaryOperation&)expr_ast;
+            this->sink.write("reverse unary expression:");
+            this->line(indent + 1);
+            this->sink.write("operator: ");
+            this->sink.write(kh::cstr(unary_ast.operation));
+            this->writeChild("rvalue:", unary_ast.rvalue, indent);
+        } break;
+
+        case kh::AstExpression::BINARY: {
+            auto& binary_ast = (const kh::AstBinaryOperation&)expr_ast;
+            this->sink.write("binary expression:");
+            this->line(indent + 1);
+            this->sink.write("operator: ");
+            this->sink.write(kh::cstr(binary_ast.operation));
+            this->writeChild("lvalue:", binary_ast.lvalue, indent);
+            this->writeChild("rvalue:", binary_ast.rvalue, indent);
+        } break;
+
+        case kh::AstExpression::TERNARY: {
+            auto& ternary_ast = (const kh::AstTernaryOperation&)expr_ast;
+            this->sink.write("ternary expression:");
+            this->writeChild("condition:", ternary_ast.condition, indent);
+            this->writeChild("value:", ternary_ast.value, indent);
+            this->writeChild("otherwise:", ternary_ast.otherwise, indent);
+        } break;
+
+        case kh::AstExpression::COMPARISON:
+            this->writeComparison((const kh::AstComparisonExpression&)expr_ast, indent);
+            break;
 
-    for (kh::Operator operation : this->operations) {
-        str += kh::str(operation) + (&operation == &this->operations.back() ? U"" : U",");
-    }
+        case kh::AstExpression::SUBSCRIPT: {
+            auto& subscript_ast = (const kh::AstSubscriptExpression&)expr_ast;
+            this->sink.write("subscript:");
+            this->writeChild("expression:", subscript_ast.expression, indent);
+            this->writeElements("argument(s):", subscript_ast.arguments, indent + 1);
+        } break;
+
+        case kh::AstExpression::CALL: {
+            auto& call_ast = (const kh::AstCallExpression&)expr_ast;
+            this->sink.write("call:");
+            this->writeChild("expression:", call_ast.expression, indent);
+            this->writeElements("argument(s):", call_ast.arguments, indent + 1);
+        } break;
+
+        case kh::AstExpression::SCOPE:
+            this->writeScoping((const kh::AstScoping&)expr_ast, indent);
+            break;
 
-    str += U"\n\t" + ind + U"value(s):";
-    for (auto& value : this->values) {
-        if (value) {
-            str += U"\n\t\t" + ind + kh::str(*value);
-        }
-    }
+        case kh::AstExpression::CONSTANT:
+            this->writeValue((const kh::AstValue&)expr_ast);
+            break;
 
-    return str;
-}
+        case kh::AstExpression::TUPLE: {
+            auto& tuple_ast = (const kh::AstTuple&)expr_ast;
+            this->sink.write(tuple_ast.elements.empty() ? "tuple: [no elements]" : "tuple:");
+            this->writeElements(nullptr, tuple_ast.elements, indent);
+        } break;
 
-std::u32string kh::AstSubscriptExpression::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"subscript:";
+        case kh::AstExpression::LIST: {
+            auto& list_ast = (const kh::AstList&)expr_ast;
+            this->sink.write(list_ast.elements.empty() ? "list: [no elements]" : "list:");
+            this->writeElements(nullptr, list_ast.elements, indent);
+        } break;
 
-    if (this->expression) {
-        str += U"\n\t" + ind + U"expression:\n\t\t" + ind + kh::str(*this->expression, indent + 2);
-    }
+        case kh::AstExpression::DICT:
+            this->writeDict((const kh::AstDict&)expr_ast, indent);
+            break;
 
-    if (!this->arguments.empty()) {
-        str += U"\n\t" + ind + U"argument(s):";
-        for (auto& argument : this->arguments) {
-            if (argument) {
-                str += U"\n\t\t" + ind + kh::str(*argument, indent + 2);
-            }
-        }
+        default:
+            this->sink.write("[unknown expression]");
     }
-
-    return str;
 }
 
-std::u32string kh::AstCallExpression::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"call:";
+void kh::AstWriter::writeIdentifiers(const kh::AstIdentifiers& identifiers_ast, size_t indent) {
+    this->sink.write("identifier(s): ");
+    this->writeNames(identifiers_ast.identifiers, ".");
 
-    if (this->expression) {
-        str += U"\n\t" + ind + U"expression:\n\t\t" + ind + kh::str(*this->expression, indent + 2);
-    }
+    bool is_function =
+        identifiers_ast.identifiers.size() == 1 && identifiers_ast.identifiers[0] == "func";
+
+    if (!identifiers_ast.generics.empty()) {
+        this->sink.write("!(");
+        for (size_t i = 0; i < identifiers_ast.generics.size(); i++) {
+            this->writeType(identifiers_ast.generics[i], identifiers_ast.generics_refs[i],
+                            identifiers_ast.generics_array[i], indent);
 
-    if (!this->arguments.empty()) {
-        str += U"\n\t" + ind + U"argument(s):";
-        for (auto& argument : this->arguments) {
-            if (argument) {
-                str += U"\n\t\t" + ind + kh::str(*argument, indent + 2);
+            if (is_function && i == 0) {
+                this->sink.write('(');
+            }
+            else if (i != identifiers_ast.generics.size() - 1) {
+                this->sink.write(", ");
             }
         }
+        this->sink.write(is_function ? "))" : ")");
     }
-
-    return str;
 }
 
-std::u32string kh::AstDeclaration::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"declare:";
+void kh::AstWriter::writeDeclaration(const kh::AstDeclaration& declaration_ast, size_t indent) {
+    this->sink.write("declare:");
 
-    str += U"\n\t" + ind + U"access: " + (this->is_static ? U"static " : U"") +
-           (this->is_public ? U"public" : U"private");
+    this->line(indent + 1);
+    this->sink.write("access: ");
+    this->sink.write(declaration_ast.is_static ? "static " : "");
+    this->sink.write(declaration_ast.is_public ? "public" : "private");
 
-    str += U"\n\t" + ind + U"type: ";
-    for (size_t refs = 0; refs < this->refs; refs++) {
-        str += U"ref ";
-    }
-    str += kh::str(this->var_type, indent + 1);
-
-    for (uint64_t dimension : this->var_array) {
-        str += U'[' + kh::str(dimension) + U']';
-    }
+    this->line(indent + 1);
+    this->sink.write("type: ");
+    this->writeType(declaration_ast.var_type, declaration_ast.refs, declaration_ast.var_array,
+                    indent + 1);
 
-    str += U"\n\t" + ind + U"name: " + kh::decodeUtf8(this->var_name);
+    this->line(indent + 1);
+    this->sink.write("name: ");
+    this->sink.write(declaration_ast.var_name);
 
-    if (this->expression)
-        str += U"\n\t" + ind + U"initializer expression:\n\t\t" + ind +
-               kh::str(*this->expression, indent + 2);
-
-    return str;
+    this->writeChild("initializer expression:", declaration_ast.expression, indent);
 }
 
-std::u32string kh::AstFunction::str(size_t indent) const {
-    BODY_HEADER();
-    str = this->is_conditional ? U"conditional function:" : U"function:";
+void kh::AstWriter::writeFunction(const kh::AstFunction& function_ast, size_t indent) {
+    this->sink.write(function_ast.is_conditional ? "conditional function:" : "function:");
 
-    str += U"\n\t" + ind + U"access: " + (this->is_static ? U"static " : U"") +
-           (this->is_public ? U"public" : U"private");
+    this->line(indent + 1);
+    this->sink.write("access: ");
+    this->sink.write(function_ast.is_static ? "static " : "");
+    this->sink.write(function_ast.is_public ? "public" : "private");
 
-    if (this->identifiers.empty()) {
-        str += U"\n\t" + ind + U"name: (lambda)";
+    this->line(indent + 1);
+    if (function_ast.identifiers.empty()) {
+        this->sink.write("name: (lambda)");
     }
     else {
-        str += U"\n\t" + ind + U"name: ";
-        for (const std::string& identifier : this->identifiers) {
-            str += kh::decodeUtf8(identifier) + (&identifier == &this->identifiers.back() ? U"" : U".");
-        }
+        this->sink.write("name: ");
+        this->writeNames(function_ast.identifiers, ".");
 
-        if (!this->generic_args.empty()) {
-            str += U"\n\t" + ind + U"generic argument(s): ";
-            for (const std::string& generic_ : this->generic_args) {
-                str +=
-                    kh::decodeUtf8(generic_) + (&generic_ == &this->generic_args.back() ? U"" : U", ");
-            }
+        if (!function_ast.generic_args.empty()) {
+            this->line(indent + 1);
+            this->sink.write("generic argument(s): ");
+            this->writeNames(function_ast.generic_args, ", ");
         }
 
-        if (!this->id_array.empty()) {
-            str += U"\n\t" + ind + U"array type dimension: ";
-            for (uint64_t size : this->id_array) {
-                str += U'[' + kh::str(size) + U']';
+        if (!function_ast.id_array.empty()) {
+            this->line(indent + 1);
+            this->sink.write("array type dimension: ");
+            for (uint64_t size : function_ast.id_array) {
+                this->sink.write('[');
+                this->sink.writeUint(size);
+                this->sink.write(']');
             }
         }
     }
 
-    str += U"\n\t" + ind + U"return type: ";
+    this->line(indent + 1);
+    this->sink.write("return type: ");
+    this->writeType(function_ast.return_type, function_ast.return_refs, function_ast.return_array,
+                    indent + 1);
 
-    for (size_t refs = 0; refs < this->return_refs; refs++) {
-        str += U"ref ";
+    this->line(indent + 1);
+    this->sink.write(function_ast.arguments.empty() ? "argument(s): [none]" : "argument(s):");
+    for (auto& argument : function_ast.arguments) {
+        this->line(indent + 2);
+        this->writeDeclaration(argument, indent + 2);
     }
-    str += kh::str(this->return_type, indent + 1);
 
-    for (uint64_t dimension : this->return_array) {
-        str += U'[' + kh::str(dimension) + U']';
+    this->line(indent + 1);
+    this->sink.write("body:");
+    for (auto& part : function_ast.getBody()) {
+        if (part) {
+            this->line(indent + 2);
+            this->write(*part, indent + 2);
+        }
     }
+}
 
-    str += U"\n\t" + ind + U"argument(s):";
-    if (this->arguments.empty()) {
-        str += U" [none]";
-    }
-    for (auto& arg : this->arguments) {
-        str += U"\n\t\t" + ind + kh::str(arg, indent + 2);
+void kh::AstWriter::writeComparison(const kh::AstComparisonExpression& comparison_ast,
+                                    size_t indent) {
+    this->sink.write("comparison expression:");
+
+    this->line(indent + 1);
+    this->sink.write("operation(s): ");
+    for (kh::Operator operation : comparison_ast.operations) {
+        this->sink.write(kh::cstr(operation));
+        this->sink.write(',');
     }
 
-    str += U"\n\t" + ind + U"body:";
-    for (auto& part : this->body) {
-        if (part) {
-            str += U"\n\t\t" + ind + kh::str(*part, indent + 2);
+    /* The values have always been written without indentation */
+    this->line(indent + 1);
+    this->sink.write("value(s):");
+    for (auto& value : comparison_ast.values) {
+        if (value) {
+            this->line(indent + 2);
+            this->write(*value, 0);
         }
     }
-
-    return str;
 }
 
-std::u32string kh::AstScoping::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"scoping (";
+void kh::AstWriter::writeScoping(const kh::AstScoping& scoping_ast, size_t indent) {
+    this->sink.write("scoping (");
 
-    if (!this->identifiers.empty()) {
-        for (const std::string& identifier : this->identifiers) {
-            str += (&this->identifiers.back() == &identifier ? U"" : U".") + kh::decodeUtf8(identifier);
+    for (const std::string& identifier : scoping_ast.identifiers) {
+        if (&identifier != &scoping_ast.identifiers.back()) {
+            this->sink.write('.');
         }
+        this->sink.write(identifier);
     }
 
-    str += U"):"; /* sad face */
+    this->sink.write("):"); /* sad face */
 
-    if (this->expression) {
-        str += U"\n\t" + ind + kh::str(*this->expression, indent + 1);
+    if (scoping_ast.expression) {
+        this->line(indent + 1);
+        this->write(*scoping_ast.expression, indent + 1);
     }
-
-    return str;
 }
 
-std::u32string kh::AstValue::str(size_t indent) const {
-    BODY_HEADER();
-
-    switch (this->value_type) {
+void kh::AstWriter::writeValue(const kh::AstValue& value_ast) {
+    switch (value_ast.value_type) {
         case kh::AstValue::ValueType::CHARACTER:
-            str = U"character: " + kh::str(this->character);
+            this->sink.write("character: ");
+            this->sink.writeUtf8(value_ast.character);
             break;
 
         case kh::AstValue::ValueType::UINTEGER:
-            str = U"unsigned integer: " + kh::str(this->uinteger);
+            this->sink.write("unsigned integer: ");
+            this->sink.writeUint(value_ast.uinteger);
             break;
 
         case kh::AstValue::ValueType::INTEGER:
-            str = U"integer: " + kh::str(this->integer);
+            this->sink.write("integer: ");
+            this->sink.writeInt(value_ast.integer);
             break;
 
         case kh::AstValue::ValueType::FLOATING:
-            str = U"floating: " + kh::str(this->floating);
+            this->sink.write("floating: ");
+            this->sink.writeFloat(value_ast.floating);
             break;
 
         case kh::AstValue::ValueType::IMAGINARY:
-            str = U"imaginary: " + kh::str(this->imaginary) + U"i";
+            this->sink.write("imaginary: ");
+            this->sink.writeFloat(value_ast.imaginary);
+            this->sink.write('i');
             break;
 
         case kh::AstValue::ValueType::BUFFER:
-            str = U"buffer: " + kh::quote(this->buffer);
+            this->sink.write("buffer: ");
+            this->sink.write(kh::quote(value_ast.buffer));
             break;
 
         case kh::AstValue::ValueType::STRING:
-            str = U"string: " + kh::quote(this->string);
+            this->sink.write("string: ");
+            this->sink.write(kh::quote(value_ast.string));
             break;
 
         default:
-            str = U"[unknown constant]";
+            this->sink.write("[unknown constant]");
     }
-
-    return str;
 }
 
-std::u32string kh::AstTuple::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"tuple:";
-
-    if (this->elements.empty()) {
-        str += U" [no elements]";
-    }
-    else {
-        for (auto& element : this->elements) {
-            if (element) {
-                str += U"\n\t" + ind + kh::str(*element, indent + 1);
-            }
-        }
+void kh::AstWriter::writeElements(const char* header,
+                                  const std::vector<std::shared_ptr<kh::AstExpression>>& elements,
+                                  size_t indent) {
+    if (elements.empty()) {
+        return;
     }
 
-    return str;
-}
-
-std::u32string kh::AstList::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"list:";
-
-    if (this->elements.empty()) {
-        str += U" [no elements]";
-    }
-    else {
-        for (auto& element : this->elements) {
-            if (element) {
-                str += U"\n\t" + ind + kh::str(*element, indent + 1);
-            }
-        }
+    /* Elements with a header are indented one more level */
+    if (header) {
+        this->line(indent);
+        this->sink.write(header);
     }
 
-    return str;
-}
-
-std::u32string kh::AstDict::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"dict:";
-
-    if (this->keys.empty()) {
-        str += U" [no pairs]";
-    }
-    else {
-        for (size_t i = 0; i < this->keys.size(); i++) {
-            str += U"\n\t" + ind + U"pair:";
-            if (this->keys[i]) {
-                str += U"\n\t\t" + ind + kh::str(*this->keys[i], indent + 2);
-            }
-            if (this->items[i]) {
-                str += U"\n\t\t" + ind + kh::str(*this->items[i], indent + 2);
-            }
+    for (auto& element : elements) {
+        if (element) {
+            this->line(indent + 1);
+            this->write(*element, indent + 1);
         }
     }
-
-    return str;
 }
 
-std::u32string kh::AstIf::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"if:";
+void kh::AstWriter::writeDict(const kh::AstDict& dict_ast, size_t indent) {
+    this->sink.write(dict_ast.keys.empty() ? "dict: [no pairs]" : "dict:");
 
-    for (size_t clause = 0; clause < this->conditions.size(); clause++) {
-        str += U"\n\t" + ind + U"if clause:";
+    for (size_t i = 0; i < dict_ast.keys.size(); i++) {
+        this->line(indent + 1);
+        this->sink.write("pair:");
 
-        if (this->conditions[clause])
-            str += U"\n\t\t" + ind + U"condition:\n\t\t\t" + ind +
-                   kh::str(*this->conditions[clause], indent + 3);
-
-        if (!this->bodies[clause].empty()) {
-            str += U"\n\t\t" + ind + U"body:";
-            for (auto& part : this->bodies[clause])
-                if (part) {
-                    str += U"\n\t\t\t" + ind + kh::str(*part, indent + 3);
-                }
+        if (dict_ast.keys[i]) {
+            this->line(indent + 2);
+            this->write(*dict_ast.keys[i], indent + 2);
         }
-    }
-
-    if (!this->else_body.empty()) {
-        str += U"\n\t" + ind + U"else body:";
-        for (auto& part : this->else_body)
-            if (part) {
-                str += U"\n\t\t" + ind + kh::str(*part, indent + 2);
-            }
-    }
-
-    return str;
-}
-
-std::u32string kh::AstWhile::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"while:";
-
-    if (this->condition) {
-        str += U"\n\t" + ind + U"condition:\n\t\t" + ind + kh::str(*this->condition, indent + 2);
-    }
-
-    if (!this->body.empty()) {
-        str += U"\n\t" + ind + U"body:";
-        for (auto& part : this->body)
-            if (part) {
-                str += U"\n\t\t" + ind + kh::str(*part, indent + 2);
-            }
-    }
-
-    return str;
-}
-
-std::u32string kh::AstDoWhile::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"do while:";
-
-    if (this->condition) {
-        str += U"\n\t" + ind + U"condition:\n\t\t" + ind + kh::str(*this->condition, indent + 2);
-    }
 
-    if (!this->body.empty()) {
-        str += U"\n\t" + ind + U"body:";
-        for (auto& part : this->body)
-            if (part) {
-                str += U"\n\t\t" + ind + kh::str(*part, indent + 2);
-            }
-    }
-
-    return str;
-}
-
-std::u32string kh::AstFor::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"for:";
-
-    if (this->initialize) {
-        str += U"\n\t" + ind + U"initializer:\n\t\t" + ind + kh::str(*this->initialize, indent + 2);
-    }
-
-    if (this->condition) {
-        str += U"\n\t" + ind + U"condition:\n\t\t" + ind + kh::str(*this->condition, indent + 2);
-    }
-
-    if (this->step) {
-        str += U"\n\t" + ind + U"step:\n\t\t" + ind + kh::str(*this->step, indent + 2);
-    }
-
-    if (!this->body.empty()) {
-        str += U"\n\t" + ind + U"body:";
-        for (auto& part : this->body)
-            if (part) {
-                str += U"\n\t\t" + ind + kh::str(*part, indent + 2);
-            }
+        if (dict_ast.items[i]) {
+            this->line(indent + 2);
+            this->write(*dict_ast.items[i], indent + 2);
+        }
     }
-
-    return str;
 }
 
-std::u32string kh::AstForEach::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"foreach:";
+void kh::AstWriter::writeIf(const kh::AstIf& if_ast, size_t indent) {
+    this->sink.write("if:");
 
-    if (this->target) {
-        str += U"\n\t" + ind + U"target:\n\t\t" + ind + kh::str(*this->target, indent + 2);
-    }
-
-    if (this->iterator) {
-        str += U"\n\t" + ind + U"iterator:\n\t\t" + ind + kh::str(*this->iterator, indent + 2);
-    }
+    for (size_t clause = 0; clause < if_ast.conditions.size(); clause++) {
+        this->line(indent + 1);
+        this->sink.write("if clause:");
 
-    if (!this->body.empty()) {
-        str += U"\n\t" + ind + U"body:";
-        for (auto& part : this->body)
-            if (part) {
-                str += U"\n\t\t" + ind + kh::str(*part, indent + 2);
-            }
+        this->writeChild("condition:", if_ast.conditions[clause], indent + 1);
+        this->writeBody("body:", if_ast.bodies[clause], indent + 1);
     }
 
-    return str;
+    this->writeBody("else body:", if_ast.else_body, indent);
 }
 
-std::u32string kh::AstStatement::str(size_t indent) const {
-    BODY_HEADER();
-    str = U"statement: ";
+void kh::AstWriter::writeStatement(const kh::AstStatement& statement_ast, size_t indent) {
+    this->sink.write("statement: ");
 
-    switch (this->statement_type) {
+    switch (statement_ast.statement_type) {
         case kh::AstStatement::Type::CONTINUE:
-            str += U"continue";
+            this->sink.write("continue");
             break;
         case kh::AstStatement::Type::BREAK:
-            str += U"break";
+            this->sink.write("break");
             break;
         case kh::AstStatement::Type::RETURN:
-            str += U"return";
+            this->sink.write("return");
             break;
         default:
-            str += U"unknown";
+            this->sink.write("unknown");
             break;
     }
 
-    if (this->statement_type == kh::AstStatement::Type::RETURN) {
-        if (this->expression) {
-            str += U"\n\t" + ind + kh::str(*this->expression, indent + 1);
+    if (statement_ast.statement_type == kh::AstStatement::Type::RETURN) {
+        if (statement_ast.expression) {
+            this->line(indent + 1);
+            this->write(*statement_ast.expression, indent + 1);
         }
     }
     else {
-        str += U" " + kh::str((uint64_t)this->loop_count);
+        this->sink.write(' ');
+        this->sink.writeUint(statement_ast.loop_count);
     }
-    return str;
 }
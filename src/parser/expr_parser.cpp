@@ -8,36 +8,32 @@
 #include <kithare/utf8.hpp>
 
 
-#define RECURSIVE_DESCENT_SINGULAR_OP(lower)                                                       \
-    do {                                                                                           \
-        kh::AstExpression* expr = lower(context);                                                  \
-        kh::Token token;                                                                           \
-        size_t index;                                                                              \
-        KH_PARSE_GUARD();                                                                          \
-        token = context.tok();                                                                     \
-        index = token.index;                                                                       \
-        while (token.type == kh::TokenType::OPERATOR) {                                            \
-            bool has_op = false;                                                                   \
-            for (const kh::Operator op : operators) {                                              \
-                if (token.value.operator_type == op) {                                             \
-                    has_op = true;                                                                 \
-                    break;                                                                         \
-                }                                                                                  \
-            }                                                                                      \
-            if (!has_op)                                                                           \
-                break;                                                                             \
-            context.ti++;                                                                          \
-            KH_PARSE_GUARD();                                                                      \
-            std::shared_ptr<kh::AstExpression> lval(expr);                                         \
-            std::shared_ptr<kh::AstExpression> rval(lower(context));                               \
-            expr = new kh::AstBinaryOperation(token.index, token.value.operator_type, lval, rval); \
-            KH_PARSE_GUARD();                                                                      \
-            token = context.tok();                                                                 \
-        }                                                                                          \
-        KH_PARSE_GUARD();                                                                          \
-        token = context.tok();                                                                     \
-    end:                                                                                           \
-        return expr;                                                                               \
+#define RECURSIVE_DESCENT_SINGULAR_OP(lower)                                                         \
+    do {                                                                                             \
+        kh::AstExpression* expr = lower(context);                                                    \
+        const kh::Token* token;                                                                      \
+        KH_PARSE_GUARD();                                                                            \
+        token = &context.tok();                                                                      \
+        while (token->type == kh::TokenType::OPERATOR) {                                             \
+            bool has_op = false;                                                                     \
+            for (const kh::Operator op : operators) {                                                \
+                if (token->value.operator_type == op) {                                              \
+                    has_op = true;                                                                   \
+                    break;                                                                           \
+                }                                                                                    \
+            }                                                                                        \
+            if (!has_op)                                                                             \
+                break;                                                                               \
+            context.ti++;                                                                            \
+            KH_PARSE_GUARD();                                                                        \
+            std::shared_ptr<kh::AstExpression> lval(expr);                                           \
+            std::shared_ptr<kh::AstExpression> rval(lower(context));                                 \
+            expr = new kh::AstBinaryOperation(token->index, token->value.operator_type, lval, rval); \
+            KH_PARSE_GUARD();                                                                        \
+            token = &context.tok();                                                                  \
+        }                                                                                            \
+    end:                                                                                             \
+        return expr;                                                                                 \
     } while (false)
 
 
@@ -55,12 +51,16 @@ kh::AstExpression* kh::parseExpression(const std::vector<kh::Token>& tokens) {
 }
 
 kh::AstExpression* kh::parseExpression(KH_PARSE_CTX) {
-    kh::Token token = context.tok();
-    size_t index = token.index;
+    if (context.depth >= context.nesting_limit) {
+        kh::skipNesting(context, false);
+        return nullptr;
+    }
 
-    return kh::parseAssignOps(context);
-end:
-    return nullptr;
+    context.depth++;
+    kh::AstExpression* expr = kh::parseAssignOps(context);
+    context.depth--;
+
+    return expr;
 }
 
 kh::AstExpression* kh::parseAssignOps(KH_PARSE_CTX) {
@@ -72,26 +72,26 @@ kh::AstExpression* kh::parseAssignOps(KH_PARSE_CTX) {
 
 kh::AstExpression* kh::parseTernary(KH_PARSE_CTX) {
     kh::AstExpression* expr = kh::parseOr(context);
-    kh::Token token;
+    const kh::Token* token;
     size_t index;
 
     KH_PARSE_GUARD();
-    token = context.tok();
-    index = token.index;
+    token = &context.tok();
+    index = token->index;
 
-    while (token.type == kh::TokenType::IDENTIFIER && token.value.identifier == "if") {
-        index = token.index;
+    while (token->type == kh::TokenType::IDENTIFIER && token->value.identifier == "if") {
+        index = token->index;
 
         context.ti++;
         KH_PARSE_GUARD();
         std::shared_ptr<kh::AstExpression> condition(kh::parseOr(context));
 
         KH_PARSE_GUARD();
-        token = context.tok();
+        token = &context.tok();
 
-        if (!(token.type == kh::TokenType::IDENTIFIER && token.value.identifier == "else")) {
-            context.exceptions.emplace_back(
-                "expected an `else` to specify the else case of the ternary expression", token);
+        if (!(token->type == kh::TokenType::IDENTIFIER && token->value.identifier == "else")) {
+            context.error("expected an `else` to specify the else case of the ternary expression",
+                          *token);
             goto end;
         }
 
@@ -103,7 +103,7 @@ kh::AstExpression* kh::parseTernary(KH_PARSE_CTX) {
         expr = new kh::AstTernaryOperation(index, condition, value, otherwise);
 
         KH_PARSE_GUARD();
-        token = context.tok();
+        token = &context.tok();
     }
 end:
     return expr;
@@ -121,20 +121,24 @@ kh::AstExpression* kh::parseAnd(KH_PARSE_CTX) {
 
 kh::AstExpression* kh::parseNot(KH_PARSE_CTX) {
     kh::AstExpression* expr = nullptr;
-    kh::Token token = context.tok();
-    size_t index = token.index;
+    std::vector<size_t> indices;
+    const kh::Token* token = &context.tok();
 
-    if (token.type == kh::TokenType::OPERATOR && token.value.operator_type == kh::Operator::NOT) {
+    /* Collects the chain of `not`s first and applies them from the innermost, so it doesn't recurse */
+    while (token->type == kh::TokenType::OPERATOR && token->value.operator_type == kh::Operator::NOT) {
+        indices.push_back(token->index);
         context.ti++;
         KH_PARSE_GUARD();
-
-        std::shared_ptr<kh::AstExpression> rval(kh::parseNot(context));
-        expr = new kh::AstUnaryOperation(token.index, token.value.operator_type, rval);
-    }
-    else {
-        expr = kh::parseComparison(context);
+        token = &context.tok();
     }
+
+    expr = kh::parseComparison(context);
 end:
+    for (size_t i = indices.size(); i > 0; i--) {
+        std::shared_ptr<kh::AstExpression> rval(expr);
+        expr = new kh::AstUnaryOperation(indices[i - 1], kh::Operator::NOT, rval);
+    }
+
     return expr;
 }
 
@@ -145,36 +149,36 @@ kh::AstExpression* kh::parseComparison(KH_PARSE_CTX) {
     };
 
     expr = kh::parseBitwiseOr(context);
-    kh::Token token;
+    const kh::Token* token;
     size_t index;
 
     KH_PARSE_GUARD();
-    token = context.tok();
-    index = token.index;
-
-    if (token.type == kh::TokenType::OPERATOR &&
-        (token.value.operator_type == kh::Operator::EQUAL ||
-         token.value.operator_type == kh::Operator::NOT_EQUAL ||
-         token.value.operator_type == kh::Operator::LESS ||
-         token.value.operator_type == kh::Operator::LESS_EQUAL ||
-         token.value.operator_type == kh::Operator::MORE ||
-         token.value.operator_type == kh::Operator::MORE_EQUAL)) {
+    token = &context.tok();
+    index = token->index;
+
+    if (token->type == kh::TokenType::OPERATOR &&
+        (token->value.operator_type == kh::Operator::EQUAL ||
+         token->value.operator_type == kh::Operator::NOT_EQUAL ||
+         token->value.operator_type == kh::Operator::LESS ||
+         token->value.operator_type == kh::Operator::LESS_EQUAL ||
+         token->value.operator_type == kh::Operator::MORE ||
+         token->value.operator_type == kh::Operator::MORE_EQUAL)) {
         comparison_expr =
             new kh::AstComparisonExpression(index, {}, {std::shared_ptr<kh::AstExpression>(expr)});
 
-        while (token.type == kh::TokenType::OPERATOR &&
-               (token.value.operator_type == kh::Operator::EQUAL ||
-                token.value.operator_type == kh::Operator::NOT_EQUAL ||
-                token.value.operator_type == kh::Operator::LESS ||
-                token.value.operator_type == kh::Operator::LESS_EQUAL ||
-                token.value.operator_type == kh::Operator::MORE ||
-                token.value.operator_type == kh::Operator::MORE_EQUAL)) {
+        while (token->type == kh::TokenType::OPERATOR &&
+               (token->value.operator_type == kh::Operator::EQUAL ||
+                token->value.operator_type == kh::Operator::NOT_EQUAL ||
+                token->value.operator_type == kh::Operator::LESS ||
+                token->value.operator_type == kh::Operator::LESS_EQUAL ||
+                token->value.operator_type == kh::Operator::MORE ||
+                token->value.operator_type == kh::Operator::MORE_EQUAL)) {
             context.ti++;
             KH_PARSE_GUARD();
-            comparison_expr->operations.push_back(token.value.operator_type);
+            comparison_expr->operations.push_back(token->value.operator_type);
             comparison_expr->values.emplace_back(kh::parseBitwiseOr(context));
             KH_PARSE_GUARD();
-            token = context.tok();
+            token = &context.tok();
         }
     }
 
@@ -210,35 +214,41 @@ kh::AstExpression* kh::parseMulDivMod(KH_PARSE_CTX) {
 
 kh::AstExpression* kh::parseUnary(KH_PARSE_CTX) {
     kh::AstExpression* expr = nullptr;
-    kh::Token token = context.tok();
-    size_t index = token.index;
+    std::vector<std::pair<size_t, kh::Operator>> operations;
+    const kh::Token* token = &context.tok();
 
-    if (token.type == kh::TokenType::OPERATOR) {
-        switch (token.value.operator_type) {
+    /* Collects the chain of prefix operators first and applies them from the innermost, so it
+     * doesn't recurse */
+    while (token->type == kh::TokenType::OPERATOR) {
+        switch (token->value.operator_type) {
             case kh::Operator::ADD:
             case kh::Operator::SUB:
             case kh::Operator::INCREMENT:
             case kh::Operator::DECREMENT:
             case kh::Operator::BIT_NOT:
             case kh::Operator::SIZEOF:
-            case kh::Operator::ADDRESS: {
+            case kh::Operator::ADDRESS:
+                operations.emplace_back(token->index, token->value.operator_type);
                 context.ti++;
                 KH_PARSE_GUARD();
-
-                std::shared_ptr<kh::AstExpression> rval(kh::parseUnary(context));
-                expr = new kh::AstUnaryOperation(token.index, token.value.operator_type, rval);
-            } break;
+                token = &context.tok();
+                break;
 
             default:
                 context.ti++;
-                context.exceptions.emplace_back(
-                    "unexpected `" + kh::encodeUtf8(kh::str(token)) + "` in an expression", token);
+                context.error("unexpected `" + kh::encodeUtf8(kh::str(*token)) + "` in an expression",
+                              *token);
+                goto end;
         }
     }
-    else {
-        expr = kh::parseExponentiation(context);
-    }
+
+    expr = kh::parseExponentiation(context);
 end:
+    for (size_t i = operations.size(); i > 0; i--) {
+        std::shared_ptr<kh::AstExpression> rval(expr);
+        expr = new kh::AstUnaryOperation(operations[i - 1].first, operations[i - 1].second, rval);
+    }
+
     return expr;
 }
 
@@ -286,7 +296,7 @@ kh::AstExpression* kh::parseRevUnary(KH_PARSE_CTX) {
                             identifiers.push_back(token.value.identifier);
                         }
                         else {
-                            context.exceptions.emplace_back("expected an identifier", token);
+                            context.error("expected an identifier", token);
                         }
                         context.ti++;
                         KH_PARSE_GUARD();
@@ -420,8 +430,7 @@ kh::AstExpression* kh::parseOthers(KH_PARSE_CTX) {
                 kh::AstFunction lambda = kh::parseFunction(context, false);
 
                 if (!lambda.identifiers.empty()) {
-                    context.exceptions.emplace_back(
-                        "a non-lambda function cannot be defined in an expression", token);
+                    context.error("a non-lambda function cannot be defined in an expression", token);
                 }
 
                 return new kh::AstFunction(lambda);
@@ -451,16 +460,18 @@ kh::AstExpression* kh::parseOthers(KH_PARSE_CTX) {
                 else if (token.type == kh::TokenType::SYMBOL &&
                          token.value.symbol_type == kh::Symbol::SQUARE_OPEN) {
                     size_t exception_counts = context.exceptions.size();
+                    bool panicking = context.panicking;
+                    context.panicking = false;
 
                     kh::parseArrayDimension(context, *static_cast<kh::AstIdentifiers*>(expr));
                     delete expr;
+                    context.panicking = panicking;
 
                     /* If there was exceptions while parsing the array dimension type, it probably
                      * wasn't an array variable declaration.. rather a subscript or something */
                     if (context.exceptions.size() > exception_counts) {
-                        for (size_t i = 0; i < context.exceptions.size() - exception_counts; i++) {
-                            context.exceptions.pop_back();
-                        }
+                        context.exceptions.erase(context.exceptions.begin() + exception_counts,
+                                                 context.exceptions.end());
 
                         context.ti = _ti;
                         expr = new kh::AstIdentifiers(kh::parseIdentifiers(context));
@@ -504,16 +515,17 @@ kh::AstExpression* kh::parseOthers(KH_PARSE_CTX) {
                     break;
 
                 default:
-                    context.exceptions.emplace_back(
-                        "unexpected `" + kh::encodeUtf8(kh::str(token)) + "` in an expression", token);
+                    context.error("unexpected `" + kh::encodeUtf8(kh::str(token)) +
+                                      "` in an expression",
+                                  token);
                     context.ti++;
                     goto end;
             }
             break;
 
         default:
-            context.exceptions.emplace_back(
-                "unexpected `" + kh::encodeUtf8(kh::str(token)) + "` in an expression", token);
+            context.error("unexpected `" + kh::encodeUtf8(kh::str(token)) + "` in an expression",
+                          token);
             context.ti++;
             goto end;
     }
@@ -521,6 +533,21 @@ end:
     return expr;
 }
 
+/* Generic arguments are the types which can nest, so they count towards the nesting limit */
+static kh::AstIdentifiers parseGenericArgument(KH_PARSE_CTX) {
+    if (context.depth >= context.nesting_limit) {
+        size_t index = context.tok().index;
+        kh::skipNesting(context, false);
+        return {index, {}, {}, {}, {}};
+    }
+
+    context.depth++;
+    kh::AstIdentifiers generic = kh::parseIdentifiers(context);
+    context.depth--;
+
+    return generic;
+}
+
 kh::AstIdentifiers kh::parseIdentifiers(KH_PARSE_CTX) {
     std::vector<std::string> identifiers;
     std::vector<kh::AstIdentifiers> generics;
@@ -535,14 +562,14 @@ kh::AstIdentifiers kh::parseIdentifiers(KH_PARSE_CTX) {
     /* Expects an identifier */
     if (token.type == kh::TokenType::IDENTIFIER) {
         if (kh::isReservedKeyword(token.value.identifier)) {
-            context.exceptions.emplace_back("cannot use a reserved keyword as an identifier", token);
+            context.error("cannot use a reserved keyword as an identifier", token);
         }
 
         identifiers.push_back(token.value.identifier);
         context.ti++;
     }
     else {
-        context.exceptions.emplace_back("expected an identifier", token);
+        context.error("expected an identifier", token);
         goto end;
     }
 
@@ -558,13 +585,12 @@ kh::AstIdentifiers kh::parseIdentifiers(KH_PARSE_CTX) {
         /* Appends the identifier */
         if (token.type == kh::TokenType::IDENTIFIER) {
             if (kh::isReservedKeyword(token.value.identifier)) {
-                context.exceptions.emplace_back("cannot use a reserved keyword as an identifier",
-                                                token);
+                context.error("cannot use a reserved keyword as an identifier", token);
             }
             identifiers.push_back(token.value.identifier);
         }
         else {
-            context.exceptions.emplace_back("expected an identifier after the dot", token);
+            context.error("expected an identifier after the dot", token);
             goto end;
         }
 
@@ -596,7 +622,7 @@ kh::AstIdentifiers kh::parseIdentifiers(KH_PARSE_CTX) {
             }
 
             /* Parses the genericization type arguments */
-            generics.push_back(kh::parseIdentifiers(context));
+            generics.push_back(parseGenericArgument(context));
             generics_array.push_back(kh::parseArrayDimension(context, generics.back()));
             KH_PARSE_GUARD();
             token = context.tok();
@@ -618,9 +644,9 @@ kh::AstIdentifiers kh::parseIdentifiers(KH_PARSE_CTX) {
                     }
                 }
                 else {
-                    context.exceptions.emplace_back("expected an opening parentheses after the "
-                                                    "return type in the genericization of `func`",
-                                                    token);
+                    context.error("expected an opening parentheses after the "
+                                  "return type in the genericization of `func`",
+                                  token);
                 }
             }
 
@@ -639,7 +665,7 @@ kh::AstIdentifiers kh::parseIdentifiers(KH_PARSE_CTX) {
                     token = context.tok();
                 }
 
-                generics.emplace_back(kh::parseIdentifiers(context));
+                generics.emplace_back(parseGenericArgument(context));
                 generics_array.push_back(kh::parseArrayDimension(context, generics.back()));
 
                 KH_PARSE_GUARD();
@@ -661,33 +687,32 @@ kh::AstIdentifiers kh::parseIdentifiers(KH_PARSE_CTX) {
                         context.ti++;
                     }
                     else {
-                        context.exceptions.emplace_back("expected a closing parentheses", token);
+                        context.error("expected a closing parentheses", token);
                     }
                 }
             }
             else {
-                context.exceptions.emplace_back("expected a closing parentheses", token);
+                context.error("expected a closing parentheses", token);
             }
         }
         else if (token.type == kh::TokenType::IDENTIFIER) {
             if (is_function) {
-                context.exceptions.emplace_back(
-                    "expected an opening parentheses for genericization of `func`", token);
+                context.error("expected an opening parentheses for genericization of `func`", token);
             }
-            generics.push_back(kh::parseIdentifiers(context));
+            generics.push_back(parseGenericArgument(context));
             generics_refs.push_back(0);
             generics_array.push_back({});
         }
         else {
-            context.exceptions.emplace_back("expected either an identifier or an opening "
-                                            "parentheses for genericization after the "
-                                            "exclamation mark ",
-                                            token);
+            context.error("expected either an identifier or an opening "
+                          "parentheses for genericization after the "
+                          "exclamation mark ",
+                          token);
             context.ti++;
         }
     }
     else if (is_function) {
-        context.exceptions.emplace_back("`func` requires genericization", token);
+        context.error("`func` requires genericization", token);
     }
 end:
     return {index, identifiers, generics, generics_refs, generics_array};
@@ -724,10 +749,10 @@ kh::AstExpression* kh::parseTuple(KH_PARSE_CTX, kh::Symbol opening, kh::Symbol c
             }
             else if (!(token.type == kh::TokenType::SYMBOL &&
                        token.value.symbol_type == kh::Symbol::COMMA)) {
-                context.exceptions.emplace_back(closing == kh::Symbol::SQUARE_CLOSE
-                                                    ? "expected a comma or a closing square bracket"
-                                                    : "expected a comma or a closing parentheses",
-                                                token);
+                context.error(closing == kh::Symbol::SQUARE_CLOSE
+                                  ? "expected a comma or a closing square bracket"
+                                  : "expected a comma or a closing parentheses",
+                              token);
                 context.ti++;
                 break;
             }
@@ -745,10 +770,10 @@ kh::AstExpression* kh::parseTuple(KH_PARSE_CTX, kh::Symbol opening, kh::Symbol c
         }
     }
     else {
-        context.exceptions.emplace_back(opening == kh::Symbol::SQUARE_OPEN
-                                            ? "expected an opening square bracket"
-                                            : "expected an opening parentheses",
-                                        token);
+        context.error(opening == kh::Symbol::SQUARE_OPEN
+                          ? "expected an opening square bracket"
+                          : "expected an opening parentheses",
+                      token);
         context.ti++;
     }
 
@@ -777,7 +802,7 @@ kh::AstExpression* kh::parseList(KH_PARSE_CTX) {
     size_t index = token.index;
 
     kh::AstTuple* tuple = (kh::AstTuple*)kh::parseTuple(context, kh::Symbol::SQUARE_OPEN,
-                                                        kh::Symbol::SQUARE_CLOSE, false);
+                                                        kh::Symbol::SQUARE_CLOSE, true);
     kh::AstList* list = new kh::AstList(tuple->index, tuple->elements);
     delete tuple;
 
@@ -817,8 +842,7 @@ kh::AstExpression* kh::parseDict(KH_PARSE_CTX) {
                 KH_PARSE_GUARD();
             }
             else {
-                context.exceptions.emplace_back("expected a colon after a key of the dict literal",
-                                                token);
+                context.error("expected a colon after a key of the dict literal", token);
             }
             items.emplace_back(kh::parseExpression(context));
             KH_PARSE_GUARD();
@@ -829,13 +853,11 @@ kh::AstExpression* kh::parseDict(KH_PARSE_CTX) {
             context.ti++;
         }
         else {
-            context.exceptions.emplace_back("expected a closing curly bracket closing the dict literal",
-                                            token);
+            context.error("expected a closing curly bracket closing the dict literal", token);
         }
     }
     else {
-        context.exceptions.emplace_back("expected an opening curly bracket for the dict literal",
-                                        token);
+        context.error("expected an opening curly bracket for the dict literal", token);
     }
 end:
     return new kh::AstDict(index, keys, items);
@@ -863,7 +885,7 @@ std::vector<uint64_t> kh::parseArrayDimension(KH_PARSE_CTX, kh::AstIdentifiers&
         else if (token.type == kh::TokenType::INTEGER || token.type == kh::TokenType::UINTEGER) {
             dimension.push_back(token.value.uinteger);
             if (token.value.uinteger == 0) {
-                context.exceptions.emplace_back("an array could not be zero sized", token);
+                context.error("an array could not be zero sized", token);
             }
 
             context.ti++;
@@ -872,14 +894,13 @@ std::vector<uint64_t> kh::parseArrayDimension(KH_PARSE_CTX, kh::AstIdentifiers&
 
             if (!(token.type == kh::TokenType::SYMBOL &&
                   token.value.symbol_type == kh::Symbol::SQUARE_CLOSE)) {
-                context.exceptions.emplace_back("expected a closing square bracket in the array size",
-                                                token);
+                context.error("expected a closing square bracket in the array size", token);
             }
         }
         else {
-            context.exceptions.emplace_back("unexpected `" + kh::encodeUtf8(kh::str(token)) +
-                                                "` while parsing the array size",
-                                            token);
+            context.error("unexpected `" + kh::encodeUtf8(kh::str(token)) +
+                              "` while parsing the array size",
+                          token);
         }
         context.ti++;
         KH_PARSE_GUARD();
@@ -0,0 +1,483 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+#include <kithare/file.hpp>
+#include <kithare/importer.hpp>
+#include <kithare/serial.hpp>
+#include <kithare/string.hpp>
+#include <kithare/thread_pool.hpp>
+#include <kithare/utf8.hpp>
+
+#if _WIN32
+#define KH_PATH_SEPARATOR U'\\'
+#else
+#define KH_PATH_SEPARATOR U'/'
+#endif
+
+
+std::string kh::ImportException::format() const {
+    if (this->line == 0) {
+        return this->what + " in " + kh::encodeUtf8(this->path);
+    }
+
+    return this->what + " in " + kh::encodeUtf8(this->path) + " at line " +
+           std::to_string(this->line) + " column " + std::to_string(this->column);
+}
+
+static std::u32string directoryOf(const std::u32string& path) {
+    size_t separator = path.find_last_of(U"/\\");
+    return separator == std::u32string::npos ? U"." : path.substr(0, separator);
+}
+
+/* Loads the modules of the graph concurrently, each module submits the ones it imports to the pool as
+ * soon as it's parsed */
+class ModuleLoader {
+public:
+    ModuleLoader(const std::vector<std::u32string>& _search_paths, size_t _workers,
+                 bool _use_interfaces)
+        : search_paths(_search_paths), use_interfaces(_use_interfaces), pool(_workers) {}
+
+    std::vector<std::unique_ptr<kh::ImportedModule>> modules;
+    std::vector<kh::ImportException> exceptions;
+
+    /* Gets the index of the module at the canonical path, queueing it to be loaded if it's new */
+    size_t add(const std::u32string& path, bool is_root = false) {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        auto found = this->indices.find(path);
+        if (found != this->indices.end()) {
+            return found->second;
+        }
+
+        size_t index = this->modules.size();
+        this->indices.emplace(path, index);
+        this->modules.emplace_back(new kh::ImportedModule());
+
+        kh::ImportedModule* module = this->modules.back().get();
+        module->path = path;
+        this->pool.submit([this, module, is_root]() { this->load(*module, is_root); });
+
+        return index;
+    }
+
+    void wait() {
+        this->pool.wait();
+    }
+
+    /* Parses the function bodies which got skipped once every module is found, so finding the
+     * imports doesn't wait on them */
+    void parseBodies() {
+        for (const std::unique_ptr<kh::ImportedModule>& module : this->modules) {
+            if (module->tokens) {
+                kh::ImportedModule* module_ptr = module.get();
+                this->pool.submit([this, module_ptr]() { this->parseBodies(*module_ptr); });
+            }
+        }
+
+        this->pool.wait();
+    }
+
+private:
+    const std::vector<std::u32string>& search_paths;
+    bool use_interfaces;
+    kh::ThreadPool pool;
+
+    std::mutex mutex;
+    std::unordered_map<std::u32string, size_t> indices;
+
+    void error(const std::string& what, const kh::ImportedModule& module, size_t index) {
+        size_t line = 0, column = 0;
+
+        /* The tokens are sorted by their index, modules loaded from their interface have none */
+        if (module.tokens) {
+            auto token = std::lower_bound(
+                module.tokens->begin(), module.tokens->end(), index,
+                [](const kh::Token& token, size_t index) { return token.index < index; });
+            if (token != module.tokens->end()) {
+                line = token->line;
+                column = token->column;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->exceptions.emplace_back(what, module.path, index, line, column);
+    }
+
+    /* Finds the file of the import, the import path `a.b.c` being `a/b/c.kh` in one of the
+     * directories */
+    bool resolve(const kh::AstImport& import, const std::u32string& directory,
+                 std::u32string& resolved) const {
+        std::u32string relative_path;
+        for (const std::string& name : import.path) {
+            relative_path += KH_PATH_SEPARATOR + kh::decodeUtf8(name);
+        }
+        relative_path += KH_SOURCE_EXTENSION;
+
+        if (import.is_relative) {
+            try {
+                resolved = kh::canonicalPath(directory + relative_path);
+                return true;
+            }
+            catch (const kh::FileError&) {
+                return false;
+            }
+        }
+
+        for (const std::u32string& search_path : this->search_paths) {
+            try {
+                resolved = kh::canonicalPath(search_path + relative_path);
+                return true;
+            }
+            catch (const kh::FileError&) {
+            }
+        }
+
+        return false;
+    }
+
+    /* Adds the errors in the skipped function bodies to the ones of the module, then writes its
+     * interface if there were none. An interface is keyed by the hash of the source, so one written
+     * for a module with errors would hide them from every later run */
+    void parseBodies(kh::ImportedModule& module) {
+        auto addExceptions = [&module](const kh::AstFunction& function_ast) {
+            if (function_ast.lazy_body) {
+                const std::vector<kh::ParseException>& body_exceptions =
+                    function_ast.lazy_body->exceptions();
+                module.parse_exceptions.insert(module.parse_exceptions.end(),
+                                               body_exceptions.begin(), body_exceptions.end());
+            }
+        };
+
+        for (const kh::AstFunction& function_ast : module.ast->functions) {
+            addExceptions(function_ast);
+        }
+        for (const kh::AstUserType& type_ast : module.ast->user_types) {
+            for (const kh::AstFunction& method : type_ast.methods) {
+                addExceptions(method);
+            }
+        }
+
+        std::stable_sort(module.parse_exceptions.begin(), module.parse_exceptions.end(),
+                         [](const kh::ParseException& a, const kh::ParseException& b) {
+                             return a.index < b.index;
+                         });
+
+        if (this->use_interfaces && module.source_hash && module.lex_exceptions.empty() &&
+            module.parse_exceptions.empty()) {
+            try {
+                kh::updateInterface(module.path, *module.ast, module.source_hash);
+            }
+            /* Such as when the directory is read-only, the module just gets parsed again */
+            catch (const kh::FileError&) {
+            }
+        }
+    }
+
+    /* Only the modules being imported get their function bodies parsed lazily, errors in the root
+     * module are all reported up front */
+    void load(kh::ImportedModule& module, bool is_root) {
+        std::string source_bytes;
+        try {
+            source_bytes = kh::readFileBinary(module.path);
+        }
+        catch (const kh::FileError&) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->exceptions.emplace_back("unable to read the module", module.path, 0, 0, 0);
+            return;
+        }
+
+        bool use_interface = this->use_interfaces && !is_root;
+        uint64_t source_hash = 0;
+        if (use_interface) {
+            source_hash = kh::hash(source_bytes);
+            module.ast = kh::loadInterface(module.path, source_hash);
+            module.from_interface = (bool)module.ast;
+        }
+
+        if (!module.ast) {
+            std::u32string source = kh::decodeUtf8(source_bytes);
+            kh::LexerContext lexer_context{source, module.lex_exceptions};
+            module.tokens = std::make_shared<const std::vector<kh::Token>>(kh::lex(lexer_context));
+
+            kh::ParserContext parser_context{*module.tokens, module.parse_exceptions};
+            if (!is_root) {
+                parser_context.lazy_tokens = module.tokens;
+            }
+            module.ast = std::make_shared<kh::AstModule>(kh::parseWhole(parser_context));
+            module.source_hash = source_hash;
+        }
+
+        std::u32string directory = directoryOf(module.path);
+        module.imports.resize(module.ast->imports.size(), KH_UNRESOLVED_IMPORT);
+
+        for (size_t i = 0; i < module.ast->imports.size(); i++) {
+            const kh::AstImport& import = module.ast->imports[i];
+
+            /* Already reported by the parser */
+            if (import.path.empty()) {
+                continue;
+            }
+
+            std::u32string resolved;
+            if (this->resolve(import, directory, resolved)) {
+                module.imports[i] = this->add(resolved);
+            }
+            else {
+                std::string name = import.is_relative ? "." : "";
+                for (size_t j = 0; j < import.path.size(); j++) {
+                    name += (j ? "." : "") + import.path[j];
+                }
+
+                this->error("unable to find the " +
+                                std::string(import.is_include ? "included" : "imported") +
+                                " module `" + name + "`",
+                            module, import.index);
+            }
+        }
+    }
+};
+
+kh::ModuleGraph kh::loadModules(const std::u32string& path,
+                                const std::vector<std::u32string>& search_paths, size_t workers,
+                                bool use_interfaces) {
+    kh::ModuleGraph graph;
+
+    std::u32string root_path;
+    try {
+        root_path = kh::canonicalPath(path);
+    }
+    catch (const kh::FileError&) {
+        graph.exceptions.emplace_back("unable to read the module", path, 0, 0, 0);
+        return graph;
+    }
+
+    std::vector<std::u32string> directories = {directoryOf(root_path)};
+    directories.insert(directories.end(), search_paths.begin(), search_paths.end());
+
+    ModuleLoader loader(directories, workers, use_interfaces);
+    loader.add(root_path, true);
+    loader.wait();
+    loader.parseBodies();
+
+    /* The modules are found in whichever order the threads get to them, sorting them by path makes
+     * the graph the same on every run */
+    size_t count = loader.modules.size();
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&loader](size_t a, size_t b) {
+        return loader.modules[a]->path < loader.modules[b]->path;
+    });
+
+    std::vector<size_t> remap(count);
+    graph.modules.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        remap[order[i]] = i;
+        graph.modules.push_back(std::move(*loader.modules[order[i]]));
+    }
+
+    for (kh::ImportedModule& module : graph.modules) {
+        for (size_t& import : module.imports) {
+            if (import != KH_UNRESOLVED_IMPORT) {
+                import = remap[import];
+            }
+        }
+    }
+
+    /* The root module is always the first one added */
+    graph.root = remap[0];
+    graph.cycles = kh::findImportCycles(graph.modules);
+
+    graph.exceptions = std::move(loader.exceptions);
+    std::stable_sort(graph.exceptions.begin(), graph.exceptions.end(),
+                     [](const kh::ImportException& a, const kh::ImportException& b) {
+                         return a.path != b.path ? a.path < b.path : a.index < b.index;
+                     });
+
+    return graph;
+}
+
+static kh::AstFunction functionSignature(const kh::AstFunction& function_ast) {
+    kh::AstFunction signature = function_ast;
+    signature.body.clear();
+    signature.lazy_body.reset();
+    signature.body_begin = 0;
+    signature.body_end = 0;
+    return signature;
+}
+
+static kh::AstDeclaration declarationSignature(const kh::AstDeclaration& declaration_ast) {
+    kh::AstDeclaration signature = declaration_ast;
+    signature.expression.reset();
+    return signature;
+}
+
+kh::AstModule kh::moduleInterface(const kh::AstModule& module_ast) {
+    std::vector<kh::AstFunction> functions;
+    for (const kh::AstFunction& function_ast : module_ast.functions) {
+        if (function_ast.is_public) {
+            functions.push_back(functionSignature(function_ast));
+        }
+    }
+
+    /* Private members are kept too, the layout of the type depends on them */
+    std::vector<kh::AstUserType> user_types;
+    for (const kh::AstUserType& type_ast : module_ast.user_types) {
+        if (!type_ast.is_public) {
+            continue;
+        }
+
+        std::vector<kh::AstDeclaration> members;
+        for (const kh::AstDeclaration& member : type_ast.members) {
+            members.push_back(declarationSignature(member));
+        }
+
+        std::vector<kh::AstFunction> methods;
+        for (const kh::AstFunction& method : type_ast.methods) {
+            if (method.is_public) {
+                methods.push_back(functionSignature(method));
+            }
+        }
+
+        user_types.emplace_back(type_ast.index, type_ast.identifiers, type_ast.base,
+                                type_ast.generic_args, members, methods, type_ast.is_class);
+        user_types.back().is_public = true;
+    }
+
+    std::vector<kh::AstEnumType> enums;
+    for (const kh::AstEnumType& enum_ast : module_ast.enums) {
+        if (enum_ast.is_public) {
+            enums.push_back(enum_ast);
+        }
+    }
+
+    std::vector<kh::AstDeclaration> variables;
+    for (const kh::AstDeclaration& variable : module_ast.variables) {
+        if (variable.is_public) {
+            variables.push_back(declarationSignature(variable));
+        }
+    }
+
+    return kh::AstModule(module_ast.imports, functions, user_types, enums, variables);
+}
+
+std::shared_ptr<kh::AstModule> kh::loadInterface(const std::u32string& source_path,
+                                                 uint64_t source_hash) {
+    try {
+        kh::MappedFile file(source_path + KH_INTERFACE_SUFFIX);
+        if (kh::interfaceHash(file.data(), file.size()) != source_hash) {
+            return nullptr;
+        }
+
+        return std::make_shared<kh::AstModule>(kh::deserializeInterface(file.data(), file.size()));
+    }
+    catch (const kh::FileError&) {
+        return nullptr;
+    }
+    catch (const kh::SerialException&) {
+        return nullptr;
+    }
+}
+
+bool kh::updateInterface(const std::u32string& source_path, const kh::AstModule& module_ast,
+                         uint64_t source_hash) {
+    std::u32string interface_path = source_path + KH_INTERFACE_SUFFIX;
+
+    try {
+        kh::MappedFile file(interface_path);
+        if (kh::interfaceHash(file.data(), file.size()) == source_hash) {
+            return false;
+        }
+    }
+    catch (const kh::FileError&) {
+    }
+    catch (const kh::SerialException&) {
+    }
+
+    kh::writeFileBinary(interface_path,
+                        kh::serializeInterface(kh::moduleInterface(module_ast), source_hash));
+    return true;
+}
+
+std::vector<std::vector<size_t>> kh::findImportCycles(const std::vector<kh::ImportedModule>& modules) {
+    /* Tarjan's strongly connected components algorithm, with the depth first search kept on its own
+     * stack of the module and its next import so long import chains can't overflow the call stack */
+    size_t count = modules.size();
+    std::vector<size_t> order(count, KH_UNRESOLVED_IMPORT);
+    std::vector<size_t> lowlink(count);
+    std::vector<bool> on_stack(count, false);
+    std::vector<size_t> stack;
+    std::vector<std::pair<size_t, size_t>> search;
+    std::vector<std::vector<size_t>> cycles;
+    size_t counter = 0;
+
+    for (size_t start = 0; start < count; start++) {
+        if (order[start] != KH_UNRESOLVED_IMPORT) {
+            continue;
+        }
+
+        order[start] = lowlink[start] = counter++;
+        stack.push_back(start);
+        on_stack[start] = true;
+        search.emplace_back(start, 0);
+
+        while (!search.empty()) {
+            size_t module = search.back().first;
+            const std::vector<size_t>& imports = modules[module].imports;
+
+            if (search.back().second < imports.size()) {
+                size_t next = imports[search.back().second++];
+
+                if (next == KH_UNRESOLVED_IMPORT) {
+                    continue;
+                }
+                else if (order[next] == KH_UNRESOLVED_IMPORT) {
+                    order[next] = lowlink[next] = counter++;
+                    stack.push_back(next);
+                    on_stack[next] = true;
+                    search.emplace_back(next, 0);
+                }
+                else if (on_stack[next]) {
+                    lowlink[module] = std::min(lowlink[module], order[next]);
+                }
+                continue;
+            }
+
+            search.pop_back();
+            if (!search.empty()) {
+                size_t parent = search.back().first;
+                lowlink[parent] = std::min(lowlink[parent], lowlink[module]);
+            }
+
+            if (lowlink[module] != order[module]) {
+                continue;
+            }
+
+            std::vector<size_t> component;
+            size_t member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                on_stack[member] = false;
+                component.push_back(member);
+            } while (member != module);
+
+            if (component.size() > 1 ||
+                std::find(imports.begin(), imports.end(), module) != imports.end()) {
+                std::sort(component.begin(), component.end());
+                cycles.push_back(std::move(component));
+            }
+        }
+    }
+
+    std::sort(cycles.begin(), cycles.end());
+    return cycles;
+}
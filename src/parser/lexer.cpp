@@ -4,8 +4,9 @@
  * Copyright (C) 2021 Kithare Organization
  */
 
+#include <cmath>
+#include <cstdint>
 #include <cwctype>
-#include <functional>
 
 #include <kithare/lexer.hpp>
 #include <kithare/utf8.hpp>
@@ -32,32 +33,32 @@ std::vector<kh::Token> kh::lex(const std::u32string& source) {
 /* Helper to raise error at a file */
 #define KH_RAISE_ERROR(msg, n) throw kh::LexException(msg, i + n)
 
-/* Use this macro to export a variable hex_str from a given start and len relative
- * to the file index */
-#define HANDLE_HEX_INTO_HEXSTR(_start, _len)                   \
-    std::string hex_str;                                       \
-    for (size_t j = _start; j < _start + _len; j++) {          \
-        if (kh::isHex(chAt(i + j)))                            \
-            hex_str += (char)chAt(i + j);                      \
-        else                                                   \
-            KH_RAISE_ERROR("expected a hexadecimal digit", j); \
-    }                                                          \
+/* Use this macro to export a variable hex_value from the hex digits of a given start and len
+ * relative to the file index */
+#define HANDLE_HEX_INTO_HEXVALUE(_start, _len)                          \
+    uint32_t hex_value = 0;                                             \
+    for (size_t j = _start; j < _start + _len; j++) {                   \
+        if (kh::isHex(chAt(i + j)))                                     \
+            hex_value = hex_value * 16 + kh::hexDigit(chAt(i + j));     \
+        else                                                            \
+            KH_RAISE_ERROR("expected a hexadecimal digit", j);          \
+    }                                                                   \
     i += _start + _len
 
 /* Helper macro */
-#define _PLACE_HEXSTR_AS_TYPE(_var, ttype)               \
+#define _PLACE_HEXVALUE_AS_TYPE(_var, ttype)             \
     if (chAt(i) == '\'') {                               \
-        _var = std::stoul(hex_str, nullptr, 16);         \
+        _var = hex_value;                                \
         tokens.emplace_back(start, i + 1, ttype, value); \
     }                                                    \
     else                                                 \
         KH_RAISE_ERROR("expected a closing single quote", 0)
 
-/* Place a hex_str as an integer into tokens stack */
-#define PLACE_HEXSTR_AS_INT() _PLACE_HEXSTR_AS_TYPE(value.integer, kh::TokenType::INTEGER)
+/* Place a hex_value as an integer into tokens stack */
+#define PLACE_HEXVALUE_AS_INT() _PLACE_HEXVALUE_AS_TYPE(value.integer, kh::TokenType::INTEGER)
 
-/* Place a hex_str as a character into tokens stack */
-#define PLACE_HEXSTR_AS_CHAR() _PLACE_HEXSTR_AS_TYPE(value.character, kh::TokenType::CHARACTER)
+/* Place a hex_value as a character into tokens stack */
+#define PLACE_HEXVALUE_AS_CHAR() _PLACE_HEXVALUE_AS_TYPE(value.character, kh::TokenType::CHARACTER)
 
 /* Helper macro */
 #define _HANDLE_ESCAPE(chr, echr, _val, _len, code) \
@@ -108,6 +109,41 @@ std::vector<kh::Token> kh::lex(const std::u32string& source) {
     default:                                   \
         KH_RAISE_ERROR("unknown escape character", 1);
 
+/* Places an integer literal with the digits from `_begin` until the current index into the tokens
+ * stack, with an unsigned or imaginary suffix at the current index if there's one */
+#define HANDLE_INTEGER_LITERAL(_begin, _base, _name, _max)                                          \
+    {                                                                                                \
+        kh::TokenValue value;                                                                        \
+        uint64_t literal;                                                                            \
+        bool fits = kh::parseInteger(context.source.data() + (_begin), context.source.data() + i,   \
+                                     _base, literal);                                                \
+        if (chAt(i) == 'u' || chAt(i) == 'U') {                                                      \
+            /* Is unsigned */                                                                        \
+            if (!fits) {                                                                             \
+                KH_RAISE_ERROR("unsigned " _name " too large to be interpret", 0);                   \
+            }                                                                                        \
+            value.uinteger = literal;                                                                \
+            tokens.emplace_back(start, i + 1, kh::TokenType::UINTEGER, value);                       \
+        }                                                                                            \
+        else if (chAt(i) == 'i' || chAt(i) == 'I') {                                                 \
+            /* Is imaginary */                                                                       \
+            if (!fits) {                                                                             \
+                KH_RAISE_ERROR("imaginary " _name " too large to be interpret", 0);                  \
+            }                                                                                        \
+            value.imaginary = literal;                                                               \
+            tokens.emplace_back(start, i + 1, kh::TokenType::IMAGINARY, value);                      \
+        }                                                                                            \
+        else {                                                                                       \
+            if (!fits || literal > (uint64_t)(_max)) {                                               \
+                KH_RAISE_ERROR(_name " too large to be interpret", -1);                              \
+            }                                                                                        \
+            value.integer = literal;                                                                 \
+            tokens.emplace_back(start, i, kh::TokenType::INTEGER, value);                            \
+            i--;                                                                                     \
+        }                                                                                            \
+        state = kh::TokenizeState::NONE;                                                             \
+    }
+
 /* Handle a simple symbol from a switch block */
 #define HANDLE_SIMPLE_SYMBOL(sym, name)                                \
     case sym: {                                                        \
@@ -159,13 +195,17 @@ std::vector<kh::Token> kh::lex(KH_LEX_CTX) {
     kh::TokenizeState state = kh::TokenizeState::NONE;
     std::vector<kh::Token> tokens;
 
+    /* Rough guess of the token count, so the tokens (which are quite large) aren't moved around as
+     * often while the vector grows */
+    tokens.reserve(context.source.size() / 8);
+
     size_t start = 0;
     std::u32string temp_str;
     std::string temp_buf;
 
     /* Lambda function which accesses the string, and throws an error directly to the console if it
      * had passed the length */
-    std::function<char32_t(const size_t)> chAt = [&](const size_t index) -> char32_t {
+    auto chAt = [&](const size_t index) -> char32_t {
         if (index < context.source.size()) {
             return context.source[index];
         }
@@ -204,8 +244,8 @@ std::vector<kh::Token> kh::lex(KH_LEX_CTX) {
                                         /* Hex character escape */
                                         case 'x':
                                         case 'X': {
-                                            HANDLE_HEX_INTO_HEXSTR(4, 2);
-                                            PLACE_HEXSTR_AS_INT();
+                                            HANDLE_HEX_INTO_HEXVALUE(4, 2);
+                                            PLACE_HEXVALUE_AS_INT();
                                         } break;
 
                                             HANDLE_ESCAPES_1(value.integer, kh::TokenType::INTEGER, 4)
@@ -303,7 +343,6 @@ std::vector<kh::Token> kh::lex(KH_LEX_CTX) {
                         }
 
                         state = kh::TokenizeState::INTEGER;
-                        temp_str = chAt(i);
                     }
 
                     else {
@@ -317,20 +356,20 @@ std::vector<kh::Token> kh::lex(KH_LEX_CTX) {
                                         /* Hex escapes */
                                         case 'x':
                                         case 'X': {
-                                            HANDLE_HEX_INTO_HEXSTR(3, 2);
-                                            PLACE_HEXSTR_AS_CHAR();
+                                            HANDLE_HEX_INTO_HEXVALUE(3, 2);
+                                            PLACE_HEXVALUE_AS_CHAR();
                                         } break;
 
                                             /* 2 bytes unicode escape */
                                         case 'u': {
-                                            HANDLE_HEX_INTO_HEXSTR(3, 4);
-                                            PLACE_HEXSTR_AS_CHAR();
+                                            HANDLE_HEX_INTO_HEXVALUE(3, 4);
+                                            PLACE_HEXVALUE_AS_CHAR();
                                         } break;
 
                                             /* 4 bytes unicode escape */
                                         case 'U': {
-                                            HANDLE_HEX_INTO_HEXSTR(3, 8);
-                                            PLACE_HEXSTR_AS_CHAR();
+                                            HANDLE_HEX_INTO_HEXVALUE(3, 8);
+                                            PLACE_HEXVALUE_AS_CHAR();
                                         } break;
 
                                             HANDLE_ESCAPES_1(value.character, kh::TokenType::CHARACTER,
@@ -503,7 +542,6 @@ std::vector<kh::Token> kh::lex(KH_LEX_CTX) {
 
                                 if (kh::isDec(chAt(i + 1))) {
                                     state = kh::TokenizeState::FLOATING;
-                                    temp_str = U"0.";
                                     continue;
                                 }
 
@@ -550,68 +588,34 @@ std::vector<kh::Token> kh::lex(KH_LEX_CTX) {
 
                     /* Checks for an integer */
                 case kh::TokenizeState::INTEGER:
-                    if (kh::isDec(chAt(i))) {
-                        temp_str += chAt(i);
-                    }
-                    else if (chAt(i) == 'u' || chAt(i) == 'U') {
-                        /* Is unsigned */
-                        kh::TokenValue value;
-                        try {
-                            value.uinteger = std::stoull(kh::encodeUtf8(temp_str));
-                        }
-                        catch (...) {
-                            KH_RAISE_ERROR("unsigned integer too large to be interpret", 0);
-                        }
-                        tokens.emplace_back(start, i + 1, kh::TokenType::UINTEGER, value);
-
-                        state = kh::TokenizeState::NONE;
+                    /* The digits are converted at once from the source after the literal ends */
+                    while (kh::isDec(chAt(i))) {
+                        i++;
                     }
-                    else if (chAt(i) == 'i' || chAt(i) == 'I') {
-                        /* Is imaginary */
-                        kh::TokenValue value;
-                        try {
-                            value.imaginary = std::stoull(kh::encodeUtf8(temp_str));
-                        }
-                        catch (...) {
-                            KH_RAISE_ERROR("imaginary integer too large to be interpret", 0);
-                        }
-                        tokens.emplace_back(start, i + 1, kh::TokenType::IMAGINARY, value);
 
-                        state = kh::TokenizeState::NONE;
-                    }
-                    else if (chAt(i) == '.') {
+                    if (chAt(i) == '.') {
                         /* Checks it as a floating point */
-                        temp_str += chAt(i);
                         state = kh::TokenizeState::FLOATING;
                     }
                     else {
-                        kh::TokenValue value;
-                        try {
-                            value.integer = std::stoll(kh::encodeUtf8(temp_str));
-                        }
-                        catch (...) {
-                            KH_RAISE_ERROR("integer too large to be interpret", -1);
-                        }
-                        tokens.emplace_back(start, i, kh::TokenType::INTEGER, value);
-
-                        state = kh::TokenizeState::NONE;
-                        i--;
+                        HANDLE_INTEGER_LITERAL(start, 10, "integer", INT64_MAX);
                     }
                     continue;
 
                     /* Checks floating point numbers */
                 case kh::TokenizeState::FLOATING:
-                    if (kh::isDec(chAt(i))) {
-                        temp_str += chAt(i);
+                    while (kh::isDec(chAt(i))) {
+                        i++;
                     }
-                    else if (chAt(i) == 'i' || chAt(i) == 'I') {
-                        /* Is imaginary */
-                        if (temp_str.back() == '.') {
-                            temp_str.pop_back();
-                        }
 
+                    if (chAt(i) == 'i' || chAt(i) == 'I') {
+                        /* Is imaginary */
                         kh::TokenValue value;
-                        value.imaginary = std::stod(kh::encodeUtf8(temp_str));
+                        value.imaginary = kh::parseFloating(context.source.data() + start,
+                                                            context.source.data() + i);
+                        if (std::isinf(value.imaginary)) {
+                            KH_RAISE_ERROR("imaginary floating point too large to be interpret", 0);
+                        }
                         tokens.emplace_back(start, i + 1, kh::TokenType::IMAGINARY, value);
 
                         state = kh::TokenizeState::NONE;
@@ -619,12 +623,16 @@ std::vector<kh::Token> kh::lex(KH_LEX_CTX) {
                     else {
                         /* An artifact from how integers were checked that was transferred as a floating
                          * point with an invalid character after . */
-                        if (temp_str.back() == '.') {
+                        if (chAt(i - 1) == '.') {
                             KH_RAISE_ERROR("was expecting a digit after the decimal point", 0);
                         }
 
                         kh::TokenValue value;
-                        value.floating = std::stod(kh::encodeUtf8(temp_str));
+                        value.floating = kh::parseFloating(context.source.data() + start,
+                                                           context.source.data() + i);
+                        if (std::isinf(value.floating)) {
+                            KH_RAISE_ERROR("floating point too large to be interpret", -1);
+                        }
                         tokens.emplace_back(start, i, kh::TokenType::FLOATING, value);
 
                         state = kh::TokenizeState::NONE;
@@ -634,141 +642,29 @@ std::vector<kh::Token> kh::lex(KH_LEX_CTX) {
 
                     /* Checks hex integers */
                 case kh::TokenizeState::HEX:
-                    if (kh::isHex(chAt(i))) {
-                        temp_str += chAt(i);
-                    }
-                    else if (chAt(i) == 'u' || chAt(i) == 'U') {
-                        /* Is unsigned */
-                        kh::TokenValue value;
-                        try {
-                            value.uinteger = std::stoull(kh::encodeUtf8(temp_str), nullptr, 16);
-                        }
-                        catch (...) {
-                            KH_RAISE_ERROR("unsigned hex integer too large to be interpret", 0);
-                        }
-                        tokens.emplace_back(start, i + 1, kh::TokenType::UINTEGER, value);
-
-                        state = kh::TokenizeState::NONE;
+                    while (kh::isHex(chAt(i))) {
+                        i++;
                     }
-                    else if (chAt(i) == 'i' || chAt(i) == 'I') {
-                        /* Is imaginary */
-                        kh::TokenValue value;
-                        try {
-                            value.imaginary = std::stoull(kh::encodeUtf8(temp_str), nullptr, 16);
-                        }
-                        catch (...) {
-                            KH_RAISE_ERROR("imaginary hex integer too large to be interpret", 0);
-                        }
-                        tokens.emplace_back(start, i + 1, kh::TokenType::IMAGINARY, value);
 
-                        state = kh::TokenizeState::NONE;
-                    }
-                    else {
-                        kh::TokenValue value;
-                        try {
-                            value.integer = std::stoull(kh::encodeUtf8(temp_str), nullptr, 16);
-                        }
-                        catch (...) {
-                            KH_RAISE_ERROR("hex integer too large to be interpret", -1);
-                        }
-                        tokens.emplace_back(start, i, kh::TokenType::INTEGER, value);
-
-                        state = kh::TokenizeState::NONE;
-                        i--;
-                    }
+                    HANDLE_INTEGER_LITERAL(start + 2, 16, "hex integer", UINT64_MAX);
                     continue;
 
                     /* Checks octal integers */
                 case kh::TokenizeState::OCTAL:
-                    if (kh::isOct(chAt(i))) {
-                        temp_str += chAt(i);
-                    }
-                    else if (chAt(i) == 'u' || chAt(i) == 'U') {
-                        /* Is unsigned */
-                        kh::TokenValue value;
-                        try {
-                            value.uinteger = std::stoull(kh::encodeUtf8(temp_str), nullptr, 8);
-                        }
-                        catch (...) {
-                            KH_RAISE_ERROR("unsigned octal integer too large to be interpret", 0);
-                        }
-                        tokens.emplace_back(start, i + 1, kh::TokenType::UINTEGER, value);
-
-                        state = kh::TokenizeState::NONE;
-                    }
-                    else if (chAt(i) == 'i' || chAt(i) == 'I') {
-                        /* Is imaginary */
-                        kh::TokenValue value;
-                        try {
-                            value.imaginary = std::stoull(kh::encodeUtf8(temp_str), nullptr, 8);
-                        }
-                        catch (...) {
-                            KH_RAISE_ERROR("imaginary octal integer too large to be interpret", 0);
-                        }
-                        tokens.emplace_back(start, i + 1, kh::TokenType::IMAGINARY, value);
-
-                        state = kh::TokenizeState::NONE;
+                    while (kh::isOct(chAt(i))) {
+                        i++;
                     }
-                    else {
-                        kh::TokenValue value;
-                        try {
-                            value.integer = std::stoull(kh::encodeUtf8(temp_str), nullptr, 8);
-                        }
-                        catch (...) {
-                            KH_RAISE_ERROR("octal integer too large to be interpret", -1);
-                        }
-                        tokens.emplace_back(start, i, kh::TokenType::INTEGER, value);
 
-                        state = kh::TokenizeState::NONE;
-                        i--;
-                    }
+                    HANDLE_INTEGER_LITERAL(start + 2, 8, "octal integer", UINT64_MAX);
                     continue;
 
                     /* Checks binary integers */
                 case kh::TokenizeState::BIN:
-                    if (kh::isBin(chAt(i))) {
-                        temp_str += chAt(i);
-                    }
-
-                    else if (chAt(i) == 'u' || chAt(i) == 'U') {
-                        /* Is unsigned */
-                        kh::TokenValue value;
-                        try {
-                            value.uinteger = std::stoull(kh::encodeUtf8(temp_str), nullptr, 2);
-                        }
-                        catch (...) {
-                            KH_RAISE_ERROR("unsigned binary integer too large to be interpret", 0);
-                        }
-                        tokens.emplace_back(start, i + 1, kh::TokenType::UINTEGER, value);
-
-                        state = kh::TokenizeState::NONE;
-                    }
-                    else if (chAt(i) == 'i' || chAt(i) == 'I') {
-                        /* Is imaginary */
-                        kh::TokenValue value;
-                        try {
-                            value.imaginary = std::stoull(kh::encodeUtf8(temp_str), nullptr, 2);
-                        }
-                        catch (...) {
-                            KH_RAISE_ERROR("imaginary binary integer too large to be interpret", 0);
-                        }
-                        tokens.emplace_back(start, i + 1, kh::TokenType::IMAGINARY, value);
-
-                        state = kh::TokenizeState::NONE;
+                    while (kh::isBin(chAt(i))) {
+                        i++;
                     }
-                    else {
-                        kh::TokenValue value;
-                        try {
-                            value.integer = std::stoull(kh::encodeUtf8(temp_str), nullptr, 2);
-                        }
-                        catch (...) {
-                            KH_RAISE_ERROR("binary integer too large to be interpret", -1);
-                        }
-                        tokens.emplace_back(start, i, kh::TokenType::INTEGER, value);
 
-                        state = kh::TokenizeState::NONE;
-                        i--;
-                    }
+                    HANDLE_INTEGER_LITERAL(start + 2, 2, "binary integer", UINT64_MAX);
                     continue;
 
                     /* Checks for a byte-string/buffer */
@@ -793,8 +689,8 @@ std::vector<kh::Token> kh::lex(KH_LEX_CTX) {
                                 /* Hex character escape */
                                 case 'x':
                                 case 'X': {
-                                    HANDLE_HEX_INTO_HEXSTR(2, 2);
-                                    temp_buf.push_back(std::stoul(hex_str, nullptr, 16));
+                                    HANDLE_HEX_INTO_HEXVALUE(2, 2);
+                                    temp_buf.push_back(hex_value);
                                     i--;
                                 } break;
 
@@ -835,8 +731,8 @@ std::vector<kh::Token> kh::lex(KH_LEX_CTX) {
                                 /* Hex character escape */
                                 case 'x':
                                 case 'X': {
-                                    HANDLE_HEX_INTO_HEXSTR(2, 2);
-                                    temp_buf.push_back(std::stoul(hex_str, nullptr, 16));
+                                    HANDLE_HEX_INTO_HEXVALUE(2, 2);
+                                    temp_buf.push_back(hex_value);
                                     i--;
                                 } break;
 
@@ -879,22 +775,22 @@ std::vector<kh::Token> kh::lex(KH_LEX_CTX) {
                                 /* Hex character escape */
                                 case 'x':
                                 case 'X': {
-                                    HANDLE_HEX_INTO_HEXSTR(2, 2);
-                                    temp_str += std::stoul(hex_str, nullptr, 16);
+                                    HANDLE_HEX_INTO_HEXVALUE(2, 2);
+                                    temp_str += hex_value;
                                     i--;
                                 } break;
 
                                     /* 2 bytes unicode escape */
                                 case 'u': {
-                                    HANDLE_HEX_INTO_HEXSTR(2, 4);
-                                    temp_str += std::stoul(hex_str, nullptr, 16);
+                                    HANDLE_HEX_INTO_HEXVALUE(2, 4);
+                                    temp_str += hex_value;
                                     i--;
                                 } break;
 
                                     /* 4 bytes unicode escape */
                                 case 'U': {
-                                    HANDLE_HEX_INTO_HEXSTR(2, 8);
-                                    temp_str += std::stoul(hex_str, nullptr, 16);
+                                    HANDLE_HEX_INTO_HEXVALUE(2, 8);
+                                    temp_str += hex_value;
                                     i--;
                                 } break;
 
@@ -931,22 +827,22 @@ std::vector<kh::Token> kh::lex(KH_LEX_CTX) {
                                 /* Hex character escape */
                                 case 'x':
                                 case 'X': {
-                                    HANDLE_HEX_INTO_HEXSTR(2, 2);
-                                    temp_str += std::stoul(hex_str, nullptr, 16);
+                                    HANDLE_HEX_INTO_HEXVALUE(2, 2);
+                                    temp_str += hex_value;
                                     i--;
                                 } break;
 
                                     /* 2 bytes unicode escape */
                                 case 'u': {
-                                    HANDLE_HEX_INTO_HEXSTR(2, 4);
-                                    temp_str += std::stoul(hex_str, nullptr, 16);
+                                    HANDLE_HEX_INTO_HEXVALUE(2, 4);
+                                    temp_str += hex_value;
                                     i--;
                                 } break;
 
                                     /* 4 bytes unicode escape */
                                 case 'U': {
-                                    HANDLE_HEX_INTO_HEXSTR(2, 8);
-                                    temp_str += std::stoul(hex_str, nullptr, 16);
+                                    HANDLE_HEX_INTO_HEXVALUE(2, 8);
+                                    temp_str += hex_value;
                                     i--;
                                 } break;
 
@@ -0,0 +1,576 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <kithare/lexer.hpp>
+
+/* At most this many significant digits are given to `strtod` when a floating literal couldn't be
+ * converted with the fast paths, the digits after those could only ever decide a rounding tie */
+#define KH_LITERAL_MAX_DIGITS 780
+
+
+/* Normalized 128 bit approximations of 10^q for -342 <= q <= 0, used by the Eisel-Lemire algorithm.
+ * Any power smaller than 10^-342 turns even a 19 digits mantissa into 0 */
+static const uint64_t powers_of_ten[343][2] = {
+        {0xeef453d6923bd65aULL, 0x113faa2906a13b3fULL}, /* 1e-342 */
+        {0x9558b4661b6565f8ULL, 0x4ac7ca59a424c507ULL}, /* 1e-341 */
+        {0xbaaee17fa23ebf76ULL, 0x5d79bcf00d2df649ULL}, /* 1e-340 */
+        {0xe95a99df8ace6f53ULL, 0xf4d82c2c107973dcULL}, /* 1e-339 */
+        {0x91d8a02bb6c10594ULL, 0x79071b9b8a4be869ULL}, /* 1e-338 */
+        {0xb64ec836a47146f9ULL, 0x9748e2826cdee284ULL}, /* 1e-337 */
+        {0xe3e27a444d8d98b7ULL, 0xfd1b1b2308169b25ULL}, /* 1e-336 */
+        {0x8e6d8c6ab0787f72ULL, 0xfe30f0f5e50e20f7ULL}, /* 1e-335 */
+        {0xb208ef855c969f4fULL, 0xbdbd2d335e51a935ULL}, /* 1e-334 */
+        {0xde8b2b66b3bc4723ULL, 0xad2c788035e61382ULL}, /* 1e-333 */
+        {0x8b16fb203055ac76ULL, 0x4c3bcb5021afcc31ULL}, /* 1e-332 */
+        {0xaddcb9e83c6b1793ULL, 0xdf4abe242a1bbf3dULL}, /* 1e-331 */
+        {0xd953e8624b85dd78ULL, 0xd71d6dad34a2af0dULL}, /* 1e-330 */
+        {0x87d4713d6f33aa6bULL, 0x8672648c40e5ad68ULL}, /* 1e-329 */
+        {0xa9c98d8ccb009506ULL, 0x680efdaf511f18c2ULL}, /* 1e-328 */
+        {0xd43bf0effdc0ba48ULL, 0x0212bd1b2566def2ULL}, /* 1e-327 */
+        {0x84a57695fe98746dULL, 0x014bb630f7604b57ULL}, /* 1e-326 */
+        {0xa5ced43b7e3e9188ULL, 0x419ea3bd35385e2dULL}, /* 1e-325 */
+        {0xcf42894a5dce35eaULL, 0x52064cac828675b9ULL}, /* 1e-324 */
+        {0x818995ce7aa0e1b2ULL, 0x7343efebd1940993ULL}, /* 1e-323 */
+        {0xa1ebfb4219491a1fULL, 0x1014ebe6c5f90bf8ULL}, /* 1e-322 */
+        {0xca66fa129f9b60a6ULL, 0xd41a26e077774ef6ULL}, /* 1e-321 */
+        {0xfd00b897478238d0ULL, 0x8920b098955522b4ULL}, /* 1e-320 */
+        {0x9e20735e8cb16382ULL, 0x55b46e5f5d5535b0ULL}, /* 1e-319 */
+        {0xc5a890362fddbc62ULL, 0xeb2189f734aa831dULL}, /* 1e-318 */
+        {0xf712b443bbd52b7bULL, 0xa5e9ec7501d523e4ULL}, /* 1e-317 */
+        {0x9a6bb0aa55653b2dULL, 0x47b233c92125366eULL}, /* 1e-316 */
+        {0xc1069cd4eabe89f8ULL, 0x999ec0bb696e840aULL}, /* 1e-315 */
+        {0xf148440a256e2c76ULL, 0xc00670ea43ca250dULL}, /* 1e-314 */
+        {0x96cd2a865764dbcaULL, 0x380406926a5e5728ULL}, /* 1e-313 */
+        {0xbc807527ed3e12bcULL, 0xc605083704f5ecf2ULL}, /* 1e-312 */
+        {0xeba09271e88d976bULL, 0xf7864a44c633682eULL}, /* 1e-311 */
+        {0x93445b8731587ea3ULL, 0x7ab3ee6afbe0211dULL}, /* 1e-310 */
+        {0xb8157268fdae9e4cULL, 0x5960ea05bad82964ULL}, /* 1e-309 */
+        {0xe61acf033d1a45dfULL, 0x6fb92487298e33bdULL}, /* 1e-308 */
+        {0x8fd0c16206306babULL, 0xa5d3b6d479f8e056ULL}, /* 1e-307 */
+        {0xb3c4f1ba87bc8696ULL, 0x8f48a4899877186cULL}, /* 1e-306 */
+        {0xe0b62e2929aba83cULL, 0x331acdabfe94de87ULL}, /* 1e-305 */
+        {0x8c71dcd9ba0b4925ULL, 0x9ff0c08b7f1d0b14ULL}, /* 1e-304 */
+        {0xaf8e5410288e1b6fULL, 0x07ecf0ae5ee44dd9ULL}, /* 1e-303 */
+        {0xdb71e91432b1a24aULL, 0xc9e82cd9f69d6150ULL}, /* 1e-302 */
+        {0x892731ac9faf056eULL, 0xbe311c083a225cd2ULL}, /* 1e-301 */
+        {0xab70fe17c79ac6caULL, 0x6dbd630a48aaf406ULL}, /* 1e-300 */
+        {0xd64d3d9db981787dULL, 0x092cbbccdad5b108ULL}, /* 1e-299 */
+        {0x85f0468293f0eb4eULL, 0x25bbf56008c58ea5ULL}, /* 1e-298 */
+        {0xa76c582338ed2621ULL, 0xaf2af2b80af6f24eULL}, /* 1e-297 */
+        {0xd1476e2c07286faaULL, 0x1af5af660db4aee1ULL}, /* 1e-296 */
+        {0x82cca4db847945caULL, 0x50d98d9fc890ed4dULL}, /* 1e-295 */
+        {0xa37fce126597973cULL, 0xe50ff107bab528a0ULL}, /* 1e-294 */
+        {0xcc5fc196fefd7d0cULL, 0x1e53ed49a96272c8ULL}, /* 1e-293 */
+        {0xff77b1fcbebcdc4fULL, 0x25e8e89c13bb0f7aULL}, /* 1e-292 */
+        {0x9faacf3df73609b1ULL, 0x77b191618c54e9acULL}, /* 1e-291 */
+        {0xc795830d75038c1dULL, 0xd59df5b9ef6a2417ULL}, /* 1e-290 */
+        {0xf97ae3d0d2446f25ULL, 0x4b0573286b44ad1dULL}, /* 1e-289 */
+        {0x9becce62836ac577ULL, 0x4ee367f9430aec32ULL}, /* 1e-288 */
+        {0xc2e801fb244576d5ULL, 0x229c41f793cda73fULL}, /* 1e-287 */
+        {0xf3a20279ed56d48aULL, 0x6b43527578c1110fULL}, /* 1e-286 */
+        {0x9845418c345644d6ULL, 0x830a13896b78aaa9ULL}, /* 1e-285 */
+        {0xbe5691ef416bd60cULL, 0x23cc986bc656d553ULL}, /* 1e-284 */
+        {0xedec366b11c6cb8fULL, 0x2cbfbe86b7ec8aa8ULL}, /* 1e-283 */
+        {0x94b3a202eb1c3f39ULL, 0x7bf7d71432f3d6a9ULL}, /* 1e-282 */
+        {0xb9e08a83a5e34f07ULL, 0xdaf5ccd93fb0cc53ULL}, /* 1e-281 */
+        {0xe858ad248f5c22c9ULL, 0xd1b3400f8f9cff68ULL}, /* 1e-280 */
+        {0x91376c36d99995beULL, 0x23100809b9c21fa1ULL}, /* 1e-279 */
+        {0xb58547448ffffb2dULL, 0xabd40a0c2832a78aULL}, /* 1e-278 */
+        {0xe2e69915b3fff9f9ULL, 0x16c90c8f323f516cULL}, /* 1e-277 */
+        {0x8dd01fad907ffc3bULL, 0xae3da7d97f6792e3ULL}, /* 1e-276 */
+        {0xb1442798f49ffb4aULL, 0x99cd11cfdf41779cULL}, /* 1e-275 */
+        {0xdd95317f31c7fa1dULL, 0x40405643d711d583ULL}, /* 1e-274 */
+        {0x8a7d3eef7f1cfc52ULL, 0x482835ea666b2572ULL}, /* 1e-273 */
+        {0xad1c8eab5ee43b66ULL, 0xda3243650005eecfULL}, /* 1e-272 */
+        {0xd863b256369d4a40ULL, 0x90bed43e40076a82ULL}, /* 1e-271 */
+        {0x873e4f75e2224e68ULL, 0x5a7744a6e804a291ULL}, /* 1e-270 */
+        {0xa90de3535aaae202ULL, 0x711515d0a205cb36ULL}, /* 1e-269 */
+        {0xd3515c2831559a83ULL, 0x0d5a5b44ca873e03ULL}, /* 1e-268 */
+        {0x8412d9991ed58091ULL, 0xe858790afe9486c2ULL}, /* 1e-267 */
+        {0xa5178fff668ae0b6ULL, 0x626e974dbe39a872ULL}, /* 1e-266 */
+        {0xce5d73ff402d98e3ULL, 0xfb0a3d212dc8128fULL}, /* 1e-265 */
+        {0x80fa687f881c7f8eULL, 0x7ce66634bc9d0b99ULL}, /* 1e-264 */
+        {0xa139029f6a239f72ULL, 0x1c1fffc1ebc44e80ULL}, /* 1e-263 */
+        {0xc987434744ac874eULL, 0xa327ffb266b56220ULL}, /* 1e-262 */
+        {0xfbe9141915d7a922ULL, 0x4bf1ff9f0062baa8ULL}, /* 1e-261 */
+        {0x9d71ac8fada6c9b5ULL, 0x6f773fc3603db4a9ULL}, /* 1e-260 */
+        {0xc4ce17b399107c22ULL, 0xcb550fb4384d21d3ULL}, /* 1e-259 */
+        {0xf6019da07f549b2bULL, 0x7e2a53a146606a48ULL}, /* 1e-258 */
+        {0x99c102844f94e0fbULL, 0x2eda7444cbfc426dULL}, /* 1e-257 */
+        {0xc0314325637a1939ULL, 0xfa911155fefb5308ULL}, /* 1e-256 */
+        {0xf03d93eebc589f88ULL, 0x793555ab7eba27caULL}, /* 1e-255 */
+        {0x96267c7535b763b5ULL, 0x4bc1558b2f3458deULL}, /* 1e-254 */
+        {0xbbb01b9283253ca2ULL, 0x9eb1aaedfb016f16ULL}, /* 1e-253 */
+        {0xea9c227723ee8bcbULL, 0x465e15a979c1cadcULL}, /* 1e-252 */
+        {0x92a1958a7675175fULL, 0x0bfacd89ec191ec9ULL}, /* 1e-251 */
+        {0xb749faed14125d36ULL, 0xcef980ec671f667bULL}, /* 1e-250 */
+        {0xe51c79a85916f484ULL, 0x82b7e12780e7401aULL}, /* 1e-249 */
+        {0x8f31cc0937ae58d2ULL, 0xd1b2ecb8b0908810ULL}, /* 1e-248 */
+        {0xb2fe3f0b8599ef07ULL, 0x861fa7e6dcb4aa15ULL}, /* 1e-247 */
+        {0xdfbdcece67006ac9ULL, 0x67a791e093e1d49aULL}, /* 1e-246 */
+        {0x8bd6a141006042bdULL, 0xe0c8bb2c5c6d24e0ULL}, /* 1e-245 */
+        {0xaecc49914078536dULL, 0x58fae9f773886e18ULL}, /* 1e-244 */
+        {0xda7f5bf590966848ULL, 0xaf39a475506a899eULL}, /* 1e-243 */
+        {0x888f99797a5e012dULL, 0x6d8406c952429603ULL}, /* 1e-242 */
+        {0xaab37fd7d8f58178ULL, 0xc8e5087ba6d33b83ULL}, /* 1e-241 */
+        {0xd5605fcdcf32e1d6ULL, 0xfb1e4a9a90880a64ULL}, /* 1e-240 */
+        {0x855c3be0a17fcd26ULL, 0x5cf2eea09a55067fULL}, /* 1e-239 */
+        {0xa6b34ad8c9dfc06fULL, 0xf42faa48c0ea481eULL}, /* 1e-238 */
+        {0xd0601d8efc57b08bULL, 0xf13b94daf124da26ULL}, /* 1e-237 */
+        {0x823c12795db6ce57ULL, 0x76c53d08d6b70858ULL}, /* 1e-236 */
+        {0xa2cb1717b52481edULL, 0x54768c4b0c64ca6eULL}, /* 1e-235 */
+        {0xcb7ddcdda26da268ULL, 0xa9942f5dcf7dfd09ULL}, /* 1e-234 */
+        {0xfe5d54150b090b02ULL, 0xd3f93b35435d7c4cULL}, /* 1e-233 */
+        {0x9efa548d26e5a6e1ULL, 0xc47bc5014a1a6dafULL}, /* 1e-232 */
+        {0xc6b8e9b0709f109aULL, 0x359ab6419ca1091bULL}, /* 1e-231 */
+        {0xf867241c8cc6d4c0ULL, 0xc30163d203c94b62ULL}, /* 1e-230 */
+        {0x9b407691d7fc44f8ULL, 0x79e0de63425dcf1dULL}, /* 1e-229 */
+        {0xc21094364dfb5636ULL, 0x985915fc12f542e4ULL}, /* 1e-228 */
+        {0xf294b943e17a2bc4ULL, 0x3e6f5b7b17b2939dULL}, /* 1e-227 */
+        {0x979cf3ca6cec5b5aULL, 0xa705992ceecf9c42ULL}, /* 1e-226 */
+        {0xbd8430bd08277231ULL, 0x50c6ff782a838353ULL}, /* 1e-225 */
+        {0xece53cec4a314ebdULL, 0xa4f8bf5635246428ULL}, /* 1e-224 */
+        {0x940f4613ae5ed136ULL, 0x871b7795e136be99ULL}, /* 1e-223 */
+        {0xb913179899f68584ULL, 0x28e2557b59846e3fULL}, /* 1e-222 */
+        {0xe757dd7ec07426e5ULL, 0x331aeada2fe589cfULL}, /* 1e-221 */
+        {0x9096ea6f3848984fULL, 0x3ff0d2c85def7621ULL}, /* 1e-220 */
+        {0xb4bca50b065abe63ULL, 0x0fed077a756b53a9ULL}, /* 1e-219 */
+        {0xe1ebce4dc7f16dfbULL, 0xd3e8495912c62894ULL}, /* 1e-218 */
+        {0x8d3360f09cf6e4bdULL, 0x64712dd7abbbd95cULL}, /* 1e-217 */
+        {0xb080392cc4349decULL, 0xbd8d794d96aacfb3ULL}, /* 1e-216 */
+        {0xdca04777f541c567ULL, 0xecf0d7a0fc5583a0ULL}, /* 1e-215 */
+        {0x89e42caaf9491b60ULL, 0xf41686c49db57244ULL}, /* 1e-214 */
+        {0xac5d37d5b79b6239ULL, 0x311c2875c522ced5ULL}, /* 1e-213 */
+        {0xd77485cb25823ac7ULL, 0x7d633293366b828bULL}, /* 1e-212 */
+        {0x86a8d39ef77164bcULL, 0xae5dff9c02033197ULL}, /* 1e-211 */
+        {0xa8530886b54dbdebULL, 0xd9f57f830283fdfcULL}, /* 1e-210 */
+        {0xd267caa862a12d66ULL, 0xd072df63c324fd7bULL}, /* 1e-209 */
+        {0x8380dea93da4bc60ULL, 0x4247cb9e59f71e6dULL}, /* 1e-208 */
+        {0xa46116538d0deb78ULL, 0x52d9be85f074e608ULL}, /* 1e-207 */
+        {0xcd795be870516656ULL, 0x67902e276c921f8bULL}, /* 1e-206 */
+        {0x806bd9714632dff6ULL, 0x00ba1cd8a3db53b6ULL}, /* 1e-205 */
+        {0xa086cfcd97bf97f3ULL, 0x80e8a40eccd228a4ULL}, /* 1e-204 */
+        {0xc8a883c0fdaf7df0ULL, 0x6122cd128006b2cdULL}, /* 1e-203 */
+        {0xfad2a4b13d1b5d6cULL, 0x796b805720085f81ULL}, /* 1e-202 */
+        {0x9cc3a6eec6311a63ULL, 0xcbe3303674053bb0ULL}, /* 1e-201 */
+        {0xc3f490aa77bd60fcULL, 0xbedbfc4411068a9cULL}, /* 1e-200 */
+        {0xf4f1b4d515acb93bULL, 0xee92fb5515482d44ULL}, /* 1e-199 */
+        {0x991711052d8bf3c5ULL, 0x751bdd152d4d1c4aULL}, /* 1e-198 */
+        {0xbf5cd54678eef0b6ULL, 0xd262d45a78a0635dULL}, /* 1e-197 */
+        {0xef340a98172aace4ULL, 0x86fb897116c87c34ULL}, /* 1e-196 */
+        {0x9580869f0e7aac0eULL, 0xd45d35e6ae3d4da0ULL}, /* 1e-195 */
+        {0xbae0a846d2195712ULL, 0x8974836059cca109ULL}, /* 1e-194 */
+        {0xe998d258869facd7ULL, 0x2bd1a438703fc94bULL}, /* 1e-193 */
+        {0x91ff83775423cc06ULL, 0x7b6306a34627ddcfULL}, /* 1e-192 */
+        {0xb67f6455292cbf08ULL, 0x1a3bc84c17b1d542ULL}, /* 1e-191 */
+        {0xe41f3d6a7377eecaULL, 0x20caba5f1d9e4a93ULL}, /* 1e-190 */
+        {0x8e938662882af53eULL, 0x547eb47b7282ee9cULL}, /* 1e-189 */
+        {0xb23867fb2a35b28dULL, 0xe99e619a4f23aa43ULL}, /* 1e-188 */
+        {0xdec681f9f4c31f31ULL, 0x6405fa00e2ec94d4ULL}, /* 1e-187 */
+        {0x8b3c113c38f9f37eULL, 0xde83bc408dd3dd04ULL}, /* 1e-186 */
+        {0xae0b158b4738705eULL, 0x9624ab50b148d445ULL}, /* 1e-185 */
+        {0xd98ddaee19068c76ULL, 0x3badd624dd9b0957ULL}, /* 1e-184 */
+        {0x87f8a8d4cfa417c9ULL, 0xe54ca5d70a80e5d6ULL}, /* 1e-183 */
+        {0xa9f6d30a038d1dbcULL, 0x5e9fcf4ccd211f4cULL}, /* 1e-182 */
+        {0xd47487cc8470652bULL, 0x7647c3200069671fULL}, /* 1e-181 */
+        {0x84c8d4dfd2c63f3bULL, 0x29ecd9f40041e073ULL}, /* 1e-180 */
+        {0xa5fb0a17c777cf09ULL, 0xf468107100525890ULL}, /* 1e-179 */
+        {0xcf79cc9db955c2ccULL, 0x7182148d4066eeb4ULL}, /* 1e-178 */
+        {0x81ac1fe293d599bfULL, 0xc6f14cd848405530ULL}, /* 1e-177 */
+        {0xa21727db38cb002fULL, 0xb8ada00e5a506a7cULL}, /* 1e-176 */
+        {0xca9cf1d206fdc03bULL, 0xa6d90811f0e4851cULL}, /* 1e-175 */
+        {0xfd442e4688bd304aULL, 0x908f4a166d1da663ULL}, /* 1e-174 */
+        {0x9e4a9cec15763e2eULL, 0x9a598e4e043287feULL}, /* 1e-173 */
+        {0xc5dd44271ad3cdbaULL, 0x40eff1e1853f29fdULL}, /* 1e-172 */
+        {0xf7549530e188c128ULL, 0xd12bee59e68ef47cULL}, /* 1e-171 */
+        {0x9a94dd3e8cf578b9ULL, 0x82bb74f8301958ceULL}, /* 1e-170 */
+        {0xc13a148e3032d6e7ULL, 0xe36a52363c1faf01ULL}, /* 1e-169 */
+        {0xf18899b1bc3f8ca1ULL, 0xdc44e6c3cb279ac1ULL}, /* 1e-168 */
+        {0x96f5600f15a7b7e5ULL, 0x29ab103a5ef8c0b9ULL}, /* 1e-167 */
+        {0xbcb2b812db11a5deULL, 0x7415d448f6b6f0e7ULL}, /* 1e-166 */
+        {0xebdf661791d60f56ULL, 0x111b495b3464ad21ULL}, /* 1e-165 */
+        {0x936b9fcebb25c995ULL, 0xcab10dd900beec34ULL}, /* 1e-164 */
+        {0xb84687c269ef3bfbULL, 0x3d5d514f40eea742ULL}, /* 1e-163 */
+        {0xe65829b3046b0afaULL, 0x0cb4a5a3112a5112ULL}, /* 1e-162 */
+        {0x8ff71a0fe2c2e6dcULL, 0x47f0e785eaba72abULL}, /* 1e-161 */
+        {0xb3f4e093db73a093ULL, 0x59ed216765690f56ULL}, /* 1e-160 */
+        {0xe0f218b8d25088b8ULL, 0x306869c13ec3532cULL}, /* 1e-159 */
+        {0x8c974f7383725573ULL, 0x1e414218c73a13fbULL}, /* 1e-158 */
+        {0xafbd2350644eeacfULL, 0xe5d1929ef90898faULL}, /* 1e-157 */
+        {0xdbac6c247d62a583ULL, 0xdf45f746b74abf39ULL}, /* 1e-156 */
+        {0x894bc396ce5da772ULL, 0x6b8bba8c328eb783ULL}, /* 1e-155 */
+        {0xab9eb47c81f5114fULL, 0x066ea92f3f326564ULL}, /* 1e-154 */
+        {0xd686619ba27255a2ULL, 0xc80a537b0efefebdULL}, /* 1e-153 */
+        {0x8613fd0145877585ULL, 0xbd06742ce95f5f36ULL}, /* 1e-152 */
+        {0xa798fc4196e952e7ULL, 0x2c48113823b73704ULL}, /* 1e-151 */
+        {0xd17f3b51fca3a7a0ULL, 0xf75a15862ca504c5ULL}, /* 1e-150 */
+        {0x82ef85133de648c4ULL, 0x9a984d73dbe722fbULL}, /* 1e-149 */
+        {0xa3ab66580d5fdaf5ULL, 0xc13e60d0d2e0ebbaULL}, /* 1e-148 */
+        {0xcc963fee10b7d1b3ULL, 0x318df905079926a8ULL}, /* 1e-147 */
+        {0xffbbcfe994e5c61fULL, 0xfdf17746497f7052ULL}, /* 1e-146 */
+        {0x9fd561f1fd0f9bd3ULL, 0xfeb6ea8bedefa633ULL}, /* 1e-145 */
+        {0xc7caba6e7c5382c8ULL, 0xfe64a52ee96b8fc0ULL}, /* 1e-144 */
+        {0xf9bd690a1b68637bULL, 0x3dfdce7aa3c673b0ULL}, /* 1e-143 */
+        {0x9c1661a651213e2dULL, 0x06bea10ca65c084eULL}, /* 1e-142 */
+        {0xc31bfa0fe5698db8ULL, 0x486e494fcff30a62ULL}, /* 1e-141 */
+        {0xf3e2f893dec3f126ULL, 0x5a89dba3c3efccfaULL}, /* 1e-140 */
+        {0x986ddb5c6b3a76b7ULL, 0xf89629465a75e01cULL}, /* 1e-139 */
+        {0xbe89523386091465ULL, 0xf6bbb397f1135823ULL}, /* 1e-138 */
+        {0xee2ba6c0678b597fULL, 0x746aa07ded582e2cULL}, /* 1e-137 */
+        {0x94db483840b717efULL, 0xa8c2a44eb4571cdcULL}, /* 1e-136 */
+        {0xba121a4650e4ddebULL, 0x92f34d62616ce413ULL}, /* 1e-135 */
+        {0xe896a0d7e51e1566ULL, 0x77b020baf9c81d17ULL}, /* 1e-134 */
+        {0x915e2486ef32cd60ULL, 0x0ace1474dc1d122eULL}, /* 1e-133 */
+        {0xb5b5ada8aaff80b8ULL, 0x0d819992132456baULL}, /* 1e-132 */
+        {0xe3231912d5bf60e6ULL, 0x10e1fff697ed6c69ULL}, /* 1e-131 */
+        {0x8df5efabc5979c8fULL, 0xca8d3ffa1ef463c1ULL}, /* 1e-130 */
+        {0xb1736b96b6fd83b3ULL, 0xbd308ff8a6b17cb2ULL}, /* 1e-129 */
+        {0xddd0467c64bce4a0ULL, 0xac7cb3f6d05ddbdeULL}, /* 1e-128 */
+        {0x8aa22c0dbef60ee4ULL, 0x6bcdf07a423aa96bULL}, /* 1e-127 */
+        {0xad4ab7112eb3929dULL, 0x86c16c98d2c953c6ULL}, /* 1e-126 */
+        {0xd89d64d57a607744ULL, 0xe871c7bf077ba8b7ULL}, /* 1e-125 */
+        {0x87625f056c7c4a8bULL, 0x11471cd764ad4972ULL}, /* 1e-124 */
+        {0xa93af6c6c79b5d2dULL, 0xd598e40d3dd89bcfULL}, /* 1e-123 */
+        {0xd389b47879823479ULL, 0x4aff1d108d4ec2c3ULL}, /* 1e-122 */
+        {0x843610cb4bf160cbULL, 0xcedf722a585139baULL}, /* 1e-121 */
+        {0xa54394fe1eedb8feULL, 0xc2974eb4ee658828ULL}, /* 1e-120 */
+        {0xce947a3da6a9273eULL, 0x733d226229feea32ULL}, /* 1e-119 */
+        {0x811ccc668829b887ULL, 0x0806357d5a3f525fULL}, /* 1e-118 */
+        {0xa163ff802a3426a8ULL, 0xca07c2dcb0cf26f7ULL}, /* 1e-117 */
+        {0xc9bcff6034c13052ULL, 0xfc89b393dd02f0b5ULL}, /* 1e-116 */
+        {0xfc2c3f3841f17c67ULL, 0xbbac2078d443ace2ULL}, /* 1e-115 */
+        {0x9d9ba7832936edc0ULL, 0xd54b944b84aa4c0dULL}, /* 1e-114 */
+        {0xc5029163f384a931ULL, 0x0a9e795e65d4df11ULL}, /* 1e-113 */
+        {0xf64335bcf065d37dULL, 0x4d4617b5ff4a16d5ULL}, /* 1e-112 */
+        {0x99ea0196163fa42eULL, 0x504bced1bf8e4e45ULL}, /* 1e-111 */
+        {0xc06481fb9bcf8d39ULL, 0xe45ec2862f71e1d6ULL}, /* 1e-110 */
+        {0xf07da27a82c37088ULL, 0x5d767327bb4e5a4cULL}, /* 1e-109 */
+        {0x964e858c91ba2655ULL, 0x3a6a07f8d510f86fULL}, /* 1e-108 */
+        {0xbbe226efb628afeaULL, 0x890489f70a55368bULL}, /* 1e-107 */
+        {0xeadab0aba3b2dbe5ULL, 0x2b45ac74ccea842eULL}, /* 1e-106 */
+        {0x92c8ae6b464fc96fULL, 0x3b0b8bc90012929dULL}, /* 1e-105 */
+        {0xb77ada0617e3bbcbULL, 0x09ce6ebb40173744ULL}, /* 1e-104 */
+        {0xe55990879ddcaabdULL, 0xcc420a6a101d0515ULL}, /* 1e-103 */
+        {0x8f57fa54c2a9eab6ULL, 0x9fa946824a12232dULL}, /* 1e-102 */
+        {0xb32df8e9f3546564ULL, 0x47939822dc96abf9ULL}, /* 1e-101 */
+        {0xdff9772470297ebdULL, 0x59787e2b93bc56f7ULL}, /* 1e-100 */
+        {0x8bfbea76c619ef36ULL, 0x57eb4edb3c55b65aULL}, /* 1e-99 */
+        {0xaefae51477a06b03ULL, 0xede622920b6b23f1ULL}, /* 1e-98 */
+        {0xdab99e59958885c4ULL, 0xe95fab368e45ecedULL}, /* 1e-97 */
+        {0x88b402f7fd75539bULL, 0x11dbcb0218ebb414ULL}, /* 1e-96 */
+        {0xaae103b5fcd2a881ULL, 0xd652bdc29f26a119ULL}, /* 1e-95 */
+        {0xd59944a37c0752a2ULL, 0x4be76d3346f0495fULL}, /* 1e-94 */
+        {0x857fcae62d8493a5ULL, 0x6f70a4400c562ddbULL}, /* 1e-93 */
+        {0xa6dfbd9fb8e5b88eULL, 0xcb4ccd500f6bb952ULL}, /* 1e-92 */
+        {0xd097ad07a71f26b2ULL, 0x7e2000a41346a7a7ULL}, /* 1e-91 */
+        {0x825ecc24c873782fULL, 0x8ed400668c0c28c8ULL}, /* 1e-90 */
+        {0xa2f67f2dfa90563bULL, 0x728900802f0f32faULL}, /* 1e-89 */
+        {0xcbb41ef979346bcaULL, 0x4f2b40a03ad2ffb9ULL}, /* 1e-88 */
+        {0xfea126b7d78186bcULL, 0xe2f610c84987bfa8ULL}, /* 1e-87 */
+        {0x9f24b832e6b0f436ULL, 0x0dd9ca7d2df4d7c9ULL}, /* 1e-86 */
+        {0xc6ede63fa05d3143ULL, 0x91503d1c79720dbbULL}, /* 1e-85 */
+        {0xf8a95fcf88747d94ULL, 0x75a44c6397ce912aULL}, /* 1e-84 */
+        {0x9b69dbe1b548ce7cULL, 0xc986afbe3ee11abaULL}, /* 1e-83 */
+        {0xc24452da229b021bULL, 0xfbe85badce996168ULL}, /* 1e-82 */
+        {0xf2d56790ab41c2a2ULL, 0xfae27299423fb9c3ULL}, /* 1e-81 */
+        {0x97c560ba6b0919a5ULL, 0xdccd879fc967d41aULL}, /* 1e-80 */
+        {0xbdb6b8e905cb600fULL, 0x5400e987bbc1c920ULL}, /* 1e-79 */
+        {0xed246723473e3813ULL, 0x290123e9aab23b68ULL}, /* 1e-78 */
+        {0x9436c0760c86e30bULL, 0xf9a0b6720aaf6521ULL}, /* 1e-77 */
+        {0xb94470938fa89bceULL, 0xf808e40e8d5b3e69ULL}, /* 1e-76 */
+        {0xe7958cb87392c2c2ULL, 0xb60b1d1230b20e04ULL}, /* 1e-75 */
+        {0x90bd77f3483bb9b9ULL, 0xb1c6f22b5e6f48c2ULL}, /* 1e-74 */
+        {0xb4ecd5f01a4aa828ULL, 0x1e38aeb6360b1af3ULL}, /* 1e-73 */
+        {0xe2280b6c20dd5232ULL, 0x25c6da63c38de1b0ULL}, /* 1e-72 */
+        {0x8d590723948a535fULL, 0x579c487e5a38ad0eULL}, /* 1e-71 */
+        {0xb0af48ec79ace837ULL, 0x2d835a9df0c6d851ULL}, /* 1e-70 */
+        {0xdcdb1b2798182244ULL, 0xf8e431456cf88e65ULL}, /* 1e-69 */
+        {0x8a08f0f8bf0f156bULL, 0x1b8e9ecb641b58ffULL}, /* 1e-68 */
+        {0xac8b2d36eed2dac5ULL, 0xe272467e3d222f3fULL}, /* 1e-67 */
+        {0xd7adf884aa879177ULL, 0x5b0ed81dcc6abb0fULL}, /* 1e-66 */
+        {0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL}, /* 1e-65 */
+        {0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL}, /* 1e-64 */
+        {0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL}, /* 1e-63 */
+        {0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL}, /* 1e-62 */
+        {0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL}, /* 1e-61 */
+        {0xcdb02555653131b6ULL, 0x3792f412cb06794dULL}, /* 1e-60 */
+        {0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL}, /* 1e-59 */
+        {0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL}, /* 1e-58 */
+        {0xc8de047564d20a8bULL, 0xf245825a5a445275ULL}, /* 1e-57 */
+        {0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL}, /* 1e-56 */
+        {0x9ced737bb6c4183dULL, 0x55464dd69685606bULL}, /* 1e-55 */
+        {0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL}, /* 1e-54 */
+        {0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL}, /* 1e-53 */
+        {0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL}, /* 1e-52 */
+        {0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL}, /* 1e-51 */
+        {0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL}, /* 1e-50 */
+        {0x95a8637627989aadULL, 0xdde7001379a44aa8ULL}, /* 1e-49 */
+        {0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL}, /* 1e-48 */
+        {0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL}, /* 1e-47 */
+        {0x9226712162ab070dULL, 0xcab3961304ca70e8ULL}, /* 1e-46 */
+        {0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL}, /* 1e-45 */
+        {0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL}, /* 1e-44 */
+        {0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL}, /* 1e-43 */
+        {0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL}, /* 1e-42 */
+        {0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL}, /* 1e-41 */
+        {0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL}, /* 1e-40 */
+        {0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL}, /* 1e-39 */
+        {0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL}, /* 1e-38 */
+        {0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL}, /* 1e-37 */
+        {0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL}, /* 1e-36 */
+        {0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL}, /* 1e-35 */
+        {0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL}, /* 1e-34 */
+        {0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL}, /* 1e-33 */
+        {0xcfb11ead453994baULL, 0x67de18eda5814af2ULL}, /* 1e-32 */
+        {0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL}, /* 1e-31 */
+        {0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL}, /* 1e-30 */
+        {0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL}, /* 1e-29 */
+        {0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL}, /* 1e-28 */
+        {0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL}, /* 1e-27 */
+        {0xc612062576589ddaULL, 0x95364afe032a819eULL}, /* 1e-26 */
+        {0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL}, /* 1e-25 */
+        {0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL}, /* 1e-24 */
+        {0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL}, /* 1e-23 */
+        {0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL}, /* 1e-22 */
+        {0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL}, /* 1e-21 */
+        {0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL}, /* 1e-20 */
+        {0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL}, /* 1e-19 */
+        {0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL}, /* 1e-18 */
+        {0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL}, /* 1e-17 */
+        {0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL}, /* 1e-16 */
+        {0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL}, /* 1e-15 */
+        {0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL}, /* 1e-14 */
+        {0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL}, /* 1e-13 */
+        {0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL}, /* 1e-12 */
+        {0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL}, /* 1e-11 */
+        {0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL}, /* 1e-10 */
+        {0x89705f4136b4a597ULL, 0x31680a88f8953031ULL}, /* 1e-9 */
+        {0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL}, /* 1e-8 */
+        {0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL}, /* 1e-7 */
+        {0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL}, /* 1e-6 */
+        {0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL}, /* 1e-5 */
+        {0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL}, /* 1e-4 */
+        {0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL}, /* 1e-3 */
+        {0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL}, /* 1e-2 */
+        {0xccccccccccccccccULL, 0xcccccccccccccccdULL}, /* 1e-1 */
+        {0x8000000000000000ULL, 0x0000000000000000ULL}, /* 1e0 */
+};
+
+/* Exact powers of 10 which are representable by a double, used by Clinger's fast path */
+static const double exact_powers_of_ten[23] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                               1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                               1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static inline void multiply(uint64_t a, uint64_t b, uint64_t& high, uint64_t& low) {
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 product = (unsigned __int128)a * b;
+    high = (uint64_t)(product >> 64);
+    low = (uint64_t)product;
+#else
+    uint64_t a_low = (uint32_t)a, a_high = a >> 32;
+    uint64_t b_low = (uint32_t)b, b_high = b >> 32;
+
+    uint64_t low_low = a_low * b_low;
+    uint64_t high_low = a_high * b_low;
+    uint64_t low_high = a_low * b_high;
+    uint64_t high_high = a_high * b_high;
+
+    uint64_t middle = high_low + (low_low >> 32) + (uint32_t)low_high;
+    high = high_high + (middle >> 32) + (low_high >> 32);
+    low = (middle << 32) | (uint32_t)low_low;
+#endif
+}
+
+static inline int leadingZeros(uint64_t n) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(n);
+#else
+    int zeros = 0;
+    while (!(n & ((uint64_t)1 << 63))) {
+        n <<= 1;
+        zeros++;
+    }
+    return zeros;
+#endif
+}
+
+/* The Eisel-Lemire algorithm, converts `mantissa * 10^exponent` to the nearest double. Returns false
+ * for the rare cases where the 128 bit approximation isn't precise enough to decide the rounding */
+static bool eiselLemire(uint64_t mantissa, int exponent, double& result) {
+    const uint64_t* power = powers_of_ten[exponent + 342];
+
+    int zeros = leadingZeros(mantissa);
+    mantissa <<= zeros;
+
+    uint64_t upper, lower;
+    multiply(mantissa, power[0], upper, lower);
+
+    /* The truncated bits could carry into the bits which decide the rounding, so the lower half of
+     * the power gets multiplied in as well */
+    if ((upper & 0x1FF) == 0x1FF && lower + mantissa < lower) {
+        uint64_t product_high, product_low;
+        multiply(mantissa, power[1], product_high, product_low);
+
+        uint64_t middle = lower + product_high;
+        if (middle < lower) {
+            upper++;
+        }
+
+        if (middle + 1 == 0 && (upper & 0x1FF) == 0x1FF && product_low + mantissa < product_low) {
+            return false;
+        }
+
+        lower = middle;
+    }
+
+    uint64_t upper_bit = upper >> 63;
+    uint64_t bits = upper >> (upper_bit + 9);
+    zeros += (int)(1 ^ upper_bit);
+
+    /* Exactly halfway between two doubles, ties to even can't be decided from here */
+    if (lower == 0 && (upper & 0x1FF) == 0 && (bits & 3) == 1) {
+        return false;
+    }
+
+    bits += bits & 1;
+    bits >>= 1;
+    if (bits >= ((uint64_t)1 << 53)) {
+        bits = (uint64_t)1 << 52;
+        zeros--;
+    }
+    bits &= ~((uint64_t)1 << 52);
+
+    /* Subnormals and overflows are left to the slow path */
+    int64_t biased_exponent = ((((int64_t)152170 + 65536) * exponent) >> 16) + 1024 + 63 - zeros;
+    if (biased_exponent < 1 || biased_exponent > 2046) {
+        return false;
+    }
+
+    bits |= (uint64_t)biased_exponent << 52;
+    std::memcpy(&result, &bits, sizeof(result));
+    return true;
+}
+
+bool kh::parseInteger(const char32_t* begin, const char32_t* end, unsigned base, uint64_t& value) {
+    value = 0;
+
+    for (const char32_t* ptr = begin; ptr < end; ptr++) {
+        uint64_t digit = kh::hexDigit(*ptr);
+
+        if (value > (UINT64_MAX - digit) / base) {
+            return false;
+        }
+
+        value = value * base + digit;
+    }
+
+    return true;
+}
+
+double kh::parseFloating(const char32_t* begin, const char32_t* end) {
+    /* The significant digits are the digits without the leading zeros, the literal is equal to them
+     * times 10^exponent */
+    const char32_t* ptr = begin;
+    int64_t exponent = 0;
+    bool after_dot = false;
+
+    for (; ptr < end && (*ptr == U'0' || *ptr == U'.'); ptr++) {
+        if (*ptr == U'.') {
+            after_dot = true;
+        }
+        else if (after_dot) {
+            exponent--;
+        }
+    }
+
+    const char32_t* significant = ptr;
+    uint64_t mantissa = 0;
+    size_t digits = 0;
+    bool truncated = false;
+
+    for (; ptr < end; ptr++) {
+        if (*ptr == U'.') {
+            after_dot = true;
+            continue;
+        }
+
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*ptr - U'0');
+            digits++;
+            exponent -= after_dot;
+        }
+        else {
+            /* Every digit past the 19th is dropped, only the place value of the dropped integer
+             * digits is kept */
+            truncated = truncated || *ptr != U'0';
+            exponent += !after_dot;
+        }
+    }
+
+    if (mantissa == 0) {
+        return 0.0;
+    }
+
+    if (!truncated) {
+        /* Clinger's fast path, both of the operands are exact so the result is correctly rounded */
+        if (mantissa <= ((uint64_t)1 << 53) && -22 <= exponent && exponent <= 22) {
+            return exponent < 0 ? (double)mantissa / exact_powers_of_ten[-exponent]
+                                : (double)mantissa * exact_powers_of_ten[exponent];
+        }
+
+        double result;
+        if (-342 <= exponent && exponent <= 0 && eiselLemire(mantissa, (int)exponent, result)) {
+            return result;
+        }
+    }
+
+    /* Exact conversion by `strtod` on the significant digits in scientific notation, written into a
+     * buffer on the stack */
+    char buffer[KH_LITERAL_MAX_DIGITS + 32];
+    size_t length = 0;
+    bool sticky = false;
+    exponent = 0;
+    after_dot = false;
+
+    for (ptr = begin; ptr < significant; ptr++) {
+        if (*ptr == U'.') {
+            after_dot = true;
+        }
+        else if (after_dot) {
+            exponent--;
+        }
+    }
+
+    for (ptr = significant; ptr < end; ptr++) {
+        if (*ptr == U'.') {
+            after_dot = true;
+        }
+        else if (length < KH_LITERAL_MAX_DIGITS) {
+            buffer[length++] = (char)*ptr;
+            exponent -= after_dot;
+        }
+        else {
+            sticky = sticky || *ptr != U'0';
+            exponent += !after_dot;
+        }
+    }
+
+    /* A trailing non-zero digit stands in for the dropped digits, so they are never rounded as if
+     * the literal was exactly halfway between two doubles */
+    if (sticky) {
+        buffer[length++] = '1';
+        exponent--;
+    }
+
+    buffer[length++] = 'e';
+    std::snprintf(buffer + length, sizeof(buffer) - length, "%lld", (long long)exponent);
+    return std::strtod(buffer, nullptr);
+}
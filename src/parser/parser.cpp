@@ -4,13 +4,125 @@
  * Copyright (C) 2021 Kithare Organization
  */
 
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sys/resource.h>
+#endif
+
 #include <kithare/parser.hpp>
 #include <kithare/utf8.hpp>
 
 
 std::string kh::ParseException::format() const {
-    return this->what + " at line " + std::to_string(this->token.line) + " column " +
-           std::to_string(this->token.column);
+    return this->what + " at line " + std::to_string(this->line) + " column " +
+           std::to_string(this->column);
+}
+
+void kh::ParserContext::error(const std::string& what, const kh::Token& token) {
+    if (!this->panicking && this->exceptions.size() <= KH_PARSE_ERROR_LIMIT) {
+        if (this->exceptions.size() == KH_PARSE_ERROR_LIMIT) {
+            this->exceptions.emplace_back("too many errors, skipping the rest of the file", token);
+        }
+        else {
+            this->exceptions.emplace_back(what, token);
+        }
+    }
+
+    this->panicking = true;
+}
+
+static bool isSyncKeyword(const std::string& identifier, kh::ParseScope scope) {
+    switch (scope) {
+        case kh::ParseScope::TOP:
+            return identifier == "def" || identifier == "try" || identifier == "class" ||
+                   identifier == "struct" || identifier == "enum" || identifier == "import" ||
+                   identifier == "include" || identifier == "public" || identifier == "private" ||
+                   identifier == "static";
+
+        case kh::ParseScope::USER_TYPE:
+            return identifier == "def" || identifier == "try" || identifier == "public" ||
+                   identifier == "private" || identifier == "static";
+
+        case kh::ParseScope::BODY:
+            return identifier == "if" || identifier == "while" || identifier == "do" ||
+                   identifier == "for" || identifier == "continue" || identifier == "break" ||
+                   identifier == "return";
+    }
+
+    return false;
+}
+
+void kh::recover(KH_PARSE_CTX, kh::ParseScope scope) {
+    if (!context.panicking) {
+        return;
+    }
+    context.panicking = false;
+
+    if (context.exceptions.size() > KH_PARSE_ERROR_LIMIT) {
+        context.ti = context.tokens.size();
+        return;
+    }
+
+    /* The construct which failed already stopped at a boundary */
+    if (context.ti == 0 || context.ti > context.tokens.size()) {
+        return;
+    }
+
+    const kh::Token& previous = context.tokens[context.ti - 1];
+    if (previous.type == kh::TokenType::SYMBOL &&
+        (previous.value.symbol_type == kh::Symbol::SEMICOLON ||
+         previous.value.symbol_type == kh::Symbol::CURLY_OPEN ||
+         previous.value.symbol_type == kh::Symbol::CURLY_CLOSE)) {
+        return;
+    }
+
+    /* Skips whole blocks so the keywords and semicolons inside of them aren't mistaken as the end of
+     * the broken construct */
+    size_t depth = 0;
+    for (; context.ti < context.tokens.size(); context.ti++) {
+        const kh::Token& token = context.tok();
+
+        if (token.type == kh::TokenType::SYMBOL) {
+            switch (token.value.symbol_type) {
+                case kh::Symbol::CURLY_OPEN:
+                    depth++;
+                    break;
+
+                case kh::Symbol::CURLY_CLOSE:
+                    if (depth == 0) {
+                        /* A stray closing bracket on the top scope is skipped, otherwise it closes
+                         * the enclosing block which its parser handles */
+                        if (scope == kh::ParseScope::TOP) {
+                            context.ti++;
+                        }
+                        return;
+                    }
+
+                    depth--;
+                    if (depth == 0) {
+                        context.ti++;
+                        return;
+                    }
+                    break;
+
+                case kh::Symbol::SEMICOLON:
+                    if (depth == 0) {
+                        context.ti++;
+                        return;
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+        }
+        else if (depth == 0 && token.type == kh::TokenType::IDENTIFIER &&
+                 isSyncKeyword(token.value.identifier, scope)) {
+            return;
+        }
+    }
 }
 
 kh::AstModule kh::parse(const std::vector<kh::Token>& tokens) {
@@ -26,8 +138,80 @@ kh::AstModule kh::parse(const std::vector<kh::Token>& tokens) {
     }
 }
 
+size_t kh::maxNestingLimit() {
+    static const size_t limit = []() {
+        size_t stack = 0;
+#ifdef __linux__
+        /* The main thread's stack is the soft limit, the threads get glibc's default */
+        rlimit main_limit;
+        if (getrlimit(RLIMIT_STACK, &main_limit) == 0 && main_limit.rlim_cur != RLIM_INFINITY) {
+            stack = (size_t)main_limit.rlim_cur;
+        }
+#ifdef __GLIBC__
+        pthread_attr_t attributes;
+        size_t thread_stack;
+        if (pthread_getattr_default_np(&attributes) == 0) {
+            if (pthread_attr_getstacksize(&attributes, &thread_stack) == 0) {
+                stack = stack ? std::min(stack, thread_stack) : thread_stack;
+            }
+            pthread_attr_destroy(&attributes);
+        }
+#endif
+#endif
+        return std::max((size_t)KH_PARSE_NESTING_LIMIT, stack / 2 / KH_PARSE_LEVEL_STACK);
+    }();
+
+    return limit;
+}
+
+void kh::skipNesting(KH_PARSE_CTX, bool is_body) {
+    context.error("exceeded the nesting limit of " + std::to_string(context.nesting_limit),
+                  context.ti < context.tokens.size() ? context.tok() : context.tokens.back());
+
+    size_t depth = 0;
+    for (; context.ti < context.tokens.size(); context.ti++) {
+        const kh::Token& token = context.tok();
+        if (token.type != kh::TokenType::SYMBOL) {
+            continue;
+        }
+
+        switch (token.value.symbol_type) {
+            case kh::Symbol::PARENTHESES_OPEN:
+            case kh::Symbol::SQUARE_OPEN:
+            case kh::Symbol::CURLY_OPEN:
+                depth++;
+                break;
+
+            case kh::Symbol::PARENTHESES_CLOSE:
+            case kh::Symbol::SQUARE_CLOSE:
+            case kh::Symbol::CURLY_CLOSE:
+                if (depth == 0) {
+                    return;
+                }
+
+                depth--;
+                if (depth == 0 && is_body) {
+                    context.ti++;
+                    return;
+                }
+                break;
+
+            case kh::Symbol::SEMICOLON:
+                if (depth == 0 && !is_body) {
+                    return;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
 kh::AstModule kh::parseWhole(KH_PARSE_CTX) {
     context.exceptions.clear();
+    context.panicking = false;
+    context.depth = 0;
 
     std::vector<kh::AstImport> imports;
     std::vector<kh::AstFunction> functions;
@@ -35,7 +219,22 @@ kh::AstModule kh::parseWhole(KH_PARSE_CTX) {
     std::vector<kh::AstEnumType> enums;
     std::vector<kh::AstDeclaration> variables;
 
+    /* Nesting past the maximum would overflow the stack, so nothing gets parsed */
+    if (context.nesting_limit > kh::maxNestingLimit()) {
+        if (!context.tokens.empty()) {
+            context.error("the nesting limit of " + std::to_string(context.nesting_limit) +
+                              " exceeds the maximum of " + std::to_string(kh::maxNestingLimit()),
+                          context.tokens[0]);
+        }
+        return {imports, functions, user_types, enums, variables};
+    }
+
     for (context.ti = 0; context.ti < context.tokens.size(); /* Nothing */) {
+        kh::recover(context, kh::ParseScope::TOP);
+        if (context.ti >= context.tokens.size()) {
+            break;
+        }
+
         kh::Token token = context.tok();
 
         bool is_public, is_static;
@@ -64,8 +263,7 @@ kh::AstModule kh::parseWhole(KH_PARSE_CTX) {
                             KH_PARSE_GUARD();
                         }
                         else {
-                            context.exceptions.emplace_back(
-                                "expected `def` after `try` at the top scope", token);
+                            context.error("expected `def` after `try` at the top scope", token);
                         }
                     }
 
@@ -77,12 +275,11 @@ kh::AstModule kh::parseWhole(KH_PARSE_CTX) {
                     functions.back().is_static = is_static;
 
                     if (functions.back().identifiers.empty()) {
-                        context.exceptions.emplace_back(
-                            "a lambda function cannot be declared at the top scope", token);
+                        context.error("a lambda function cannot be declared at the top scope", token);
                     }
 
                     if (is_static && functions.back().identifiers.size() == 1) {
-                        context.exceptions.emplace_back("a top scope function cannot be static", token);
+                        context.error("a top scope function cannot be static", token);
                     }
                 }
                 /* Parses class declaration */
@@ -93,7 +290,7 @@ kh::AstModule kh::parseWhole(KH_PARSE_CTX) {
 
                     user_types.back().is_public = is_public;
                     if (is_static) {
-                        context.exceptions.emplace_back("a class cannot be static", token);
+                        context.error("a class cannot be static", token);
                     }
                 }
                 /* Parses struct declaration */
@@ -104,7 +301,7 @@ kh::AstModule kh::parseWhole(KH_PARSE_CTX) {
 
                     user_types.back().is_public = is_public;
                     if (is_static) {
-                        context.exceptions.emplace_back("a struct cannot be static", token);
+                        context.error("a struct cannot be static", token);
                     }
                 }
                 /* Parses enum declaration */
@@ -115,7 +312,7 @@ kh::AstModule kh::parseWhole(KH_PARSE_CTX) {
 
                     enums.back().is_public = is_public;
                     if (is_static) {
-                        context.exceptions.emplace_back("an enum cannot be static", token);
+                        context.error("an enum cannot be static", token);
                     }
                 }
                 /* Parses import statement */
@@ -126,7 +323,7 @@ kh::AstModule kh::parseWhole(KH_PARSE_CTX) {
 
                     imports.back().is_public = is_public;
                     if (is_static) {
-                        context.exceptions.emplace_back("an import cannot be static", token);
+                        context.error("an import cannot be static", token);
                     }
                 }
                 /* Parses include statement */
@@ -137,13 +334,14 @@ kh::AstModule kh::parseWhole(KH_PARSE_CTX) {
 
                     imports.back().is_public = is_public;
                     if (is_static) {
-                        context.exceptions.emplace_back("an include cannot be static", token);
+                        context.error("an include cannot be static", token);
                     }
                 }
                 /* If it was none of those above, it's probably a variable declaration */
                 else {
                     /* Parses the variable's return type, name, and assignment value */
                     variables.push_back(kh::parseDeclaration(context));
+                    variables.back().is_public = is_public;
 
                     /* Makes sure it ends with a semicolon */
                     KH_PARSE_GUARD();
@@ -153,12 +351,11 @@ kh::AstModule kh::parseWhole(KH_PARSE_CTX) {
                         context.ti++;
                     }
                     else {
-                        context.exceptions.emplace_back(
-                            "expected a semicolon after a variable declaration", token);
+                        context.error("expected a semicolon after a variable declaration", token);
                     }
 
                     if (is_static) {
-                        context.exceptions.emplace_back("a top scope variable cannot be static", token);
+                        context.error("a top scope variable cannot be static", token);
                     }
                 }
             } break;
@@ -169,18 +366,18 @@ kh::AstModule kh::parseWhole(KH_PARSE_CTX) {
                 }
                 else {
                     context.ti++;
-                    context.exceptions.emplace_back("unexpected `" + kh::encodeUtf8(kh::str(token)) +
-                                                        "` while parsing the top scope",
-                                                    token);
+                    context.error("unexpected `" + kh::encodeUtf8(kh::str(token)) +
+                                      "` while parsing the top scope",
+                                  token);
                 }
                 break;
 
                 /* Unknown token */
             default:
                 context.ti++;
-                context.exceptions.emplace_back("unexpected `" + kh::encodeUtf8(kh::str(token)) +
-                                                    "` while parsing the top scope",
-                                                token);
+                context.error("unexpected `" + kh::encodeUtf8(kh::str(token)) +
+                                  "` while parsing the top scope",
+                              token);
         }
     }
 
@@ -194,11 +391,11 @@ end:
         cleaned_exceptions.reserve(context.exceptions.size());
 
         for (kh::ParseException& exc : context.exceptions) {
-            if (last_element == nullptr || last_index != exc.token.index ||
+            if (last_element == nullptr || last_index != exc.index ||
                 last_element->what != exc.what) {
                 cleaned_exceptions.push_back(exc);
             }
-            last_index = exc.token.index;
+            last_index = exc.index;
             last_element = &exc;
         }
 
@@ -223,10 +420,10 @@ void kh::parseAccessAttribs(KH_PARSE_CTX, bool& is_public, bool& is_static) {
             is_public = true;
 
             if (specified_public) {
-                context.exceptions.emplace_back("`public` was already specified", token);
+                context.error("`public` was already specified", token);
             }
             if (specified_private) {
-                context.exceptions.emplace_back("`private` was already specified", token);
+                context.error("`private` was already specified", token);
             }
 
             specified_public = true;
@@ -235,10 +432,10 @@ void kh::parseAccessAttribs(KH_PARSE_CTX, bool& is_public, bool& is_static) {
             is_public = false;
 
             if (specified_public) {
-                context.exceptions.emplace_back("`public` was already specified", token);
+                context.error("`public` was already specified", token);
             }
             if (specified_private) {
-                context.exceptions.emplace_back("`private` was already specified", token);
+                context.error("`private` was already specified", token);
             }
 
             specified_private = true;
@@ -247,7 +444,7 @@ void kh::parseAccessAttribs(KH_PARSE_CTX, bool& is_public, bool& is_static) {
             is_static = true;
 
             if (specified_static) {
-                context.exceptions.emplace_back("`static` was already specified", token);
+                context.error("`static` was already specified", token);
             }
 
             specified_static = true;
@@ -286,15 +483,14 @@ kh::AstImport kh::parseImport(KH_PARSE_CTX, bool is_include) {
      * one identifier to be imported) */
     if (token.type == kh::TokenType::IDENTIFIER) {
         if (kh::isReservedKeyword(token.value.identifier)) {
-            context.exceptions.emplace_back("was trying to " + type + " a reserved keyword", token);
+            context.error("was trying to " + type + " a reserved keyword", token);
         }
 
         path.push_back(token.value.identifier);
         context.ti++;
     }
     else {
-        context.exceptions.emplace_back("expected an identifier after the `" + type + "` keyword",
-                                        token);
+        context.error("expected an identifier after the `" + type + "` keyword", token);
         context.ti++;
     }
 
@@ -310,7 +506,7 @@ kh::AstImport kh::parseImport(KH_PARSE_CTX, bool is_include) {
         /* Appends the identifier */
         if (token.type == kh::TokenType::IDENTIFIER) {
             if (kh::isReservedKeyword(token.value.identifier)) {
-                context.exceptions.emplace_back("was trying to " + type + " a reserved keyword", token);
+                context.error("was trying to " + type + " a reserved keyword", token);
             }
             path.push_back(token.value.identifier);
             context.ti++;
@@ -318,8 +514,7 @@ kh::AstImport kh::parseImport(KH_PARSE_CTX, bool is_include) {
             token = context.tok();
         }
         else {
-            context.exceptions.emplace_back(
-                "expected an identifier after the dot in the " + type + " statement", token);
+            context.error("expected an identifier after the dot in the " + type + " statement", token);
             break;
         }
     }
@@ -333,14 +528,13 @@ kh::AstImport kh::parseImport(KH_PARSE_CTX, bool is_include) {
         /* Gets the set namespace identifier */
         if (token.type == kh::TokenType::IDENTIFIER) {
             if (kh::isReservedKeyword(token.value.identifier)) {
-                context.exceptions.emplace_back(
-                    "could not use a reserved keyword as the alias of the import", token);
+                context.error("could not use a reserved keyword as the alias of the import", token);
             }
             identifier = token.value.identifier;
         }
         else {
-            context.exceptions.emplace_back(
-                "expected an identifier after the `as` keyword in the import statement", token);
+            context.error("expected an identifier after the `as` keyword in the import statement",
+                          token);
         }
 
         context.ti++;
@@ -353,7 +547,7 @@ kh::AstImport kh::parseImport(KH_PARSE_CTX, bool is_include) {
         context.ti++;
     }
     else {
-        context.exceptions.emplace_back("expected a semicolon after the " + type + " statement", token);
+        context.error("expected a semicolon after the " + type + " statement", token);
     }
 end:
     return {index, path, is_include, is_relative,
@@ -369,6 +563,8 @@ kh::AstFunction kh::parseFunction(KH_PARSE_CTX, bool is_conditional) {
     size_t return_refs = 0;
     std::vector<kh::AstDeclaration> arguments;
     std::vector<std::shared_ptr<kh::AstBody>> body;
+    size_t body_begin = 0;
+    size_t body_end = 0;
 
     kh::Token token = context.tok();
     size_t index = token.index;
@@ -390,7 +586,7 @@ kh::AstFunction kh::parseFunction(KH_PARSE_CTX, bool is_conditional) {
 
             if (token.type == kh::TokenType::INTEGER || token.type == kh::TokenType::UINTEGER) {
                 if (token.value.uinteger == 0) {
-                    context.exceptions.emplace_back("an array could not be zero sized", token);
+                    context.error("an array could not be zero sized", token);
                 }
 
                 id_array.push_back(token.value.uinteger);
@@ -399,11 +595,11 @@ kh::AstFunction kh::parseFunction(KH_PARSE_CTX, bool is_conditional) {
                 token = context.tok();
             }
             else {
-                context.exceptions.emplace_back("expected an integer for the array size", token);
+                context.error("expected an integer for the array size", token);
             }
             if (!(token.type == kh::TokenType::SYMBOL &&
                   token.value.symbol_type == kh::Symbol::SQUARE_CLOSE)) {
-                context.exceptions.emplace_back("expected a closing square bracket", token);
+                context.error("expected a closing square bracket", token);
             }
             context.ti++;
             KH_PARSE_GUARD();
@@ -423,8 +619,8 @@ kh::AstFunction kh::parseFunction(KH_PARSE_CTX, bool is_conditional) {
                 context.ti++;
             }
             else {
-                context.exceptions.emplace_back(
-                    "expected an identifier after the dot in the function declaration name", token);
+                context.error("expected an identifier after the dot in the function declaration name",
+                              token);
             }
         }
 
@@ -433,7 +629,7 @@ kh::AstFunction kh::parseFunction(KH_PARSE_CTX, bool is_conditional) {
         token = context.tok();
         if (!(token.type == kh::TokenType::SYMBOL &&
               token.value.symbol_type == kh::Symbol::PARENTHESES_OPEN)) {
-            context.exceptions.emplace_back(
+            context.error(
                 "expected an opening parentheses of the argument(s) in the function declaration",
                 token);
             goto end;
@@ -468,16 +664,16 @@ kh::AstFunction kh::parseFunction(KH_PARSE_CTX, bool is_conditional) {
                 break;
             }
             else {
-                context.exceptions.emplace_back("expected a closing parentheses or a comma in "
-                                                "the function declaration's argument(s)",
-                                                token);
+                context.error("expected a closing parentheses or a comma in "
+                              "the function declaration's argument(s)",
+                              token);
                 goto end;
             }
         }
         else {
-            context.exceptions.emplace_back("expected a closing parentheses or a comma in the "
-                                            "function declaration's argument(s)",
-                                            token);
+            context.error("expected a closing parentheses or a comma in the "
+                          "function declaration's argument(s)",
+                          token);
             goto end;
         }
     }
@@ -518,18 +714,88 @@ kh::AstFunction kh::parseFunction(KH_PARSE_CTX, bool is_conditional) {
         else {
             return_type = kh::AstIdentifiers(token.index, {"void"}, {}, {}, {});
 
-            context.exceptions.emplace_back("expected a `->` specifying a return type", token);
+            context.error("expected a `->` specifying a return type", token);
         }
     }
     else {
         return_type = kh::AstIdentifiers(token.index, {"void"}, {}, {}, {});
     }
 
+    /* Skips the body by matching the curly brackets, lambdas are always parsed as they're part of
+     * an expression */
+    if (context.lazy_tokens && !identifiers.empty()) {
+        token = context.tok();
+        if (!(token.type == kh::TokenType::SYMBOL &&
+              token.value.symbol_type == kh::Symbol::CURLY_OPEN)) {
+            context.error("expected an opening curly bracket", token);
+            goto end;
+        }
+
+        body_begin = context.ti;
+
+        size_t depth = 0;
+        for (; context.ti < context.tokens.size(); context.ti++) {
+            const kh::Token& bracket = context.tok();
+            if (bracket.type != kh::TokenType::SYMBOL) {
+                continue;
+            }
+
+            if (bracket.value.symbol_type == kh::Symbol::CURLY_OPEN) {
+                depth++;
+            }
+            else if (bracket.value.symbol_type == kh::Symbol::CURLY_CLOSE) {
+                depth--;
+                if (depth == 0) {
+                    break;
+                }
+            }
+        }
+
+        KH_PARSE_GUARD();
+        context.ti++;
+        body_end = context.ti;
+    }
     /* Parses the function's body */
-    body = kh::parseBody(context);
+    else {
+        body = kh::parseBody(context);
+    }
 end:
-    return {index,       identifiers, generic_args, id_array, return_array,
-            return_type, return_refs, arguments,    body,     is_conditional};
+    kh::AstFunction function{index,       identifiers, generic_args, id_array, return_array,
+                             return_type, return_refs, arguments,    body,     is_conditional};
+    function.body_begin = body_begin;
+    function.body_end = body_end;
+
+    if (context.lazy_tokens && body_end != 0) {
+        function.lazy_body =
+            std::make_shared<kh::LazyBody>(context.lazy_tokens, body_begin, context.nesting_limit);
+    }
+
+    return function;
+}
+
+kh::LazyBody::LazyBody(const std::shared_ptr<const std::vector<kh::Token>>& _tokens, size_t _begin,
+                       size_t _nesting_limit)
+    : tokens(_tokens), begin(_begin), nesting_limit(_nesting_limit) {}
+
+const std::vector<std::shared_ptr<kh::AstBody>>& kh::LazyBody::body() {
+    std::call_once(this->parsed, [this]() {
+        kh::ParserContext context{*this->tokens, this->parse_exceptions};
+        context.nesting_limit = this->nesting_limit;
+        context.ti = this->begin;
+
+        this->parsed_body = kh::parseBody(context);
+    });
+
+    return this->parsed_body;
+}
+
+const std::vector<kh::ParseException>& kh::LazyBody::exceptions() {
+    this->body();
+    return this->parse_exceptions;
+}
+
+const std::vector<std::shared_ptr<kh::AstBody>>& kh::AstFunction::getBody() const {
+    return this->lazy_body ? this->lazy_body->body() : this->body;
 }
 
 kh::AstDeclaration kh::parseDeclaration(KH_PARSE_CTX) {
@@ -562,13 +828,12 @@ kh::AstDeclaration kh::parseDeclaration(KH_PARSE_CTX) {
     KH_PARSE_GUARD();
     token = context.tok();
     if (token.type != kh::TokenType::IDENTIFIER) {
-        context.exceptions.emplace_back(
-            "expected an identifier of the name of the variable declaration", token);
+        context.error("expected an identifier of the name of the variable declaration", token);
         goto end;
     }
 
     if (kh::isReservedKeyword(token.value.identifier)) {
-        context.exceptions.emplace_back("cannot use a reserved keyword as a variable name", token);
+        context.error("cannot use a reserved keyword as a variable name", token);
     }
 
     var_name = token.value.identifier;
@@ -629,10 +894,10 @@ kh::AstUserType kh::parseUserType(KH_PARSE_CTX, bool is_class) {
             context.ti++;
         }
         else {
-            context.exceptions.emplace_back("expected a closing parentheses after the base class "
-                                            "argument in the " +
-                                                type_name + " declaration",
-                                            token);
+            context.error("expected a closing parentheses after the base class "
+                          "argument in the " +
+                              type_name + " declaration",
+                          token);
         }
     }
 
@@ -646,6 +911,7 @@ kh::AstUserType kh::parseUserType(KH_PARSE_CTX, bool is_class) {
         token = context.tok();
 
         while (true) {
+            kh::recover(context, kh::ParseScope::USER_TYPE);
             KH_PARSE_GUARD();
             kh::Token token = context.tok();
 
@@ -672,8 +938,7 @@ kh::AstUserType kh::parseUserType(KH_PARSE_CTX, bool is_class) {
                                 KH_PARSE_GUARD();
                             }
                             else {
-                                context.exceptions.emplace_back(
-                                    "expected `def` after `try` at the top scope", token);
+                                context.error("expected `def` after `try` at the top scope", token);
                             }
                         }
 
@@ -682,13 +947,12 @@ kh::AstUserType kh::parseUserType(KH_PARSE_CTX, bool is_class) {
 
                         /* Ensures that methods don't have generic argument(s) */
                         if (!methods.back().generic_args.empty()) {
-                            context.exceptions.emplace_back("a method cannot have generic arguments",
-                                                            token);
+                            context.error("a method cannot have generic arguments", token);
                         }
 
                         /* Nor a lambda.. */
                         if (methods.back().identifiers.empty()) {
-                            context.exceptions.emplace_back("a method cannot be a lambda", token);
+                            context.error("a method cannot be a lambda", token);
                         }
 
                         methods.back().is_public = is_public;
@@ -707,11 +971,9 @@ kh::AstUserType kh::parseUserType(KH_PARSE_CTX, bool is_class) {
                             context.ti++;
                         }
                         else {
-                            context.ti++;
-                            context.exceptions.emplace_back("expected a semicolon after a "
-                                                            "variable declaration in the " +
-                                                                type_name + " body",
-                                                            token);
+                            context.error("expected a semicolon after a variable declaration in the " +
+                                              type_name + " body",
+                                          token);
                         }
 
                         members.back().is_public = is_public;
@@ -734,24 +996,22 @@ kh::AstUserType kh::parseUserType(KH_PARSE_CTX, bool is_class) {
 
                         default:
                             context.ti++;
-                            context.exceptions.emplace_back(
-                                "unexpected `" + kh::encodeUtf8(kh::str(token)) +
-                                    "` while parsing the " + type_name + " body",
-                                token);
+                            context.error("unexpected `" + kh::encodeUtf8(kh::str(token)) +
+                                              "` while parsing the " + type_name + " body",
+                                          token);
                     }
                 } break;
 
                 default:
                     context.ti++;
-                    context.exceptions.emplace_back("unexpected `" + kh::encodeUtf8(kh::str(token)) +
-                                                        "` while parsing the " + type_name + " body",
-                                                    token);
+                    context.error("unexpected `" + kh::encodeUtf8(kh::str(token)) +
+                                      "` while parsing the " + type_name + " body",
+                                  token);
             }
         }
     }
     else {
-        context.exceptions.emplace_back(
-            "expected an opening curly bracket for the " + type_name + " body", token);
+        context.error("expected an opening curly bracket for the " + type_name + " body", token);
     }
 end:
     return {index, identifiers, base, generic_args, members, methods, is_class};
@@ -772,7 +1032,7 @@ kh::AstEnumType kh::parseEnum(KH_PARSE_CTX) {
     std::vector<std::string> _generic_args;
     kh::parseTopScopeIdentifiersAndGenericArgs(context, identifiers, _generic_args);
     if (!_generic_args.empty()) {
-        context.exceptions.emplace_back("an enum could not have generic arguments", token);
+        context.error("an enum could not have generic arguments", token);
     }
 
     KH_PARSE_GUARD();
@@ -797,9 +1057,9 @@ kh::AstEnumType kh::parseEnum(KH_PARSE_CTX) {
                 members.push_back(token.value.identifier);
             }
             else {
-                context.exceptions.emplace_back("unexpected `" + kh::encodeUtf8(kh::str(token)) +
-                                                    "` while parsing the enum body",
-                                                token);
+                context.error("unexpected `" + kh::encodeUtf8(kh::str(token)) +
+                                  "` while parsing the enum body",
+                              token);
 
                 context.ti++;
                 KH_PARSE_GUARD();
@@ -829,9 +1089,9 @@ kh::AstEnumType kh::parseEnum(KH_PARSE_CTX) {
                     token = context.tok();
                 }
                 else {
-                    context.exceptions.emplace_back("expected an integer constant after the "
-                                                    "assignment operator on the enum member",
-                                                    token);
+                    context.error("expected an integer constant after the "
+                                  "assignment operator on the enum member",
+                                  token);
 
                     values.push_back(counter);
                     counter++;
@@ -845,14 +1105,14 @@ kh::AstEnumType kh::parseEnum(KH_PARSE_CTX) {
             /* Ensures there's no enum member with the same name or index value */
             for (size_t member = 0; member < members.size() - 1; member++) {
                 if (members[member] == members.back()) {
-                    context.exceptions.emplace_back("this enum member has the same name as the #" +
-                                                        std::to_string(member + 1) + " member",
-                                                    token);
+                    context.error("this enum member has the same name as the #" +
+                                      std::to_string(member + 1) + " member",
+                                  token);
                     break;
                 }
 
                 if (values[member] == values.back()) {
-                    context.exceptions.emplace_back(
+                    context.error(
                         "this enum member has a same index value as `" + members[member] + "`", token);
                     break;
                 }
@@ -867,9 +1127,9 @@ kh::AstEnumType kh::parseEnum(KH_PARSE_CTX) {
             /* Ensures a comma after an enum member */
             else if (!(token.type == kh::TokenType::SYMBOL &&
                        token.value.symbol_type == kh::Symbol::COMMA)) {
-                context.exceptions.emplace_back("expected a closing curly bracket or a comma "
-                                                "after an enum member in the enum body",
-                                                token);
+                context.error("expected a closing curly bracket or a comma "
+                              "after an enum member in the enum body",
+                              token);
             }
             context.ti++;
             KH_PARSE_GUARD();
@@ -877,8 +1137,7 @@ kh::AstEnumType kh::parseEnum(KH_PARSE_CTX) {
         }
     }
     else {
-        context.exceptions.emplace_back("expected an opening curly bracket after the enum declaration",
-                                        token);
+        context.error("expected an opening curly bracket after the enum declaration", token);
     }
 end:
     return {index, identifiers, members, values};
@@ -888,9 +1147,15 @@ std::vector<std::shared_ptr<kh::AstBody>> kh::parseBody(KH_PARSE_CTX, size_t loo
     std::vector<std::shared_ptr<kh::AstBody>> body;
     kh::Token token = context.tok();
 
+    if (context.depth >= context.nesting_limit) {
+        kh::skipNesting(context, true);
+        return body;
+    }
+    context.depth++;
+
     /* Expects an opening curly bracket */
     if (!(token.type == kh::TokenType::SYMBOL && token.value.symbol_type == kh::Symbol::CURLY_OPEN)) {
-        context.exceptions.emplace_back("expected an opening curly bracket", token);
+        context.error("expected an opening curly bracket", token);
         goto end;
     }
 
@@ -898,6 +1163,7 @@ std::vector<std::shared_ptr<kh::AstBody>> kh::parseBody(KH_PARSE_CTX, size_t loo
 
     /* Parses the body */
     while (true) {
+        kh::recover(context, kh::ParseScope::BODY);
         KH_PARSE_GUARD();
         token = context.tok();
         size_t index = token.index;
@@ -912,8 +1178,8 @@ std::vector<std::shared_ptr<kh::AstBody>> kh::parseBody(KH_PARSE_CTX, size_t loo
                     do {
                         /* Parses the expression and if body */
                         context.ti++;
-                        token = context.tok();
                         KH_PARSE_GUARD();
+                        token = context.tok();
                         conditions.emplace_back(kh::parseExpression(context));
                         KH_PARSE_GUARD();
                         bodies.emplace_back(kh::parseBody(context, loop_count + 1));
@@ -964,7 +1230,7 @@ std::vector<std::shared_ptr<kh::AstBody>> kh::parseBody(KH_PARSE_CTX, size_t loo
                         condition.reset(kh::parseExpression(context));
                     }
                     else
-                        context.exceptions.emplace_back("expected `while` after the `do {...}`", token);
+                        context.error("expected `while` after the `do {...}`", token);
 
                     KH_PARSE_GUARD();
                     token = context.tok();
@@ -975,8 +1241,7 @@ std::vector<std::shared_ptr<kh::AstBody>> kh::parseBody(KH_PARSE_CTX, size_t loo
                         context.ti++;
                     }
                     else
-                        context.exceptions.emplace_back(
-                            "expected a semicolon after `do {...} while ...`", token);
+                        context.error("expected a semicolon after `do {...} while ...`", token);
 
                     body.emplace_back(new kh::AstDoWhile(index, condition, do_while_body));
                 }
@@ -1018,8 +1283,7 @@ std::vector<std::shared_ptr<kh::AstBody>> kh::parseBody(KH_PARSE_CTX, size_t loo
                             KH_PARSE_GUARD();
                         }
                         else {
-                            context.exceptions.emplace_back("expected a comma after `for ..., ...`",
-                                                            token);
+                            context.error("expected a comma after `for ..., ...`", token);
                         }
                         std::shared_ptr<kh::AstExpression> step(kh::parseExpression(context));
                         KH_PARSE_GUARD();
@@ -1030,8 +1294,8 @@ std::vector<std::shared_ptr<kh::AstBody>> kh::parseBody(KH_PARSE_CTX, size_t loo
                             new kh::AstFor(index, target_or_initializer, condition, step, for_body));
                     }
                     else {
-                        context.exceptions.emplace_back(
-                            "expected a colon or a comma after the `for` target/initializer", token);
+                        context.error("expected a colon or a comma after the `for` target/initializer",
+                                      token);
                     }
                 }
                 /* `continue` statement */
@@ -1041,15 +1305,13 @@ std::vector<std::shared_ptr<kh::AstBody>> kh::parseBody(KH_PARSE_CTX, size_t loo
                     token = context.tok();
 
                     if (!loop_count) {
-                        context.exceptions.emplace_back(
-                            "`continue` cannot be used outside of while or for loops", token);
+                        context.error("`continue` cannot be used outside of while or for loops", token);
                     }
                     size_t loop_breaks = 0;
                     /* Continuing multiple loops `continue 4;` */
                     if (token.type == kh::TokenType::UINTEGER || token.type == kh::TokenType::INTEGER) {
                         if (token.value.uinteger >= loop_count) {
-                            context.exceptions.emplace_back(
-                                "trying to `continue` an invalid amount of loops", token);
+                            context.error("trying to `continue` an invalid amount of loops", token);
                         }
                         loop_breaks = token.value.uinteger;
                         context.ti++;
@@ -1063,8 +1325,7 @@ std::vector<std::shared_ptr<kh::AstBody>> kh::parseBody(KH_PARSE_CTX, size_t loo
                         context.ti++;
                     }
                     else {
-                        context.exceptions.emplace_back(
-                            "expected a semicolon or an integer after `continue`", token);
+                        context.error("expected a semicolon or an integer after `continue`", token);
                     }
                     body.emplace_back(
                         new kh::AstStatement(index, kh::AstStatement::Type::CONTINUE, loop_breaks));
@@ -1076,15 +1337,13 @@ std::vector<std::shared_ptr<kh::AstBody>> kh::parseBody(KH_PARSE_CTX, size_t loo
                     token = context.tok();
 
                     if (!loop_count) {
-                        context.exceptions.emplace_back(
-                            "`break` cannot be used outside of while or for loops", token);
+                        context.error("`break` cannot be used outside of while or for loops", token);
                     }
                     size_t loop_breaks = 0;
                     /* Breaking multiple loops `break 2;` */
                     if (token.type == kh::TokenType::UINTEGER || token.type == kh::TokenType::INTEGER) {
                         if (token.value.uinteger >= loop_count) {
-                            context.exceptions.emplace_back(
-                                "trying to `break` an invalid amount of loops", token);
+                            context.error("trying to `break` an invalid amount of loops", token);
                         }
                         loop_breaks = token.value.uinteger;
                         context.ti++;
@@ -1098,8 +1357,7 @@ std::vector<std::shared_ptr<kh::AstBody>> kh::parseBody(KH_PARSE_CTX, size_t loo
                         context.ti++;
                     }
                     else {
-                        context.exceptions.emplace_back(
-                            "expected a semicolon or an integer after `break`", token);
+                        context.error("expected a semicolon or an integer after `break`", token);
                     }
                     body.emplace_back(
                         new kh::AstStatement(index, kh::AstStatement::Type::BREAK, loop_breaks));
@@ -1128,8 +1386,7 @@ std::vector<std::shared_ptr<kh::AstBody>> kh::parseBody(KH_PARSE_CTX, size_t loo
                             context.ti++;
                         }
                         else {
-                            context.exceptions.emplace_back("expected a semicolon after `return ...`",
-                                                            token);
+                            context.error("expected a semicolon after `return ...`", token);
                         }
                     }
 
@@ -1172,14 +1429,14 @@ std::vector<std::shared_ptr<kh::AstBody>> kh::parseBody(KH_PARSE_CTX, size_t loo
                     context.ti++;
                 }
                 else {
-                    context.exceptions.emplace_back(
-                        "expected a semicolon after the expression in the body", token);
+                    context.error("expected a semicolon after the expression in the body", token);
                 }
                 body.emplace_back(expr);
             }
         }
     }
 end:
+    context.depth--;
     return body;
 }
 
@@ -1197,14 +1454,13 @@ void kh::parseTopScopeIdentifiersAndGenericArgs(KH_PARSE_CTX, std::vector<std::s
     forceIn:
         if (token.type == kh::TokenType::IDENTIFIER) {
             if (kh::isReservedKeyword(token.value.identifier)) {
-                context.exceptions.emplace_back("cannot use a reserved keyword as an identifier",
-                                                token);
+                context.error("cannot use a reserved keyword as an identifier", token);
             }
             identifiers.push_back(token.value.identifier);
             context.ti++;
         }
         else {
-            context.exceptions.emplace_back("expected an identifier", token);
+            context.error("expected an identifier", token);
         }
         KH_PARSE_GUARD();
         token = context.tok();
@@ -1219,8 +1475,8 @@ void kh::parseTopScopeIdentifiersAndGenericArgs(KH_PARSE_CTX, std::vector<std::s
         /* a.b.c!T */
         if (token.type == kh::TokenType::IDENTIFIER) {
             if (kh::isReservedKeyword(token.value.identifier)) {
-                context.exceptions.emplace_back(
-                    "cannot use a reserved keyword as an identifier of a generic argument", token);
+                context.error("cannot use a reserved keyword as an identifier of a generic argument",
+                              token);
             }
             generic_args.push_back(token.value.identifier);
             context.ti++;
@@ -1241,7 +1497,7 @@ void kh::parseTopScopeIdentifiersAndGenericArgs(KH_PARSE_CTX, std::vector<std::s
             forceInGenericArgs:
                 if (token.type == kh::TokenType::IDENTIFIER) {
                     if (kh::isReservedKeyword(token.value.identifier)) {
-                        context.exceptions.emplace_back(
+                        context.error(
                             "cannot use a reserved keyword as an identifier of a generic argument",
                             token);
                     }
@@ -1249,8 +1505,7 @@ void kh::parseTopScopeIdentifiersAndGenericArgs(KH_PARSE_CTX, std::vector<std::s
                     context.ti++;
                 }
                 else {
-                    context.exceptions.emplace_back("expected an identifier for a generic argument",
-                                                    token);
+                    context.error("expected an identifier for a generic argument", token);
                 }
                 KH_PARSE_GUARD();
                 token = context.tok();
@@ -1262,7 +1517,7 @@ void kh::parseTopScopeIdentifiersAndGenericArgs(KH_PARSE_CTX, std::vector<std::s
                 context.ti++;
             }
             else {
-                context.exceptions.emplace_back("expected a closing parentheses", token);
+                context.error("expected a closing parentheses", token);
             }
         }
     }
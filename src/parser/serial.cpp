@@ -0,0 +1,1236 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <cstring>
+#include <unordered_map>
+
+#include <kithare/serial.hpp>
+
+#define KH_SERIAL_TOKENS_MAGIC "KTOK"
+#define KH_SERIAL_AST_MAGIC "KAST"
+#define KH_SERIAL_INTERFACE_MAGIC "KINT"
+
+
+std::string kh::SerialException::format() const {
+    return this->what + " at byte " + std::to_string(this->index);
+}
+
+static void appendU32(std::string& buffer, size_t n) {
+    if (n > 0xFFFFFFFF) {
+        throw kh::SerialException("the serialized buffer is too large", buffer.size());
+    }
+
+    for (size_t i = 0; i < 4; i++) {
+        buffer += (char)((n >> (i * 8)) & 0xFF);
+    }
+}
+
+static uint32_t readU32(const unsigned char* data) {
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) |
+           ((uint32_t)data[3] << 24);
+}
+
+/* Builds the body and the deduplicated string table, the AST records are written in post-order so
+ * every child reference is already known when its parent gets written */
+struct SerialWriter {
+    std::string body;
+    std::vector<const std::string*> strings;
+    std::unordered_map<std::string, uint64_t> string_ids;
+
+    void byte(uint8_t n) {
+        this->body += (char)n;
+    }
+
+    void varint(uint64_t n) {
+        while (n >= 0x80) {
+            this->body += (char)((n & 0x7F) | 0x80);
+            n >>= 7;
+        }
+        this->body += (char)n;
+    }
+
+    void signedVarint(int64_t n) {
+        this->varint(((uint64_t)n << 1) ^ (uint64_t)(n >> 63));
+    }
+
+    void floating(double n) {
+        uint64_t bits;
+        std::memcpy(&bits, &n, sizeof(bits));
+
+        for (size_t i = 0; i < 8; i++) {
+            this->body += (char)((bits >> (i * 8)) & 0xFF);
+        }
+    }
+
+    void string(const std::string& str) {
+        auto id = this->string_ids.emplace(str, this->strings.size());
+        if (id.second) {
+            this->strings.push_back(&id.first->first);
+        }
+
+        this->varint(id.first->second);
+    }
+
+    void codePoints(const std::u32string& str) {
+        this->varint(str.size());
+        for (char32_t chr : str) {
+            this->varint(chr);
+        }
+    }
+
+    void names(const std::vector<std::string>& names) {
+        this->varint(names.size());
+        for (const std::string& name : names) {
+            this->string(name);
+        }
+    }
+
+    void dimensions(const std::vector<uint64_t>& dimensions) {
+        this->varint(dimensions.size());
+        for (uint64_t dimension : dimensions) {
+            this->varint(dimension);
+        }
+    }
+
+    void children(const std::vector<uint64_t>& refs) {
+        this->varint(refs.size());
+        for (uint64_t ref : refs) {
+            this->varint(ref);
+        }
+    }
+
+    /* Starts a record, returning the reference to it */
+    uint64_t record(kh::AstTag tag, size_t index) {
+        uint64_t ref = this->body.size() + 1;
+        this->byte((uint8_t)tag);
+        this->varint(index);
+        return ref;
+    }
+
+    uint64_t write(const kh::AstModule& module_ast);
+    uint64_t write(const kh::AstImport& import_ast);
+    uint64_t write(const kh::AstUserType& type_ast);
+    uint64_t write(const kh::AstEnumType& enum_ast);
+    uint64_t write(const kh::AstBody& body_ast);
+    uint64_t write(const kh::AstIdentifiers& identifiers_ast);
+    uint64_t write(const kh::AstDeclaration& declaration_ast);
+    uint64_t write(const kh::AstFunction& function_ast);
+
+    uint64_t write(const std::shared_ptr<kh::AstExpression>& expression) {
+        return expression ? this->write(*expression) : 0;
+    }
+
+    template <typename T>
+    std::vector<uint64_t> writeAll(const std::vector<T>& nodes) {
+        std::vector<uint64_t> refs;
+        refs.reserve(nodes.size());
+        for (auto& node : nodes) {
+            refs.push_back(this->write(node));
+        }
+        return refs;
+    }
+
+    template <typename T>
+    std::vector<uint64_t> writeAll(const std::vector<std::shared_ptr<T>>& nodes) {
+        std::vector<uint64_t> refs;
+        refs.reserve(nodes.size());
+        for (auto& node : nodes) {
+            refs.push_back(node ? this->write(*node) : 0);
+        }
+        return refs;
+    }
+
+    std::string finish(const char* magic, uint64_t root);
+};
+
+uint64_t SerialWriter::write(const kh::AstModule& module_ast) {
+    std::vector<uint64_t> imports = this->writeAll(module_ast.imports);
+    std::vector<uint64_t> functions = this->writeAll(module_ast.functions);
+    std::vector<uint64_t> user_types = this->writeAll(module_ast.user_types);
+    std::vector<uint64_t> enums = this->writeAll(module_ast.enums);
+    std::vector<uint64_t> variables = this->writeAll(module_ast.variables);
+
+    uint64_t ref = this->record(kh::AstTag::MODULE, 0);
+    this->children(imports);
+    this->children(functions);
+    this->children(user_types);
+    this->children(enums);
+    this->children(variables);
+    return ref;
+}
+
+uint64_t SerialWriter::write(const kh::AstImport& import_ast) {
+    uint64_t ref = this->record(kh::AstTag::IMPORT, import_ast.index);
+    this->byte(import_ast.is_include | (import_ast.is_relative << 1) | (import_ast.is_public << 2));
+    this->names(import_ast.path);
+    this->string(import_ast.identifier);
+    return ref;
+}
+
+uint64_t SerialWriter::write(const kh::AstUserType& type_ast) {
+    uint64_t base = type_ast.base ? this->write(*type_ast.base) : 0;
+    std::vector<uint64_t> members = this->writeAll(type_ast.members);
+    std::vector<uint64_t> methods = this->writeAll(type_ast.methods);
+
+    uint64_t ref = this->record(kh::AstTag::USER_TYPE, type_ast.index);
+    this->byte(type_ast.is_class | (type_ast.is_public << 1));
+    this->names(type_ast.identifiers);
+    this->varint(base);
+    this->names(type_ast.generic_args);
+    this->children(members);
+    this->children(methods);
+    return ref;
+}
+
+uint64_t SerialWriter::write(const kh::AstEnumType& enum_ast) {
+    uint64_t ref = this->record(kh::AstTag::ENUM_TYPE, enum_ast.index);
+    this->byte(enum_ast.is_public);
+    this->names(enum_ast.identifiers);
+    this->names(enum_ast.members);
+    this->dimensions(enum_ast.values);
+    return ref;
+}
+
+uint64_t SerialWriter::write(const kh::AstIdentifiers& identifiers_ast) {
+    std::vector<uint64_t> generics = this->writeAll(identifiers_ast.generics);
+
+    uint64_t ref = this->record(kh::AstTag::IDENTIFIERS, identifiers_ast.index);
+    this->names(identifiers_ast.identifiers);
+    this->children(generics);
+    for (size_t i = 0; i < generics.size(); i++) {
+        this->varint(identifiers_ast.generics_refs[i]);
+        this->dimensions(identifiers_ast.generics_array[i]);
+    }
+    return ref;
+}
+
+uint64_t SerialWriter::write(const kh::AstDeclaration& declaration_ast) {
+    uint64_t var_type = this->write(declaration_ast.var_type);
+    uint64_t expression = this->write(declaration_ast.expression);
+
+    uint64_t ref = this->record(kh::AstTag::DECLARATION, declaration_ast.index);
+    this->byte(declaration_ast.is_public | (declaration_ast.is_static << 1));
+    this->varint(var_type);
+    this->dimensions(declaration_ast.var_array);
+    this->string(declaration_ast.var_name);
+    this->varint(expression);
+    this->varint(declaration_ast.refs);
+    return ref;
+}
+
+uint64_t SerialWriter::write(const kh::AstFunction& function_ast) {
+    uint64_t return_type = this->write(function_ast.return_type);
+    std::vector<uint64_t> arguments = this->writeAll(function_ast.arguments);
+    std::vector<uint64_t> body = this->writeAll(function_ast.getBody());
+
+    uint64_t ref = this->record(kh::AstTag::FUNCTION, function_ast.index);
+    this->byte(function_ast.is_public | (function_ast.is_static << 1) |
+               (function_ast.is_conditional << 2));
+    this->names(function_ast.identifiers);
+    this->names(function_ast.generic_args);
+    this->dimensions(function_ast.id_array);
+    this->varint(return_type);
+    this->dimensions(function_ast.return_array);
+    this->varint(function_ast.return_refs);
+    this->children(arguments);
+    this->children(body);
+    return ref;
+}
+
+uint64_t SerialWriter::write(const kh::AstBody& body_ast) {
+    uint64_t ref;
+
+    switch (body_ast.type) {
+        case kh::AstBody::EXPRESSION:
+            break;
+
+        case kh::AstBody::IF: {
+            auto& if_ast = (const kh::AstIf&)body_ast;
+            std::vector<uint64_t> conditions = this->writeAll(if_ast.conditions);
+            std::vector<std::vector<uint64_t>> bodies;
+            for (auto& body : if_ast.bodies) {
+                bodies.push_back(this->writeAll(body));
+            }
+            std::vector<uint64_t> else_body = this->writeAll(if_ast.else_body);
+
+            ref = this->record(kh::AstTag::IF, if_ast.index);
+            this->children(conditions);
+            for (auto& body : bodies) {
+                this->children(body);
+            }
+            this->children(else_body);
+            return ref;
+        }
+
+        case kh::AstBody::WHILE:
+        case kh::AstBody::DO_WHILE: {
+            auto& while_ast = (const kh::AstWhile&)body_ast;
+            auto& do_while_ast = (const kh::AstDoWhile&)body_ast;
+            bool is_while = body_ast.type == kh::AstBody::WHILE;
+
+            uint64_t condition = this->write(is_while ? while_ast.condition : do_while_ast.condition);
+            std::vector<uint64_t> body = this->writeAll(is_while ? while_ast.body : do_while_ast.body);
+
+            ref = this->record(is_while ? kh::AstTag::WHILE : kh::AstTag::DO_WHILE, body_ast.index);
+            this->varint(condition);
+            this->children(body);
+            return ref;
+        }
+
+        case kh::AstBody::FOR: {
+            auto& for_ast = (const kh::AstFor&)body_ast;
+            uint64_t initialize = this->write(for_ast.initialize);
+            uint64_t condition = this->write(for_ast.condition);
+            uint64_t step = this->write(for_ast.step);
+            std::vector<uint64_t> body = this->writeAll(for_ast.body);
+
+            ref = this->record(kh::AstTag::FOR, for_ast.index);
+            this->varint(initialize);
+            this->varint(condition);
+            this->varint(step);
+            this->children(body);
+            return ref;
+        }
+
+        case kh::AstBody::FOREACH: {
+            auto& foreach_ast = (const kh::AstForEach&)body_ast;
+            uint64_t target = this->write(foreach_ast.target);
+            uint64_t iterator = this->write(foreach_ast.iterator);
+            std::vector<uint64_t> body = this->writeAll(foreach_ast.body);
+
+            ref = this->record(kh::AstTag::FOREACH, foreach_ast.index);
+            this->varint(target);
+            this->varint(iterator);
+            this->children(body);
+            return ref;
+        }
+
+        case kh::AstBody::STATEMENT: {
+            auto& statement_ast = (const kh::AstStatement&)body_ast;
+            bool is_return = statement_ast.statement_type == kh::AstStatement::Type::RETURN;
+            uint64_t expression = is_return ? this->write(statement_ast.expression) : 0;
+
+            ref = this->record(kh::AstTag::STATEMENT, statement_ast.index);
+            this->byte((uint8_t)statement_ast.statement_type);
+            this->varint(is_return ? expression : statement_ast.loop_count);
+            return ref;
+        }
+
+        default:
+            throw kh::SerialException("unable to serialize an unknown body", this->body.size());
+    }
+
+    auto& expr_ast = (const kh::AstExpression&)body_ast;
+
+    switch (expr_ast.expression_type) {
+        case kh::AstExpression::IDENTIFIER:
+            return this->write((const kh::AstIdentifiers&)expr_ast);
+
+        case kh::AstExpression::DECLARE:
+            return this->write((const kh::AstDeclaration&)expr_ast);
+
+        case kh::AstExpression::FUNCTION:
+            return this->write((const kh::AstFunction&)expr_ast);
+
+        case kh::AstExpression::UNARY:
+        case kh::AstExpression::REV_UNARY: {
+            auto& unary_ast = (const kh::AstUnaryOperation&)expr_ast;
+            auto& rev_unary_ast = (const kh::AstRevUnaryOperation&)expr_ast;
+            bool is_unary = expr_ast.expression_type == kh::AstExpression::UNARY;
+
+            uint64_t rvalue = this->write(is_unary ? unary_ast.rvalue : rev_unary_ast.rvalue);
+
+            ref = this->record(is_unary ? kh::AstTag::UNARY : kh::AstTag::REV_UNARY, expr_ast.index);
+            this->byte((uint8_t)(is_unary ? unary_ast.operation : rev_unary_ast.operation));
+            this->varint(rvalue);
+            return ref;
+        }
+
+        case kh::AstExpression::BINARY: {
+            auto& binary_ast = (const kh::AstBinaryOperation&)expr_ast;
+            uint64_t lvalue = this->write(binary_ast.lvalue);
+            uint64_t rvalue = this->write(binary_ast.rvalue);
+
+            ref = this->record(kh::AstTag::BINARY, binary_ast.index);
+            this->byte((uint8_t)binary_ast.operation);
+            this->varint(lvalue);
+            this->varint(rvalue);
+            return ref;
+        }
+
+        case kh::AstExpression::TERNARY: {
+            auto& ternary_ast = (const kh::AstTernaryOperation&)expr_ast;
+            uint64_t condition = this->write(ternary_ast.condition);
+            uint64_t value = this->write(ternary_ast.value);
+            uint64_t otherwise = this->write(ternary_ast.otherwise);
+
+            ref = this->record(kh::AstTag::TERNARY, ternary_ast.index);
+            this->varint(condition);
+            this->varint(value);
+            this->varint(otherwise);
+            return ref;
+        }
+
+        case kh::AstExpression::COMPARISON: {
+            auto& comparison_ast = (const kh::AstComparisonExpression&)expr_ast;
+            std::vector<uint64_t> values = this->writeAll(comparison_ast.values);
+
+            ref = this->record(kh::AstTag::COMPARISON, comparison_ast.index);
+            this->varint(comparison_ast.operations.size());
+            for (kh::Operator operation : comparison_ast.operations) {
+                this->byte((uint8_t)operation);
+            }
+            this->children(values);
+            return ref;
+        }
+
+        case kh::AstExpression::SUBSCRIPT:
+        case kh::AstExpression::CALL: {
+            auto& subscript_ast = (const kh::AstSubscriptExpression&)expr_ast;
+            auto& call_ast = (const kh::AstCallExpression&)expr_ast;
+            bool is_call = expr_ast.expression_type == kh::AstExpression::CALL;
+
+            uint64_t expression = this->write(is_call ? call_ast.expression : subscript_ast.expression);
+            std::vector<uint64_t> arguments =
+                this->writeAll(is_call ? call_ast.arguments : subscript_ast.arguments);
+
+            ref = this->record(is_call ? kh::AstTag::CALL : kh::AstTag::SUBSCRIPT, expr_ast.index);
+            this->varint(expression);
+            this->children(arguments);
+            return ref;
+        }
+
+        case kh::AstExpression::SCOPE: {
+            auto& scoping_ast = (const kh::AstScoping&)expr_ast;
+            uint64_t expression = this->write(scoping_ast.expression);
+
+            ref = this->record(kh::AstTag::SCOPING, scoping_ast.index);
+            this->varint(expression);
+            this->names(scoping_ast.identifiers);
+            return ref;
+        }
+
+        case kh::AstExpression::CONSTANT: {
+            auto& value_ast = (const kh::AstValue&)expr_ast;
+
+            ref = this->record(kh::AstTag::VALUE, value_ast.index);
+            this->byte((uint8_t)value_ast.value_type);
+
+            switch (value_ast.value_type) {
+                case kh::AstValue::CHARACTER:
+                    this->varint(value_ast.character);
+                    break;
+                case kh::AstValue::UINTEGER:
+                    this->varint(value_ast.uinteger);
+                    break;
+                case kh::AstValue::INTEGER:
+                    this->signedVarint(value_ast.integer);
+                    break;
+                case kh::AstValue::FLOATING:
+                case kh::AstValue::IMAGINARY:
+                    this->floating(value_ast.floating);
+                    break;
+                case kh::AstValue::BUFFER:
+                    this->string(value_ast.buffer);
+                    break;
+                case kh::AstValue::STRING:
+                    this->codePoints(value_ast.string);
+                    break;
+            }
+            return ref;
+        }
+
+        case kh::AstExpression::TUPLE:
+        case kh::AstExpression::LIST: {
+            auto& tuple_ast = (const kh::AstTuple&)expr_ast;
+            auto& list_ast = (const kh::AstList&)expr_ast;
+            bool is_tuple = expr_ast.expression_type == kh::AstExpression::TUPLE;
+
+            std::vector<uint64_t> elements =
+                this->writeAll(is_tuple ? tuple_ast.elements : list_ast.elements);
+
+            ref = this->record(is_tuple ? kh::AstTag::TUPLE : kh::AstTag::LIST, expr_ast.index);
+            this->children(elements);
+            return ref;
+        }
+
+        case kh::AstExpression::DICT: {
+            auto& dict_ast = (const kh::AstDict&)expr_ast;
+            std::vector<uint64_t> keys = this->writeAll(dict_ast.keys);
+            std::vector<uint64_t> items = this->writeAll(dict_ast.items);
+
+            ref = this->record(kh::AstTag::DICT, dict_ast.index);
+            this->children(keys);
+            this->children(items);
+            return ref;
+        }
+
+        default:
+            throw kh::SerialException("unable to serialize an unknown expression",
+                                      this->body.size());
+    }
+}
+
+std::string SerialWriter::finish(const char* magic, uint64_t root) {
+    size_t string_data_size = 0;
+    for (const std::string* str : this->strings) {
+        string_data_size += str->size();
+    }
+
+    size_t body_offset = KH_SERIAL_HEADER_SIZE + (this->strings.size() + 1) * 4 + string_data_size;
+
+    std::string buffer;
+    buffer.reserve(body_offset + this->body.size());
+    buffer.append(magic, 4);
+    appendU32(buffer, KH_SERIAL_VERSION);
+    appendU32(buffer, this->strings.size());
+    appendU32(buffer, body_offset);
+    appendU32(buffer, this->body.size());
+    appendU32(buffer, root ? root - 1 : 0);
+
+    size_t string_offset = 0;
+    appendU32(buffer, string_offset);
+    for (const std::string* str : this->strings) {
+        string_offset += str->size();
+        appendU32(buffer, string_offset);
+    }
+
+    for (const std::string* str : this->strings) {
+        buffer += *str;
+    }
+
+    buffer += this->body;
+    return buffer;
+}
+
+std::string kh::serialize(const std::vector<kh::Token>& tokens) {
+    SerialWriter writer;
+    writer.varint(tokens.size());
+
+    size_t previous = 0;
+    for (const kh::Token& token : tokens) {
+        writer.byte((uint8_t)token.type);
+        writer.signedVarint((int64_t)(token.index - previous));
+        writer.varint(token.length);
+        writer.varint(token.line);
+        writer.varint(token.column);
+        previous = token.index;
+
+        switch (token.type) {
+            case kh::TokenType::IDENTIFIER:
+                writer.string(token.value.identifier);
+                break;
+            case kh::TokenType::OPERATOR:
+                writer.byte((uint8_t)token.value.operator_type);
+                break;
+            case kh::TokenType::SYMBOL:
+                writer.byte((uint8_t)token.value.symbol_type);
+                break;
+            case kh::TokenType::CHARACTER:
+                writer.varint(token.value.character);
+                break;
+            case kh::TokenType::STRING:
+                writer.codePoints(token.value.string);
+                break;
+            case kh::TokenType::BUFFER:
+                writer.string(token.value.buffer);
+                break;
+            case kh::TokenType::UINTEGER:
+                writer.varint(token.value.uinteger);
+                break;
+            case kh::TokenType::INTEGER:
+                writer.signedVarint(token.value.integer);
+                break;
+            case kh::TokenType::FLOATING:
+            case kh::TokenType::IMAGINARY:
+                writer.floating(token.value.floating);
+                break;
+        }
+    }
+
+    return writer.finish(KH_SERIAL_TOKENS_MAGIC, 0);
+}
+
+std::string kh::serialize(const kh::AstModule& module_ast) {
+    SerialWriter writer;
+    uint64_t root = writer.write(module_ast);
+    return writer.finish(KH_SERIAL_AST_MAGIC, root);
+}
+
+std::string kh::serializeInterface(const kh::AstModule& interface_ast, uint64_t source_hash) {
+    SerialWriter writer;
+    for (size_t i = 0; i < 8; i++) {
+        writer.byte((uint8_t)(source_hash >> (i * 8)));
+    }
+
+    uint64_t root = writer.write(interface_ast);
+    return writer.finish(KH_SERIAL_INTERFACE_MAGIC, root);
+}
+
+kh::SerialReader::SerialReader(const char* _data, size_t _size, const char* magic)
+    : data((const unsigned char*)_data), size(_size) {
+    if (this->size < KH_SERIAL_HEADER_SIZE || std::memcmp(this->data, magic, 4) != 0) {
+        throw kh::SerialException("expected a buffer starting with `" + std::string(magic) + "`", 0);
+    }
+
+    if (readU32(this->data + 4) != KH_SERIAL_VERSION) {
+        throw kh::SerialException("unsupported version " + std::to_string(readU32(this->data + 4)),
+                                  4);
+    }
+
+    this->string_count = readU32(this->data + 8);
+    size_t body_offset = readU32(this->data + 12);
+    this->body_size = readU32(this->data + 16);
+    this->root_offset = readU32(this->data + 20);
+
+    size_t index_end = KH_SERIAL_HEADER_SIZE + (this->string_count + 1) * 4;
+    if (index_end > this->size || index_end > body_offset) {
+        throw kh::SerialException("the string index is out of bounds", 8);
+    }
+    if (body_offset > this->size || this->body_size > this->size - body_offset) {
+        throw kh::SerialException("the body is out of bounds", 12);
+    }
+
+    this->string_index = this->data + KH_SERIAL_HEADER_SIZE;
+    this->string_data = this->data + index_end;
+    this->string_data_size = body_offset - index_end;
+    this->body = this->data + body_offset;
+    this->referenced.resize(this->body_size);
+}
+
+size_t kh::SerialReader::root() const {
+    return this->root_offset;
+}
+
+size_t kh::SerialReader::bodySize() const {
+    return this->body_size;
+}
+
+size_t kh::SerialReader::strings() const {
+    return this->string_count;
+}
+
+std::string kh::SerialReader::string(size_t id) const {
+    size_t index_offset = KH_SERIAL_HEADER_SIZE + id * 4;
+    if (id >= this->string_count) {
+        throw kh::SerialException("string " + std::to_string(id) + " is out of range", index_offset);
+    }
+
+    size_t begin = readU32(this->string_index + id * 4);
+    size_t end = readU32(this->string_index + id * 4 + 4);
+    if (begin > end || end > this->string_data_size) {
+        throw kh::SerialException("string " + std::to_string(id) + " is out of bounds",
+                                  index_offset);
+    }
+
+    return std::string((const char*)this->string_data + begin, end - begin);
+}
+
+uint8_t kh::SerialReader::byte(size_t& offset) const {
+    if (offset >= this->body_size) {
+        throw kh::SerialException("unexpected end of the body", offset);
+    }
+
+    return this->body[offset++];
+}
+
+uint64_t kh::SerialReader::varint(size_t& offset) const {
+    size_t start = offset;
+    uint64_t n = 0;
+
+    for (unsigned shift = 0;; shift += 7) {
+        uint8_t chunk = this->byte(offset);
+        if (shift == 63 && chunk > 1) {
+            throw kh::SerialException("varint overflows 64 bits", start);
+        }
+
+        n |= (uint64_t)(chunk & 0x7F) << shift;
+        if (!(chunk & 0x80)) {
+            return n;
+        }
+    }
+}
+
+int64_t kh::SerialReader::signedVarint(size_t& offset) const {
+    uint64_t n = this->varint(offset);
+    return (int64_t)(n >> 1) ^ -(int64_t)(n & 1);
+}
+
+double kh::SerialReader::floating(size_t& offset) const {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < 8; i++) {
+        bits |= (uint64_t)this->byte(offset) << (i * 8);
+    }
+
+    double n;
+    std::memcpy(&n, &bits, sizeof(n));
+    return n;
+}
+
+bool kh::SerialReader::child(size_t& offset, size_t record, size_t& child_offset) const {
+    size_t start = offset;
+    uint64_t ref = this->varint(offset);
+    if (!ref) {
+        return false;
+    }
+
+    if (ref - 1 >= record) {
+        throw kh::SerialException("child record isn't written before its parent", start);
+    }
+    if (this->referenced[ref - 1]) {
+        throw kh::SerialException("child record is referenced more than once", start);
+    }
+
+    this->referenced[ref - 1] = true;
+    child_offset = ref - 1;
+    return true;
+}
+
+void kh::SerialReader::enter(size_t record) const {
+    if (this->depth >= KH_SERIAL_DEPTH_LIMIT) {
+        throw kh::SerialException("records nest too deeply", record);
+    }
+    this->depth++;
+}
+
+void kh::SerialReader::leave() const {
+    this->depth--;
+}
+
+/* Reads the trees back from the records, `offset` is the start of the record being read */
+static kh::AstTag readTag(const kh::SerialReader& reader, size_t& offset) {
+    size_t start = offset;
+    uint8_t tag = reader.byte(offset);
+    if (tag > (uint8_t)kh::AstTag::DICT) {
+        throw kh::SerialException("unknown record tag " + std::to_string(tag), start);
+    }
+
+    return (kh::AstTag)tag;
+}
+
+static void expectTag(const kh::SerialReader& reader, size_t& offset, kh::AstTag tag) {
+    size_t start = offset;
+    if (readTag(reader, offset) != tag) {
+        throw kh::SerialException("unexpected record tag", start);
+    }
+}
+
+static size_t readCount(const kh::SerialReader& reader, size_t& offset) {
+    size_t start = offset;
+    uint64_t count = reader.varint(offset);
+
+    /* Every element takes at least a byte */
+    if (count > reader.bodySize() - offset) {
+        throw kh::SerialException("count is out of bounds", start);
+    }
+
+    return count;
+}
+
+template <typename T>
+static T readEnum(const kh::SerialReader& reader, size_t& offset, T last) {
+    size_t start = offset;
+    uint8_t value = reader.byte(offset);
+    if (value > (uint8_t)last) {
+        throw kh::SerialException("unknown enum value " + std::to_string(value), start);
+    }
+
+    return (T)value;
+}
+
+static std::vector<std::string> readNames(const kh::SerialReader& reader, size_t& offset) {
+    std::vector<std::string> names(readCount(reader, offset));
+    for (std::string& name : names) {
+        name = reader.string(reader.varint(offset));
+    }
+    return names;
+}
+
+static std::vector<uint64_t> readDimensions(const kh::SerialReader& reader, size_t& offset) {
+    std::vector<uint64_t> dimensions(readCount(reader, offset));
+    for (uint64_t& dimension : dimensions) {
+        dimension = reader.varint(offset);
+    }
+    return dimensions;
+}
+
+static std::u32string readCodePoints(const kh::SerialReader& reader, size_t& offset) {
+    std::u32string str(readCount(reader, offset), U'\0');
+    for (char32_t& chr : str) {
+        chr = (char32_t)reader.varint(offset);
+    }
+    return str;
+}
+
+static std::shared_ptr<kh::AstBody> readBody(const kh::SerialReader& reader, size_t record);
+
+static kh::AstIdentifiers readIdentifiers(const kh::SerialReader& reader, size_t record);
+static kh::AstDeclaration readDeclaration(const kh::SerialReader& reader, size_t record);
+static kh::AstFunction readFunction(const kh::SerialReader& reader, size_t record);
+
+/* Reads a child reference and the child record itself with `read_child` */
+template <typename T, typename F>
+static bool readChild(const kh::SerialReader& reader, size_t& offset, size_t record, T& child,
+                      const F& read_child) {
+    size_t child_offset;
+    if (!reader.child(offset, record, child_offset)) {
+        return false;
+    }
+
+    reader.enter(child_offset);
+    child = read_child(reader, child_offset);
+    reader.leave();
+    return true;
+}
+
+static std::shared_ptr<kh::AstExpression> readExpression(const kh::SerialReader& reader,
+                                                         size_t& offset, size_t record) {
+    size_t start = offset;
+    std::shared_ptr<kh::AstBody> body;
+    if (!readChild(reader, offset, record, body, readBody)) {
+        return nullptr;
+    }
+
+    if (body->type != kh::AstBody::EXPRESSION) {
+        throw kh::SerialException("expected an expression record", start);
+    }
+
+    return std::static_pointer_cast<kh::AstExpression>(body);
+}
+
+static std::vector<std::shared_ptr<kh::AstExpression>>
+readExpressions(const kh::SerialReader& reader, size_t& offset, size_t record) {
+    std::vector<std::shared_ptr<kh::AstExpression>> expressions(readCount(reader, offset));
+    for (auto& expression : expressions) {
+        expression = readExpression(reader, offset, record);
+    }
+    return expressions;
+}
+
+static std::vector<std::shared_ptr<kh::AstBody>> readBodies(const kh::SerialReader& reader,
+                                                            size_t& offset, size_t record) {
+    std::vector<std::shared_ptr<kh::AstBody>> bodies(readCount(reader, offset));
+    for (auto& body : bodies) {
+        readChild(reader, offset, record, body, readBody);
+    }
+    return bodies;
+}
+
+template <typename T, typename F>
+static std::vector<T> readRecords(const kh::SerialReader& reader, size_t& offset, size_t record,
+                                  const F& read_record) {
+    size_t count = readCount(reader, offset);
+    std::vector<T> records;
+    records.reserve(count);
+
+    for (size_t i = 0; i < count; i++) {
+        size_t start = offset;
+        size_t child_offset;
+        if (!reader.child(offset, record, child_offset)) {
+            throw kh::SerialException("unexpected null record", start);
+        }
+        reader.enter(child_offset);
+        records.push_back(read_record(reader, child_offset));
+        reader.leave();
+    }
+    return records;
+}
+
+static kh::AstIdentifiers readIdentifiers(const kh::SerialReader& reader, size_t record) {
+    size_t offset = record;
+    expectTag(reader, offset, kh::AstTag::IDENTIFIERS);
+    size_t index = reader.varint(offset);
+
+    std::vector<std::string> identifiers = readNames(reader, offset);
+    std::vector<kh::AstIdentifiers> generics =
+        readRecords<kh::AstIdentifiers>(reader, offset, record, readIdentifiers);
+
+    std::vector<size_t> generics_refs;
+    std::vector<std::vector<uint64_t>> generics_array;
+    for (size_t i = 0; i < generics.size(); i++) {
+        generics_refs.push_back(reader.varint(offset));
+        generics_array.push_back(readDimensions(reader, offset));
+    }
+
+    return kh::AstIdentifiers(index, identifiers, generics, generics_refs, generics_array);
+}
+
+static kh::AstDeclaration readDeclaration(const kh::SerialReader& reader, size_t record) {
+    size_t offset = record;
+    expectTag(reader, offset, kh::AstTag::DECLARATION);
+    size_t index = reader.varint(offset);
+    uint8_t flags = reader.byte(offset);
+
+    size_t start = offset;
+    kh::AstIdentifiers var_type(0, {}, {}, {}, {});
+    if (!readChild(reader, offset, record, var_type, readIdentifiers)) {
+        throw kh::SerialException("unexpected null type", start);
+    }
+
+    std::vector<uint64_t> var_array = readDimensions(reader, offset);
+    std::string var_name = reader.string(reader.varint(offset));
+    std::shared_ptr<kh::AstExpression> expression = readExpression(reader, offset, record);
+    size_t refs = reader.varint(offset);
+
+    kh::AstDeclaration declaration(index, var_type, var_array, var_name, expression, refs);
+    declaration.is_public = flags & 1;
+    declaration.is_static = flags & 2;
+    return declaration;
+}
+
+static kh::AstFunction readFunction(const kh::SerialReader& reader, size_t record) {
+    size_t offset = record;
+    expectTag(reader, offset, kh::AstTag::FUNCTION);
+    size_t index = reader.varint(offset);
+    uint8_t flags = reader.byte(offset);
+
+    std::vector<std::string> identifiers = readNames(reader, offset);
+    std::vector<std::string> generic_args = readNames(reader, offset);
+    std::vector<uint64_t> id_array = readDimensions(reader, offset);
+
+    size_t start = offset;
+    kh::AstIdentifiers return_type(0, {}, {}, {}, {});
+    if (!readChild(reader, offset, record, return_type, readIdentifiers)) {
+        throw kh::SerialException("unexpected null return type", start);
+    }
+
+    std::vector<uint64_t> return_array = readDimensions(reader, offset);
+    size_t return_refs = reader.varint(offset);
+    std::vector<kh::AstDeclaration> arguments =
+        readRecords<kh::AstDeclaration>(reader, offset, record, readDeclaration);
+    std::vector<std::shared_ptr<kh::AstBody>> body = readBodies(reader, offset, record);
+
+    kh::AstFunction function(index, identifiers, generic_args, id_array, return_array, return_type,
+                             return_refs, arguments, body, flags & 4);
+    function.is_public = flags & 1;
+    function.is_static = flags & 2;
+    return function;
+}
+
+static kh::AstImport readImport(const kh::SerialReader& reader, size_t record) {
+    size_t offset = record;
+    expectTag(reader, offset, kh::AstTag::IMPORT);
+    size_t index = reader.varint(offset);
+    uint8_t flags = reader.byte(offset);
+
+    std::vector<std::string> path = readNames(reader, offset);
+    std::string identifier = reader.string(reader.varint(offset));
+
+    kh::AstImport import_ast(index, path, flags & 1, flags & 2, identifier);
+    import_ast.is_public = flags & 4;
+    return import_ast;
+}
+
+static kh::AstUserType readUserType(const kh::SerialReader& reader, size_t record) {
+    size_t offset = record;
+    expectTag(reader, offset, kh::AstTag::USER_TYPE);
+    size_t index = reader.varint(offset);
+    uint8_t flags = reader.byte(offset);
+
+    std::vector<std::string> identifiers = readNames(reader, offset);
+
+    std::shared_ptr<kh::AstIdentifiers> base;
+    kh::AstIdentifiers base_ast(0, {}, {}, {}, {});
+    if (readChild(reader, offset, record, base_ast, readIdentifiers)) {
+        base = std::make_shared<kh::AstIdentifiers>(base_ast);
+    }
+
+    std::vector<std::string> generic_args = readNames(reader, offset);
+    std::vector<kh::AstDeclaration> members =
+        readRecords<kh::AstDeclaration>(reader, offset, record, readDeclaration);
+    std::vector<kh::AstFunction> methods =
+        readRecords<kh::AstFunction>(reader, offset, record, readFunction);
+
+    kh::AstUserType type_ast(index, identifiers, base, generic_args, members, methods, flags & 1);
+    type_ast.is_public = flags & 2;
+    return type_ast;
+}
+
+static kh::AstEnumType readEnumType(const kh::SerialReader& reader, size_t record) {
+    size_t offset = record;
+    expectTag(reader, offset, kh::AstTag::ENUM_TYPE);
+    size_t index = reader.varint(offset);
+    uint8_t flags = reader.byte(offset);
+
+    std::vector<std::string> identifiers = readNames(reader, offset);
+    std::vector<std::string> members = readNames(reader, offset);
+
+    size_t start = offset;
+    std::vector<uint64_t> values = readDimensions(reader, offset);
+    if (values.size() != members.size()) {
+        throw kh::SerialException("enum values don't match its members", start);
+    }
+
+    kh::AstEnumType enum_ast(index, identifiers, members, values);
+    enum_ast.is_public = flags & 1;
+    return enum_ast;
+}
+
+static std::shared_ptr<kh::AstBody> readBody(const kh::SerialReader& reader, size_t record) {
+    size_t offset = record;
+    kh::AstTag tag = readTag(reader, offset);
+    size_t index = reader.varint(offset);
+
+    switch (tag) {
+        case kh::AstTag::IF: {
+            std::vector<std::shared_ptr<kh::AstExpression>> conditions =
+                readExpressions(reader, offset, record);
+
+            std::vector<std::vector<std::shared_ptr<kh::AstBody>>> bodies;
+            for (size_t i = 0; i < conditions.size(); i++) {
+                bodies.push_back(readBodies(reader, offset, record));
+            }
+
+            std::vector<std::shared_ptr<kh::AstBody>> else_body = readBodies(reader, offset, record);
+            return std::make_shared<kh::AstIf>(index, conditions, bodies, else_body);
+        }
+
+        case kh::AstTag::WHILE:
+        case kh::AstTag::DO_WHILE: {
+            std::shared_ptr<kh::AstExpression> condition = readExpression(reader, offset, record);
+            std::vector<std::shared_ptr<kh::AstBody>> body = readBodies(reader, offset, record);
+
+            if (tag == kh::AstTag::WHILE) {
+                return std::make_shared<kh::AstWhile>(index, condition, body);
+            }
+            return std::make_shared<kh::AstDoWhile>(index, condition, body);
+        }
+
+        case kh::AstTag::FOR: {
+            std::shared_ptr<kh::AstExpression> initialize = readExpression(reader, offset, record);
+            std::shared_ptr<kh::AstExpression> condition = readExpression(reader, offset, record);
+            std::shared_ptr<kh::AstExpression> step = readExpression(reader, offset, record);
+            std::vector<std::shared_ptr<kh::AstBody>> body = readBodies(reader, offset, record);
+            return std::make_shared<kh::AstFor>(index, initialize, condition, step, body);
+        }
+
+        case kh::AstTag::FOREACH: {
+            std::shared_ptr<kh::AstExpression> target = readExpression(reader, offset, record);
+            std::shared_ptr<kh::AstExpression> iterator = readExpression(reader, offset, record);
+            std::vector<std::shared_ptr<kh::AstBody>> body = readBodies(reader, offset, record);
+            return std::make_shared<kh::AstForEach>(index, target, iterator, body);
+        }
+
+        case kh::AstTag::STATEMENT: {
+            kh::AstStatement::Type type =
+                readEnum(reader, offset, kh::AstStatement::Type::RETURN);
+
+            if (type == kh::AstStatement::Type::RETURN) {
+                std::shared_ptr<kh::AstExpression> expression =
+                    readExpression(reader, offset, record);
+                return std::make_shared<kh::AstStatement>(index, type, expression);
+            }
+            return std::make_shared<kh::AstStatement>(index, type, (size_t)reader.varint(offset));
+        }
+
+        case kh::AstTag::IDENTIFIERS:
+            return std::make_shared<kh::AstIdentifiers>(readIdentifiers(reader, record));
+
+        case kh::AstTag::DECLARATION:
+            return std::make_shared<kh::AstDeclaration>(readDeclaration(reader, record));
+
+        case kh::AstTag::FUNCTION:
+            return std::make_shared<kh::AstFunction>(readFunction(reader, record));
+
+        case kh::AstTag::UNARY:
+        case kh::AstTag::REV_UNARY: {
+            kh::Operator operation = readEnum(reader, offset, kh::Operator::ADDRESS);
+            std::shared_ptr<kh::AstExpression> rvalue = readExpression(reader, offset, record);
+
+            if (tag == kh::AstTag::UNARY) {
+                return std::make_shared<kh::AstUnaryOperation>(index, operation, rvalue);
+            }
+            return std::make_shared<kh::AstRevUnaryOperation>(index, operation, rvalue);
+        }
+
+        case kh::AstTag::BINARY: {
+            kh::Operator operation = readEnum(reader, offset, kh::Operator::ADDRESS);
+            std::shared_ptr<kh::AstExpression> lvalue = readExpression(reader, offset, record);
+            std::shared_ptr<kh::AstExpression> rvalue = readExpression(reader, offset, record);
+            return std::make_shared<kh::AstBinaryOperation>(index, operation, lvalue, rvalue);
+        }
+
+        case kh::AstTag::TERNARY: {
+            std::shared_ptr<kh::AstExpression> condition = readExpression(reader, offset, record);
+            std::shared_ptr<kh::AstExpression> value = readExpression(reader, offset, record);
+            std::shared_ptr<kh::AstExpression> otherwise = readExpression(reader, offset, record);
+            return std::make_shared<kh::AstTernaryOperation>(index, condition, value, otherwise);
+        }
+
+        case kh::AstTag::COMPARISON: {
+            std::vector<kh::Operator> operations(readCount(reader, offset));
+            for (kh::Operator& operation : operations) {
+                operation = readEnum(reader, offset, kh::Operator::ADDRESS);
+            }
+
+            std::vector<std::shared_ptr<kh::AstExpression>> values =
+                readExpressions(reader, offset, record);
+            return std::make_shared<kh::AstComparisonExpression>(index, operations, values);
+        }
+
+        case kh::AstTag::SUBSCRIPT:
+        case kh::AstTag::CALL: {
+            std::shared_ptr<kh::AstExpression> expression = readExpression(reader, offset, record);
+            std::vector<std::shared_ptr<kh::AstExpression>> arguments =
+                readExpressions(reader, offset, record);
+
+            if (tag == kh::AstTag::CALL) {
+                return std::make_shared<kh::AstCallExpression>(index, expression, arguments);
+            }
+            return std::make_shared<kh::AstSubscriptExpression>(index, expression, arguments);
+        }
+
+        case kh::AstTag::SCOPING: {
+            std::shared_ptr<kh::AstExpression> expression = readExpression(reader, offset, record);
+            std::vector<std::string> identifiers = readNames(reader, offset);
+            return std::make_shared<kh::AstScoping>(index, expression, identifiers);
+        }
+
+        case kh::AstTag::VALUE: {
+            kh::AstValue::ValueType type = readEnum(reader, offset, kh::AstValue::STRING);
+
+            switch (type) {
+                case kh::AstValue::CHARACTER:
+                    return std::make_shared<kh::AstValue>(index, (char32_t)reader.varint(offset));
+                case kh::AstValue::UINTEGER:
+                    return std::make_shared<kh::AstValue>(index, reader.varint(offset));
+                case kh::AstValue::INTEGER:
+                    return std::make_shared<kh::AstValue>(index, reader.signedVarint(offset));
+                case kh::AstValue::FLOATING:
+                case kh::AstValue::IMAGINARY:
+                    return std::make_shared<kh::AstValue>(index, reader.floating(offset), type);
+                case kh::AstValue::BUFFER:
+                    return std::make_shared<kh::AstValue>(index,
+                                                          reader.string(reader.varint(offset)));
+                default:
+                    return std::make_shared<kh::AstValue>(index, readCodePoints(reader, offset));
+            }
+        }
+
+        case kh::AstTag::TUPLE:
+        case kh::AstTag::LIST: {
+            std::vector<std::shared_ptr<kh::AstExpression>> elements =
+                readExpressions(reader, offset, record);
+
+            if (tag == kh::AstTag::TUPLE) {
+                return std::make_shared<kh::AstTuple>(index, elements);
+            }
+            return std::make_shared<kh::AstList>(index, elements);
+        }
+
+        case kh::AstTag::DICT: {
+            size_t start = offset;
+            std::vector<std::shared_ptr<kh::AstExpression>> keys =
+                readExpressions(reader, offset, record);
+            std::vector<std::shared_ptr<kh::AstExpression>> items =
+                readExpressions(reader, offset, record);
+
+            if (keys.size() != items.size()) {
+                throw kh::SerialException("dict keys don't match its items", start);
+            }
+            return std::make_shared<kh::AstDict>(index, keys, items);
+        }
+
+        default:
+            throw kh::SerialException("expected a body record", record);
+    }
+}
+
+std::vector<kh::Token> kh::deserializeTokens(const char* data, size_t size) {
+    kh::SerialReader reader(data, size, KH_SERIAL_TOKENS_MAGIC);
+    size_t offset = 0;
+
+    size_t count = readCount(reader, offset);
+    std::vector<kh::Token> tokens;
+    tokens.reserve(count);
+
+    size_t index = 0;
+    for (size_t i = 0; i < count; i++) {
+        kh::TokenType type = readEnum(reader, offset, kh::TokenType::IMAGINARY);
+        index += reader.signedVarint(offset);
+        size_t length = reader.varint(offset);
+        size_t line = reader.varint(offset);
+        size_t column = reader.varint(offset);
+
+        kh::TokenValue value;
+        switch (type) {
+            case kh::TokenType::IDENTIFIER:
+                value.identifier = reader.string(reader.varint(offset));
+                break;
+            case kh::TokenType::OPERATOR:
+                value.operator_type = readEnum(reader, offset, kh::Operator::ADDRESS);
+                break;
+            case kh::TokenType::SYMBOL:
+                value.symbol_type = readEnum(reader, offset, kh::Symbol::SQUARE_CLOSE);
+                break;
+            case kh::TokenType::CHARACTER:
+                value.character = (char32_t)reader.varint(offset);
+                break;
+            case kh::TokenType::STRING:
+                value.string = readCodePoints(reader, offset);
+                break;
+            case kh::TokenType::BUFFER:
+                value.buffer = reader.string(reader.varint(offset));
+                break;
+            case kh::TokenType::UINTEGER:
+                value.uinteger = reader.varint(offset);
+                break;
+            case kh::TokenType::INTEGER:
+                value.integer = reader.signedVarint(offset);
+                break;
+            case kh::TokenType::FLOATING:
+            case kh::TokenType::IMAGINARY:
+                value.floating = reader.floating(offset);
+                break;
+        }
+
+        tokens.emplace_back(index, index + length, type, value);
+        tokens.back().line = line;
+        tokens.back().column = column;
+    }
+
+    return tokens;
+}
+
+static kh::AstModule readModule(const kh::SerialReader& reader) {
+    size_t record = reader.root();
+    size_t offset = record;
+    expectTag(reader, offset, kh::AstTag::MODULE);
+    reader.varint(offset);
+
+    std::vector<kh::AstImport> imports =
+        readRecords<kh::AstImport>(reader, offset, record, readImport);
+    std::vector<kh::AstFunction> functions =
+        readRecords<kh::AstFunction>(reader, offset, record, readFunction);
+    std::vector<kh::AstUserType> user_types =
+        readRecords<kh::AstUserType>(reader, offset, record, readUserType);
+    std::vector<kh::AstEnumType> enums =
+        readRecords<kh::AstEnumType>(reader, offset, record, readEnumType);
+    std::vector<kh::AstDeclaration> variables =
+        readRecords<kh::AstDeclaration>(reader, offset, record, readDeclaration);
+
+    return kh::AstModule(imports, functions, user_types, enums, variables);
+}
+
+kh::AstModule kh::deserializeAst(const char* data, size_t size) {
+    return readModule(kh::SerialReader(data, size, KH_SERIAL_AST_MAGIC));
+}
+
+uint64_t kh::interfaceHash(const char* data, size_t size) {
+    kh::SerialReader reader(data, size, KH_SERIAL_INTERFACE_MAGIC);
+
+    uint64_t hash = 0;
+    size_t offset = 0;
+    for (size_t i = 0; i < 8; i++) {
+        hash |= (uint64_t)reader.byte(offset) << (i * 8);
+    }
+
+    return hash;
+}
+
+kh::AstModule kh::deserializeInterface(const char* data, size_t size) {
+    return readModule(kh::SerialReader(data, size, KH_SERIAL_INTERFACE_MAGIC));
+}
@@ -4,6 +4,7 @@
  * Copyright (C) 2021 Kithare Organization
  */
 
+#include <kithare/json.hpp>
 #include <kithare/string.hpp>
 #include <kithare/token.hpp>
 #include <kithare/utf8.hpp>
@@ -15,186 +16,255 @@ kh::Token::Token(size_t _index, size_t _end, kh::TokenType _type, const kh::Toke
     : column(0), line(0), index(_index), length(_end - index), type(_type), value(_value) {}
 
 std::u32string kh::str(const kh::Token& token, bool show_token_type) {
-    std::u32string str;
+    std::string str;
+    {
+        kh::Sink sink(str);
+        kh::writeToken(sink, token, show_token_type);
+    }
+
+    return kh::decodeUtf8(str);
+}
+
+void kh::writeToken(kh::Sink& sink, const kh::Token& token, bool show_token_type) {
     if (show_token_type) {
-        str = kh::str(token.type) + U' ';
+        sink.write(kh::cstr(token.type));
+        sink.write(' ');
     }
 
     switch (token.type) {
         case kh::TokenType::IDENTIFIER:
-            str += kh::decodeUtf8(token.value.identifier);
+            sink.write(token.value.identifier);
             break;
         case kh::TokenType::OPERATOR:
-            str += kh::str(token.value.operator_type);
+            sink.write(kh::cstr(token.value.operator_type));
             break;
         case kh::TokenType::SYMBOL:
-            str += kh::str(token.value.symbol_type);
+            sink.write(kh::cstr(token.value.symbol_type));
             break;
 
         case kh::TokenType::CHARACTER:
-            str += kh::str(token.value.character);
+            sink.writeUtf8(token.value.character);
             break;
         case kh::TokenType::STRING:
-            str += kh::quote(token.value.string);
+            sink.write(kh::quote(token.value.string));
             break;
         case kh::TokenType::BUFFER:
-            str += kh::quote(token.value.buffer);
+            sink.write(kh::quote(token.value.buffer));
             break;
 
         case kh::TokenType::UINTEGER:
-            str += kh::str(token.value.uinteger);
+            sink.writeUint(token.value.uinteger);
             break;
         case kh::TokenType::INTEGER:
-            str += kh::str(token.value.integer);
+            sink.writeInt(token.value.integer);
             break;
         case kh::TokenType::FLOATING:
-            str += kh::str(token.value.floating);
+            sink.writeFloat(token.value.floating);
             break;
         case kh::TokenType::IMAGINARY:
-            str += kh::str(token.value.imaginary) + U"i";
+            sink.writeFloat(token.value.imaginary);
+            sink.write('i');
             break;
 
         default:
-            str = U"unknown";
+            sink.write("unknown");
     }
+}
+
+void kh::writeJson(kh::JsonWriter& json, const kh::Token& token) {
+    json.beginObject();
+    json.member("type", kh::cstr(token.type));
+    json.member("index", token.index);
+    json.member("length", token.length);
+    json.key("value");
 
-    return str;
+    switch (token.type) {
+        case kh::TokenType::IDENTIFIER:
+            json.value(token.value.identifier);
+            break;
+        case kh::TokenType::OPERATOR:
+            json.value(kh::cstr(token.value.operator_type));
+            break;
+        case kh::TokenType::SYMBOL:
+            json.value(kh::cstr(token.value.symbol_type));
+            break;
+
+        case kh::TokenType::CHARACTER:
+            json.value(std::u32string(1, token.value.character));
+            break;
+        case kh::TokenType::STRING:
+            json.value(token.value.string);
+            break;
+        case kh::TokenType::BUFFER:
+            json.buffer(token.value.buffer);
+            break;
+
+        case kh::TokenType::UINTEGER:
+            json.value(token.value.uinteger);
+            break;
+        case kh::TokenType::INTEGER:
+            json.value(token.value.integer);
+            break;
+        case kh::TokenType::FLOATING:
+            json.value(token.value.floating);
+            break;
+        case kh::TokenType::IMAGINARY:
+            json.value(token.value.imaginary);
+            break;
+
+        default:
+            json.null();
+    }
+
+    json.endObject();
 }
 
-std::u32string kh::str(kh::TokenType type) {
+const char* kh::cstr(kh::TokenType type) {
     switch (type) {
         case kh::TokenType::IDENTIFIER:
-            return U"identifier";
+            return "identifier";
         case kh::TokenType::OPERATOR:
-            return U"operator";
+            return "operator";
         case kh::TokenType::SYMBOL:
-            return U"symbol";
+            return "symbol";
 
         case kh::TokenType::CHARACTER:
-            return U"character";
+            return "character";
         case kh::TokenType::STRING:
-            return U"string";
+            return "string";
         case kh::TokenType::BUFFER:
-            return U"buffer";
+            return "buffer";
 
         case kh::TokenType::UINTEGER:
-            return U"uinteger";
+            return "uinteger";
         case kh::TokenType::INTEGER:
-            return U"integer";
+            return "integer";
         case kh::TokenType::FLOATING:
-            return U"floating";
+            return "floating";
         case kh::TokenType::IMAGINARY:
-            return U"imaginary";
+            return "imaginary";
 
         default:
-            return U"unknown";
+            return "unknown";
     }
 }
 
-std::u32string kh::str(kh::Operator op) {
+const char* kh::cstr(kh::Operator op) {
     switch (op) {
         case kh::Operator::ADD:
-            return U"+";
+            return "+";
         case kh::Operator::SUB:
-            return U"-";
+            return "-";
         case kh::Operator::MUL:
-            return U"*";
+            return "*";
         case kh::Operator::DIV:
-            return U"/";
+            return "/";
         case kh::Operator::MOD:
-            return U"%";
+            return "%";
         case kh::Operator::POW:
-            return U"^";
+            return "^";
 
         case kh::Operator::IADD:
-            return U"+=";
+            return "+=";
         case kh::Operator::ISUB:
-            return U"-=";
+            return "-=";
         case kh::Operator::IMUL:
-            return U"*=";
+            return "*=";
         case kh::Operator::IDIV:
-            return U"/=";
+            return "/=";
         case kh::Operator::IMOD:
-            return U"%=";
+            return "%=";
         case kh::Operator::IPOW:
-            return U"^=";
+            return "^=";
 
         case kh::Operator::INCREMENT:
-            return U"++";
+            return "++";
         case kh::Operator::DECREMENT:
-            return U"--";
+            return "--";
 
         case kh::Operator::EQUAL:
-            return U"==";
+            return "==";
         case kh::Operator::NOT_EQUAL:
-            return U"!=";
+            return "!=";
         case kh::Operator::LESS:
-            return U"<";
+            return "<";
         case kh::Operator::MORE:
-            return U">";
+            return ">";
         case kh::Operator::LESS_EQUAL:
-            return U"<=";
+            return "<=";
         case kh::Operator::MORE_EQUAL:
-            return U">=";
+            return ">=";
 
         case kh::Operator::BIT_AND:
-            return U"&";
+            return "&";
         case kh::Operator::BIT_OR:
-            return U"|";
+            return "|";
         case kh::Operator::BIT_NOT:
-            return U"~";
+            return "~";
 
         case kh::Operator::BIT_LSHIFT:
-            return U"<<";
+            return "<<";
         case kh::Operator::BIT_RSHIFT:
-            return U">>";
+            return ">>";
 
         case kh::Operator::AND:
-            return U"and";
+            return "and";
         case kh::Operator::OR:
-            return U"or";
+            return "or";
         case kh::Operator::NOT:
-            return U"not";
+            return "not";
 
         case kh::Operator::ASSIGN:
-            return U"=";
+            return "=";
         case kh::Operator::SIZEOF:
-            return U"#";
+            return "#";
         case kh::Operator::ADDRESS:
-            return U"@";
+            return "@";
 
         default:
-            return U"unknown";
+            return "unknown";
     }
 }
 
-std::u32string kh::str(kh::Symbol sym) {
+const char* kh::cstr(kh::Symbol sym) {
     switch (sym) {
         case kh::Symbol::SEMICOLON:
-            return U";";
+            return ";";
         case kh::Symbol::DOT:
-            return U".";
+            return ".";
         case kh::Symbol::COMMA:
-            return U",";
+            return ",";
         case kh::Symbol::COLON:
-            return U":";
+            return ":";
 
         case kh::Symbol::PARENTHESES_OPEN:
-            return U"(";
+            return "(";
         case kh::Symbol::PARENTHESES_CLOSE:
-            return U")";
+            return ")";
 
         case kh::Symbol::CURLY_OPEN:
-            return U"{";
+            return "{";
         case kh::Symbol::CURLY_CLOSE:
-            return U"}";
+            return "}";
 
         case kh::Symbol::SQUARE_OPEN:
-            return U"[";
+            return "[";
         case kh::Symbol::SQUARE_CLOSE:
-            return U"]";
+            return "]";
 
         default:
-            return U"unknown";
+            return "unknown";
     }
 }
+
+std::u32string kh::str(kh::TokenType type) {
+    return kh::str(std::string(kh::cstr(type)));
+}
+
+std::u32string kh::str(kh::Operator op) {
+    return kh::str(std::string(kh::cstr(op)));
+}
+
+std::u32string kh::str(kh::Symbol sym) {
+    return kh::str(std::string(kh::cstr(sym)));
+}
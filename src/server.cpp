@@ -0,0 +1,313 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#ifndef _WIN32
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <kithare/server.hpp>
+#include <kithare/thread_pool.hpp>
+#include <kithare/utf8.hpp>
+
+/* macOS doesn't have `MSG_NOSIGNAL`, `SIGPIPE` is ignored by the server there instead */
+#if !defined(_WIN32) && !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#endif
+
+/* Upper limit of a single frame, so a malformed request can't make the server allocate gigabytes */
+#define KH_SERVER_MAX_FRAME ((uint32_t)1 << 30)
+
+/* Frames are received in chunks of this size, so the memory of a frame only grows with the bytes
+ * which actually arrived rather than with the size a client claims */
+#define KH_SERVER_CHUNK_SIZE ((uint32_t)1 << 16)
+
+/* Seconds the server waits on a client to send or receive before dropping the connection, so
+ * clients going silent don't hold onto the workers */
+#define KH_SERVER_TIMEOUT 10
+
+
+std::string kh::ServerException::format() const {
+    return this->what;
+}
+
+#ifdef _WIN32
+std::string kh::defaultSocketPath() {
+    return "";
+}
+
+void kh::runServer(const std::string& socket_path, const kh::ServerHandler& handler, size_t workers) {
+    throw kh::ServerException("the compile server is not supported on Windows");
+}
+
+kh::ServerResponse kh::runClient(const std::string& socket_path, const kh::ServerRequest& request) {
+    throw kh::ServerException("the compile server is not supported on Windows");
+}
+#else
+/* Sends the whole of `size` bytes, returns false if the connection broke or timed out */
+static bool sendAll(int fd, const char* data, size_t size) {
+    while (size) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+
+        data += sent;
+        size -= sent;
+    }
+
+    return true;
+}
+
+/* Receives exactly `size` bytes, returns false if the connection broke or timed out */
+static bool recvAll(int fd, char* data, size_t size) {
+    while (size) {
+        ssize_t received = recv(fd, data, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+
+        data += received;
+        size -= received;
+    }
+
+    return true;
+}
+
+/* Every integer is sent as a little endian 32 bit integer, and every string is sent as a frame
+ * prefixed by its length */
+static void appendU32(std::string& buffer, uint32_t n) {
+    for (size_t i = 0; i < 4; i++) {
+        buffer += (char)((n >> (i * 8)) & 0xff);
+    }
+}
+
+static void appendFrame(std::string& buffer, const std::string& frame) {
+    appendU32(buffer, (uint32_t)frame.size());
+    buffer += frame;
+}
+
+static bool recvU32(int fd, uint32_t& n) {
+    unsigned char bytes[4];
+    if (!recvAll(fd, (char*)bytes, 4)) {
+        return false;
+    }
+
+    n = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    return true;
+}
+
+static bool recvFrame(int fd, std::string& frame) {
+    uint32_t size;
+    if (!recvU32(fd, size) || size > KH_SERVER_MAX_FRAME) {
+        return false;
+    }
+
+    frame.clear();
+    while (frame.size() < size) {
+        size_t received = frame.size();
+        frame.resize(received + std::min(size - (uint32_t)received, KH_SERVER_CHUNK_SIZE));
+        if (!recvAll(fd, &frame[received], frame.size() - received)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static sockaddr_un socketAddress(const std::string& socket_path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        throw kh::ServerException("the socket path `" + socket_path + "` is too long");
+    }
+
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return address;
+}
+
+/* Reads a request, runs it with the handler, then sends back the response */
+static void serveConnection(int fd, const kh::ServerHandler& handler) {
+    kh::ServerRequest request;
+    uint32_t argc;
+
+    if (recvFrame(fd, request.cwd) && recvU32(fd, argc)) {
+        bool ok = true;
+        /* The count comes from the client, so no more than a typical command line is reserved */
+        request.args.reserve(std::min(argc, (uint32_t)64));
+
+        for (uint32_t i = 0; i < argc && ok; i++) {
+            std::string arg;
+            if (!recvFrame(fd, arg)) {
+                ok = false;
+                break;
+            }
+
+            try {
+                request.args.push_back(kh::decodeUtf8(arg));
+            }
+            catch (kh::Utf8DecodingException&) {
+                ok = false;
+            }
+        }
+
+        if (ok) {
+            /* A failing request is reported to its client, the server keeps serving the others */
+            kh::ServerResponse response;
+            std::string failure = "The compile server failed to handle the request: ";
+            try {
+                response = handler(request);
+            }
+            catch (kh::Exception& exc) {
+                response.code = 1;
+                response.err = failure + exc.format() + '\n';
+            }
+            catch (std::exception& exc) {
+                response.code = 1;
+                response.err = failure + exc.what() + '\n';
+            }
+
+            std::string buffer;
+            buffer.reserve(12 + response.out.size() + response.err.size());
+            appendU32(buffer, (uint32_t)response.code);
+            appendFrame(buffer, response.out);
+            appendFrame(buffer, response.err);
+            sendAll(fd, buffer.data(), buffer.size());
+        }
+    }
+
+    close(fd);
+}
+
+/* Removes a socket left behind by a server which didn't shut down cleanly. Other files and the
+ * sockets of servers still listening on them are left alone */
+static void removeStaleSocket(const std::string& socket_path, const sockaddr_un& address) {
+    struct stat info;
+    if (lstat(socket_path.c_str(), &info) < 0) {
+        return;
+    }
+
+    if (!S_ISSOCK(info.st_mode)) {
+        throw kh::ServerException("`" + socket_path + "` already exists and is not a socket");
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0) {
+        bool listening = connect(fd, (const sockaddr*)&address, sizeof(address)) == 0;
+        close(fd);
+        if (listening) {
+            throw kh::ServerException("a compile server is already listening on `" + socket_path +
+                                      "`");
+        }
+    }
+
+    unlink(socket_path.c_str());
+}
+
+std::string kh::defaultSocketPath() {
+    const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir && *runtime_dir) {
+        return std::string(runtime_dir) + "/kcr.sock";
+    }
+
+    return "/tmp/kcr-" + std::to_string(getuid()) + ".sock";
+}
+
+void kh::runServer(const std::string& socket_path, const kh::ServerHandler& handler, size_t workers) {
+    sockaddr_un address = socketAddress(socket_path);
+    removeStaleSocket(socket_path, address);
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        throw kh::ServerException("unable to create a socket: " + std::string(std::strerror(errno)));
+    }
+
+    if (bind(server_fd, (sockaddr*)&address, sizeof(address)) < 0 || listen(server_fd, 128) < 0) {
+        std::string reason = std::strerror(errno);
+        close(server_fd);
+        throw kh::ServerException("unable to listen on `" + socket_path + "`: " + reason);
+    }
+
+    /* Broken client connections are handled through the return value of `send` */
+    std::signal(SIGPIPE, SIG_IGN);
+
+    kh::ThreadPool pool(workers);
+
+    while (true) {
+        int client_fd = accept(server_fd, nullptr, nullptr);
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+
+            std::string reason = std::strerror(errno);
+            close(server_fd);
+            unlink(socket_path.c_str());
+            throw kh::ServerException("unable to accept a connection: " + reason);
+        }
+
+        timeval timeout = {KH_SERVER_TIMEOUT, 0};
+        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        pool.submit([client_fd, &handler] { serveConnection(client_fd, handler); });
+    }
+}
+
+kh::ServerResponse kh::runClient(const std::string& socket_path, const kh::ServerRequest& request) {
+    sockaddr_un address = socketAddress(socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw kh::ServerException("unable to create a socket: " + std::string(std::strerror(errno)));
+    }
+
+    if (connect(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+        std::string reason = std::strerror(errno);
+        close(fd);
+        throw kh::ServerException("unable to connect to the compile server at `" + socket_path +
+                                  "`: " + reason);
+    }
+
+    std::string buffer;
+    appendFrame(buffer, request.cwd);
+    appendU32(buffer, (uint32_t)request.args.size());
+    for (const std::u32string& arg : request.args) {
+        appendFrame(buffer, kh::encodeUtf8(arg));
+    }
+
+    kh::ServerResponse response;
+    uint32_t code;
+
+    bool ok = sendAll(fd, buffer.data(), buffer.size()) && recvU32(fd, code) &&
+              recvFrame(fd, response.out) && recvFrame(fd, response.err);
+    close(fd);
+
+    if (!ok) {
+        throw kh::ServerException("the connection to the compile server was broken");
+    }
+
+    response.code = (int)code;
+    return response;
+}
+#endif
@@ -0,0 +1,161 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+#include <kithare/sink.hpp>
+#include <kithare/string.hpp>
+
+
+kh::Sink::Sink(int _fd) : fd(_fd) {
+    this->buffer = new char[KH_SINK_BUFFER_SIZE];
+}
+
+kh::Sink::Sink(std::string& _str) : str(&_str) {}
+
+kh::Sink::~Sink() {
+    this->flush();
+    delete[] this->buffer;
+}
+
+void kh::Sink::write(char chr) {
+    if (this->str) {
+        *this->str += chr;
+        return;
+    }
+
+    if (this->size == KH_SINK_BUFFER_SIZE) {
+        this->flush();
+    }
+
+    this->buffer[this->size++] = chr;
+}
+
+void kh::Sink::write(const char* str) {
+    this->write(str, std::strlen(str));
+}
+
+void kh::Sink::write(const char* data, size_t size) {
+    if (this->str) {
+        this->str->append(data, size);
+        return;
+    }
+
+    if (this->size + size > KH_SINK_BUFFER_SIZE) {
+        this->flush();
+
+        /* Writes anything which doesn't fit in the buffer directly */
+        if (size > KH_SINK_BUFFER_SIZE) {
+            this->writeOut(data, size);
+            return;
+        }
+    }
+
+    std::memcpy(this->buffer + this->size, data, size);
+    this->size += size;
+}
+
+void kh::Sink::write(const std::string& str) {
+    this->write(str.data(), str.size());
+}
+
+void kh::Sink::write(const std::u32string& str) {
+    for (char32_t chr : str) {
+        this->writeUtf8(chr);
+    }
+}
+
+void kh::Sink::writeUtf8(char32_t chr) {
+    char bytes[4];
+    size_t size;
+
+    if (chr > 0xFFFF) {
+        bytes[0] = (char)(0b11110000 | (0b00000111 & (chr >> 18)));
+        bytes[1] = (char)(0b10000000 | (0b00111111 & (chr >> 12)));
+        bytes[2] = (char)(0b10000000 | (0b00111111 & (chr >> 6)));
+        bytes[3] = (char)(0b10000000 | (0b00111111 & chr));
+        size = 4;
+    }
+    else if (chr > 0x7FF) {
+        bytes[0] = (char)(0b11100000 | (0b00001111 & (chr >> 12)));
+        bytes[1] = (char)(0b10000000 | (0b00111111 & (chr >> 6)));
+        bytes[2] = (char)(0b10000000 | (0b00111111 & chr));
+        size = 3;
+    }
+    else if (chr > 0x7F) {
+        bytes[0] = (char)(0b11000000 | (0b00011111 & (chr >> 6)));
+        bytes[1] = (char)(0b10000000 | (0b00111111 & chr));
+        size = 2;
+    }
+    else {
+        this->write((char)chr);
+        return;
+    }
+
+    this->write(bytes, size);
+}
+
+void kh::Sink::writeInt(int64_t n) {
+    if (n < 0) {
+        this->write('-');
+        this->writeUint(0 - (uint64_t)n);
+    }
+    else {
+        this->writeUint((uint64_t)n);
+    }
+}
+
+void kh::Sink::writeUint(uint64_t n) {
+    char digits[20];
+    size_t i = sizeof(digits);
+
+    do {
+        digits[--i] = (char)('0' + n % 10);
+        n /= 10;
+    } while (n);
+
+    this->write(digits + i, sizeof(digits) - i);
+}
+
+void kh::Sink::writeFloat(double n) {
+    char digits[KH_FLOAT_STR_SIZE];
+    this->write(digits, kh::formatFloat(digits, n) - digits);
+}
+
+void kh::Sink::flush() {
+    if (this->size) {
+        this->writeOut(this->buffer, this->size);
+        this->size = 0;
+    }
+}
+
+void kh::Sink::writeOut(const char* data, size_t size) {
+    while (size) {
+#ifdef _WIN32
+        int written = _write(this->fd, data, (unsigned)size);
+#else
+        ssize_t written = ::write(this->fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+#endif
+
+        /* There's nowhere to report a broken output to, so the rest is dropped */
+        if (written <= 0) {
+            return;
+        }
+
+        data += written;
+        size -= written;
+    }
+}
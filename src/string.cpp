@@ -4,129 +4,175 @@
  * Copyright (C) 2021 Kithare Organization
  */
 
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KH_STRING_SSE2
+
+#ifdef _MSC_VER
+#include <intrin.h>
+static inline unsigned kh_ctz(unsigned n) {
+    unsigned long index;
+    _BitScanForward(&index, n);
+    return index;
+}
+#else
+#define kh_ctz __builtin_ctz
+#endif
+#endif
+
 #include <kithare/string.hpp>
 #include <kithare/utf8.hpp>
 
 
-std::u32string kh::quote(const std::u32string& str) {
-    std::u32string quoted_str = U"\"";
-    quoted_str.reserve(str.size() + str.size() / 8 + 2);
+/* The character after the backslash of each ASCII character's escape, 0 for the characters which are
+ * written as is, and `x` for the ones which are written as hex escapes */
+static const char escapes[128] = {
+    'x', 'x', 'x', 'x', 'x', 'x', 'x', 'a', 'b', 't', 'n', 'v', 'f', 'r', 'x', 'x',
+    'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x', 'x',
+    0,   0,   '"', 0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   '\\', 0,  0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   'x'};
+
+static const char hex_digits[] = "0123456789abcdef";
+
+/* Gets the size of a character once it's quoted */
+static inline size_t quotedSize(char32_t chr) {
+    if (chr < 128) {
+        return escapes[chr] == 0 ? 1 : escapes[chr] == 'x' ? 4 : 2;
+    }
+
+    return chr <= 0xff ? 4 : chr <= 0xffff ? 6 : 10;
+}
+
+/* Writes the escape of a character which isn't written as is, such as `\n`, `\xff`, `\u1234` or
+ * `\U00012345` */
+static inline char32_t* writeEscape(char32_t* out, char32_t chr) {
+    *out++ = U'\\';
+
+    if (chr < 128 && escapes[chr] != 'x') {
+        *out++ = escapes[chr];
+        return out;
+    }
+
+    size_t digits;
+    if (chr <= 0xff) {
+        *out++ = U'x';
+        digits = 2;
+    }
+    else if (chr <= 0xffff) {
+        *out++ = U'u';
+        digits = 4;
+    }
+    else {
+        *out++ = U'U';
+        digits = 8;
+    }
+
+    for (size_t i = digits; i > 0; i--) {
+        *out++ = hex_digits[(chr >> ((i - 1) * 4)) & 0xf];
+    }
 
+    return out;
+}
+
+#ifdef KH_STRING_SSE2
+/* Gets the amount of characters at the start of a block of 16 bytes which are written as is */
+static inline size_t printableRun(const char* str) {
+    __m128i chars = _mm_loadu_si128((const __m128i*)str);
+
+    /* Bytes above 127 are negative when compared as signed, so they fail the first comparison */
+    __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8(31)),
+                                      _mm_cmplt_epi8(chars, _mm_set1_epi8(127)));
+    __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('"')),
+                                   _mm_cmpeq_epi8(chars, _mm_set1_epi8('\\')));
+
+    unsigned mask = ~_mm_movemask_epi8(_mm_andnot_si128(special, printable)) & 0xffff;
+    return mask ? kh_ctz(mask) : 16;
+}
+
+/* Widens 16 bytes into 16 characters */
+static inline void widen(char32_t* out, const char* str) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i chars = _mm_loadu_si128((const __m128i*)str);
+    __m128i low = _mm_unpacklo_epi8(chars, zero);
+    __m128i high = _mm_unpackhi_epi8(chars, zero);
+
+    _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi16(low, zero));
+    _mm_storeu_si128((__m128i*)(out + 4), _mm_unpackhi_epi16(low, zero));
+    _mm_storeu_si128((__m128i*)(out + 8), _mm_unpacklo_epi16(high, zero));
+    _mm_storeu_si128((__m128i*)(out + 12), _mm_unpackhi_epi16(high, zero));
+}
+#endif
+
+std::u32string kh::quote(const std::u32string& str) {
+    size_t size = 2;
     for (char32_t chr : str) {
-        switch (chr) {
-            case U'"':
-                quoted_str += U"\\\"";
-                break;
-            case U'\\':
-                quoted_str += U"\\\\";
-                break;
-            case U' ':
-                quoted_str += U" ";
-                break;
-            case U'\t':
-                quoted_str += U"\\t";
-                break;
-            case U'\v':
-                quoted_str += U"\\v";
-                break;
-            case U'\n':
-                quoted_str += U"\\n";
-                break;
-            case U'\r':
-                quoted_str += U"\\r";
-                break;
-            case U'\b':
-                quoted_str += U"\\b";
-                break;
-            case U'\f':
-                quoted_str += U"\\f";
-                break;
-            case U'\a':
-                quoted_str += U"\\a";
-                break;
-            default:
-                if (chr > 32 && chr < 127) {
-                    quoted_str += (char32_t)chr;
-                }
-                else {
-                    std::stringstream sstream;
-                    sstream << std::hex << (uint32_t)chr;
-
-                    if (chr <= 0xff)
-                        quoted_str +=
-                            U"\\x" + kh::str((sstream.str().size() == 1 ? "0" : "") + sstream.str());
-                    else if (chr <= 0xfff) {
-                        quoted_str += U"\\u0" + kh::str(sstream.str());
-                    }
-                    else if (chr <= 0xfffff) {
-                        quoted_str += U"\\U000" + kh::str(sstream.str());
-                    }
-                    else if (chr <= 0xffffff) {
-                        quoted_str += U"\\U00" + kh::str(sstream.str());
-                    }
-                    else if (chr <= 0xfffffff) {
-                        quoted_str += U"\\U0" + kh::str(sstream.str());
-                    }
-                    else
-                        quoted_str += U"\\U" + kh::str(sstream.str());
-                }
+        size += quotedSize(chr);
+    }
+
+    std::u32string quoted_str(size, U'"');
+    char32_t* out = &quoted_str[1];
+    const char32_t* chr = str.data();
+    const char32_t* end = chr + str.size();
+
+    while (chr < end) {
+        /* Copies a run of characters which are written as is at once */
+        const char32_t* run = chr;
+        while (chr < end && *chr < 128 && escapes[*chr] == 0) {
+            chr++;
+        }
+
+        std::memcpy(out, run, (chr - run) * sizeof(char32_t));
+        out += chr - run;
+
+        if (chr < end) {
+            out = writeEscape(out, *chr++);
         }
     }
 
-    quoted_str += U'"';
     return quoted_str;
 }
 
 std::u32string kh::quote(const std::string& str) {
-    std::u32string quoted_str = U"\"";
-    quoted_str.reserve(str.size() + str.size() / 8 + 2);
-
+    size_t size = 2;
     for (char chr : str) {
-        switch (chr) {
-            case '"':
-                quoted_str += U"\\\"";
-                break;
-            case '\\':
-                quoted_str += U"\\\\";
-                break;
-            case ' ':
-                quoted_str += U" ";
-                break;
-            case '\t':
-                quoted_str += U"\\t";
-                break;
-            case '\v':
-                quoted_str += U"\\v";
-                break;
-            case '\n':
-                quoted_str += U"\\n";
-                break;
-            case '\r':
-                quoted_str += U"\\r";
-                break;
-            case '\b':
-                quoted_str += U"\\b";
-                break;
-            case '\f':
-                quoted_str += U"\\f";
-                break;
-            case '\a':
-                quoted_str += U"\\a";
+        size += quotedSize((uint8_t)chr);
+    }
+
+    std::u32string quoted_str(size, U'"');
+    char32_t* out = &quoted_str[1];
+    const char* chr = str.data();
+    const char* end = chr + str.size();
+
+    while (chr < end) {
+#ifdef KH_STRING_SSE2
+        /* Widens whole blocks of printable ASCII characters at once */
+        while (end - chr >= 16) {
+            size_t run = printableRun(chr);
+            widen(out, chr);
+            out += run;
+            chr += run;
+
+            if (run < 16) {
                 break;
-            default:
-                if (chr > 32 && chr < 127) {
-                    quoted_str += (char32_t)chr;
-                }
-                else {
-                    std::stringstream sstream;
-                    sstream << std::hex << (int)(uint8_t)chr;
-                    quoted_str +=
-                        U"\\x" + kh::str((sstream.str().size() == 1 ? "0" : "") + sstream.str());
-                }
+            }
+        }
+#endif
+
+        while (chr < end && (uint8_t)*chr < 128 && escapes[(uint8_t)*chr] == 0) {
+            *out++ = (uint8_t)*chr++;
+        }
+
+        if (chr < end) {
+            out = writeEscape(out, (uint8_t)*chr++);
         }
     }
 
-    quoted_str += U'"';
     return quoted_str;
 }
 
@@ -188,8 +234,16 @@ std::u32string kh::str(char32_t chr) {
 
 KH_REPR_TO_STRING(int64_t);
 KH_REPR_TO_STRING(uint64_t);
-KH_REPR_TO_STRING(float);
-KH_REPR_TO_STRING(double);
+
+std::u32string kh::str(float n) {
+    char buffer[KH_FLOAT_STR_SIZE];
+    return std::u32string(buffer, kh::formatFloat(buffer, n));
+}
+
+std::u32string kh::str(double n) {
+    char buffer[KH_FLOAT_STR_SIZE];
+    return std::u32string(buffer, kh::formatFloat(buffer, n));
+}
 
 std::u32string kh::str(const std::complex<float>& n) {
     return kh::str(n.real()) + U" + " + kh::str(n.imag()) + U"i";
@@ -198,3 +252,14 @@ std::u32string kh::str(const std::complex<float>& n) {
 std::u32string kh::str(const std::complex<double>& n) {
     return kh::str(n.real()) + U" + " + kh::str(n.imag()) + U"i";
 }
+
+uint64_t kh::hash(const std::string& str) {
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for (char chr : str) {
+        hash ^= (uint8_t)chr;
+        hash *= 0x100000001b3;
+    }
+
+    return hash;
+}
@@ -0,0 +1,911 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include <kithare/builder.hpp>
+#include <kithare/ir.hpp>
+#include <kithare/lexer.hpp>
+#include <kithare/parser.hpp>
+#include <kithare/passes.hpp>
+#include <kithare/symbols.hpp>
+#include <kithare/test.hpp>
+#include <kithare/thread_pool.hpp>
+#include <kithare/utf8.hpp>
+
+
+static std::vector<std::string>* errors_ptr;
+
+struct Counted {
+    size_t* destroyed;
+
+    Counted(size_t* _destroyed) : destroyed(_destroyed) {}
+    ~Counted() {
+        (*this->destroyed)++;
+    }
+};
+
+static void irArenaTest() {
+    size_t destroyed = 0;
+
+    {
+        kh::IrArena arena;
+        for (size_t i = 0; i < 10000; i++) {
+            char* chr = arena.make<char>('a');
+            double* n = arena.make<double>(1.5);
+            KH_TEST_ASSERT(*chr == 'a' && *n == 1.5);
+            KH_TEST_ASSERT((size_t)n % alignof(double) == 0);
+            arena.make<Counted>(&destroyed);
+        }
+
+        /* Larger than a block */
+        char* large = (char*)arena.allocate(KH_IR_ARENA_BLOCK_SIZE * 2, 16);
+        KH_TEST_ASSERT((size_t)large % 16 == 0);
+        large[KH_IR_ARENA_BLOCK_SIZE * 2 - 1] = 0;
+
+        KH_TEST_ASSERT(arena.allocated() ==
+                       10000 * (sizeof(char) + sizeof(double) + sizeof(Counted)) +
+                           KH_IR_ARENA_BLOCK_SIZE * 2);
+        KH_TEST_ASSERT(destroyed == 0);
+    }
+
+    KH_TEST_ASSERT(destroyed == 10000);
+    return;
+error:
+    errors_ptr->back() += "irArenaTest";
+}
+
+static void irModuleTest() {
+    kh::IrModule module_ir;
+    const kh::IrType* int64 = module_ir.type(kh::IrType::INT64);
+    const kh::IrType* int32 = module_ir.type(kh::IrType::INT32);
+    const kh::IrType* double_type = module_ir.type(kh::IrType::DOUBLE);
+    const kh::IrType* bool_type = module_ir.type(kh::IrType::BOOL);
+    const kh::IrType* list = module_ir.type(kh::IrType::LIST, {int64});
+
+    KH_TEST_ASSERT(module_ir.type(kh::IrType::INT64) == int64);
+    KH_TEST_ASSERT(module_ir.type(kh::IrType::ARRAY, {int64}, 3) ==
+                   module_ir.type(kh::IrType::ARRAY, {int64}, 3));
+    KH_TEST_ASSERT(module_ir.type(kh::IrType::ARRAY, {int64}, 3) !=
+                   module_ir.type(kh::IrType::ARRAY, {int64}, 4));
+    KH_TEST_ASSERT(kh::str(module_ir.type(kh::IrType::FUNC, {int64, double_type, bool_type})) ==
+                   U"func!(int64(double, bool))");
+    KH_TEST_ASSERT(kh::str(module_ir.type(kh::IrType::DICT, {int32, list})) ==
+                   U"dict!(int32, list!(int64))");
+
+    /* The pools only keep one of each constant */
+    KH_TEST_ASSERT(module_ir.constant(kh::IrConst::integer(int64, 1)) == 0);
+    KH_TEST_ASSERT(module_ir.constant(kh::IrConst::integer(int64, 2)) == 1);
+    KH_TEST_ASSERT(module_ir.constant(kh::IrConst::integer(int64, 1)) == 0);
+    KH_TEST_ASSERT(module_ir.constant(kh::IrConst::integer(int32, 1)) == 2);
+    KH_TEST_ASSERT(module_ir.constant(kh::IrConst::floating(double_type, 0.0)) == 3);
+    KH_TEST_ASSERT(module_ir.constant(kh::IrConst::floating(double_type, -0.0)) == 4);
+    KH_TEST_ASSERT(module_ir.constant(kh::IrConst::floating(double_type, NAN)) == 5);
+    KH_TEST_ASSERT(module_ir.constant(kh::IrConst::floating(double_type, NAN)) == 5);
+    KH_TEST_ASSERT(module_ir.string(U"hello") == module_ir.string(U"hello"));
+    KH_TEST_ASSERT(module_ir.string(U"hello") != module_ir.string(U"world"));
+    KH_TEST_ASSERT(module_ir.strings.size() == 2);
+
+    {
+        kh::IrFunction* max = module_ir.function("max", int64);
+        max->local("a", int64);
+        max->local("b", int64);
+        max->arguments = 2;
+
+        uint32_t a = max->emit(kh::IrOp::LOAD, int64, 0);
+        uint32_t b = max->emit(kh::IrOp::LOAD, int64, 1);
+        uint32_t more = max->emit(kh::IrOp::MORE, bool_type, a, b);
+        max->emit(kh::IrOp::BRANCH, module_ir.type(kh::IrType::VOID), more, 4, 5);
+        max->emit(kh::IrOp::RETURN, module_ir.type(kh::IrType::VOID), a);
+        max->emit(kh::IrOp::RETURN, module_ir.type(kh::IrType::VOID), b);
+
+        kh::IrFunction* caller = module_ir.function("caller", int64);
+        uint32_t one = caller->emit(kh::IrOp::CONST, int64, 0);
+        uint32_t two = caller->emit(kh::IrOp::CONST, int64, 1);
+        uint32_t result = caller->call(int64, 0, {one, two});
+        caller->emit(kh::IrOp::RETURN, module_ir.type(kh::IrType::VOID), result);
+
+        KH_TEST_ASSERT(kh::str(module_ir) == U"function max(int64 a, int64 b) -> int64\n"
+                                             U"    0: %0 = load int64 $0\n"
+                                             U"    1: %1 = load int64 $1\n"
+                                             U"    2: %2 = more bool %0, %1\n"
+                                             U"    3: branch %2, #4, #5\n"
+                                             U"    4: return %0\n"
+                                             U"    5: return %1\n"
+                                             U"function caller() -> int64\n"
+                                             U"    0: %0 = const int64 1\n"
+                                             U"    1: %1 = const int64 2\n"
+                                             U"    2: %2 = call int64 max(%0, %1)\n"
+                                             U"    3: return %2\n");
+
+        /* Large functions are just long arrays */
+        kh::IrFunction* large = module_ir.function("large", int64);
+        uint32_t sum = large->emit(kh::IrOp::CONST, int64, 0);
+        for (size_t i = 0; i < 1000000; i++) {
+            sum = large->emit(kh::IrOp::ADD, int64, sum, sum);
+        }
+        large->emit(kh::IrOp::RETURN, module_ir.type(kh::IrType::VOID), sum);
+        KH_TEST_ASSERT(large->code.size() == 1000002);
+        KH_TEST_ASSERT(sizeof(kh::IrInstruction) <= 32);
+    }
+
+    return;
+error:
+    errors_ptr->back() += "irModuleTest";
+}
+
+/* Makes `depth` nested generic types, such as `Box!(Box!(int64))` */
+static const kh::IrType* nestedType(size_t depth, kh::IrType::Kind kind) {
+    const kh::IrType* type = kh::internType(kh::IrType::INT64);
+    for (size_t i = 0; i < depth; i++) {
+        type = kh::internType(kind, {type, kh::internType(kh::IrType::BOOL)}, 0, "Box");
+    }
+    return type;
+}
+
+static void irTypeInternTest() {
+    const kh::IrType* int64 = kh::internType(kh::IrType::INT64);
+    const kh::IrType* tuple = kh::internType(kh::IrType::TUPLE, {int64, int64});
+
+    /* Types are told apart by all of their parts */
+    KH_TEST_ASSERT(kh::internType(kh::IrType::TUPLE, {int64, int64}) == tuple);
+    KH_TEST_ASSERT(kh::internType(kh::IrType::TUPLE, {int64}) != tuple);
+    KH_TEST_ASSERT(kh::internType(kh::IrType::LIST, {int64, int64}) != tuple);
+    KH_TEST_ASSERT(kh::internType(kh::IrType::STRUCT, {}, 0, "A") !=
+                   kh::internType(kh::IrType::STRUCT, {}, 0, "B"));
+    KH_TEST_ASSERT(kh::internType(kh::IrType::ARRAY, {int64}, 1) !=
+                   kh::internType(kh::IrType::ARRAY, {int64}, 2));
+
+    {
+        /* Threads interning the same types at once all get the same instances */
+        std::vector<const kh::IrType*> types(64);
+        kh::ThreadPool pool(8);
+        for (size_t i = 0; i < types.size(); i++) {
+            pool.submit([&types, i]() {
+                types[i] = nestedType(500 + i % 2, i % 4 < 2 ? kh::IrType::CLASS : kh::IrType::STRUCT);
+            });
+        }
+        pool.wait();
+
+        for (size_t i = 0; i < types.size(); i++) {
+            KH_TEST_ASSERT(types[i] == types[i % 4]);
+            KH_TEST_ASSERT(types[i] ==
+                           nestedType(500 + i % 2, i % 4 < 2 ? kh::IrType::CLASS : kh::IrType::STRUCT));
+        }
+        KH_TEST_ASSERT(types[0] != types[1] && types[0] != types[2]);
+
+        /* The types themselves are keys */
+        std::unordered_map<const kh::IrType*, size_t> counts;
+        for (const kh::IrType* type : types) {
+            counts[type]++;
+        }
+        KH_TEST_ASSERT(counts.size() == 4);
+        KH_TEST_ASSERT(counts[types[3]] == 16);
+
+        /* Interning the same types again doesn't add any */
+        size_t interned = kh::internedTypes();
+        nestedType(501, kh::IrType::CLASS);
+        KH_TEST_ASSERT(kh::internedTypes() == interned);
+
+        /* A new generation starts with none, and is freed with the last scope using it */
+        std::weak_ptr<kh::TypeInterner> released;
+        {
+            std::shared_ptr<kh::TypeInterner> generation = kh::newTypeInterner();
+            released = generation;
+            kh::TypeScope scope(generation);
+            generation.reset();
+
+            KH_TEST_ASSERT(kh::internedTypes() == 0);
+            KH_TEST_ASSERT(nestedType(2, kh::IrType::CLASS) == nestedType(2, kh::IrType::CLASS));
+            KH_TEST_ASSERT(kh::internedTypes() == 4);
+            KH_TEST_ASSERT(nestedType(500, kh::IrType::CLASS) != types[0]);
+        }
+        KH_TEST_ASSERT(released.expired());
+        KH_TEST_ASSERT(!kh::currentTypeInterner());
+        KH_TEST_ASSERT(kh::internedTypes() == interned);
+    }
+
+    return;
+error:
+    errors_ptr->back() += "irTypeInternTest";
+}
+
+static void symbolsTest() {
+    uint32_t x = kh::internIdentifier("x");
+    uint32_t y = kh::internIdentifier("y");
+    KH_TEST_ASSERT(x != y && kh::internIdentifier("x") == x);
+    KH_TEST_ASSERT(kh::identifierName(y) == "y");
+
+    {
+        /* Threads interning the same names all get the same IDs */
+        std::vector<uint32_t> ids(64);
+        kh::ThreadPool pool(8);
+        for (size_t i = 0; i < ids.size(); i++) {
+            pool.submit([&ids, i]() {
+                for (size_t j = 0; j < 1000; j++) {
+                    kh::internIdentifier("name" + std::to_string(j));
+                }
+                ids[i] = kh::internIdentifier("name" + std::to_string(i % 4));
+            });
+        }
+        pool.wait();
+
+        for (size_t i = 0; i < ids.size(); i++) {
+            KH_TEST_ASSERT(ids[i] == kh::internIdentifier("name" + std::to_string(i % 4)));
+        }
+
+        /* The map grows past its initial slots without losing any */
+        kh::IdMap<size_t> map;
+        for (size_t i = 0; i < 1000; i++) {
+            map[kh::internIdentifier("name" + std::to_string(i))] = i;
+        }
+        KH_TEST_ASSERT(map.size() == 1000);
+        for (size_t i = 0; i < 1000; i++) {
+            const size_t* value = map.find(kh::internIdentifier("name" + std::to_string(i)));
+            KH_TEST_ASSERT(value && *value == i);
+        }
+        KH_TEST_ASSERT(!map.find(x));
+    }
+
+    {
+        /* A new generation has none of the names, the process wide IDs are back after it */
+        std::shared_ptr<kh::IdentifierInterner> generation = kh::newIdentifierInterner();
+        {
+            kh::IdentifierScope scope(generation);
+            KH_TEST_ASSERT(kh::currentIdentifierInterner() == generation);
+            uint32_t z = kh::internIdentifier("z");
+            KH_TEST_ASSERT(z < KH_IDENTIFIER_SHARDS && kh::identifierName(z) == "z");
+        }
+        KH_TEST_ASSERT(!kh::currentIdentifierInterner());
+        KH_TEST_ASSERT(kh::internIdentifier("x") == x && kh::identifierName(y) == "y");
+    }
+
+    {
+        kh::ScopedSymbols symbols;
+        symbols.push();
+        KH_TEST_ASSERT(symbols.declare(x, 0));
+        KH_TEST_ASSERT(!symbols.declare(x, 1));
+
+        /* Inner scopes shadow the outer ones until they're popped */
+        symbols.push();
+        KH_TEST_ASSERT(symbols.declare(x, 2) && symbols.declare(y, 3));
+        KH_TEST_ASSERT(symbols.find(x) == 2 && symbols.find(y) == 3);
+        symbols.pop();
+        KH_TEST_ASSERT(symbols.find(x) == 0 && symbols.find(y) == KH_NO_IDENTIFIER);
+
+        /* Deep nesting doesn't change what's found */
+        for (uint32_t i = 0; i < 10000; i++) {
+            symbols.push();
+            KH_TEST_ASSERT(symbols.declare(i % 2 ? x : y, i));
+        }
+        KH_TEST_ASSERT(symbols.depth() == 10001);
+        KH_TEST_ASSERT(symbols.find(x) == 9999 && symbols.find(y) == 9998);
+        for (uint32_t i = 0; i < 10000; i++) {
+            symbols.pop();
+        }
+        KH_TEST_ASSERT(symbols.find(x) == 0 && symbols.find(y) == KH_NO_IDENTIFIER);
+
+        /* Redeclared in a later scope at the same depth */
+        symbols.push();
+        KH_TEST_ASSERT(symbols.declare(y, 4));
+        symbols.pop();
+        symbols.push();
+        KH_TEST_ASSERT(symbols.declare(y, 5) && symbols.find(y) == 5);
+        symbols.pop();
+    }
+
+    return;
+error:
+    errors_ptr->back() += "symbolsTest";
+}
+
+/* Lexes and parses a source which is expected to be valid, then builds it */
+static std::vector<kh::BuildException> buildSource(const std::u32string& source,
+                                                   kh::IrModule& module_ir, size_t workers = 0) {
+    std::vector<kh::LexException> lex_exceptions;
+    kh::LexerContext lexer_context{source, lex_exceptions};
+    std::vector<kh::Token> tokens = kh::lex(lexer_context);
+
+    std::vector<kh::ParseException> parse_exceptions;
+    kh::ParserContext parser_context{tokens, parse_exceptions};
+    kh::AstModule ast = kh::parseWhole(parser_context);
+
+    kh::Builder builder(ast, module_ir);
+    builder.build(workers);
+    kh::locate(builder.exceptions, tokens);
+
+    if (!lex_exceptions.empty() || !parse_exceptions.empty()) {
+        builder.exceptions.emplace_back("invalid test source", 0);
+    }
+    return builder.exceptions;
+}
+
+static void semanticizerTest() {
+    kh::IrModule module_ir;
+    std::vector<kh::BuildException> exceptions =
+        buildSource(U"enum Color { red, green = 5 }\n"
+                    U"def add(int a, float b) -> float { return a + b; }\n"
+                    U"def pick(bool up) -> Color {\n"
+                    U"    int32 n;\n"
+                    U"    while up { n += 1; if n > 2 { break; } }\n"
+                    U"    return Color.green;\n"
+                    U"}\n",
+                    module_ir);
+    KH_TEST_ASSERT(exceptions.empty());
+
+    KH_TEST_ASSERT(kh::str(module_ir) == U"function add(int64 a, float b) -> float\n"
+                                         U"    0: %0 = load int64 $0\n"
+                                         U"    1: %1 = load float $1\n"
+                                         U"    2: %2 = convert float %0\n"
+                                         U"    3: %3 = add float %2, %1\n"
+                                         U"    4: return %3\n"
+                                         U"function pick(bool up) -> Color\n"
+                                         U"    local $1 int32 n\n"
+                                         U"    0: %0 = const int32 0\n"
+                                         U"    1: store $1, %0\n"
+                                         U"    2: %2 = load bool $0\n"
+                                         U"    3: branch %2, #4, #17\n"
+                                         U"    4: %4 = load int32 $1\n"
+                                         U"    5: %5 = const int64 1\n"
+                                         U"    6: %6 = convert int64 %4\n"
+                                         U"    7: %7 = add int64 %6, %5\n"
+                                         U"    8: %8 = convert int32 %7\n"
+                                         U"    9: store $1, %8\n"
+                                         U"    10: %10 = load int32 $1\n"
+                                         U"    11: %11 = const int64 2\n"
+                                         U"    12: %12 = convert int64 %10\n"
+                                         U"    13: %13 = more bool %12, %11\n"
+                                         U"    14: branch %13, #15, #16\n"
+                                         U"    15: jump #17\n"
+                                         U"    16: jump #2\n"
+                                         U"    17: %17 = const Color 5\n"
+                                         U"    18: return %17\n");
+
+    {
+        /* Diagnostics of every function, sorted by where they are */
+        kh::IrModule invalid_ir;
+        exceptions = buildSource(U"def a() -> int { return \"x\"; }\n"
+                                 U"def b() { undefined; c(1); }\n"
+                                 U"def c() -> int { if true { return 1; } }\n"
+                                 U"def a() {}\n",
+                                 invalid_ir);
+        KH_TEST_ASSERT(exceptions.size() == 5);
+        KH_TEST_ASSERT(exceptions[0].format() == "can't convert `str` to `int64` at line 1 column 18");
+        KH_TEST_ASSERT(exceptions[1].format() == "`undefined` is not declared at line 2 column 11");
+        KH_TEST_ASSERT(exceptions[2].format() ==
+                       "`c` takes 0 argument(s) but 1 were given at line 2 column 23");
+        KH_TEST_ASSERT(exceptions[3].format() ==
+                       "`c` doesn't return a value on every path at line 3 column 5");
+        KH_TEST_ASSERT(exceptions[4].format() == "`a` is already declared at line 4 column 5");
+    }
+
+    return;
+error:
+    errors_ptr->back() += "semanticizerTest";
+}
+
+static void semanticizerParallelTest() {
+    /* Lots of functions using overlapping constants, which are pooled in the order of the functions
+     * however many threads lowered them */
+    std::u32string source = U"int base = 7;\n";
+    for (size_t i = 0; i < 500; i++) {
+        source += U"def f" + kh::decodeUtf8(std::to_string(i)) + U"(int x) -> int { str s = \"s" +
+                  kh::decodeUtf8(std::to_string(i % 50)) + U"\"; return x * " +
+                  kh::decodeUtf8(std::to_string(i % 30)) + U" + base; }\n";
+        if (i % 100 == 7) {
+            source += U"def e" + kh::decodeUtf8(std::to_string(i)) + U"() { missing(); }\n";
+        }
+    }
+
+    kh::IrModule serial_ir;
+    std::vector<kh::BuildException> serial_exceptions = buildSource(source, serial_ir, 1);
+    std::u32string serial_dump = kh::str(serial_ir);
+
+    for (size_t workers : {2, 8}) {
+        kh::IrModule parallel_ir;
+        std::vector<kh::BuildException> parallel_exceptions =
+            buildSource(source, parallel_ir, workers);
+
+        KH_TEST_ASSERT(kh::str(parallel_ir) == serial_dump);
+        KH_TEST_ASSERT(parallel_ir.constants.size() == serial_ir.constants.size());
+        KH_TEST_ASSERT(parallel_ir.strings == serial_ir.strings);
+        KH_TEST_ASSERT(parallel_exceptions.size() == serial_exceptions.size());
+        for (size_t i = 0; i < parallel_exceptions.size(); i++) {
+            KH_TEST_ASSERT(parallel_exceptions[i].format() == serial_exceptions[i].format());
+        }
+    }
+
+    KH_TEST_ASSERT(serial_ir.functions.size() == 506);
+    KH_TEST_ASSERT(serial_ir.strings.size() == 50);
+    KH_TEST_ASSERT(serial_exceptions.size() == 5);
+    for (size_t i = 1; i < serial_exceptions.size(); i++) {
+        KH_TEST_ASSERT(serial_exceptions[i - 1].line < serial_exceptions[i].line);
+    }
+
+    return;
+error:
+    errors_ptr->back() += "semanticizerParallelTest";
+}
+
+static void semanticizerChainTest() {
+    /* Chains of operators whose length the parser doesn't limit, lowered on the worker threads
+     * without running out of stack */
+    std::u32string negations = U"def f() -> int { int x = ";
+    std::u32string nots = U"def g(bool b) -> bool { return ";
+    std::u32string sums = U"def h(int x) -> int { return x";
+    std::u32string ands = U"def i(bool b) -> bool { return b";
+    std::u32string ternaries = U"def j(bool b) -> int { return 1";
+    for (size_t i = 0; i < 50000; i++) {
+        negations += U"- ";
+        nots += U"not ";
+        sums += U" + x";
+        ands += U" and b";
+        ternaries += U" if b else 2";
+    }
+
+    {
+        kh::IrModule module_ir;
+        std::vector<kh::BuildException> exceptions =
+            buildSource(negations + U"1; return x; }\n" + nots + U"b; }\n" + sums + U"; }\n" + ands +
+                            U"; }\n" + ternaries + U"; }\n",
+                        module_ir, 2);
+        KH_TEST_ASSERT(exceptions.empty());
+        KH_TEST_ASSERT(module_ir.functions.size() == 5);
+
+        size_t negated = 0, added = 0;
+        for (const kh::IrInstruction& instruction : module_ir.functions[0]->code) {
+            negated += instruction.op == kh::IrOp::NEG;
+        }
+        for (const kh::IrInstruction& instruction : module_ir.functions[2]->code) {
+            added += instruction.op == kh::IrOp::ADD;
+        }
+        KH_TEST_ASSERT(negated == 50000 && added == 50000);
+    }
+
+    return;
+error:
+    errors_ptr->back() += "semanticizerChainTest";
+}
+
+static void genericTest() {
+    /* The instances are used from many functions at once, and by each other */
+    std::u32string source = U"struct Pair!(A, B) { A first; B second; }\n"
+                            U"def id!T(T x) -> T { return x; }\n"
+                            U"def wrap!T(T x) -> T { return id(x); }\n";
+    for (size_t i = 0; i < 200; i++) {
+        source += U"def u" + kh::decodeUtf8(std::to_string(i)) +
+                  U"(int x) -> int { float f = id!float(1.5); str s = wrap(\"s\"); "
+                  U"Pair!(int, str) p; return id(x); }\n";
+    }
+
+    kh::IrModule serial_ir;
+    std::vector<kh::BuildException> serial_exceptions = buildSource(source, serial_ir, 1);
+    std::u32string serial_dump = kh::str(serial_ir);
+
+    for (size_t workers : {2, 8}) {
+        kh::IrModule parallel_ir;
+        KH_TEST_ASSERT(buildSource(source, parallel_ir, workers).empty());
+        KH_TEST_ASSERT(kh::str(parallel_ir) == serial_dump);
+    }
+
+    KH_TEST_ASSERT(serial_exceptions.empty());
+    KH_TEST_ASSERT(serial_ir.functions.size() == 204);
+    KH_TEST_ASSERT(serial_ir.functions[200]->name == "id!(float)");
+    KH_TEST_ASSERT(serial_ir.functions[201]->name == "id!(int64)");
+    KH_TEST_ASSERT(serial_ir.functions[202]->name == "id!(str)");
+    KH_TEST_ASSERT(serial_ir.functions[203]->name == "wrap!(str)");
+    KH_TEST_ASSERT(
+        serial_ir.functions[0]->locals[3].type ==
+        kh::internType(kh::IrType::STRUCT,
+                       {kh::internType(kh::IrType::INT64), kh::internType(kh::IrType::STRING)}, 0,
+                       "Pair"));
+
+    {
+        /* The tasks of a build intern into the generation of the thread building */
+        size_t interned = kh::internedTypes();
+        kh::TypeScope types(kh::newTypeInterner());
+        kh::IdentifierScope identifiers(kh::newIdentifierInterner());
+
+        kh::IrModule module_ir;
+        KH_TEST_ASSERT(buildSource(source, module_ir, 8).empty());
+        KH_TEST_ASSERT(kh::str(module_ir) == serial_dump);
+        KH_TEST_ASSERT(
+            module_ir.functions[0]->locals[3].type ==
+            kh::internType(kh::IrType::STRUCT,
+                           {kh::internType(kh::IrType::INT64), kh::internType(kh::IrType::STRING)},
+                           0, "Pair"));
+        KH_TEST_ASSERT(kh::internedTypes() != interned);
+    }
+
+    {
+        /* Each instance asking for a larger one has to be stopped */
+        kh::IrModule module_ir;
+        std::vector<kh::BuildException> exceptions =
+            buildSource(U"def grow!T(T x) -> int { list!T y; return grow(y); }\n"
+                        U"def g() -> int { return grow(1); }\n"
+                        U"def h() -> int { return id!(int, float)(2) + id(); }\n"
+                        U"def id!T(T x) -> T { return x; }\n",
+                        module_ir, 4);
+
+        KH_TEST_ASSERT(exceptions.size() == 3);
+        KH_TEST_ASSERT(exceptions[0].format() ==
+                       "`grow` is instantiated too deeply at line 1 column 47");
+        KH_TEST_ASSERT(exceptions[1].format() ==
+                       "`id` takes 1 generic argument(s) but 2 were given at line 3 column 40");
+        KH_TEST_ASSERT(exceptions[2].format() ==
+                       "can't infer the generic arguments of `id` at line 3 column 48");
+    }
+
+    return;
+error:
+    errors_ptr->back() += "genericTest";
+}
+
+static void mergeTest() {
+    /* The `size` instances are all `eight`, which makes the `outer` instances the same as well */
+    kh::IrModule module_ir;
+    std::vector<kh::BuildException> exceptions =
+        buildSource(U"def eight() -> int { return 8; }\n"
+                    U"def size!T() -> int { return 8; }\n"
+                    U"def outer!T() -> int { return size!T() + 1; }\n"
+                    U"def id!T(T x) -> T { return x; }\n"
+                    U"def main() { int a = outer!int() + outer!str() + size!bool() + id(1); "
+                    U"float b = id!float(2.5); }\n",
+                    module_ir);
+    KH_TEST_ASSERT(exceptions.empty());
+    KH_TEST_ASSERT(module_ir.functions.size() == 9);
+
+    KH_TEST_ASSERT(kh::mergeIdenticalFunctions(module_ir) == 4);
+    KH_TEST_ASSERT(module_ir.functions.size() == 5);
+    KH_TEST_ASSERT(module_ir.functions[0]->name == "eight");
+    KH_TEST_ASSERT(module_ir.functions[1]->name == "main");
+    KH_TEST_ASSERT(module_ir.functions[2]->name == "id!(float)");
+    KH_TEST_ASSERT(module_ir.functions[3]->name == "id!(int64)");
+    KH_TEST_ASSERT(module_ir.functions[4]->name == "outer!(int64)");
+    KH_TEST_ASSERT(module_ir.functions[4]->code[0].a == 0);
+    for (const kh::IrInstruction& instruction : module_ir.functions[1]->code) {
+        KH_TEST_ASSERT(instruction.op != kh::IrOp::CALL || instruction.a != 1);
+    }
+
+    /* Nothing's left to merge */
+    KH_TEST_ASSERT(kh::mergeIdenticalFunctions(module_ir) == 0);
+
+    return;
+error:
+    errors_ptr->back() += "mergeTest";
+}
+
+static void foldTest() {
+    const kh::IrType* int8_type = kh::internType(kh::IrType::INT8);
+    const kh::IrType* int32_type = kh::internType(kh::IrType::INT32);
+    const kh::IrType* int64_type = kh::internType(kh::IrType::INT64);
+    const kh::IrType* uint8_type = kh::internType(kh::IrType::UINT8);
+    const kh::IrType* float_type = kh::internType(kh::IrType::FLOAT);
+    const kh::IrType* double_type = kh::internType(kh::IrType::DOUBLE);
+    const kh::IrType* complex_type = kh::internType(kh::IrType::COMPLEX);
+    const kh::IrType* bool_type = kh::internType(kh::IrType::BOOL);
+    kh::IrConst result = kh::IrConst::boolean(bool_type, false);
+
+    /* Integers wrap around to their size */
+    KH_TEST_ASSERT(kh::evaluate(kh::IrOp::ADD, int8_type, kh::IrConst::integer(int8_type, 127),
+                                kh::IrConst::integer(int8_type, 1), result));
+    KH_TEST_ASSERT(result == kh::IrConst::integer(int8_type, -128));
+    KH_TEST_ASSERT(kh::evaluate(kh::IrOp::SUB, uint8_type, kh::IrConst::uinteger(uint8_type, 0),
+                                kh::IrConst::uinteger(uint8_type, 1), result));
+    KH_TEST_ASSERT(result == kh::IrConst::uinteger(uint8_type, 255));
+    KH_TEST_ASSERT(kh::evaluate(kh::IrOp::DIV, int64_type,
+                                kh::IrConst::integer(int64_type, INT64_MIN),
+                                kh::IrConst::integer(int64_type, -1), result));
+    KH_TEST_ASSERT(result == kh::IrConst::integer(int64_type, INT64_MIN));
+    KH_TEST_ASSERT(kh::evaluate(kh::IrOp::CONVERT, int8_type, kh::IrConst::integer(int64_type, 300),
+                                result, result));
+    KH_TEST_ASSERT(result == kh::IrConst::integer(int8_type, 44));
+
+    /* Left to the runtime */
+    KH_TEST_ASSERT(!kh::evaluate(kh::IrOp::MOD, int32_type, kh::IrConst::integer(int32_type, 7),
+                                 kh::IrConst::integer(int32_type, 0), result));
+    KH_TEST_ASSERT(!kh::evaluate(kh::IrOp::BIT_LSHIFT, int32_type, kh::IrConst::integer(int32_type, 1),
+                                 kh::IrConst::integer(int32_type, 32), result));
+    KH_TEST_ASSERT(!kh::evaluate(kh::IrOp::CONVERT, int32_type,
+                                 kh::IrConst::floating(double_type, 3e9), result, result));
+
+    KH_TEST_ASSERT(kh::evaluate(kh::IrOp::DIV, double_type, kh::IrConst::floating(double_type, 1.0),
+                                kh::IrConst::floating(double_type, 0.0), result));
+    KH_TEST_ASSERT(std::isinf(result.floating()) && result.floating() > 0);
+    KH_TEST_ASSERT(kh::evaluate(kh::IrOp::LESS_EQUAL, bool_type,
+                                kh::IrConst::floating(double_type, NAN),
+                                kh::IrConst::floating(double_type, 1.0), result));
+    KH_TEST_ASSERT(result == kh::IrConst::boolean(bool_type, false));
+    KH_TEST_ASSERT(kh::evaluate(kh::IrOp::CONVERT, int64_type,
+                                kh::IrConst::floating(double_type, -2.9), result, result));
+    KH_TEST_ASSERT(result == kh::IrConst::integer(int64_type, -2));
+
+    /* Computed in the precision of floats rather than rounded from doubles */
+    KH_TEST_ASSERT(kh::evaluate(kh::IrOp::ADD, float_type, kh::IrConst::floating(float_type, 0.1),
+                                kh::IrConst::floating(float_type, 0.2), result));
+    KH_TEST_ASSERT(result == kh::IrConst::floating(float_type, 0.1f + 0.2f));
+
+    KH_TEST_ASSERT(kh::evaluate(kh::IrOp::MUL, complex_type,
+                                kh::IrConst::complex(complex_type, 1.0, 2.0),
+                                kh::IrConst::complex(complex_type, 3.0, -1.0), result));
+    KH_TEST_ASSERT(result == kh::IrConst::complex(complex_type, 5.0, 5.0));
+
+    {
+        /* The branch is known, so `a` is only ever assigned the constant */
+        kh::IrModule module_ir;
+        KH_TEST_ASSERT(buildSource(U"def f(int x) -> int {\n"
+                                   U"    int a = 2 + 3 * 4;\n"
+                                   U"    if a < 10 { a = x; }\n"
+                                   U"    return a * 2 + x;\n"
+                                   U"}\n",
+                                   module_ir)
+                           .empty());
+        KH_TEST_ASSERT(kh::foldConstants(module_ir) > 0);
+
+        const kh::IrFunction& function_ir = *module_ir.functions[0];
+        size_t constants = 0;
+        for (const kh::IrInstruction& instruction : function_ir.code) {
+            KH_TEST_ASSERT(instruction.op != kh::IrOp::BRANCH && instruction.op != kh::IrOp::MUL);
+            if (instruction.op == kh::IrOp::CONST) {
+                constants++;
+                KH_TEST_ASSERT(module_ir.constants[instruction.a].integer() == 14 ||
+                               module_ir.constants[instruction.a].integer() == 28);
+            }
+        }
+        KH_TEST_ASSERT(constants == 2);
+    }
+
+    return;
+error:
+    errors_ptr->back() += "foldTest";
+}
+
+static void evaluateTest() {
+    kh::IrModule module_ir;
+    kh::EvaluatedCalls evaluated;
+    size_t steps = 0;
+    std::vector<kh::BuildException> exceptions =
+        buildSource(U"def square(int x) -> int { return x * x; }\n"
+                    U"def fib(int n) -> int {\n"
+                    U"    if n < 2 { return n; }\n"
+                    U"    return fib(n - 1) + fib(n - 2);\n"
+                    U"}\n"
+                    U"def forever() -> int { while true {} return 0; }\n"
+                    U"def inverse(int x) -> int { return 100 / x; }\n"
+                    U"def deep(int n) -> int { return deep(n + 1); }\n"
+                    U"int counter = 0;\n"
+                    U"def impure() -> int { counter += 1; return counter; }\n"
+                    U"int table = fib(20) + square(3);\n"
+                    U"def main() -> int {\n"
+                    U"    int t = square(7);\n"
+                    U"    return fib(t - 39) + forever() + impure() + inverse(0) + inverse(4) +\n"
+                    U"           deep(0);\n"
+                    U"}\n",
+                    module_ir);
+    KH_TEST_ASSERT(exceptions.empty());
+
+    /* `fib(t - 39)` only has a constant argument once `square(7)` is evaluated and folded */
+    KH_TEST_ASSERT(kh::foldConstants(module_ir) > 0);
+    KH_TEST_ASSERT(kh::evaluateCalls(module_ir, evaluated) == 4);
+    KH_TEST_ASSERT(kh::foldConstants(module_ir) > 0);
+    KH_TEST_ASSERT(kh::evaluateCalls(module_ir, evaluated) == 1);
+    kh::foldConstants(module_ir);
+
+    /* The calls which failed aren't run again */
+    steps = evaluated.steps;
+    KH_TEST_ASSERT(kh::evaluateCalls(module_ir, evaluated) == 0);
+    KH_TEST_ASSERT(evaluated.steps == steps);
+
+    {
+        /* Endless loops, runtime errors, endless recursion and globals are left to the runtime */
+        std::vector<int64_t> constants;
+        std::vector<std::string> calls;
+        for (const kh::IrFunction* function_ir : module_ir.functions) {
+            for (const kh::IrInstruction& instruction : function_ir->code) {
+                if (instruction.op == kh::IrOp::CONST) {
+                    constants.push_back(module_ir.constants[instruction.a].integer());
+                }
+                else if (instruction.op == kh::IrOp::CALL && function_ir->name == "main") {
+                    calls.push_back(module_ir.functions[instruction.a]->name);
+                }
+            }
+        }
+
+        KH_TEST_ASSERT(std::count(constants.begin(), constants.end(), 49) == 1);
+        KH_TEST_ASSERT(std::count(constants.begin(), constants.end(), 55) == 1);
+        KH_TEST_ASSERT(std::count(constants.begin(), constants.end(), 25) == 1);
+        KH_TEST_ASSERT(std::count(constants.begin(), constants.end(), 6774) == 1);
+        KH_TEST_ASSERT(calls == std::vector<std::string>({"forever", "impure", "inverse", "deep"}));
+    }
+
+    {
+        /* Nothing more is run once the budget of the module is used up */
+        kh::IrModule small_ir;
+        KH_TEST_ASSERT(buildSource(U"def square(int x) -> int { return x * x; }\n"
+                                   U"def main() -> int { return square(3) + square(4); }\n",
+                                   small_ir)
+                           .empty());
+        kh::EvaluatedCalls tight;
+        tight.steps = 5;
+        KH_TEST_ASSERT(kh::evaluateCalls(small_ir, tight) == 1);
+        KH_TEST_ASSERT(tight.steps == 0);
+        KH_TEST_ASSERT(kh::evaluateCalls(small_ir, tight) == 0);
+    }
+
+    return;
+error:
+    errors_ptr->back() += "evaluateTest";
+}
+
+static void eliminateTest() {
+    {
+        kh::IrModule module_ir;
+        KH_TEST_ASSERT(buildSource(U"int used = 4;\n"
+                                   U"int unused = helper(1);\n"
+                                   U"def helper(int x) -> int { return x + 1; }\n"
+                                   U"def orphan() -> str { return \"orphan\"; }\n"
+                                   U"def id!T(T x) -> T { return x; }\n"
+                                   U"def wrap!T(T x) -> T { return id(x); }\n"
+                                   U"def unwrapped!T(T x) -> T { return x; }\n"
+                                   U"def main() -> int {\n"
+                                   U"    int dead = 3;\n"
+                                   U"    str s = wrap(\"s\");\n"
+                                   U"    return used + id(1);\n"
+                                   U"}\n"
+                                   U"def never() -> float { return unwrapped(1.5); }\n",
+                                   module_ir)
+                           .empty());
+
+        /* `helper` is still called by the initializer, only its result is dropped */
+        kh::EliminatedCode eliminated = kh::eliminateDeadCode(module_ir);
+        KH_TEST_ASSERT(eliminated.functions == 3);
+        KH_TEST_ASSERT(eliminated.globals == 1);
+        KH_TEST_ASSERT(eliminated.constants == 3);
+
+        std::vector<std::string> names;
+        for (const kh::IrFunction* function_ir : module_ir.functions) {
+            names.push_back(function_ir->name);
+        }
+        KH_TEST_ASSERT(names == std::vector<std::string>({"helper", "main", "#init", "id!(int64)",
+                                                           "id!(str)", "wrap!(str)"}));
+        KH_TEST_ASSERT(module_ir.globals.size() == 1 && module_ir.globals[0].name == "used");
+        KH_TEST_ASSERT(module_ir.strings == std::vector<std::u32string>({U"s"}));
+        KH_TEST_ASSERT(module_ir.functions[1]->locals.empty());
+
+        for (const kh::IrFunction* function_ir : module_ir.functions) {
+            for (const kh::IrInstruction& instruction : function_ir->code) {
+                KH_TEST_ASSERT(instruction.op != kh::IrOp::NOP);
+            }
+        }
+    }
+
+    {
+        /* Modules without `main` keep their public functions and globals, with their
+         * initializers, for the ones importing them */
+        kh::IrModule module_ir;
+        KH_TEST_ASSERT(buildSource(U"def api() -> int { return helper(); }\n"
+                                   U"private def helper() -> int { return 1; }\n"
+                                   U"private def orphan() -> int { return 2; }\n"
+                                   U"int table = 42;\n"
+                                   U"private int hidden = 7;\n",
+                                   module_ir)
+                           .empty());
+        kh::EliminatedCode eliminated = kh::eliminateDeadCode(module_ir);
+        KH_TEST_ASSERT(eliminated.functions == 1 && eliminated.globals == 1);
+        KH_TEST_ASSERT(module_ir.functions.size() == 3);
+        KH_TEST_ASSERT(module_ir.functions[0]->name == "api");
+        KH_TEST_ASSERT(module_ir.functions[1]->name == "helper");
+        KH_TEST_ASSERT(module_ir.functions[0]->code[0].a == 1);
+        KH_TEST_ASSERT(module_ir.globals.size() == 1 && module_ir.globals[0].name == "table");
+
+        const kh::IrFunction& init = *module_ir.functions[2];
+        KH_TEST_ASSERT(init.name == "#init");
+        KH_TEST_ASSERT(std::count_if(init.code.begin(), init.code.end(),
+                                     [](const kh::IrInstruction& instruction) {
+                                         return instruction.op == kh::IrOp::GLOBAL_STORE;
+                                     }) == 1);
+    }
+
+    return;
+error:
+    errors_ptr->back() += "eliminateTest";
+}
+
+static void inlineTest() {
+    const char32_t* source = U"def square(int x) -> int { return x * x; }\n"
+                             U"def clamp(int x, int lo, int hi) -> int {\n"
+                             U"    if x < lo { return lo; }\n"
+                             U"    if x > hi { return hi; }\n"
+                             U"    return x;\n"
+                             U"}\n"
+                             U"def even(int n) -> bool { return true if n == 0 else odd(n - 1); }\n"
+                             U"def odd(int n) -> bool { return false if n == 0 else even(n - 1); }\n"
+                             U"def fact(int n) -> int { return 1 if n < 2 else n * fact(n - 1); }\n"
+                             U"def main() -> int {\n"
+                             U"    int total = clamp(square(3), 0, 5);\n"
+                             U"    return total + fact(3) + (1 if even(4) else 0);\n"
+                             U"}\n";
+
+    {
+        kh::IrModule module_ir;
+        KH_TEST_ASSERT(buildSource(source, module_ir).empty());
+
+        /* Only `square` and `clamp` are inlined, the others are recursive */
+        KH_TEST_ASSERT(kh::inlineCalls(module_ir) == 2);
+        const kh::IrFunction& main_ir = *module_ir.functions[5];
+        KH_TEST_ASSERT(main_ir.name == "main");
+        KH_TEST_ASSERT(main_ir.locals.size() == 8);
+        KH_TEST_ASSERT(main_ir.locals[2].name == "square.x" && main_ir.locals[3].name == "#square");
+
+        std::vector<uint32_t> callees;
+        for (const kh::IrFunction* function_ir : module_ir.functions) {
+            for (const kh::IrInstruction& instruction : function_ir->code) {
+                if (instruction.op == kh::IrOp::CALL) {
+                    callees.push_back(instruction.a);
+                }
+            }
+        }
+        KH_TEST_ASSERT(callees == std::vector<uint32_t>({3, 2, 4, 4, 2}));
+
+        /* With the arguments known, what was inlined folds into the constant it's stored */
+        kh::foldConstants(module_ir);
+        bool stored = false;
+        for (const kh::IrInstruction& instruction : main_ir.code) {
+            if (instruction.op == kh::IrOp::STORE && instruction.a == 0) {
+                const kh::IrInstruction& value = main_ir.code[instruction.b];
+                KH_TEST_ASSERT(value.op == kh::IrOp::CONST);
+                KH_TEST_ASSERT(module_ir.constants[value.a].integer() == 5);
+                stored = true;
+            }
+        }
+        KH_TEST_ASSERT(stored);
+    }
+
+    {
+        /* No growth allowed, nothing is inlined */
+        kh::IrModule module_ir;
+        KH_TEST_ASSERT(buildSource(source, module_ir).empty());
+        KH_TEST_ASSERT(kh::inlineCalls(module_ir, 0) == 0);
+    }
+
+    {
+        /* A call chain far longer than the call stack could recurse through */
+        kh::IrModule module_ir;
+        const kh::IrType* void_type = module_ir.type(kh::IrType::VOID);
+        uint32_t length = 200000;
+        for (uint32_t i = 0; i < length; i++) {
+            kh::IrFunction* link = module_ir.function("f" + std::to_string(i), void_type);
+            if (i + 1 < length) {
+                link->call(void_type, i + 1, {});
+            }
+            link->emit(kh::IrOp::RETURN, void_type);
+        }
+        KH_TEST_ASSERT(kh::inlineCalls(module_ir, 100) > 0);
+    }
+
+    return;
+error:
+    errors_ptr->back() += "inlineTest";
+}
+
+void kh_test::builderTest(std::vector<std::string>& errors) {
+    errors_ptr = &errors;
+    irArenaTest();
+    irModuleTest();
+    irTypeInternTest();
+    symbolsTest();
+    semanticizerTest();
+    semanticizerParallelTest();
+    semanticizerChainTest();
+    genericTest();
+    mergeTest();
+    foldTest();
+    evaluateTest();
+    eliminateTest();
+    inlineTest();
+}
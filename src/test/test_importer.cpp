@@ -0,0 +1,306 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#if _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <kithare/file.hpp>
+#include <kithare/importer.hpp>
+#include <kithare/serial.hpp>
+#include <kithare/string.hpp>
+#include <kithare/test.hpp>
+#include <kithare/utf8.hpp>
+
+
+static std::vector<std::string>* errors_ptr;
+
+static std::string makeDirectory(const std::string& path = "") {
+#if _WIN32
+    std::string directory =
+        path.empty() ? std::string(std::getenv("TEMP")) + "\\kh_importer_test" : path;
+    _mkdir(directory.c_str());
+#else
+    std::string directory = path;
+    if (path.empty()) {
+        char name[] = "/tmp/kh_importer_test_XXXXXX";
+        directory = mkdtemp(name);
+    }
+    else {
+        mkdir(directory.c_str(), 0700);
+    }
+#endif
+    return directory;
+}
+
+static void writeFile(const std::string& path, const std::string& content) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file) {
+        fwrite(content.data(), 1, content.size(), file);
+        fclose(file);
+    }
+}
+
+static std::string fileName(const kh::ImportedModule& module) {
+    std::string path = kh::encodeUtf8(module.path);
+    return path.substr(path.find_last_of("/\\") + 1);
+}
+
+static void importerGraphTest() {
+    std::string directory = makeDirectory();
+    std::string lib = directory + "/lib";
+    makeDirectory(lib);
+
+    writeFile(directory + "/main.kh", "import lib.a;\n"
+                                      "import lib.b;\n"
+                                      "import missing.thing;\n"
+                                      "import lib.self;\n"
+                                      "def main() { a.a(); }\n");
+    writeFile(lib + "/a.kh", "import .common;\n"
+                             "def a() { common.common(); }\n");
+    writeFile(lib + "/b.kh", "import lib.common;\n"
+                             "include .c;\n");
+    writeFile(lib + "/c.kh", "import lib.d;\n");
+    writeFile(lib + "/d.kh", "import lib.c;\n"
+                             "import .nowhere;\n");
+    writeFile(lib + "/self.kh", "import lib.self;\n");
+    writeFile(lib + "/common.kh", "def common() { return 1; }\n");
+
+    {
+        kh::ModuleGraph graph = kh::loadModules(kh::decodeUtf8(directory + "/main.kh"), {}, 8);
+
+        /* The common module is imported twice but only loaded once */
+        KH_TEST_ASSERT(graph.modules.size() == 7);
+        KH_TEST_ASSERT(fileName(graph.modules[0]) == "a.kh");
+        KH_TEST_ASSERT(fileName(graph.modules[1]) == "b.kh");
+        KH_TEST_ASSERT(fileName(graph.modules[2]) == "c.kh");
+        KH_TEST_ASSERT(fileName(graph.modules[3]) == "common.kh");
+        KH_TEST_ASSERT(fileName(graph.modules[4]) == "d.kh");
+        KH_TEST_ASSERT(fileName(graph.modules[5]) == "self.kh");
+        KH_TEST_ASSERT(fileName(graph.modules[6]) == "main.kh");
+        KH_TEST_ASSERT(graph.root == 6);
+
+        for (const kh::ImportedModule& module : graph.modules) {
+            KH_TEST_ASSERT(module.ast);
+            KH_TEST_ASSERT(module.lex_exceptions.empty());
+            KH_TEST_ASSERT(module.parse_exceptions.empty());
+            KH_TEST_ASSERT(module.imports.size() == module.ast->imports.size());
+        }
+
+        KH_TEST_ASSERT(graph.modules[0].imports[0] == 3);
+        KH_TEST_ASSERT(graph.modules[1].imports[0] == 3);
+        KH_TEST_ASSERT(graph.modules[1].imports[1] == 2);
+        KH_TEST_ASSERT(graph.modules[6].imports[0] == 0);
+        KH_TEST_ASSERT(graph.modules[6].imports[1] == 1);
+        KH_TEST_ASSERT(graph.modules[6].imports[2] == KH_UNRESOLVED_IMPORT);
+        KH_TEST_ASSERT(graph.modules[6].imports[3] == 5);
+
+        /* Only the function bodies of the imported modules are left to be parsed */
+        KH_TEST_ASSERT(!graph.modules[6].ast->functions[0].lazy_body);
+        KH_TEST_ASSERT(graph.modules[3].ast->functions[0].lazy_body);
+        KH_TEST_ASSERT(graph.modules[3].ast->functions[0].getBody().size() == 1);
+
+        KH_TEST_ASSERT(graph.cycles.size() == 2);
+        KH_TEST_ASSERT((graph.cycles[0] == std::vector<size_t>{2, 4}));
+        KH_TEST_ASSERT((graph.cycles[1] == std::vector<size_t>{5}));
+
+        KH_TEST_ASSERT(graph.exceptions.size() == 2);
+        KH_TEST_ASSERT(graph.exceptions[0].what == "unable to find the imported module `.nowhere`");
+        KH_TEST_ASSERT(graph.exceptions[0].line == 2);
+        KH_TEST_ASSERT(graph.exceptions[1].what ==
+                       "unable to find the imported module `missing.thing`");
+        KH_TEST_ASSERT(graph.exceptions[1].line == 3);
+        KH_TEST_ASSERT(graph.exceptions[1].column == 8);
+
+        /* The graph doesn't depend on the order the threads load the modules in */
+        kh::ModuleGraph serial = kh::loadModules(kh::decodeUtf8(lib + "/../main.kh"), {}, 1);
+        KH_TEST_ASSERT(serial.modules.size() == graph.modules.size());
+        for (size_t i = 0; i < graph.modules.size(); i++) {
+            KH_TEST_ASSERT(serial.modules[i].path == graph.modules[i].path);
+            KH_TEST_ASSERT(serial.modules[i].imports == graph.modules[i].imports);
+        }
+
+        /* Non-relative imports are looked up in the search paths too */
+        kh::ModuleGraph searched =
+            kh::loadModules(kh::decodeUtf8(lib + "/a.kh"), {kh::decodeUtf8(directory)});
+        KH_TEST_ASSERT(searched.modules.size() == 2);
+        KH_TEST_ASSERT(searched.exceptions.empty());
+
+        kh::ModuleGraph missing = kh::loadModules(kh::decodeUtf8(directory + "/nothing.kh"));
+        KH_TEST_ASSERT(missing.modules.empty());
+        KH_TEST_ASSERT(missing.exceptions.size() == 1);
+    }
+
+    for (const char* name : {"a", "b", "c", "d", "self", "common"}) {
+        std::remove((lib + "/" + name + ".kh").c_str());
+    }
+    std::remove((directory + "/main.kh").c_str());
+#if _WIN32
+    _rmdir(lib.c_str());
+    _rmdir(directory.c_str());
+#else
+    rmdir(lib.c_str());
+    rmdir(directory.c_str());
+#endif
+    return;
+error:
+    errors_ptr->back() += "importerGraphTest";
+}
+
+static void importerCycleTest() {
+    /* A single cycle through a long chain of imports, which mustn't recurse per module */
+    std::vector<kh::ImportedModule> modules(100000);
+    for (size_t i = 0; i < modules.size(); i++) {
+        modules[i].imports = {(i + 1) % modules.size(), KH_UNRESOLVED_IMPORT};
+    }
+
+    {
+        std::vector<std::vector<size_t>> cycles = kh::findImportCycles(modules);
+        KH_TEST_ASSERT(cycles.size() == 1);
+        KH_TEST_ASSERT(cycles[0].size() == modules.size());
+        KH_TEST_ASSERT(cycles[0].back() == modules.size() - 1);
+
+        /* Breaking the chain leaves no cycles */
+        modules.back().imports = {};
+        KH_TEST_ASSERT(kh::findImportCycles(modules).empty());
+
+        /* Two cycles joined by an import are still separate */
+        modules[49999].imports = {0, 50000};
+        modules.back().imports = {50000};
+        cycles = kh::findImportCycles(modules);
+        KH_TEST_ASSERT(cycles.size() == 2);
+        KH_TEST_ASSERT(cycles[0].size() == 50000 && cycles[0][0] == 0);
+        KH_TEST_ASSERT(cycles[1].size() == 50000 && cycles[1][0] == 50000);
+    }
+
+    return;
+error:
+    errors_ptr->back() += "importerCycleTest";
+}
+
+static void importerInterfaceTest() {
+    std::string directory = makeDirectory();
+    std::string lib_source = "import .other;\n"
+                             "def visible(int x) -> int { return x + 1; }\n"
+                             "private def hidden() {}\n"
+                             "class Thing { int count = 3; private def helper() {} def get() -> int "
+                             "{ return count; } }\n"
+                             "private struct Hidden { int x; }\n"
+                             "enum Color { RED, GREEN }\n"
+                             "int answer = 42;\n";
+    writeFile(directory + "/main.kh", "import lib;\n");
+    writeFile(directory + "/lib.kh", lib_source);
+    writeFile(directory + "/other.kh", "");
+
+    {
+        std::vector<kh::LexException> lex_exceptions;
+        std::u32string source = kh::decodeUtf8(lib_source);
+        kh::LexerContext lexer_context{source, lex_exceptions};
+        std::vector<kh::Token> tokens = kh::lex(lexer_context);
+        std::vector<kh::ParseException> parse_exceptions;
+        kh::ParserContext parser_context{tokens, parse_exceptions};
+        kh::AstModule ast = kh::parseWhole(parser_context);
+        KH_TEST_ASSERT(lex_exceptions.empty() && parse_exceptions.empty());
+
+        kh::AstModule interface_ast = kh::moduleInterface(ast);
+        KH_TEST_ASSERT(interface_ast.imports.size() == 1);
+        KH_TEST_ASSERT(interface_ast.functions.size() == 1);
+        KH_TEST_ASSERT(interface_ast.functions[0].body.empty());
+        KH_TEST_ASSERT(interface_ast.functions[0].arguments.size() == 1);
+        KH_TEST_ASSERT(interface_ast.user_types.size() == 1);
+        KH_TEST_ASSERT(interface_ast.user_types[0].members.size() == 1);
+        KH_TEST_ASSERT(!interface_ast.user_types[0].members[0].expression);
+        KH_TEST_ASSERT(interface_ast.user_types[0].methods.size() == 1);
+        KH_TEST_ASSERT(interface_ast.enums.size() == 1);
+        KH_TEST_ASSERT(interface_ast.variables.size() == 1);
+        KH_TEST_ASSERT(!interface_ast.variables[0].expression);
+
+        /* Round trips like an AST, but only with the matching magic */
+        std::string serialized = kh::serializeInterface(interface_ast, 0x0123456789abcdef);
+        KH_TEST_ASSERT(kh::interfaceHash(serialized.data(), serialized.size()) == 0x0123456789abcdef);
+        kh::AstModule interface_copy = kh::deserializeInterface(serialized.data(), serialized.size());
+        KH_TEST_ASSERT(kh::serialize(interface_copy) == kh::serialize(interface_ast));
+
+        bool thrown = false;
+        std::string ast_serialized = kh::serialize(interface_ast);
+        try {
+            kh::interfaceHash(ast_serialized.data(), ast_serialized.size());
+        }
+        catch (const kh::SerialException&) {
+            thrown = true;
+        }
+        KH_TEST_ASSERT(thrown);
+
+        /* The first load writes the interface of the imported module, the root doesn't get one */
+        std::u32string main_path = kh::decodeUtf8(directory + "/main.kh");
+        std::u32string lib_path = kh::canonicalPath(kh::decodeUtf8(directory + "/lib.kh"));
+        kh::ModuleGraph graph = kh::loadModules(main_path, {}, 4, true);
+        KH_TEST_ASSERT(graph.modules.size() == 3 && graph.exceptions.empty());
+        KH_TEST_ASSERT(graph.modules[0].path == lib_path);
+        KH_TEST_ASSERT(!graph.modules[0].from_interface);
+        KH_TEST_ASSERT(!kh::updateInterface(lib_path, *graph.modules[0].ast, kh::hash(lib_source)));
+
+        /* Then the interface is loaded instead of the source, imports included */
+        graph = kh::loadModules(main_path, {}, 4, true);
+        KH_TEST_ASSERT(graph.modules.size() == 3 && graph.exceptions.empty());
+        KH_TEST_ASSERT(graph.modules[0].from_interface);
+        KH_TEST_ASSERT(!graph.modules[0].tokens);
+        KH_TEST_ASSERT(graph.modules[0].ast->functions.size() == 1);
+        KH_TEST_ASSERT(graph.modules[0].ast->functions[0].getBody().empty());
+        KH_TEST_ASSERT(graph.modules[0].imports[0] == 2);
+        KH_TEST_ASSERT(!graph.modules[1].from_interface);
+
+        /* Changing the source makes the interface stale, so it's parsed and written again */
+        writeFile(directory + "/lib.kh", lib_source + "def another() {}\n");
+        graph = kh::loadModules(main_path, {}, 4, true);
+        KH_TEST_ASSERT(!graph.modules[0].from_interface);
+        KH_TEST_ASSERT(graph.modules[0].ast->functions.size() == 3);
+
+        graph = kh::loadModules(main_path, {}, 4, true);
+        KH_TEST_ASSERT(graph.modules[0].from_interface);
+        KH_TEST_ASSERT(graph.modules[0].ast->functions.size() == 2);
+
+        /* A corrupted interface is ignored */
+        writeFile(directory + "/lib.khi", "KINT garbage");
+        KH_TEST_ASSERT(!kh::loadInterface(lib_path, kh::hash(lib_source + "def another() {}\n")));
+        graph = kh::loadModules(main_path, {}, 4, true);
+        KH_TEST_ASSERT(!graph.modules[0].from_interface);
+        KH_TEST_ASSERT(graph.modules[0].ast->functions.size() == 3);
+
+        /* Errors in the skipped bodies are reported, and no interface is written to hide them */
+        std::remove((directory + "/lib.khi").c_str());
+        std::string broken_source = lib_source + "def broken() { return 1 +; }\n";
+        writeFile(directory + "/lib.kh", broken_source);
+        graph = kh::loadModules(main_path, {}, 4, true);
+        KH_TEST_ASSERT(graph.modules[0].parse_exceptions.size() == 1);
+        KH_TEST_ASSERT(!kh::loadInterface(lib_path, kh::hash(broken_source)));
+    }
+
+    for (const char* name : {"main.kh", "lib.kh", "other.kh", "lib.khi", "other.khi"}) {
+        std::remove((directory + "/" + name).c_str());
+    }
+#if _WIN32
+    _rmdir(directory.c_str());
+#else
+    rmdir(directory.c_str());
+#endif
+    return;
+error:
+    errors_ptr->back() += "importerInterfaceTest";
+}
+
+void kh_test::importerTest(std::vector<std::string>& errors) {
+    errors_ptr = &errors;
+    importerGraphTest();
+    importerCycleTest();
+    importerInterfaceTest();
+}
@@ -111,6 +111,47 @@ error:
     errors_ptr->back() += "lexerNumeralTest";
 }
 
+static void lexerNumeralLimitTest() {
+    std::vector<kh::LexException> lex_exceptions;
+    kh::LexerContext lexer_context{U"9223372036854775807 18446744073709551615U " /* Largest integers */
+                                   U"0xFFFFFFFFFFFFFFFF 0b1U 0o1777777777777777777777 "
+                                   U"0.1234567890123456789 2.2250738585072014 " /* Eisel-Lemire */
+                                   U"9007199254740993.0 " /* Halfway, rounds to even */
+                                   U"1.00000000000000011102230246251565404236316680908203125 "
+                                   U"9223372036854775808 18446744073709551616U " /* Too large */
+                                   U"0x10000000000000000 ",
+                                   lex_exceptions};
+    std::vector<kh::Token> tokens = kh::lex(lexer_context);
+
+    KH_TEST_ASSERT(lex_exceptions.size() == 3);
+    KH_TEST_ASSERT(lex_exceptions[0].what == "integer too large to be interpret");
+    KH_TEST_ASSERT(lex_exceptions[1].what == "unsigned integer too large to be interpret");
+    KH_TEST_ASSERT(lex_exceptions[2].what == "hex integer too large to be interpret");
+
+    KH_TEST_ASSERT(tokens.size() == 9);
+    KH_TEST_ASSERT(tokens[0].type == kh::TokenType::INTEGER);
+    KH_TEST_ASSERT(tokens[0].value.integer == INT64_MAX);
+    KH_TEST_ASSERT(tokens[1].type == kh::TokenType::UINTEGER);
+    KH_TEST_ASSERT(tokens[1].value.uinteger == UINT64_MAX);
+    KH_TEST_ASSERT(tokens[2].type == kh::TokenType::INTEGER);
+    KH_TEST_ASSERT(tokens[2].value.integer == -1);
+    KH_TEST_ASSERT(tokens[3].type == kh::TokenType::UINTEGER);
+    KH_TEST_ASSERT(tokens[3].value.uinteger == 1);
+    KH_TEST_ASSERT(tokens[4].type == kh::TokenType::INTEGER);
+    KH_TEST_ASSERT(tokens[4].value.integer == -1);
+    KH_TEST_ASSERT(tokens[5].type == kh::TokenType::FLOATING);
+    KH_TEST_ASSERT(tokens[5].value.floating == 0.1234567890123456789);
+    KH_TEST_ASSERT(tokens[6].type == kh::TokenType::FLOATING);
+    KH_TEST_ASSERT(tokens[6].value.floating == 2.2250738585072014);
+    KH_TEST_ASSERT(tokens[7].type == kh::TokenType::FLOATING);
+    KH_TEST_ASSERT(tokens[7].value.floating == 9007199254740992.0);
+    KH_TEST_ASSERT(tokens[8].type == kh::TokenType::FLOATING);
+    KH_TEST_ASSERT(tokens[8].value.floating == 1.0);
+    return;
+error:
+    errors_ptr->back() += "lexerNumeralLimitTest";
+}
+
 static void lexerStringTest() {
     std::vector<kh::LexException> lex_exceptions;
     kh::LexerContext lexer_context{
@@ -162,5 +203,6 @@ void kh_test::lexerTest(std::vector<std::string>& errors) {
     errors_ptr = &errors;
     lexerTypeTest();
     lexerNumeralTest();
+    lexerNumeralLimitTest();
     lexerStringTest();
 }
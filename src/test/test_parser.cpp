@@ -6,7 +6,10 @@
 
 #include <kithare/lexer.hpp>
 #include <kithare/parser.hpp>
+#include <kithare/serial.hpp>
 #include <kithare/test.hpp>
+#include <kithare/thread_pool.hpp>
+#include <kithare/utf8.hpp>
 
 
 static std::vector<std::string>* errors_ptr;
@@ -38,7 +41,480 @@ error:
     errors_ptr->back() += "parserImportTest";
 }
 
+static void parserSerialTest() {
+    std::vector<kh::LexException> lex_exceptions;
+    kh::LexerContext lexer_context{U"import std;                                    \n"
+                                   U"import .rel.mod as m;                          \n"
+                                   U"include other.thing;                           \n"
+                                   U"enum Color { red, green = 5, blue }            \n"
+                                   U"private int counter = 3;                       \n"
+                                   U"class Child!T(Parent) {                        \n"
+                                   U"    static T[4] items;                         \n"
+                                   U"    def get(ref int i) -> ref T { return i; }  \n"
+                                   U"}                                              \n"
+                                   U"def f!T(ref T[2] values, int n) -> T[3] {      \n"
+                                   U"    x = (1, -2.5, 3i, 'c', b\"\\xff\", \"s\\u1234\"); \n"
+                                   U"    y = {1: [a, b]} if n else arr[1, 2];       \n"
+                                   U"    v = 1 < 2 <= 3 != -4;                      \n"
+                                   U"    t = f(1)(2).g.h + x.y!(int, float).z;      \n"
+                                   U"    s = -x + ~y * z++;                         \n"
+                                   U"    do { continue; break; } while x;           \n"
+                                   U"    for i = 0, i < n, i++ { return; }          \n"
+                                   U"    for a : c { }                              \n"
+                                   U"    if a { b; } elif c { d; } else { e; }      \n"
+                                   U"    func!(int(int)) op = def(int a) -> int { return a; };\n"
+                                   U"}                                              \n",
+                                   lex_exceptions};
+    std::vector<kh::Token> tokens = kh::lex(lexer_context);
+    std::vector<kh::ParseException> parse_exceptions;
+    kh::ParserContext parser_context{tokens, parse_exceptions};
+    kh::AstModule ast = kh::parseWhole(parser_context);
+
+    KH_TEST_ASSERT(lex_exceptions.empty());
+    KH_TEST_ASSERT(parse_exceptions.empty());
+
+    {
+        std::string serialized = kh::serialize(tokens);
+        std::vector<kh::Token> tokens_copy =
+            kh::deserializeTokens(serialized.data(), serialized.size());
+
+        KH_TEST_ASSERT(tokens_copy.size() == tokens.size());
+        for (size_t i = 0; i < tokens.size(); i++) {
+            KH_TEST_ASSERT(kh::str(tokens_copy[i], true) == kh::str(tokens[i], true));
+            KH_TEST_ASSERT(tokens_copy[i].index == tokens[i].index);
+            KH_TEST_ASSERT(tokens_copy[i].length == tokens[i].length);
+        }
+    }
+
+    {
+        std::string serialized = kh::serialize(ast);
+        kh::AstModule ast_copy = kh::deserializeAst(serialized.data(), serialized.size());
+        KH_TEST_ASSERT(kh::str(ast_copy) == kh::str(ast));
+        KH_TEST_ASSERT(kh::serialize(ast_copy) == serialized);
+
+        /* Every truncation is rejected instead of being read out of bounds */
+        for (size_t size = 0; size < serialized.size(); size++) {
+            try {
+                kh::deserializeAst(serialized.data(), size);
+                KH_TEST_ASSERT(false);
+            }
+            catch (kh::SerialException& exc) {
+            }
+        }
+
+        /* The tokens magic isn't accepted as an AST */
+        std::string token_serialized = kh::serialize(tokens);
+        try {
+            kh::deserializeAst(token_serialized.data(), token_serialized.size());
+            KH_TEST_ASSERT(false);
+        }
+        catch (kh::SerialException& exc) {
+        }
+    }
+
+    return;
+error:
+    errors_ptr->back() += "parserSerialTest";
+}
+
+static void appendVarint(std::string& buffer, uint64_t n) {
+    while (n >= 0x80) {
+        buffer += (char)((n & 0x7F) | 0x80);
+        n >>= 7;
+    }
+    buffer += (char)n;
+}
+
+static void appendU32(std::string& buffer, uint32_t n) {
+    for (size_t i = 0; i < 4; i++) {
+        buffer += (char)((n >> (i * 8)) & 0xFF);
+    }
+}
+
+/* An AST buffer declaring `x` of the type of the identifiers record `type`, with the string table
+ * only having "x" */
+static std::string forgeAst(std::string body, uint64_t type) {
+    size_t declaration = body.size();
+    body += (char)kh::AstTag::DECLARATION;
+    body += std::string("\0\0", 2);
+    appendVarint(body, type + 1);
+    body += std::string("\0\0\0\0", 4);
+
+    size_t root = body.size();
+    body += (char)kh::AstTag::MODULE;
+    body += std::string("\0\0\0\0\0", 5);
+    body += (char)1;
+    appendVarint(body, declaration + 1);
+
+    std::string buffer = "KAST";
+    appendU32(buffer, KH_SERIAL_VERSION);
+    appendU32(buffer, 1);
+    appendU32(buffer, KH_SERIAL_HEADER_SIZE + 9);
+    appendU32(buffer, (uint32_t)body.size());
+    appendU32(buffer, (uint32_t)root);
+    appendU32(buffer, 0);
+    appendU32(buffer, 1);
+    return buffer + "x" + body;
+}
+
+static void parserSerialForgedTest() {
+    {
+        /* Identifiers having the same record as generic arguments twice over at every level, which
+         * would expand into a type exponentially larger than the buffer */
+        std::string body;
+        uint64_t type = 0;
+        for (size_t i = 0; i < 64; i++) {
+            size_t record = body.size();
+            body += (char)kh::AstTag::IDENTIFIERS;
+            body += std::string("\0\0", 2);
+            if (i == 0) {
+                body += '\0';
+            }
+            else {
+                body += (char)2;
+                appendVarint(body, type + 1);
+                appendVarint(body, type + 1);
+                body += std::string("\0\0\0\0", 4);
+            }
+            type = record;
+        }
+
+        std::string buffer = forgeAst(body, type);
+        try {
+            kh::deserializeAst(buffer.data(), buffer.size());
+            KH_TEST_ASSERT(false);
+        }
+        catch (kh::SerialException& exc) {
+            KH_TEST_ASSERT(exc.what == "child record is referenced more than once");
+        }
+    }
+
+    {
+        /* A chain of records too deep to be read back recursively */
+        std::string body;
+        uint64_t type = 0;
+        for (size_t i = 0; i < KH_SERIAL_DEPTH_LIMIT * 2; i++) {
+            size_t record = body.size();
+            body += (char)kh::AstTag::IDENTIFIERS;
+            body += std::string("\0\0", 2);
+            if (i == 0) {
+                body += '\0';
+            }
+            else {
+                body += (char)1;
+                appendVarint(body, type + 1);
+                body += std::string("\0\0", 2);
+            }
+            type = record;
+        }
+
+        std::string buffer = forgeAst(body, type);
+        try {
+            kh::deserializeAst(buffer.data(), buffer.size());
+            KH_TEST_ASSERT(false);
+        }
+        catch (kh::SerialException& exc) {
+            KH_TEST_ASSERT(exc.what == "records nest too deeply");
+        }
+    }
+
+    return;
+error:
+    errors_ptr->back() += "parserSerialForgedTest";
+}
+
+static void parserRecoveryTest() {
+    {
+        /* Every broken statement and declaration is reported once, without the errors which
+         * cascade from it */
+        std::vector<kh::LexException> lex_exceptions;
+        kh::LexerContext lexer_context{U"def f() {              \n"
+                                       U"    x = (1 + ;         \n"
+                                       U"    y = 2;             \n"
+                                       U"    if x { z = ]; }    \n"
+                                       U"}                      \n"
+                                       U"class A {              \n"
+                                       U"    int a = ;          \n"
+                                       U"    def g() {}         \n"
+                                       U"}                      \n"
+                                       U"def h() { return 1; }  \n",
+                                       lex_exceptions};
+        std::vector<kh::Token> tokens = kh::lex(lexer_context);
+        std::vector<kh::ParseException> parse_exceptions;
+        kh::ParserContext parser_context{tokens, parse_exceptions};
+        kh::AstModule ast = kh::parseWhole(parser_context);
+
+        KH_TEST_ASSERT(lex_exceptions.empty());
+        KH_TEST_ASSERT(parse_exceptions.size() == 3);
+        KH_TEST_ASSERT(parse_exceptions[0].line == 2);
+        KH_TEST_ASSERT(parse_exceptions[1].line == 4);
+        KH_TEST_ASSERT(parse_exceptions[2].line == 7);
+        KH_TEST_ASSERT(ast.functions.size() == 2);
+        KH_TEST_ASSERT(ast.user_types.size() == 1);
+        KH_TEST_ASSERT(ast.user_types[0].methods.size() == 1);
+    }
+
+    {
+        /* Garbage doesn't get reported past the error limit */
+        std::u32string source;
+        for (size_t i = 0; i < 10000; i++) {
+            source += U"] ) , ; ";
+        }
+
+        std::vector<kh::LexException> lex_exceptions;
+        kh::LexerContext lexer_context{source, lex_exceptions};
+        std::vector<kh::Token> tokens = kh::lex(lexer_context);
+        std::vector<kh::ParseException> parse_exceptions;
+        kh::ParserContext parser_context{tokens, parse_exceptions};
+        kh::parseWhole(parser_context);
+
+        KH_TEST_ASSERT(parse_exceptions.size() == KH_PARSE_ERROR_LIMIT + 1);
+    }
+
+    {
+        /* Every truncation of a valid source is parsed without cascading errors */
+        std::vector<kh::LexException> lex_exceptions;
+        kh::LexerContext lexer_context{U"class A { int a; def g(int b) -> int { return a + b; } } \n"
+                                       U"def f(int n) {                                        \n"
+                                       U"    for i = 0, i < n, i++ { if i { break; } }          \n"
+                                       U"    return [n][0] if n else {1: 2}[1];                 \n"
+                                       U"}                                                     \n",
+                                       lex_exceptions};
+        std::vector<kh::Token> tokens = kh::lex(lexer_context);
+        KH_TEST_ASSERT(lex_exceptions.empty());
+
+        for (size_t size = 1; size < tokens.size(); size++) {
+            std::vector<kh::Token> truncated(tokens.begin(), tokens.begin() + size);
+            std::vector<kh::ParseException> parse_exceptions;
+            kh::ParserContext parser_context{truncated, parse_exceptions};
+            kh::parseWhole(parser_context);
+
+            KH_TEST_ASSERT(parse_exceptions.size() <= 1);
+        }
+    }
+
+    return;
+error:
+    errors_ptr->back() += "parserRecoveryTest";
+}
+
+static std::vector<kh::ParseException> parseNested(const std::u32string& source,
+                                                   size_t nesting_limit = KH_PARSE_NESTING_LIMIT) {
+    std::vector<kh::LexException> lex_exceptions;
+    kh::LexerContext lexer_context{source, lex_exceptions};
+    std::vector<kh::Token> tokens = kh::lex(lexer_context);
+
+    std::vector<kh::ParseException> parse_exceptions;
+    kh::ParserContext parser_context{tokens, parse_exceptions};
+    parser_context.nesting_limit = nesting_limit;
+
+    /* The AST is torn down on return, which mustn't recurse either */
+    kh::parseWhole(parser_context);
+    return parse_exceptions;
+}
+
+static void parserNestingTest() {
+    const size_t depth = 1000000;
+
+    std::u32string parentheses = U"def f() { x = ";
+    std::u32string bodies = U"def f() { ";
+    std::u32string generics = U"def f() { ";
+    std::u32string unary = U"def f() { x = ";
+    std::u32string nots = U"def f() { x = ";
+    std::u32string binary = U"def f() { x = 1";
+    std::u32string elifs = U"def f() { if x { y = 1; }";
+
+    for (size_t i = 0; i < depth; i++) {
+        parentheses += U'(';
+        bodies += U"if x { ";
+        generics += U"a!(";
+        unary += U'-';
+        nots += U"not ";
+        binary += U" + 1";
+    }
+
+    for (size_t i = 0; i < depth / 10; i++) {
+        elifs += U" elif x { y = 1; }";
+    }
+
+    parentheses += U'1';
+    bodies += U"y = 1;";
+    generics += U"int";
+    for (size_t i = 0; i < depth; i++) {
+        parentheses += U')';
+        bodies += U" }";
+        generics += U')';
+    }
+
+    parentheses += U"; }";
+    bodies += U" }";
+    generics += U" x; }";
+    unary += U"1; }";
+    nots += U"1; }";
+    binary += U"; }";
+    elifs += U" }";
+
+    /* Anything nested past the limit gets reported once and skipped */
+    KH_TEST_ASSERT(parseNested(parentheses).size() == 1);
+    KH_TEST_ASSERT(parseNested(bodies).size() == 1);
+    KH_TEST_ASSERT(parseNested(generics).size() == 1);
+
+    /* Chains which don't nest in the source don't count towards the limit */
+    KH_TEST_ASSERT(parseNested(unary).empty());
+    KH_TEST_ASSERT(parseNested(nots).empty());
+    KH_TEST_ASSERT(parseNested(binary).empty());
+    KH_TEST_ASSERT(parseNested(elifs).empty());
+
+    /* The limit is configurable */
+    KH_TEST_ASSERT(parseNested(U"def f() { x = ((((1)))); }", 6).empty());
+    KH_TEST_ASSERT(parseNested(U"def f() { x = ((((1)))); }", 5).size() == 1);
+    KH_TEST_ASSERT(parseNested(U"def f() { if x { if x { } } }", 3).empty());
+    KH_TEST_ASSERT(parseNested(U"def f() { if x { if x { } } }", 2).size() == 1);
+
+    /* Up to the maximum the stack allows, limits past it are reported instead of parsing */
+    KH_TEST_ASSERT(kh::maxNestingLimit() >= KH_PARSE_NESTING_LIMIT);
+    {
+        std::vector<kh::ParseException> exceptions =
+            parseNested(parentheses, kh::maxNestingLimit() + 1);
+        KH_TEST_ASSERT(exceptions.size() == 1);
+        KH_TEST_ASSERT(exceptions[0].what.find("exceeds the maximum") != std::string::npos);
+    }
+
+    return;
+error:
+    errors_ptr->back() += "parserNestingTest";
+}
+
+static void parserSkippedBodyTest() {
+    std::vector<kh::LexException> lex_exceptions;
+    kh::LexerContext lexer_context{U"import std;                                  \n"
+                                   U"func!(int(int)) twice = def (int x) -> int { \n"
+                                   U"    return x * 2;                            \n"
+                                   U"};                                           \n"
+                                   U"class Point {                                \n"
+                                   U"    float x; float y;                        \n"
+                                   U"    def length() -> float {                  \n"
+                                   U"        if x { return {1: {2: 3}}[1][2]; }   \n"
+                                   U"        return (x * x + y * y) ^ 0.5;        \n"
+                                   U"    }                                        \n"
+                                   U"}                                            \n"
+                                   U"def main(ref int[2] args) {                  \n"
+                                   U"    while true { do { break; } while 1; }    \n"
+                                   U"}                                            \n",
+                                   lex_exceptions};
+    std::shared_ptr<const std::vector<kh::Token>> tokens =
+        std::make_shared<const std::vector<kh::Token>>(kh::lex(lexer_context));
+    KH_TEST_ASSERT(lex_exceptions.empty());
+
+    {
+        std::vector<kh::ParseException> parse_exceptions;
+        kh::ParserContext parser_context{*tokens, parse_exceptions};
+        kh::AstModule eager = kh::parseWhole(parser_context);
+        KH_TEST_ASSERT(parse_exceptions.empty());
+
+        parser_context.ti = 0;
+        parser_context.lazy_tokens = tokens;
+        kh::AstModule module_ast = kh::parseWhole(parser_context);
+        KH_TEST_ASSERT(parse_exceptions.empty());
+
+        /* Named functions and methods are skipped, but not the lambda in the variable */
+        KH_TEST_ASSERT(module_ast.functions.size() == 1);
+        KH_TEST_ASSERT(module_ast.functions[0].body.empty());
+        KH_TEST_ASSERT(module_ast.functions[0].body_end > module_ast.functions[0].body_begin);
+        KH_TEST_ASSERT(module_ast.user_types[0].methods[0].body.empty());
+        KH_TEST_ASSERT(module_ast.user_types[0].methods[0].body_end >
+                       module_ast.user_types[0].methods[0].body_begin);
+        KH_TEST_ASSERT(kh::str(module_ast.variables[0]) == kh::str(eager.variables[0]));
+
+        /* The skipped bodies are parsed into the same ASTs later */
+        KH_TEST_ASSERT(kh::str(module_ast) == kh::str(eager));
+    }
+
+    {
+        /* Errors inside of skipped bodies aren't found until they're parsed, but an unclosed body
+         * still is */
+        std::shared_ptr<const std::vector<kh::Token>> broken =
+            std::make_shared<const std::vector<kh::Token>>(tokens->begin(), tokens->end() - 1);
+        std::vector<kh::ParseException> parse_exceptions;
+        kh::ParserContext parser_context{*broken, parse_exceptions};
+        parser_context.lazy_tokens = broken;
+        kh::parseWhole(parser_context);
+        KH_TEST_ASSERT(parse_exceptions.size() == 1);
+    }
+
+    return;
+error:
+    errors_ptr->back() += "parserSkippedBodyTest";
+}
+
+static void parserLazyTest() {
+    std::u32string source = U"class Point { float x; def length() -> float { return x ^ 0.5; } } \n";
+    for (size_t i = 0; i < 64; i++) {
+        source += U"def f" + kh::decodeUtf8(std::to_string(i)) +
+                  U"(int n) { for i = 0, i < n, i++ { x = [n, {1: 2}][0]; } }\n";
+    }
+    source += U"def broken() { x = (1 + ; }\n";
+
+    std::vector<kh::LexException> lex_exceptions;
+    kh::LexerContext lexer_context{source, lex_exceptions};
+    std::shared_ptr<const std::vector<kh::Token>> tokens =
+        std::make_shared<const std::vector<kh::Token>>(kh::lex(lexer_context));
+    KH_TEST_ASSERT(lex_exceptions.empty());
+
+    {
+        std::vector<kh::ParseException> eager_exceptions;
+        kh::ParserContext eager_context{*tokens, eager_exceptions};
+        kh::AstModule eager = kh::parseWhole(eager_context);
+        KH_TEST_ASSERT(eager_exceptions.size() == 1);
+
+        std::vector<kh::ParseException> parse_exceptions;
+        kh::ParserContext parser_context{*tokens, parse_exceptions};
+        parser_context.lazy_tokens = tokens;
+        kh::AstModule module_ast = kh::parseWhole(parser_context);
+
+        /* The error in the body is only found once it's parsed */
+        KH_TEST_ASSERT(parse_exceptions.empty());
+        KH_TEST_ASSERT(module_ast.functions.size() == 65);
+        KH_TEST_ASSERT(module_ast.functions.back().lazy_body->exceptions().size() == 1);
+
+        /* Every thread gets the same body, parsed once */
+        kh::ThreadPool pool(8);
+        std::vector<const std::vector<std::shared_ptr<kh::AstBody>>*> bodies(256);
+        for (size_t i = 0; i < bodies.size(); i++) {
+            pool.submit([&module_ast, &bodies, i]() {
+                bodies[i] = &module_ast.functions[i % 4].getBody();
+            });
+        }
+        pool.wait();
+
+        for (size_t i = 0; i < bodies.size(); i++) {
+            KH_TEST_ASSERT(bodies[i] == bodies[i % 4]);
+            KH_TEST_ASSERT(!bodies[i]->empty());
+        }
+
+        /* Copies share the lazy body and the tokens outlive the parse */
+        kh::AstModule copy = module_ast;
+        tokens.reset();
+        KH_TEST_ASSERT(&copy.functions[10].getBody() == &module_ast.functions[10].getBody());
+        KH_TEST_ASSERT(kh::str(copy.user_types[0]) == kh::str(eager.user_types[0]));
+
+        for (size_t i = 0; i < 64; i++) {
+            KH_TEST_ASSERT(kh::str(module_ast.functions[i]) == kh::str(eager.functions[i]));
+        }
+    }
+
+    return;
+error:
+    errors_ptr->back() += "parserLazyTest";
+}
+
 void kh_test::parserTest(std::vector<std::string>& errors) {
     errors_ptr = &errors;
     parserImportTest();
+    parserSerialTest();
+    parserSerialForgedTest();
+    parserRecoveryTest();
+    parserNestingTest();
+    parserSkippedBodyTest();
+    parserLazyTest();
 }
@@ -0,0 +1,141 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include <kithare/json.hpp>
+#include <kithare/string.hpp>
+#include <kithare/test.hpp>
+
+
+static std::vector<std::string>* errors_ptr;
+
+static std::string formatFloat(double n) {
+    char buffer[KH_FLOAT_STR_SIZE];
+    return std::string(buffer, kh::formatFloat(buffer, n));
+}
+
+static std::string formatFloat(float n) {
+    char buffer[KH_FLOAT_STR_SIZE];
+    return std::string(buffer, kh::formatFloat(buffer, n));
+}
+
+static void stringQuoteTest() {
+    KH_TEST_ASSERT(kh::quote(std::string("Hello, world!")) == U"\"Hello, world!\"");
+    KH_TEST_ASSERT(kh::quote(std::string("\"\\\t\n\x00\x7f\xff", 7)) ==
+                   U"\"\\\"\\\\\\t\\n\\x00\\x7f\\xff\"");
+    KH_TEST_ASSERT(kh::quote(U"a\u00e9\u0123\u1234\U00012345") ==
+                   U"\"a\\xe9\\u0123\\u1234\\U00012345\"");
+
+    /* Long enough to go through the block copies, with escapes on both sides of a block boundary */
+    KH_TEST_ASSERT(kh::quote(std::string("0123456789abcde\n0123456789abcdef\n")) ==
+                   U"\"0123456789abcde\\n0123456789abcdef\\n\"");
+    return;
+error:
+    errors_ptr->back() += "stringQuoteTest";
+}
+
+static void stringFloatTest() {
+    KH_TEST_ASSERT(formatFloat(0.0) == "0.0");
+    KH_TEST_ASSERT(formatFloat(-0.0) == "-0.0");
+    KH_TEST_ASSERT(formatFloat(0.1) == "0.1");
+    KH_TEST_ASSERT(formatFloat(6.9) == "6.9");
+    KH_TEST_ASSERT(formatFloat(25.0) == "25.0");
+    KH_TEST_ASSERT(formatFloat(-123456.789) == "-123456.789");
+    KH_TEST_ASSERT(formatFloat(0.0001) == "0.0001");
+    KH_TEST_ASSERT(formatFloat(0.00001) == "1e-05");
+    KH_TEST_ASSERT(formatFloat(1e15) == "1000000000000000.0");
+    KH_TEST_ASSERT(formatFloat(1e16) == "1e+16");
+    KH_TEST_ASSERT(formatFloat(1e100) == "1e+100");
+    KH_TEST_ASSERT(formatFloat(5e-324) == "5e-324");
+    KH_TEST_ASSERT(formatFloat(1.7976931348623157e308) == "1.7976931348623157e+308");
+    KH_TEST_ASSERT(formatFloat(std::numeric_limits<double>::infinity()) == "inf");
+    KH_TEST_ASSERT(formatFloat(-std::numeric_limits<double>::infinity()) == "-inf");
+    KH_TEST_ASSERT(formatFloat(std::numeric_limits<double>::quiet_NaN()) == "nan");
+
+    KH_TEST_ASSERT(formatFloat(0.1f) == "0.1");
+    KH_TEST_ASSERT(formatFloat(1e6f) == "1000000.0");
+    KH_TEST_ASSERT(formatFloat(1e7f) == "1e+07");
+    KH_TEST_ASSERT(formatFloat(3.4028235e38f) == "3.4028235e+38");
+    return;
+error:
+    errors_ptr->back() += "stringFloatTest";
+}
+
+static void stringFloatRoundTripTest() {
+    /* Walks through doubles of every magnitude with an xorshift generator */
+    uint64_t state = 0x2545F4914F6CDD1D;
+
+    for (size_t i = 0; i < 100000; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        double n;
+        std::memcpy(&n, &state, sizeof(n));
+        if (n != n) {
+            continue;
+        }
+
+        double read = std::strtod(formatFloat(n).c_str(), nullptr);
+        KH_TEST_ASSERT(std::memcmp(&read, &n, sizeof(n)) == 0);
+
+        float f;
+        uint32_t bits = (uint32_t)state;
+        std::memcpy(&f, &bits, sizeof(f));
+        if (f != f) {
+            continue;
+        }
+
+        float read_f = std::strtof(formatFloat(f).c_str(), nullptr);
+        KH_TEST_ASSERT(std::memcmp(&read_f, &f, sizeof(f)) == 0);
+    }
+    return;
+error:
+    errors_ptr->back() += "stringFloatRoundTripTest";
+}
+
+static void stringJsonTest() {
+    std::string output;
+    {
+        kh::Sink sink(output);
+        kh::JsonWriter json(sink);
+
+        json.beginObject();
+        json.member("empty", std::vector<std::string>{}.empty());
+        json.key("list");
+        json.beginArray();
+        json.value((int64_t)-1);
+        json.value(0.5);
+        json.value(std::numeric_limits<double>::infinity());
+        json.beginObject();
+        json.endObject();
+        json.endArray();
+        json.member("name", std::string("a\"b\\c\n\x01"));
+        json.member("text", std::u32string(U"ሴ\U0001F600") + (char32_t)0xD800);
+        json.key("buffer");
+        json.buffer("\xff\t");
+        json.endObject();
+    }
+
+    KH_TEST_ASSERT(output == "{\"empty\":true,\"list\":[-1,0.5,null,{}],"
+                             "\"name\":\"a\\\"b\\\\c\\n\\u0001\","
+                             "\"text\":\"\xe1\x88\xb4\xf0\x9f\x98\x80\\ufffd\","
+                             "\"buffer\":\"\xc3\xbf\\t\"}");
+    return;
+error:
+    errors_ptr->back() += "stringJsonTest";
+}
+
+void kh_test::stringTest(std::vector<std::string>& errors) {
+    errors_ptr = &errors;
+    stringQuoteTest();
+    stringFloatTest();
+    stringFloatRoundTripTest();
+    stringJsonTest();
+}
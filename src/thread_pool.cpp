@@ -0,0 +1,99 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <kithare/thread_pool.hpp>
+
+
+kh::ThreadPool::ThreadPool(size_t workers) {
+    if (workers == 0) {
+        workers = std::thread::hardware_concurrency();
+    }
+
+    /* `hardware_concurrency` may return 0 if it's not computable */
+    if (workers == 0) {
+        workers = 1;
+    }
+
+    this->workers.reserve(workers);
+    for (size_t i = 0; i < workers; i++) {
+        this->workers.emplace_back(&kh::ThreadPool::work, this);
+    }
+}
+
+kh::ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+
+    this->task_available.notify_all();
+    for (std::thread& worker : this->workers) {
+        worker.join();
+    }
+}
+
+void kh::ThreadPool::submit(const std::function<void()>& task) {
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->tasks.push_back(task);
+    }
+
+    this->task_available.notify_one();
+}
+
+void kh::ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->task_done.wait(lock, [this] { return this->tasks.empty() && this->running == 0; });
+
+    if (this->exception) {
+        std::exception_ptr exception = this->exception;
+        this->exception = nullptr;
+        std::rethrow_exception(exception);
+    }
+}
+
+size_t kh::ThreadPool::size() const {
+    return this->workers.size();
+}
+
+void kh::ThreadPool::work() {
+    while (true) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->task_available.wait(lock, [this] { return this->stopping || !this->tasks.empty(); });
+
+            /* Finishes the queued tasks first before stopping */
+            if (this->tasks.empty()) {
+                return;
+            }
+
+            task = std::move(this->tasks.front());
+            this->tasks.pop_front();
+            this->running++;
+        }
+
+        /* A task throwing mustn't take down the worker, and the whole process with it */
+        std::exception_ptr exception;
+        try {
+            task();
+        }
+        catch (...) {
+            exception = std::current_exception();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->running--;
+            if (exception && !this->exception) {
+                this->exception = exception;
+            }
+        }
+
+        this->task_done.notify_all();
+    }
+}
@@ -0,0 +1,224 @@
+/*
+ * This file is a part of the Kithare programming language source code.
+ * The source code for Kithare programming language is distributed under the MIT license.
+ * Copyright (C) 2021 Kithare Organization
+ */
+
+#include <algorithm>
+#include <set>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <kithare/watcher.hpp>
+
+/* How long the watcher waits for more events after the first one before reporting the changes */
+#define KH_WATCH_SETTLE_MS 50
+
+
+std::string kh::WatchException::format() const {
+    return this->what;
+}
+
+#ifndef __linux__
+std::vector<std::string> kh::findSources(const std::string& directory) {
+    throw kh::WatchException("watch mode is only supported on Linux");
+}
+
+kh::Watcher::Watcher(const std::string& _directory) : directory(_directory) {
+    throw kh::WatchException("watch mode is only supported on Linux");
+}
+
+kh::Watcher::~Watcher() {}
+
+std::vector<std::string> kh::Watcher::wait() {
+    return {};
+}
+
+void kh::Watcher::watchTree(const std::string& path, std::vector<std::string>* new_sources) {}
+#else
+static bool isSource(const std::string& name) {
+    return name.size() > 3 && name.compare(name.size() - 3, 3, ".kh") == 0;
+}
+
+/* Calls `on_dir` for `path` and every directory under it and collects the source files found.
+ * Symbolic links are followed, the directories already walked are skipped so links looping back
+ * up the tree don't recurse forever */
+template <typename T>
+static void walkTree(const std::string& path, std::vector<std::string>& sources, const T& on_dir,
+                     std::set<std::pair<dev_t, ino_t>>& visited) {
+    struct stat dir_info;
+    if (stat(path.c_str(), &dir_info) < 0 ||
+        !visited.insert(std::make_pair(dir_info.st_dev, dir_info.st_ino)).second) {
+        return;
+    }
+
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        return;
+    }
+
+    on_dir(path);
+
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+
+        std::string entry_path = path + '/' + name;
+        struct stat info;
+        if (stat(entry_path.c_str(), &info) < 0) {
+            continue;
+        }
+
+        if (S_ISDIR(info.st_mode)) {
+            walkTree(entry_path, sources, on_dir, visited);
+        }
+        else if (S_ISREG(info.st_mode) && isSource(name)) {
+            sources.push_back(entry_path);
+        }
+    }
+
+    closedir(dir);
+}
+
+template <typename T>
+static void walkTree(const std::string& path, std::vector<std::string>& sources, const T& on_dir) {
+    std::set<std::pair<dev_t, ino_t>> visited;
+    walkTree(path, sources, on_dir, visited);
+}
+
+std::vector<std::string> kh::findSources(const std::string& directory) {
+    std::vector<std::string> sources;
+    walkTree(directory, sources, [](const std::string&) {});
+
+    std::sort(sources.begin(), sources.end());
+    return sources;
+}
+
+kh::Watcher::Watcher(const std::string& _directory) : directory(_directory) {
+    this->fd = inotify_init1(IN_CLOEXEC);
+    if (this->fd < 0) {
+        throw kh::WatchException("unable to initialize inotify: " +
+                                 std::string(std::strerror(errno)));
+    }
+
+    this->watchTree(this->directory, nullptr);
+    if (this->watched_dirs.empty()) {
+        close(this->fd);
+        throw kh::WatchException("unable to watch the directory `" + this->directory + "`");
+    }
+}
+
+kh::Watcher::~Watcher() {
+    close(this->fd);
+}
+
+void kh::Watcher::watchTree(const std::string& path, std::vector<std::string>* new_sources) {
+    std::vector<std::string> sources;
+
+    /* Saving by renaming a temporary file over the source is reported as `IN_MOVED_TO`, while
+     * `IN_CLOSE_WRITE` is used instead of `IN_MODIFY` so a save is only reported once */
+    walkTree(path, sources, [this](const std::string& dir_path) {
+        int wd = inotify_add_watch(this->fd, dir_path.c_str(),
+                                   IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE |
+                                       IN_DELETE | IN_ONLYDIR);
+        if (wd >= 0) {
+            this->watched_dirs[wd] = dir_path;
+        }
+    });
+
+    if (new_sources) {
+        new_sources->insert(new_sources->end(), sources.begin(), sources.end());
+    }
+}
+
+std::vector<std::string> kh::Watcher::wait() {
+    std::set<std::string> changed;
+    alignas(inotify_event) char buffer[4096];
+    int timeout = -1;
+
+    while (true) {
+        pollfd poll_fd = {this->fd, POLLIN, 0};
+        int ready = poll(&poll_fd, 1, timeout);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready < 0) {
+            throw kh::WatchException("unable to poll inotify: " + std::string(std::strerror(errno)));
+        }
+
+        /* The burst of events has settled */
+        if (ready == 0) {
+            if (!changed.empty()) {
+                break;
+            }
+
+            timeout = -1;
+            continue;
+        }
+
+        ssize_t size = read(this->fd, buffer, sizeof(buffer));
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size < 0) {
+            throw kh::WatchException("unable to read inotify events: " +
+                                     std::string(std::strerror(errno)));
+        }
+
+        for (char* ptr = buffer; ptr < buffer + size;) {
+            const inotify_event* event = (const inotify_event*)ptr;
+            ptr += sizeof(inotify_event) + event->len;
+
+            /* Events got dropped, so every source is rescanned and reported as changed */
+            if (event->mask & IN_Q_OVERFLOW) {
+                std::vector<std::string> sources;
+                this->watchTree(this->directory, &sources);
+                changed.insert(sources.begin(), sources.end());
+                continue;
+            }
+
+            if (event->mask & IN_IGNORED) {
+                this->watched_dirs.erase(event->wd);
+                continue;
+            }
+
+            auto dir = this->watched_dirs.find(event->wd);
+            if (dir == this->watched_dirs.end() || !event->len) {
+                continue;
+            }
+
+            std::string path = dir->second + '/' + event->name;
+
+            /* Watches newly created directories, the files which got in there before the watch got
+             * added would be missed otherwise */
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    std::vector<std::string> new_sources;
+                    this->watchTree(path, &new_sources);
+                    changed.insert(new_sources.begin(), new_sources.end());
+                }
+                continue;
+            }
+
+            /* A newly created file is reported once it's closed after being written */
+            if (!(event->mask & IN_CREATE) && isSource(event->name)) {
+                changed.insert(path);
+            }
+        }
+
+        timeout = KH_WATCH_SETTLE_MS;
+    }
+
+    return std::vector<std::string>(changed.begin(), changed.end());
+}
+#endif